@@ -8,6 +8,15 @@
 # The bundle will have the format: number of certificates; crt 1 subject name length; crt 1 public key length;
 # crt 1 subject name; crt 1 public key; crt 2...
 #
+# With --indexed the entries are preceded by a subject-hash index, so the firmware can find the
+# issuer of a certificate by binary search: magic 'CAIX'; number of certificates; then, for each
+# certificate, the 32-bit FNV-1a hash of its subject name and the offset of its entry from the start
+# of the bundle, sorted by hash. The entries that follow keep the format above. All fields are
+# big-endian.
+#
+# --include keeps only the certificates whose subject contains one of the given strings, and
+# --reindex converts an existing bundle without parsing the certificates again.
+#
 # SPDX-FileCopyrightText: 2018-2022 Espressif Systems (Shanghai) CO LTD
 # SPDX-License-Identifier: Apache-2.0
 
@@ -26,13 +35,13 @@ try:
     from cryptography.hazmat.backends import default_backend
     from cryptography.hazmat.primitives import serialization
 except ImportError:
-    print('The cryptography package is not installed.'
-          'Please refer to the Get Started section of the ESP-IDF Programming Guide for '
-          'setting up the required packages.')
-    raise
+    # Only needed to parse certificates; --reindex works without it
+    x509 = None
 
 ca_bundle_bin_file = 'x509_crt_bundle'
 
+indexed_bundle_magic = b'CAIX'
+
 quiet = False
 
 
@@ -49,6 +58,63 @@ def critical(msg):
     sys.stderr.write('\n')
 
 
+def subject_hash(sub_name_der):
+    """ 32-bit FNV-1a of the DER subject name, the key of the bundle index """
+    h = 0x811c9dc5
+    for byte in bytearray(sub_name_der):
+        h = ((h ^ byte) * 0x01000193) & 0xffffffff
+    return h
+
+
+def pack_bundle(entries, indexed):
+    """ Pack a list of (subject name DER, public key DER) tuples """
+    if not indexed:
+        # Sort certificates in order to do binary search when looking up certificates
+        entries = sorted(entries, key=lambda entry: entry[0])
+        bundle = struct.pack('>H', len(entries))
+        for sub_name_der, pub_key_der in entries:
+            bundle += struct.pack('>HH', len(sub_name_der), len(pub_key_der)) + sub_name_der + pub_key_der
+        return bundle
+
+    entries = sorted(entries, key=lambda entry: (subject_hash(entry[0]), entry[0]))
+    header_len = len(indexed_bundle_magic) + 2 + 8 * len(entries)
+
+    index = b''
+    data = b''
+    for sub_name_der, pub_key_der in entries:
+        index += struct.pack('>II', subject_hash(sub_name_der), header_len + len(data))
+        data += struct.pack('>HH', len(sub_name_der), len(pub_key_der)) + sub_name_der + pub_key_der
+
+    return indexed_bundle_magic + struct.pack('>H', len(entries)) + index + data
+
+
+def unpack_bundle(bundle):
+    """ Read the (subject name DER, public key DER) tuples of an existing bundle """
+    offset = 0
+    if bundle.startswith(indexed_bundle_magic):
+        offset = len(indexed_bundle_magic)
+    count, = struct.unpack_from('>H', bundle, offset)
+    offset += 2
+    if offset != 2:
+        offset += 8 * count
+
+    entries = []
+    for _ in range(count):
+        name_len, key_len = struct.unpack_from('>HH', bundle, offset)
+        offset += 4
+        entries.append((bundle[offset:offset + name_len], bundle[offset + name_len:offset + name_len + key_len]))
+        offset += name_len + key_len
+        if offset > len(bundle):
+            raise InputError('Truncated certificate bundle')
+
+    return entries
+
+
+def selected(subject, include):
+    """ True if no --include was given or the subject contains one of its strings """
+    return not include or any(pattern in subject for pattern in include)
+
+
 class CertificateBundle:
     def __init__(self):
         self.certificates = []
@@ -116,13 +182,12 @@ class CertificateBundle:
         self.certificates.append(x509.load_der_x509_certificate(crt_str, default_backend()))
         status('Successfully added 1 certificate')
 
-    def create_bundle(self):
-        # Sort certificates in order to do binary search when looking up certificates
-        self.certificates = sorted(self.certificates, key=lambda cert: cert.subject.public_bytes(default_backend()))
-
-        bundle = struct.pack('>H', len(self.certificates))
-
+    def create_bundle(self, include=None, indexed=False):
+        entries = []
         for crt in self.certificates:
+            if not selected(crt.subject.rfc4514_string(), include):
+                continue
+
             """ Read the public key as DER format """
             pub_key = crt.public_key()
             pub_key_der = pub_key.public_bytes(serialization.Encoding.DER, serialization.PublicFormat.SubjectPublicKeyInfo)
@@ -130,15 +195,12 @@ class CertificateBundle:
             """ Read the subject name as DER format """
             sub_name_der = crt.subject.public_bytes(default_backend())
 
-            name_len = len(sub_name_der)
-            key_len = len(pub_key_der)
-            len_data = struct.pack('>HH', name_len, key_len)
+            entries.append((sub_name_der, pub_key_der))
 
-            bundle += len_data
-            bundle += sub_name_der
-            bundle += pub_key_der
+        if include:
+            status('Kept %d of %d certificates' % (len(entries), len(self.certificates)))
 
-        return bundle
+        return pack_bundle(entries, indexed)
 
     def add_with_filter(self, crts_path, filter_path):
 
@@ -178,15 +240,41 @@ def main():
     parser = argparse.ArgumentParser(description='ESP-IDF x509 certificate bundle utility')
 
     parser.add_argument('--quiet', '-q', help="Don't print non-critical status messages to stderr", action='store_true')
-    parser.add_argument('--input', '-i', nargs='+', required=True,
+    parser.add_argument('--input', '-i', nargs='+',
                         help='Paths to the custom certificate folders or files to parse, parses all .pem or .der files')
     parser.add_argument('--filter', '-f', help='Path to CSV-file where the second columns contains the name of the certificates \
                         that should be included from cacrt_all.pem')
+    parser.add_argument('--include', '-s', nargs='+',
+                        help='Keep only the certificates whose subject contains one of these strings, e.g. "CN=ISRG Root X1". \
+                        The subject is matched in RFC 4514 form, or as raw DER bytes with --reindex')
+    parser.add_argument('--indexed', '-x', action='store_true',
+                        help='Emit the bundle with a sorted subject-hash index for binary search lookups')
+    parser.add_argument('--reindex', '-r', help='Path to an existing bundle to convert instead of parsing certificates; \
+                        applies --include and --indexed to its entries')
 
     args = parser.parse_args()
 
     quiet = args.quiet
 
+    if args.reindex:
+        with open(args.reindex, 'rb') as f:
+            entries = unpack_bundle(f.read())
+        kept = [entry for entry in entries if selected(entry[0].decode('latin-1'), args.include)]
+        status('Kept %d of %d certificates' % (len(kept), len(entries)))
+
+        with open(ca_bundle_bin_file, 'wb') as f:
+            f.write(pack_bundle(kept, args.indexed))
+        return
+
+    if not args.input:
+        raise InputError('Either --input or --reindex is required')
+
+    if x509 is None:
+        print('The cryptography package is not installed.'
+              'Please refer to the Get Started section of the ESP-IDF Programming Guide for '
+              'setting up the required packages.')
+        sys.exit(2)
+
     bundle = CertificateBundle()
 
     for path in args.input:
@@ -202,7 +290,7 @@ def main():
 
     status('Successfully added %d certificates in total' % len(bundle.certificates))
 
-    crt_bundle = bundle.create_bundle()
+    crt_bundle = bundle.create_bundle(args.include, args.indexed)
 
     with open(ca_bundle_bin_file, 'wb') as f:
         f.write(crt_bundle)
@@ -0,0 +1,254 @@
+#include "actualizacion_ota.h"
+
+#include <string.h>
+
+ActualizacionOTA actualizacionOTA;
+
+ActualizacionOTA::ActualizacionOTA(void)
+    : estadoActual(OTA_INACTIVA), pedido(PEDIDO_NINGUNO), bytesEscritos(0), causaFallo(NULL), tamanoImagen(0),
+      siguiente(0), manejador(0), particion(NULL)
+{
+  memset(hashEsperado, 0, sizeof(hashEsperado));
+}
+
+/**
+ * @brief Hay una transferencia que todavia no termino ni fallo
+ */
+bool ActualizacionOTA::ocupada(void) const
+{
+  uint8_t actual = estadoActual.load(std::memory_order_acquire);
+  return actual == OTA_PREPARANDO || actual == OTA_RECIBIENDO;
+}
+
+bool ActualizacionOTA::iniciar(uint32_t tamano, const uint8_t *hash)
+{
+  if (tamano == 0)
+  {
+    return false;
+  }
+
+  if (ocupada() || estado() == OTA_LISTA)
+  {
+    // La misma imagen se reanuda desde siguiente; otra no se mezcla con esta
+    return ocupada() && tamano == tamanoImagen && memcmp(hash, hashEsperado, LONGITUD_HASH_OTA) == 0;
+  }
+
+  // En reposo el lado de la escritura no toca el estado: se puede fijar desde aqui
+  tamanoImagen = tamano;
+  memcpy(hashEsperado, hash, LONGITUD_HASH_OTA);
+  siguiente = 0;
+  bytesEscritos.store(0, std::memory_order_relaxed);
+  causaFallo = NULL;
+  estadoActual.store(OTA_PREPARANDO, std::memory_order_release);
+  return true;
+}
+
+void ActualizacionOTA::cancelar(void)
+{
+  pedido.store(PEDIDO_CANCELAR, std::memory_order_release);
+}
+
+bool ActualizacionOTA::aceptaBloque(void) const
+{
+  return estado() == OTA_RECIBIENDO && siguiente < tamanoImagen && cola.tamano() < BLOQUES_OTA_EN_COLA;
+}
+
+bool ActualizacionOTA::recibirBloque(uint32_t desplazamiento, const uint8_t *datos, uint16_t longitud)
+{
+  if (estado() != OTA_RECIBIENDO || desplazamiento != siguiente || longitud == 0 || longitud > TAMANO_BLOQUE_OTA ||
+      longitud > tamanoImagen - siguiente)
+  {
+    return false;
+  }
+
+  entrante.desplazamiento = desplazamiento;
+  entrante.longitud = longitud;
+  memcpy(entrante.datos, datos, longitud);
+  if (!cola.encolar(entrante))
+  {
+    return false;
+  }
+  siguiente += longitud;
+  return true;
+}
+
+uint32_t ActualizacionOTA::siguienteDesplazamiento(void) const
+{
+  return siguiente;
+}
+
+EstadoOTA ActualizacionOTA::estado(void) const
+{
+  return (EstadoOTA)estadoActual.load(std::memory_order_acquire);
+}
+
+uint32_t ActualizacionOTA::tamano(void) const
+{
+  return tamanoImagen;
+}
+
+uint32_t ActualizacionOTA::escritos(void) const
+{
+  return bytesEscritos.load(std::memory_order_relaxed);
+}
+
+const char *ActualizacionOTA::motivo(void) const
+{
+  return causaFallo;
+}
+
+bool ActualizacionOTA::procesar(void)
+{
+  if (pedido.exchange(PEDIDO_NINGUNO, std::memory_order_acq_rel) == PEDIDO_CANCELAR && ocupada())
+  {
+    if (estado() == OTA_RECIBIENDO)
+    {
+      esp_ota_abort(manejador);
+      mbedtls_sha256_free(&contextoHash);
+    }
+    while (cola.desencolar(saliente))
+    {
+    }
+    estadoActual.store(OTA_INACTIVA, std::memory_order_release);
+    return true;
+  }
+
+  switch (estado())
+  {
+  case OTA_PREPARANDO:
+    preparar();
+    return true;
+
+  case OTA_RECIBIENDO:
+    if (!cola.desencolar(saliente))
+    {
+      return false;
+    }
+    escribir(saliente);
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Abre la particion inactiva y empieza el hash
+ */
+void ActualizacionOTA::preparar(void)
+{
+  // Bloques de una transferencia anterior que se encolaron mientras se cancelaba
+  while (cola.desencolar(saliente))
+  {
+  }
+
+  particion = esp_ota_get_next_update_partition(NULL);
+  if (particion == NULL)
+  {
+    causaFallo = "sin particion OTA";
+    estadoActual.store(OTA_FALLIDA, std::memory_order_release);
+    return;
+  }
+  if (tamanoImagen > particion->size)
+  {
+    causaFallo = "imagen mayor que la particion";
+    estadoActual.store(OTA_FALLIDA, std::memory_order_release);
+    return;
+  }
+  if (esp_ota_begin(particion, OTA_WITH_SEQUENTIAL_WRITES, &manejador) != ESP_OK)
+  {
+    causaFallo = "esp_ota_begin";
+    estadoActual.store(OTA_FALLIDA, std::memory_order_release);
+    return;
+  }
+
+  mbedtls_sha256_init(&contextoHash);
+  mbedtls_sha256_starts_ret(&contextoHash, 0);
+  estadoActual.store(OTA_RECIBIENDO, std::memory_order_release);
+}
+
+/**
+ * @brief Escribe un bloque en flash y, con el ultimo, cierra la imagen
+ */
+void ActualizacionOTA::escribir(const BloqueOTA &bloque)
+{
+  uint32_t escritosAntes = bytesEscritos.load(std::memory_order_relaxed);
+  if (bloque.desplazamiento != escritosAntes)
+  {
+    fallar("bloque fuera de orden");
+    return;
+  }
+  if (esp_ota_write(manejador, bloque.datos, bloque.longitud) != ESP_OK)
+  {
+    fallar("esp_ota_write");
+    return;
+  }
+  mbedtls_sha256_update_ret(&contextoHash, bloque.datos, bloque.longitud);
+  bytesEscritos.store(escritosAntes + bloque.longitud, std::memory_order_relaxed);
+
+  if (escritosAntes + bloque.longitud == tamanoImagen)
+  {
+    terminar();
+  }
+}
+
+/**
+ * @brief Verifica el hash y la imagen y la deja como particion de arranque
+ */
+void ActualizacionOTA::terminar(void)
+{
+  uint8_t calculado[LONGITUD_HASH_OTA];
+  mbedtls_sha256_finish_ret(&contextoHash, calculado);
+  if (memcmp(calculado, hashEsperado, LONGITUD_HASH_OTA) != 0)
+  {
+    fallar("SHA-256 distinto");
+    return;
+  }
+  mbedtls_sha256_free(&contextoHash);
+
+  // esp_ota_end() libera el manejador aun si la imagen no es valida
+  if (esp_ota_end(manejador) != ESP_OK)
+  {
+    causaFallo = "imagen invalida";
+    estadoActual.store(OTA_FALLIDA, std::memory_order_release);
+    return;
+  }
+  if (esp_ota_set_boot_partition(particion) != ESP_OK)
+  {
+    causaFallo = "esp_ota_set_boot_partition";
+    estadoActual.store(OTA_FALLIDA, std::memory_order_release);
+    return;
+  }
+  estadoActual.store(OTA_LISTA, std::memory_order_release);
+}
+
+/**
+ * @brief Aborta la escritura en curso
+ */
+void ActualizacionOTA::fallar(const char *causa)
+{
+  esp_ota_abort(manejador);
+  mbedtls_sha256_free(&contextoHash);
+  while (cola.desencolar(saliente))
+  {
+  }
+  causaFallo = causa;
+  estadoActual.store(OTA_FALLIDA, std::memory_order_release);
+}
+
+bool ActualizacionOTA::pendienteDeValidar(void)
+{
+  esp_ota_img_states_t estadoImagen;
+  return esp_ota_get_state_partition(esp_ota_get_running_partition(), &estadoImagen) == ESP_OK &&
+         estadoImagen == ESP_OTA_IMG_PENDING_VERIFY;
+}
+
+bool ActualizacionOTA::confirmarArranque(void)
+{
+  return esp_ota_mark_app_valid_cancel_rollback() == ESP_OK;
+}
+
+void ActualizacionOTA::revertir(void)
+{
+  esp_ota_mark_app_invalid_rollback_and_reboot();
+}
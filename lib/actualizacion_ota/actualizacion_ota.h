@@ -0,0 +1,160 @@
+#ifndef ACTUALIZACION_OTA_H
+#define ACTUALIZACION_OTA_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "esp_ota_ops.h"
+#include "mbedtls/sha256.h"
+#include "cola_spsc.h"
+
+/**
+ * @file actualizacion_ota.h
+ * @brief Actualizacion del firmware por bloques, escrita en flash a medida que llega
+ *
+ * La imagen llega por MQTT en bloques con su desplazamiento. El lado de la
+ * red (la tarea que atiende el callback) los valida y los copia a una cola
+ * corta; el lado de la escritura, una tarea de prioridad minima, los pasa
+ * a la particion OTA inactiva con esp_ota_write() y los agrega al SHA-256.
+ * Nunca hay en RAM mas que BLOQUES_OTA_EN_COLA bloques.
+ *
+ * El borrado de la particion es por sector, a medida que se escribe
+ * (OTA_WITH_SEQUENTIAL_WRITES): cada operacion de flash detiene la cache
+ * de ambos nucleos, y un borrado completo al iniciar los detendria por
+ * segundos.
+ *
+ * La transferencia se reanuda donde quedo: el lado de la red solo acepta
+ * el bloque que empieza en siguienteDesplazamiento(), y quien envia la
+ * imagen pide siempre ese. Un reinicio la empieza de nuevo.
+ *
+ * Al terminar se compara el SHA-256 con el anunciado, esp_ota_end() valida
+ * la imagen y la particion queda como la de arranque. El firmware nuevo
+ * arranca pendiente de validar: si no confirma con confirmarArranque()
+ * antes de reiniciarse, el bootloader vuelve a la particion anterior.
+ */
+
+#define TAMANO_BLOQUE_OTA 512  ///< Mayor bloque de imagen aceptado (debe caber en el buffer MQTT)
+#define BLOQUES_OTA_EN_COLA 4  ///< Bloques en espera de escritura (potencia de dos)
+#define LONGITUD_HASH_OTA 32   ///< Bytes del SHA-256 de la imagen
+
+/**
+ * @brief Estados de la actualizacion
+ */
+enum EstadoOTA : uint8_t
+{
+  OTA_INACTIVA = 0, ///< Sin transferencia
+  OTA_PREPARANDO,   ///< Pedida, a la espera de abrir la particion
+  OTA_RECIBIENDO,   ///< Aceptando bloques
+  OTA_LISTA,        ///< Imagen verificada; la proxima arranca con ella
+  OTA_FALLIDA       ///< Abortada; motivo() dice por que
+};
+
+/**
+ * @brief Bloque de imagen en espera de escritura
+ */
+struct BloqueOTA
+{
+  uint32_t desplazamiento;
+  uint16_t longitud;
+  uint8_t datos[TAMANO_BLOQUE_OTA];
+};
+
+class ActualizacionOTA
+{
+public:
+  ActualizacionOTA(void);
+
+  /**
+   * @brief Pide una transferencia nueva o reanuda la que esta en curso (lado de la red)
+   * @param tamano Bytes de la imagen
+   * @param hash SHA-256 de la imagen
+   * @return false si hay otra imagen en curso o lista, o el tamano es 0
+   */
+  bool iniciar(uint32_t tamano, const uint8_t *hash);
+
+  /**
+   * @brief Pide abortar la transferencia en curso (lado de la red)
+   */
+  void cancelar(void);
+
+  /**
+   * @brief Encola un bloque de la imagen (lado de la red)
+   * @return false si no es el bloque esperado, no cabe o la cola esta llena
+   */
+  bool recibirBloque(uint32_t desplazamiento, const uint8_t *datos, uint16_t longitud);
+
+  /**
+   * @brief Indica si recibirBloque() aceptaria ahora el siguiente bloque (lado de la red)
+   */
+  bool aceptaBloque(void) const;
+
+  /// Primer byte que falta recibir (lado de la red)
+  uint32_t siguienteDesplazamiento(void) const;
+
+  EstadoOTA estado(void) const;
+  uint32_t tamano(void) const;
+
+  /// Bytes ya escritos en flash
+  uint32_t escritos(void) const;
+
+  /// Motivo del ultimo fallo, o NULL
+  const char *motivo(void) const;
+
+  /**
+   * @brief Atiende la cancelacion, la preparacion o un bloque (lado de la escritura)
+   * @return true si hizo algo; false si no habia trabajo
+   */
+  bool procesar(void);
+
+  /**
+   * @brief Indica si el firmware en ejecucion es una actualizacion aun sin validar
+   */
+  static bool pendienteDeValidar(void);
+
+  /**
+   * @brief Da por bueno el firmware en ejecucion y cancela la vuelta atras
+   */
+  static bool confirmarArranque(void);
+
+  /**
+   * @brief Marca el firmware en ejecucion como invalido y reinicia en el anterior
+   */
+  static void revertir(void);
+
+private:
+  enum Pedido : uint8_t
+  {
+    PEDIDO_NINGUNO = 0,
+    PEDIDO_CANCELAR
+  };
+
+  bool ocupada(void) const;
+  void preparar(void);
+  void escribir(const BloqueOTA &bloque);
+  void terminar(void);
+  void fallar(const char *causa);
+
+  std::atomic<uint8_t> estadoActual;
+  std::atomic<uint8_t> pedido;
+  std::atomic<uint32_t> bytesEscritos;
+  const char *volatile causaFallo;
+
+  // Los fija el lado de la red antes de pasar a OTA_PREPARANDO
+  uint32_t tamanoImagen;
+  uint8_t hashEsperado[LONGITUD_HASH_OTA];
+
+  // Solo el lado de la red
+  uint32_t siguiente;
+  BloqueOTA entrante;
+
+  // Solo el lado de la escritura
+  BloqueOTA saliente;
+  esp_ota_handle_t manejador;
+  const esp_partition_t *particion;
+  mbedtls_sha256_context contextoHash;
+
+  ColaSPSC<BloqueOTA, BLOQUES_OTA_EN_COLA> cola;
+};
+
+extern ActualizacionOTA actualizacionOTA;
+
+#endif
@@ -0,0 +1,43 @@
+#include "backoff.h"
+
+#include <Arduino.h>
+
+Backoff::Backoff(uint32_t esperaBaseMs, uint32_t esperaMaximaMs)
+    : esperaBaseMs(esperaBaseMs), esperaMaximaMs(esperaMaximaMs), fallos(0)
+{
+}
+
+uint32_t Backoff::siguienteEsperaMs(void)
+{
+  uint32_t nominal = esperaBaseMs;
+  for (uint16_t i = 0; i < fallos && nominal < esperaMaximaMs; i++)
+  {
+    nominal *= 2;
+  }
+  if (nominal > esperaMaximaMs)
+  {
+    nominal = esperaMaximaMs;
+  }
+
+  if (fallos < UINT16_MAX)
+  {
+    fallos++;
+  }
+
+  return nominal / 2 + (uint32_t)random((long)(nominal / 2) + 1);
+}
+
+uint32_t Backoff::esperaInicialMs(void) const
+{
+  return (uint32_t)random((long)esperaBaseMs + 1);
+}
+
+void Backoff::reiniciar(void)
+{
+  fallos = 0;
+}
+
+uint16_t Backoff::intentos(void) const
+{
+  return fallos;
+}
@@ -0,0 +1,55 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <stdint.h>
+
+/**
+ * @file backoff.h
+ * @brief Espera exponencial con fluctuacion aleatoria entre reintentos
+ *
+ * La espera nominal se duplica en cada fallo, desde esperaBaseMs hasta
+ * esperaMaximaMs. La espera real se elige al azar entre la mitad y el
+ * total de la nominal ("equal jitter"), de modo que dispositivos que
+ * pierden la conexion al mismo tiempo no reintentan en sincronia contra
+ * el broker.
+ */
+class Backoff
+{
+public:
+  /**
+   * @param esperaBaseMs Espera nominal tras el primer fallo
+   * @param esperaMaximaMs Tope de la espera nominal
+   */
+  Backoff(uint32_t esperaBaseMs, uint32_t esperaMaximaMs);
+
+  /**
+   * @brief Calcula la espera antes del siguiente reintento y cuenta el fallo
+   * @return Milisegundos a esperar
+   */
+  uint32_t siguienteEsperaMs(void);
+
+  /**
+   * @brief Espera aleatoria entre 0 y esperaBaseMs para el primer intento
+   *
+   * Sirve para repartir en el tiempo la primera reconexion tras una caida
+   * que afecta a toda la flota a la vez (reinicio del broker).
+   */
+  uint32_t esperaInicialMs(void) const;
+
+  /**
+   * @brief Vuelve a la espera base tras una conexion exitosa
+   */
+  void reiniciar(void);
+
+  /**
+   * @brief Fallos consecutivos desde el ultimo reinicio
+   */
+  uint16_t intentos(void) const;
+
+private:
+  uint32_t esperaBaseMs;
+  uint32_t esperaMaximaMs;
+  uint16_t fallos;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef BANDA_MUERTA_H
+#define BANDA_MUERTA_H
+
+#include <stdint.h>
+#include <math.h>
+
+/**
+ * @file banda_muerta.h
+ * @brief Reporte por cambio (banda muerta) con latido de silencio maximo
+ *
+ * Un valor solo se publica si se aleja del ultimo valor publicado mas que
+ * la banda muerta, o si el topico lleva mas de silencioMaximoMs sin
+ * publicarse. El latido permite al backend distinguir un valor estable de
+ * un dispositivo caido.
+ */
+
+/**
+ * @brief Parametros de reporte de un topico
+ */
+struct ConfiguracionReporte
+{
+  float bandaMuerta;         ///< Cambio minimo para publicar (<= 0: publicar siempre)
+  uint32_t silencioMaximoMs; ///< Tiempo maximo sin publicar (0: sin latido)
+};
+
+/**
+ * @brief Estado de reporte por cambio de un topico
+ */
+class ReportePorCambio
+{
+public:
+  ReportePorCambio(void) : ultimoValor(0.0f), ultimaPublicacionMs(0), publicado(false)
+  {
+  }
+
+  /**
+   * @brief Decide si un valor nuevo debe publicarse
+   * @param configuracion Parametros del topico
+   * @param valor Valor candidato
+   * @param ahoraMs Marca de tiempo actual (millis)
+   * @return true si supera la banda muerta, no hay banda o vencio el latido
+   */
+  bool debePublicar(const ConfiguracionReporte &configuracion, float valor, uint32_t ahoraMs) const
+  {
+    if (!publicado)
+    {
+      return true;
+    }
+    // Sin banda se publica todo, tambien un valor repetido
+    if (configuracion.bandaMuerta <= 0.0f || fabsf(valor - ultimoValor) > configuracion.bandaMuerta)
+    {
+      return true;
+    }
+    return configuracion.silencioMaximoMs > 0 &&
+           ahoraMs - ultimaPublicacionMs >= configuracion.silencioMaximoMs;
+  }
+
+  /**
+   * @brief Registra que el valor se publico con exito
+   *
+   * Solo debe llamarse si la publicacion tuvo exito, para que un fallo se
+   * reintente con la siguiente muestra.
+   */
+  void registrarPublicacion(float valor, uint32_t ahoraMs)
+  {
+    ultimoValor = valor;
+    ultimaPublicacionMs = ahoraMs;
+    publicado = true;
+  }
+
+  /**
+   * @brief Olvida el ultimo valor para que el siguiente se publique siempre
+   */
+  void reiniciar(void)
+  {
+    publicado = false;
+  }
+
+private:
+  float ultimoValor;
+  uint32_t ultimaPublicacionMs;
+  bool publicado;
+};
+
+#endif
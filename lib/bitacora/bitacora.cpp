@@ -0,0 +1,141 @@
+#include "bitacora.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BLOQUE_VACIADO 128 ///< Bytes enviados a la salida por iteracion de vaciar()
+
+Bitacora bitacora;
+
+/// Letra de cada nivel en el prefijo de la linea
+static const char LETRAS_NIVEL[] = {'-', 'E', 'A', 'I', 'D'};
+
+Bitacora::Bitacora(void) : lineasDescartadas(0)
+{
+  serie.datos = datosSerie;
+  serie.mascara = TAMANO_BITACORA - 1;
+  serie.escritura = 0;
+  serie.lectura = 0;
+
+  mqtt.datos = datosMQTT;
+  mqtt.mascara = TAMANO_BITACORA_MQTT - 1;
+  mqtt.escritura = 0;
+  mqtt.lectura = 0;
+
+  portMUX_TYPE inicial = portMUX_INITIALIZER_UNLOCKED;
+  cerrojo = inicial;
+}
+
+/**
+ * @brief Copia una linea completa al anillo, o nada si no cabe
+ *
+ * Llamar con el cerrojo tomado.
+ */
+bool Bitacora::agregar(Anillo &anillo, const char *linea, size_t longitud)
+{
+  if (longitud > anillo.mascara + 1 - (anillo.escritura - anillo.lectura))
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < longitud; i++)
+  {
+    anillo.datos[(anillo.escritura + i) & anillo.mascara] = (uint8_t)linea[i];
+  }
+  anillo.escritura += longitud;
+  return true;
+}
+
+void Bitacora::escribir(uint8_t nivel, const char *formato, ...)
+{
+  char linea[MAX_LINEA_BITACORA];
+  int prefijo = snprintf(linea, sizeof(linea), "[%lu][%c] ", (unsigned long)millis(),
+                         LETRAS_NIVEL[nivel < sizeof(LETRAS_NIVEL) ? nivel : 0]);
+
+  va_list argumentos;
+  va_start(argumentos, formato);
+  int mensaje = vsnprintf(linea + prefijo, sizeof(linea) - prefijo - 1, formato, argumentos);
+  va_end(argumentos);
+
+  // Una linea demasiado larga se trunca
+  size_t longitud = (size_t)prefijo + (mensaje < 0 ? 0 : (size_t)mensaje);
+  if (longitud > sizeof(linea) - 2)
+  {
+    longitud = sizeof(linea) - 2;
+  }
+  linea[longitud++] = '\n';
+
+  portENTER_CRITICAL(&cerrojo);
+  if (!agregar(serie, linea, longitud))
+  {
+    lineasDescartadas++;
+  }
+  if (nivel <= NIVEL_LOG_MQTT)
+  {
+    // El salto de linea separa las lineas en el anillo de MQTT
+    agregar(mqtt, linea, longitud);
+  }
+  portEXIT_CRITICAL(&cerrojo);
+}
+
+size_t Bitacora::vaciar(Print &salida)
+{
+  size_t total = 0;
+  uint8_t bloque[BLOQUE_VACIADO];
+
+  for (;;)
+  {
+    portENTER_CRITICAL(&cerrojo);
+    size_t cantidad = serie.escritura - serie.lectura;
+    if (cantidad > sizeof(bloque))
+    {
+      cantidad = sizeof(bloque);
+    }
+    for (size_t i = 0; i < cantidad; i++)
+    {
+      bloque[i] = serie.datos[(serie.lectura + i) & serie.mascara];
+    }
+    serie.lectura += cantidad;
+    portEXIT_CRITICAL(&cerrojo);
+
+    if (cantidad == 0)
+    {
+      return total;
+    }
+
+    // La escritura al UART, que si puede esperar, se hace fuera del cerrojo
+    salida.write(bloque, cantidad);
+    total += cantidad;
+  }
+}
+
+size_t Bitacora::siguienteLineaMQTT(char *destino, size_t capacidad)
+{
+  size_t longitud = 0;
+
+  portENTER_CRITICAL(&cerrojo);
+  while (mqtt.lectura != mqtt.escritura)
+  {
+    char caracter = (char)mqtt.datos[mqtt.lectura++ & mqtt.mascara];
+    if (caracter == '\n')
+    {
+      break;
+    }
+    if (longitud + 1 < capacidad)
+    {
+      destino[longitud++] = caracter;
+    }
+  }
+  portEXIT_CRITICAL(&cerrojo);
+
+  if (capacidad > 0)
+  {
+    destino[longitud] = '\0';
+  }
+  return longitud;
+}
+
+uint32_t Bitacora::descartadas(void) const
+{
+  return lineasDescartadas;
+}
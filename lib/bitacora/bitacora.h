@@ -0,0 +1,126 @@
+#ifndef BITACORA_H
+#define BITACORA_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+/**
+ * @file bitacora.h
+ * @brief Bitacora con niveles de compilacion y salida asincrona
+ *
+ * Las macros LOG_* formatean el mensaje en un anillo en RAM y regresan sin
+ * esperar al UART; una tarea de baja prioridad lo vacia con vaciar(). Los
+ * niveles por encima de NIVEL_LOG se eliminan al compilar, sin evaluar
+ * siquiera sus argumentos. Si el anillo esta lleno la linea se descarta y
+ * se cuenta, nunca se bloquea a quien escribe.
+ *
+ * Opcionalmente, las lineas de nivel NIVEL_LOG_MQTT o mas graves se copian
+ * a un segundo anillo que la tarea de red reenvia por MQTT.
+ *
+ * Es segura para varias tareas: la copia al anillo se hace en una seccion
+ * critica corta, despues de formatear.
+ */
+
+// Niveles, de mas a menos grave
+#define NIVEL_LOG_NINGUNO 0    ///< Sin bitacora
+#define NIVEL_LOG_ERROR 1      ///< Fallos que pierden datos o conexion
+#define NIVEL_LOG_AVISO 2      ///< Situaciones anomalas recuperables
+#define NIVEL_LOG_INFO 3       ///< Eventos normales del sistema
+#define NIVEL_LOG_DEPURACION 4 ///< Detalle por muestra o por mensaje
+
+#ifndef NIVEL_LOG
+#define NIVEL_LOG NIVEL_LOG_INFO ///< Nivel maximo compilado
+#endif
+#ifndef NIVEL_LOG_MQTT
+#define NIVEL_LOG_MQTT NIVEL_LOG_AVISO ///< Nivel maximo reenviado por MQTT (NINGUNO: no reenviar)
+#endif
+
+#define TAMANO_BITACORA 4096     ///< Anillo hacia el UART en bytes (potencia de dos)
+#define TAMANO_BITACORA_MQTT 1024 ///< Anillo hacia MQTT en bytes (potencia de dos)
+#define MAX_LINEA_BITACORA 160    ///< Longitud maxima de una linea, con prefijo
+
+/// Nivel no compilado: el optimizador lo elimina, pero el formato se sigue verificando
+#define LOG_DESCARTADO(...)                  \
+  do                                         \
+  {                                          \
+    if (0)                                   \
+    {                                        \
+      bitacora.escribir(0, __VA_ARGS__);     \
+    }                                        \
+  } while (0)
+
+#if NIVEL_LOG >= NIVEL_LOG_ERROR
+#define LOG_ERROR(...) bitacora.escribir(NIVEL_LOG_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) LOG_DESCARTADO(__VA_ARGS__)
+#endif
+
+#if NIVEL_LOG >= NIVEL_LOG_AVISO
+#define LOG_AVISO(...) bitacora.escribir(NIVEL_LOG_AVISO, __VA_ARGS__)
+#else
+#define LOG_AVISO(...) LOG_DESCARTADO(__VA_ARGS__)
+#endif
+
+#if NIVEL_LOG >= NIVEL_LOG_INFO
+#define LOG_INFO(...) bitacora.escribir(NIVEL_LOG_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_DESCARTADO(__VA_ARGS__)
+#endif
+
+#if NIVEL_LOG >= NIVEL_LOG_DEPURACION
+#define LOG_DEPURACION(...) bitacora.escribir(NIVEL_LOG_DEPURACION, __VA_ARGS__)
+#else
+#define LOG_DEPURACION(...) LOG_DESCARTADO(__VA_ARGS__)
+#endif
+
+class Bitacora
+{
+public:
+  Bitacora(void);
+
+  /**
+   * @brief Formatea una linea y la deja en el anillo; no bloquea
+   *
+   * Usar las macros LOG_* en lugar de llamarla directamente. El salto de
+   * linea final se agrega solo.
+   */
+  void escribir(uint8_t nivel, const char *formato, ...) __attribute__((format(printf, 3, 4)));
+
+  /**
+   * @brief Envia a la salida lo acumulado, de a bloques
+   * @return Bytes enviados
+   */
+  size_t vaciar(Print &salida);
+
+  /**
+   * @brief Extrae la linea mas antigua pendiente de reenviar por MQTT
+   * @param destino Buffer de al menos MAX_LINEA_BITACORA bytes
+   * @return Longitud de la linea sin terminador, 0 si no hay
+   */
+  size_t siguienteLineaMQTT(char *destino, size_t capacidad);
+
+  /// Lineas descartadas por anillo lleno desde el inicio
+  uint32_t descartadas(void) const;
+
+private:
+  struct Anillo
+  {
+    uint8_t *datos;
+    uint32_t mascara;
+    uint32_t escritura;
+    uint32_t lectura;
+  };
+
+  static bool agregar(Anillo &anillo, const char *linea, size_t longitud);
+
+  uint8_t datosSerie[TAMANO_BITACORA];
+  uint8_t datosMQTT[TAMANO_BITACORA_MQTT];
+  Anillo serie;
+  Anillo mqtt;
+  uint32_t lineasDescartadas;
+  portMUX_TYPE cerrojo;
+};
+
+extern Bitacora bitacora;
+
+#endif
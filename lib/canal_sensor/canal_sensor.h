@@ -0,0 +1,349 @@
+#ifndef CANAL_SENSOR_H
+#define CANAL_SENSOR_H
+
+#include <stdint.h>
+#include <math.h>
+#include <new>
+#include "filtros.h"
+#include "banda_muerta.h"
+
+/**
+ * @file canal_sensor.h
+ * @brief Canales de sensor descritos en tablas constexpr y tarea de muestreo generica
+ *
+ * Un canal es una magnitud con topico propio. Su topico (un prefijo
+ * compartido mas un sufijo), su filtro y su reporte por cambio se
+ * describen en una tabla constexpr de DescriptorCanal; los canales que
+ * entrega un mismo sensor forman un grupo contiguo (DescriptorGrupo) con
+ * periodo y ciclo de entrega comunes.
+ *
+ * Un controlador de sensor es cualquier clase con este ciclo de vida:
+ * - bool consultar(uint32_t ahoraMs): inicia una lectura o sondea la que
+ *   esta en curso, sin bloquear; true cuando hay una lectura completa
+ * - uint8_t salidas(void) const: valores que trae cada lectura
+ * - float leer(uint8_t salida) const: valor de una salida, NaN si fallo
+ *
+ * TareaSensor<Controlador, Entregar, Reloj> hace lo mismo para cualquier
+ * controlador: sondea, filtra cada salida en su canal y entrega los
+ * valores filtrados cada lecturasPorEntrega lecturas, con el instante en
+ * que se completo la ultima lectura segun Reloj. Las lecturas por entrega
+ * y la ventana de los filtros se pueden cambiar en marcha. El controlador,
+ * la funcion de entrega y el reloj son parametros de plantilla: no hay
+ * funciones virtuales ni memoria dinamica.
+ */
+
+#ifndef VENTANA_FILTRO_CANAL
+#define VENTANA_FILTRO_CANAL 10 ///< Ventana de la mediana y de la media robusta
+#endif
+
+/**
+ * @brief Filtro que usa un canal
+ */
+enum TipoFiltro : uint8_t
+{
+  FILTRO_MEDIANA = 0,   ///< FiltroMediana: descarta valores espurios aislados
+  FILTRO_MEDIA_ROBUSTA, ///< FiltroMediaRobusta: media con rechazo de atipicos
+  FILTRO_EWMA           ///< FiltroEWMA: suavizado exponencial
+};
+
+/**
+ * @brief Entrada del registro de canales
+ */
+struct DescriptorCanal
+{
+  uint8_t prefijo;              ///< Prefijo de topico compartido, indice en la tabla de la aplicacion
+  const char *sufijo;           ///< Resto del topico; NULL: el numero del sensor dentro del grupo
+  TipoFiltro filtro;            ///< Filtro del canal
+  float parametro;              ///< Alfa del EWMA o k de la media robusta
+  float desviacionMinima;       ///< Piso de desviacion de la media robusta
+  ConfiguracionReporte reporte; ///< Banda muerta y latido
+};
+
+/**
+ * @brief Entrada del registro de grupos: los canales de un mismo sensor
+ */
+struct DescriptorGrupo
+{
+  const char *nombre;         ///< Nombre de la tarea en el planificador y el diagnostico
+  uint8_t primerCanal;        ///< Canal de la salida 0 del controlador
+  uint8_t canales;            ///< Canales reservados: salidas maximas del controlador
+  uint32_t periodoMs;         ///< Periodo de sondeo del controlador
+  uint8_t lecturasPorEntrega; ///< Lecturas por entrega; 0 = solo con entregar()
+};
+
+/**
+ * @brief Filtro de cualquiera de los tipos de TipoFiltro, elegido al construirlo
+ *
+ * Permite guardar los canales de todos los sensores en un solo arreglo
+ * indexado por canal. El despacho es un switch sobre el tipo, sin
+ * funciones virtuales, y el objeto sigue siendo trivialmente copiable.
+ */
+class FiltroCanal
+{
+public:
+  FiltroCanal(void) : tipo(FILTRO_EWMA), ewma()
+  {
+  }
+
+  explicit FiltroCanal(const DescriptorCanal &descriptor) : tipo(descriptor.filtro)
+  {
+    switch (tipo)
+    {
+    case FILTRO_MEDIANA:
+      new (&mediana) FiltroMediana<VENTANA_FILTRO_CANAL>();
+      break;
+    case FILTRO_MEDIA_ROBUSTA:
+      new (&mediaRobusta) FiltroMediaRobusta<VENTANA_FILTRO_CANAL>(descriptor.parametro, descriptor.desviacionMinima);
+      break;
+    default:
+      new (&ewma) FiltroEWMA(descriptor.parametro);
+      break;
+    }
+  }
+
+  bool agregar(float muestra)
+  {
+    switch (tipo)
+    {
+    case FILTRO_MEDIANA:
+      return mediana.agregar(muestra);
+    case FILTRO_MEDIA_ROBUSTA:
+      return mediaRobusta.agregar(muestra);
+    default:
+      return ewma.agregar(muestra);
+    }
+  }
+
+  float valor(void) const
+  {
+    switch (tipo)
+    {
+    case FILTRO_MEDIANA:
+      return mediana.valor();
+    case FILTRO_MEDIA_ROBUSTA:
+      return mediaRobusta.valor();
+    default:
+      return ewma.valor();
+    }
+  }
+
+  uint8_t validas(void) const
+  {
+    switch (tipo)
+    {
+    case FILTRO_MEDIANA:
+      return mediana.validas();
+    case FILTRO_MEDIA_ROBUSTA:
+      return mediaRobusta.validas();
+    default:
+      return ewma.validas();
+    }
+  }
+
+  void reiniciar(void)
+  {
+    switch (tipo)
+    {
+    case FILTRO_MEDIANA:
+      mediana.reiniciar();
+      break;
+    case FILTRO_MEDIA_ROBUSTA:
+      mediaRobusta.reiniciar();
+      break;
+    default:
+      ewma.reiniciar();
+      break;
+    }
+  }
+
+  /**
+   * @brief Cambia la ventana de la mediana o de la media robusta (el EWMA no tiene)
+   * @param n Muestras de la ventana, de 1 a VENTANA_FILTRO_CANAL
+   */
+  void cambiarVentana(uint8_t n)
+  {
+    switch (tipo)
+    {
+    case FILTRO_MEDIANA:
+      mediana.cambiarVentana(n);
+      break;
+    case FILTRO_MEDIA_ROBUSTA:
+      mediaRobusta.cambiarVentana(n);
+      break;
+    default:
+      break;
+    }
+  }
+
+private:
+  TipoFiltro tipo;
+  union
+  {
+    FiltroMediana<VENTANA_FILTRO_CANAL> mediana;
+    FiltroMediaRobusta<VENTANA_FILTRO_CANAL> mediaRobusta;
+    FiltroEWMA ewma;
+  };
+};
+
+/**
+ * @brief Filtro de un canal mas el conteo de muestras desde la ultima entrega
+ *
+ * El filtro conserva su ventana entre entregas; el conteo evita volver a
+ * entregar un valor viejo cuando el sensor deja de responder.
+ */
+struct CanalFiltrado
+{
+  FiltroCanal filtro; ///< Estimador del canal
+  uint8_t recientes;  ///< Muestras aceptadas desde la ultima entrega
+
+  /**
+   * @brief Agrega una lectura al filtro (las NaN se descartan)
+   */
+  void filtrar(float lectura)
+  {
+    if (filtro.agregar(lectura) && recientes < UINT8_MAX)
+    {
+      recientes++;
+    }
+  }
+
+  /**
+   * @brief Valor filtrado a entregar, NaN si no hubo muestras desde la ultima entrega
+   */
+  float tomar(void)
+  {
+    if (recientes == 0)
+    {
+      return NAN;
+    }
+    recientes = 0;
+    return filtro.valor();
+  }
+};
+
+/**
+ * @brief Destino de los valores filtrados de una tarea
+ * @param canal Canal del valor
+ * @param valor Valor filtrado, NaN si el canal no tuvo muestras validas en el ciclo
+ * @param instanteUs Instante de la ultima lectura filtrada, segun el reloj de la tarea
+ */
+typedef void (*EntregaCanal)(uint8_t canal, float valor, int64_t instanteUs);
+
+/**
+ * @brief Reloj monotonico en microsegundos (p. ej. esp_timer_get_time)
+ */
+typedef int64_t (*RelojMonotonico)(void);
+
+/**
+ * @brief Muestreo generico de un grupo de canales
+ *
+ * @tparam Controlador Controlador de sensor (ver el ciclo de vida arriba)
+ * @tparam Entregar Funcion que recibe los valores filtrados
+ * @tparam Reloj Reloj con que se marca cada lectura completa
+ */
+template <typename Controlador, EntregaCanal Entregar, RelojMonotonico Reloj>
+class TareaSensor
+{
+public:
+  /**
+   * @param controlador Controlador del sensor
+   * @param grupo Descriptor del grupo en el registro
+   * @param canales Arreglo de todos los canales, indexado por canal
+   */
+  TareaSensor(Controlador &controlador, const DescriptorGrupo &grupo, CanalFiltrado *canales)
+      : controlador(controlador), grupo(grupo), canales(canales + grupo.primerCanal),
+        lecturasPorEntrega(grupo.lecturasPorEntrega), lecturas(0), ultimaLecturaUs(0)
+  {
+  }
+
+  /**
+   * @brief Sondea el controlador y filtra o entrega lo que corresponda
+   * @param ahoraMs Marca de tiempo del tick del planificador
+   * @return true si se completo una lectura
+   */
+  bool ejecutar(uint32_t ahoraMs)
+  {
+    if (!controlador.consultar(ahoraMs))
+    {
+      return false;
+    }
+    ultimaLecturaUs = Reloj();
+
+    uint8_t cantidad = salidas();
+    for (uint8_t i = 0; i < cantidad; i++)
+    {
+      canales[i].filtrar(controlador.leer(i));
+    }
+
+    if (lecturasPorEntrega > 0 && ++lecturas >= lecturasPorEntrega)
+    {
+      entregar();
+    }
+    return true;
+  }
+
+  /**
+   * @brief Cambia las lecturas por entrega del grupo; 0 = solo con entregar()
+   */
+  void cambiarLecturasPorEntrega(uint8_t lecturasNuevas)
+  {
+    lecturasPorEntrega = lecturasNuevas;
+    if (lecturasPorEntrega > 0 && lecturas >= lecturasPorEntrega)
+    {
+      entregar();
+    }
+  }
+
+  /**
+   * @brief Instante en que se completo la ultima lectura, segun Reloj
+   */
+  int64_t ultimaLectura(void) const
+  {
+    return ultimaLecturaUs;
+  }
+
+  /**
+   * @brief Salidas de la ultima lectura completa, a lo sumo los canales del grupo
+   */
+  uint8_t cantidadSalidas(void) const
+  {
+    return salidas();
+  }
+
+  /**
+   * @brief Valor crudo de una salida en la ultima lectura completa, sin filtrar; NaN si fallo
+   */
+  float lectura(uint8_t salida) const
+  {
+    return controlador.leer(salida);
+  }
+
+  /**
+   * @brief Entrega ya el valor filtrado de cada canal del grupo
+   */
+  void entregar(void)
+  {
+    lecturas = 0;
+    uint8_t cantidad = salidas();
+    for (uint8_t i = 0; i < cantidad; i++)
+    {
+      Entregar((uint8_t)(grupo.primerCanal + i), canales[i].tomar(), ultimaLecturaUs);
+    }
+  }
+
+private:
+  uint8_t salidas(void) const
+  {
+    uint8_t cantidad = controlador.salidas();
+    return cantidad < grupo.canales ? cantidad : grupo.canales;
+  }
+
+  Controlador &controlador;
+  const DescriptorGrupo &grupo;
+  CanalFiltrado *canales;     ///< Canal de la salida 0
+  uint8_t lecturasPorEntrega; ///< Inicialmente las del grupo
+  uint8_t lecturas;           ///< Lecturas desde la ultima entrega
+  int64_t ultimaLecturaUs;    ///< Instante en que se completo la ultima lectura
+};
+
+#endif
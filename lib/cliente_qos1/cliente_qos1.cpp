@@ -0,0 +1,421 @@
+#include "cliente_qos1.h"
+
+#include <string.h>
+
+#define TIPO_PUBLISH_QOS1 0x32 ///< PUBLISH con QoS 1, sin DUP ni retain
+#define BANDERA_DUP 0x08       ///< Marca de reenvio en el primer byte del PUBLISH
+#define TIPO_PUBACK 0x40       ///< PUBACK: cuerpo de 2 bytes con el identificador
+#define MASCARA_TIPO 0xF0      ///< Tipo de paquete en el primer byte
+#define MAX_LONGITUD_VARIABLE 4 ///< Bytes maximos de la longitud restante
+
+ClienteQoS1::ClienteQoS1(Client &transporte)
+    : transporte(transporte), ocupado(0), primero(0), cantidad(0), siguienteIdentificador(1), enFlujo(false),
+      longitudFlujo(0), escritosFlujo(0), perdidos(), siguientePerdido(0), totalConfirmadas(0), totalReenviadas(0)
+{
+  reiniciarEntrada();
+}
+
+bool ClienteQoS1::publicar(const char *topico, const uint8_t *carga, size_t longitud)
+{
+  size_t longitudCabecera;
+  uint16_t identificador;
+  uint8_t *paquete = armarCabecera(topico, longitud, true, longitudCabecera, identificador);
+  if (paquete == NULL)
+  {
+    return false;
+  }
+
+  memcpy(paquete + longitudCabecera, carga, longitud);
+  agregar(identificador, (uint16_t)(longitudCabecera + longitud));
+
+  // Si la escritura falla el mensaje queda en la ventana y sale al reconectar
+  transporte.write(paquete, longitudCabecera + longitud);
+  return true;
+}
+
+uint16_t ClienteQoS1::iniciarPublicacion(const char *topico, size_t longitud)
+{
+  size_t longitudCabecera;
+  uint16_t identificador;
+  uint8_t *cabecera = enFlujo ? NULL : armarCabecera(topico, longitud, false, longitudCabecera, identificador);
+  if (cabecera == NULL)
+  {
+    return 0;
+  }
+
+  // La cabecera solo pasa por la arena: el mensaje no se conserva
+  agregar(identificador, 0);
+  enFlujo = true;
+  longitudFlujo = longitud;
+  escritosFlujo = 0;
+  transporte.write(cabecera, longitudCabecera);
+  return identificador;
+}
+
+bool ClienteQoS1::terminarPublicacion(void)
+{
+  if (!enFlujo)
+  {
+    return false;
+  }
+  enFlujo = false;
+
+  if (escritosFlujo != longitudFlujo)
+  {
+    stop(); // Paquete truncado: el broker ya no puede separar los siguientes
+    return false;
+  }
+  return true;
+}
+
+EstadoFlujoQoS1 ClienteQoS1::estadoFlujo(uint16_t identificador) const
+{
+  // Primero los perdidos: detras de un mensaje sin PUBACK, el perdido sigue
+  // en la ventana marcado como confirmado hasta que se libere el frente
+  for (uint8_t i = 0; i < VENTANA_QOS1; i++)
+  {
+    if (perdidos[i] == identificador)
+    {
+      return FLUJO_PERDIDO;
+    }
+  }
+  for (uint8_t i = 0; i < cantidad; i++)
+  {
+    const Mensaje &mensaje = ventana[(primero + i) % VENTANA_QOS1];
+    if (mensaje.identificador == identificador)
+    {
+      return mensaje.confirmado ? FLUJO_CONFIRMADO : FLUJO_EN_VUELO;
+    }
+  }
+  return FLUJO_CONFIRMADO;
+}
+
+uint8_t ClienteQoS1::reenviarPendientes(void)
+{
+  uint8_t reenviados = 0;
+  for (uint8_t i = 0; i < cantidad; i++)
+  {
+    Mensaje &mensaje = ventana[(primero + i) % VENTANA_QOS1];
+    if (mensaje.confirmado)
+    {
+      continue;
+    }
+    if (mensaje.longitud == 0)
+    {
+      // Enviado por flujo, sin copia: se da por perdido y sale de la ventana
+      mensaje.confirmado = true;
+      perdidos[siguientePerdido] = mensaje.identificador;
+      siguientePerdido = (siguientePerdido + 1) % VENTANA_QOS1;
+      continue;
+    }
+    arena[mensaje.inicio] |= BANDERA_DUP;
+    transporte.write(arena + mensaje.inicio, mensaje.longitud);
+    reenviados++;
+  }
+  liberarConfirmados();
+  totalReenviadas += reenviados;
+  return reenviados;
+}
+
+uint8_t ClienteQoS1::enVuelo(void) const
+{
+  return cantidad;
+}
+
+uint32_t ClienteQoS1::confirmadas(void) const
+{
+  return totalConfirmadas;
+}
+
+uint32_t ClienteQoS1::reenviadas(void) const
+{
+  return totalReenviadas;
+}
+
+/**
+ * @brief Arma al final de la arena la cabecera de un PUBLISH de QoS 1
+ *
+ * Toma un identificador nuevo y verifica que haya lugar en la ventana y en
+ * la arena, compactandola si hace falta.
+ *
+ * @param conCarga true si la carga se copiara a continuacion de la cabecera
+ * @param longitudCabecera Bytes de la cabecera armada
+ * @param identificador Identificador de paquete asignado
+ * @return Inicio del paquete en la arena, NULL si no hay lugar o conexion
+ */
+uint8_t *ClienteQoS1::armarCabecera(const char *topico, size_t longitudCarga, bool conCarga,
+                                    size_t &longitudCabecera, uint16_t &identificador)
+{
+  if (cantidad >= VENTANA_QOS1 || !transporte.connected())
+  {
+    return NULL;
+  }
+
+  size_t longitudTopico = strlen(topico);
+  size_t restantePaquete = 2 + longitudTopico + 2 + longitudCarga;
+
+  // Cabecera fija: tipo y longitud restante en base 128
+  uint8_t fija[1 + MAX_LONGITUD_VARIABLE];
+  size_t longitudFija = 0;
+  fija[longitudFija++] = TIPO_PUBLISH_QOS1;
+  size_t pendiente = restantePaquete;
+  do
+  {
+    uint8_t digito = pendiente % 128;
+    pendiente /= 128;
+    fija[longitudFija++] = pendiente > 0 ? (uint8_t)(digito | 0x80) : digito;
+  } while (pendiente > 0 && longitudFija <= MAX_LONGITUD_VARIABLE);
+  if (pendiente > 0)
+  {
+    return NULL;
+  }
+
+  longitudCabecera = longitudFija + 2 + longitudTopico + 2;
+  size_t enArena = longitudCabecera + (conCarga ? longitudCarga : 0);
+  if (enArena > TAMANO_ARENA_QOS1)
+  {
+    return NULL;
+  }
+  if (ocupado + enArena > TAMANO_ARENA_QOS1)
+  {
+    compactar();
+    if (ocupado + enArena > TAMANO_ARENA_QOS1)
+    {
+      return NULL;
+    }
+  }
+
+  identificador = siguienteIdentificador;
+  siguienteIdentificador = siguienteIdentificador == UINT16_MAX ? 1 : siguienteIdentificador + 1;
+  for (uint8_t i = 0; i < VENTANA_QOS1; i++)
+  {
+    if (perdidos[i] == identificador)
+    {
+      perdidos[i] = 0; // El identificador vuelve a usarse
+    }
+  }
+
+  uint8_t *paquete = arena + ocupado;
+  uint8_t *cursor = paquete;
+  memcpy(cursor, fija, longitudFija);
+  cursor += longitudFija;
+  *cursor++ = (uint8_t)(longitudTopico >> 8);
+  *cursor++ = (uint8_t)longitudTopico;
+  memcpy(cursor, topico, longitudTopico);
+  cursor += longitudTopico;
+  *cursor++ = (uint8_t)(identificador >> 8);
+  *cursor = (uint8_t)identificador;
+  return paquete;
+}
+
+/**
+ * @brief Pone en la ventana el paquete armado al final de la arena
+ * @param longitudPaquete Bytes que conserva la arena; 0 si se envia por flujo
+ */
+void ClienteQoS1::agregar(uint16_t identificador, uint16_t longitudPaquete)
+{
+  Mensaje &mensaje = ventana[(primero + cantidad) % VENTANA_QOS1];
+  mensaje.identificador = identificador;
+  mensaje.inicio = ocupado;
+  mensaje.longitud = longitudPaquete;
+  mensaje.confirmado = false;
+  cantidad++;
+  ocupado = (uint16_t)(ocupado + longitudPaquete);
+}
+
+/**
+ * @brief Sigue el flujo entrante byte a byte y detecta los PUBACK
+ *
+ * Solo interpreta la cabecera fija de cada paquete; el resto lo cuenta y
+ * lo deja pasar. Un PUBACK es el tipo 4 con exactamente 2 bytes de cuerpo.
+ */
+void ClienteQoS1::observar(uint8_t dato)
+{
+  switch (fase)
+  {
+  case ENTRADA_CABECERA:
+    tipoEntrante = dato & MASCARA_TIPO;
+    restante = 0;
+    desplazamientoLongitud = 0;
+    fase = ENTRADA_LONGITUD;
+    break;
+
+  case ENTRADA_LONGITUD:
+    restante |= (uint32_t)(dato & 0x7F) << desplazamientoLongitud;
+    desplazamientoLongitud += 7;
+    if (dato & 0x80)
+    {
+      if (desplazamientoLongitud >= 7 * MAX_LONGITUD_VARIABLE)
+      {
+        reiniciarEntrada(); // Longitud invalida: se pierde el sincronismo
+      }
+      break;
+    }
+    if (tipoEntrante != TIPO_PUBACK || restante != 2)
+    {
+      tipoEntrante = 0;
+    }
+    identificadorEntrante = 0;
+    fase = restante > 0 ? ENTRADA_CUERPO : ENTRADA_CABECERA;
+    break;
+
+  case ENTRADA_CUERPO:
+    identificadorEntrante = (uint16_t)((identificadorEntrante << 8) | dato);
+    if (--restante == 0)
+    {
+      if (tipoEntrante == TIPO_PUBACK)
+      {
+        confirmar(identificadorEntrante);
+      }
+      fase = ENTRADA_CABECERA;
+    }
+    break;
+  }
+}
+
+/**
+ * @brief Marca confirmado un mensaje
+ */
+void ClienteQoS1::confirmar(uint16_t identificador)
+{
+  for (uint8_t i = 0; i < cantidad; i++)
+  {
+    Mensaje &mensaje = ventana[(primero + i) % VENTANA_QOS1];
+    if (mensaje.identificador == identificador && !mensaje.confirmado)
+    {
+      mensaje.confirmado = true;
+      totalConfirmadas++;
+      break;
+    }
+  }
+  liberarConfirmados();
+}
+
+/**
+ * @brief Saca de la ventana los mensajes confirmados del frente de la cola
+ */
+void ClienteQoS1::liberarConfirmados(void)
+{
+  while (cantidad > 0 && ventana[primero].confirmado)
+  {
+    primero = (primero + 1) % VENTANA_QOS1;
+    cantidad--;
+  }
+  if (cantidad == 0)
+  {
+    ocupado = 0;
+  }
+}
+
+/**
+ * @brief Mueve los paquetes en vuelo al inicio de la arena
+ */
+void ClienteQoS1::compactar(void)
+{
+  if (cantidad == 0)
+  {
+    ocupado = 0;
+    return;
+  }
+
+  uint16_t base = ventana[primero].inicio;
+  if (base == 0)
+  {
+    return;
+  }
+  memmove(arena, arena + base, ocupado - base);
+  ocupado = (uint16_t)(ocupado - base);
+  for (uint8_t i = 0; i < cantidad; i++)
+  {
+    ventana[(primero + i) % VENTANA_QOS1].inicio -= base;
+  }
+}
+
+void ClienteQoS1::reiniciarEntrada(void)
+{
+  fase = ENTRADA_CABECERA;
+  tipoEntrante = 0;
+  desplazamientoLongitud = 0;
+  restante = 0;
+  identificadorEntrante = 0;
+}
+
+int ClienteQoS1::connect(IPAddress ip, uint16_t port)
+{
+  enFlujo = false;
+  reiniciarEntrada();
+  return transporte.connect(ip, port);
+}
+
+int ClienteQoS1::connect(const char *host, uint16_t port)
+{
+  enFlujo = false;
+  reiniciarEntrada();
+  return transporte.connect(host, port);
+}
+
+size_t ClienteQoS1::write(uint8_t dato)
+{
+  return write(&dato, 1);
+}
+
+size_t ClienteQoS1::write(const uint8_t *buf, size_t size)
+{
+  size_t escritos = transporte.write(buf, size);
+  if (enFlujo)
+  {
+    escritosFlujo += escritos;
+  }
+  return escritos;
+}
+
+int ClienteQoS1::available(void)
+{
+  return transporte.available();
+}
+
+int ClienteQoS1::read(void)
+{
+  int dato = transporte.read();
+  if (dato >= 0)
+  {
+    observar((uint8_t)dato);
+  }
+  return dato;
+}
+
+int ClienteQoS1::read(uint8_t *buf, size_t size)
+{
+  int leidos = transporte.read(buf, size);
+  for (int i = 0; i < leidos; i++)
+  {
+    observar(buf[i]);
+  }
+  return leidos;
+}
+
+int ClienteQoS1::peek(void)
+{
+  return transporte.peek();
+}
+
+void ClienteQoS1::flush(void)
+{
+  transporte.flush();
+}
+
+void ClienteQoS1::stop(void)
+{
+  transporte.stop();
+  reiniciarEntrada();
+}
+
+uint8_t ClienteQoS1::connected(void)
+{
+  return transporte.connected();
+}
+
+ClienteQoS1::operator bool(void)
+{
+  return connected();
+}
@@ -0,0 +1,194 @@
+#ifndef CLIENTE_QOS1_H
+#define CLIENTE_QOS1_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+/**
+ * @file cliente_qos1.h
+ * @brief Publicacion MQTT con QoS 1 y ventana de mensajes en vuelo para PubSubClient
+ *
+ * PubSubClient solo publica con QoS 0 e ignora los PUBACK. ClienteQoS1 se
+ * intercala entre PubSubClient y el transporte (ClienteTLS): reenvia todo
+ * el trafico sin tocarlo y, ademas,
+ * - arma y envia por su cuenta los PUBLISH de QoS 1 con un identificador
+ *   de paquete propio, sin esperar su PUBACK, hasta VENTANA_QOS1 a la vez;
+ * - sigue el flujo entrante, que lee PubSubClient, y al pasar un PUBACK
+ *   libera el mensaje correspondiente de la ventana.
+ *
+ * Cada mensaje en vuelo se conserva en una arena de TAMANO_ARENA_QOS1
+ * bytes hasta su PUBACK. Con sesion persistente (cleanSession = false) la
+ * norma obliga a reenviar los no confirmados al reconectar, con la marca
+ * DUP: reenviarPendientes() lo hace tras cada CONNECT aceptado.
+ *
+ * Un mensaje grande puede enviarse por flujo: iniciarPublicacion() escribe
+ * la cabecera, la carga pasa por write() en bloques y
+ * terminarPublicacion() cierra el paquete. Esos mensajes ocupan un lugar
+ * en la ventana pero no se copian en la arena, de modo que no pueden
+ * reenviarse: si la conexion cae antes de su PUBACK quedan perdidos
+ * (estadoFlujo()) y le toca a quien los envio repetirlos desde su origen,
+ * p. ej. el registro en flash.
+ *
+ * Los PUBACK llegan en el orden de los PUBLISH; la ventana es una cola.
+ * Debe usarse desde la misma tarea que PubSubClient, y nunca entre un
+ * beginPublish() y su endPublish().
+ */
+
+#ifndef VENTANA_QOS1
+#define VENTANA_QOS1 8 ///< PUBLISH de QoS 1 en vuelo sin confirmar
+#endif
+#ifndef TAMANO_ARENA_QOS1
+#define TAMANO_ARENA_QOS1 4096 ///< Bytes para los paquetes en vuelo
+#endif
+
+static_assert(TAMANO_ARENA_QOS1 <= UINT16_MAX, "Los desplazamientos de la arena son de 16 bits");
+
+/**
+ * @brief Situacion de un mensaje enviado por flujo
+ */
+enum EstadoFlujoQoS1 : uint8_t
+{
+  FLUJO_EN_VUELO = 0, ///< Enviado, esperando su PUBACK
+  FLUJO_CONFIRMADO,   ///< Llego su PUBACK
+  FLUJO_PERDIDO       ///< La conexion cayo antes del PUBACK; no se reenviara
+};
+
+class ClienteQoS1 : public Client
+{
+public:
+  /**
+   * @param transporte Conexion por la que viaja el MQTT (p. ej. ClienteTLS)
+   */
+  explicit ClienteQoS1(Client &transporte);
+
+  /**
+   * @brief Envia un PUBLISH de QoS 1 sin esperar su PUBACK
+   * @param topico Topico, terminado en '\0'
+   * @param carga Datos del mensaje
+   * @param longitud Bytes de carga
+   * @return true si el mensaje quedo en la ventana; false si la ventana o la
+   *         arena estan llenas o no hay conexion
+   */
+  bool publicar(const char *topico, const uint8_t *carga, size_t longitud);
+
+  /**
+   * @brief Escribe la cabecera de un PUBLISH de QoS 1 cuya carga se enviara por flujo
+   *
+   * Hasta terminarPublicacion() la carga se escribe con write(), en
+   * bloques de cualquier tamano, y deben ser exactamente longitud bytes.
+   *
+   * @param topico Topico, terminado en '\0'
+   * @param longitud Bytes de carga que se escribiran
+   * @return Identificador del paquete, 0 si la ventana esta llena o no hay conexion
+   */
+  uint16_t iniciarPublicacion(const char *topico, size_t longitud);
+
+  /**
+   * @brief Cierra el mensaje abierto con iniciarPublicacion()
+   *
+   * Si no se escribio la carga completa, el paquete quedo truncado y el
+   * flujo MQTT ya no es valido: se cierra la conexion.
+   *
+   * @return true si el mensaje salio completo
+   */
+  bool terminarPublicacion(void);
+
+  /**
+   * @brief Situacion de un mensaje enviado por flujo
+   * @param identificador Valor devuelto por iniciarPublicacion()
+   */
+  EstadoFlujoQoS1 estadoFlujo(uint16_t identificador) const;
+
+  /**
+   * @brief Reenvia con la marca DUP los mensajes aun sin PUBACK
+   *
+   * Llamar justo despues de que se acepte el CONNECT con sesion persistente.
+   * Los enviados por flujo no se pueden reenviar y pasan a FLUJO_PERDIDO.
+   *
+   * @return Mensajes reenviados
+   */
+  uint8_t reenviarPendientes(void);
+
+  /**
+   * @brief Mensajes enviados que aun esperan su PUBACK
+   */
+  uint8_t enVuelo(void) const;
+
+  /**
+   * @brief PUBACK recibidos desde el arranque
+   */
+  uint32_t confirmadas(void) const;
+
+  /**
+   * @brief Mensajes reenviados tras una reconexion desde el arranque
+   */
+  uint32_t reenviadas(void) const;
+
+  // Interfaz Client de Arduino, hacia el transporte
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+  size_t write(uint8_t dato) override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available(void) override;
+  int read(void) override;
+  int read(uint8_t *buf, size_t size) override;
+  int peek(void) override;
+  void flush(void) override;
+  void stop(void) override;
+  uint8_t connected(void) override;
+  operator bool(void) override;
+
+private:
+  /**
+   * @brief Fase del paquete entrante que se esta leyendo
+   */
+  enum FaseEntrada : uint8_t
+  {
+    ENTRADA_CABECERA = 0, ///< Primer byte: tipo y banderas
+    ENTRADA_LONGITUD,     ///< Longitud restante, de 1 a 4 bytes
+    ENTRADA_CUERPO        ///< Cabecera variable y carga
+  };
+
+  struct Mensaje
+  {
+    uint16_t identificador; ///< Identificador de paquete del PUBLISH
+    uint16_t inicio;        ///< Desplazamiento del paquete en la arena
+    uint16_t longitud;      ///< Bytes del paquete completo; 0 si se envio por flujo
+    bool confirmado;        ///< Ya llego su PUBACK
+  };
+
+  uint8_t *armarCabecera(const char *topico, size_t longitudCarga, bool conCarga, size_t &longitudCabecera,
+                         uint16_t &identificador);
+  void agregar(uint16_t identificador, uint16_t longitudPaquete);
+  void observar(uint8_t dato);
+  void confirmar(uint16_t identificador);
+  void liberarConfirmados(void);
+  void compactar(void);
+  void reiniciarEntrada(void);
+
+  Client &transporte;
+
+  uint8_t arena[TAMANO_ARENA_QOS1];
+  uint16_t ocupado; ///< Fin del ultimo paquete en la arena
+  Mensaje ventana[VENTANA_QOS1];
+  uint8_t primero;  ///< Mensaje mas antiguo en vuelo
+  uint8_t cantidad; ///< Mensajes en vuelo
+  uint16_t siguienteIdentificador;
+
+  bool enFlujo;                    ///< Hay un mensaje por flujo abierto
+  size_t longitudFlujo;            ///< Carga declarada del mensaje por flujo
+  size_t escritosFlujo;            ///< Carga ya escrita del mensaje por flujo
+  uint16_t perdidos[VENTANA_QOS1]; ///< Ultimos mensajes por flujo perdidos
+  uint8_t siguientePerdido;        ///< Proxima posicion de perdidos
+
+  FaseEntrada fase;
+  uint8_t tipoEntrante;
+  uint8_t desplazamientoLongitud; ///< Bits ya leidos de la longitud restante
+  uint32_t restante;              ///< Bytes del cuerpo por leer
+  uint16_t identificadorEntrante; ///< Primeros dos bytes del cuerpo
+
+  uint32_t totalConfirmadas;
+  uint32_t totalReenviadas;
+};
+
+#endif
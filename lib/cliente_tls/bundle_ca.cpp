@@ -0,0 +1,118 @@
+#include "bundle_ca.h"
+
+#include <string.h>
+#include "mbedtls/pk.h"
+#include "mbedtls/md.h"
+
+#define MAGIA_BUNDLE_INDEXADO "CAIX"  ///< Identifica el formato con indice
+#define LONGITUD_MAGIA_BUNDLE 4       ///< Bytes de la marca
+#define TAMANO_ENTRADA_INDICE 8       ///< Hash y desplazamiento, u32 cada uno
+#define BASE_FNV1A 0x811c9dc5u        ///< Valor inicial del FNV-1a de 32 bits
+#define PRIMO_FNV1A 0x01000193u       ///< Primo del FNV-1a de 32 bits
+
+static uint16_t leer16(const uint8_t *p)
+{
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t leer32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+bool bundleCAIndexado(const uint8_t *bundle)
+{
+  return bundle != NULL && memcmp(bundle, MAGIA_BUNDLE_INDEXADO, LONGITUD_MAGIA_BUNDLE) == 0;
+}
+
+uint32_t hashSujetoCA(const uint8_t *nombre, size_t longitud)
+{
+  uint32_t hash = BASE_FNV1A;
+  for (size_t i = 0; i < longitud; i++)
+  {
+    hash = (hash ^ nombre[i]) * PRIMO_FNV1A;
+  }
+  return hash;
+}
+
+/**
+ * @brief Verifica la firma de un certificado con la clave publica de una CA
+ * @return 0 si la firma es valida
+ */
+static int verificarFirma(const mbedtls_x509_crt *certificado, const uint8_t *clave, size_t longitudClave)
+{
+  mbedtls_pk_context emisor;
+  mbedtls_pk_init(&emisor);
+
+  int resultado = mbedtls_pk_parse_public_key(&emisor, clave, longitudClave);
+  if (resultado == 0 && !mbedtls_pk_can_do(&emisor, certificado->sig_pk))
+  {
+    resultado = -1; // La CA tiene otro tipo de clave: no puede ser el emisor
+  }
+
+  const mbedtls_md_info_t *md = mbedtls_md_info_from_type(certificado->sig_md);
+  unsigned char hash[MBEDTLS_MD_MAX_SIZE];
+  if (resultado == 0)
+  {
+    resultado = md != NULL ? mbedtls_md(md, certificado->tbs.p, certificado->tbs.len, hash) : -1;
+  }
+  if (resultado == 0)
+  {
+    resultado = mbedtls_pk_verify_ext(certificado->sig_pk, certificado->sig_opts, &emisor, certificado->sig_md,
+                                      hash, mbedtls_md_get_size(md), certificado->sig.p, certificado->sig.len);
+  }
+
+  mbedtls_pk_free(&emisor);
+  return resultado;
+}
+
+int verificarConBundleCA(void *bundle, mbedtls_x509_crt *certificado, int profundidad, uint32_t *banderas)
+{
+  (void)profundidad;
+
+  // Una firma con hash debil no importa si el emisor es de confianza
+  if ((*banderas & ~MBEDTLS_X509_BADCERT_BAD_MD) != MBEDTLS_X509_BADCERT_NOT_TRUSTED)
+  {
+    return 0;
+  }
+
+  const uint8_t *datos = (const uint8_t *)bundle;
+  const uint8_t *indice = datos + LONGITUD_MAGIA_BUNDLE + 2;
+  const uint8_t *emisor = certificado->issuer_raw.p;
+  size_t longitudEmisor = certificado->issuer_raw.len;
+  uint32_t hash = hashSujetoCA(emisor, longitudEmisor);
+
+  // Primera entrada con hash >= al del emisor
+  uint16_t inicio = 0;
+  uint16_t fin = leer16(datos + LONGITUD_MAGIA_BUNDLE);
+  uint16_t cantidad = fin;
+  while (inicio < fin)
+  {
+    uint16_t medio = inicio + (fin - inicio) / 2;
+    if (leer32(indice + medio * TAMANO_ENTRADA_INDICE) < hash)
+    {
+      inicio = medio + 1;
+    }
+    else
+    {
+      fin = medio;
+    }
+  }
+
+  // Las colisiones de hash quedan contiguas: se distinguen por el nombre completo
+  for (uint16_t i = inicio; i < cantidad && leer32(indice + i * TAMANO_ENTRADA_INDICE) == hash; i++)
+  {
+    const uint8_t *entrada = datos + leer32(indice + i * TAMANO_ENTRADA_INDICE + 4);
+    uint16_t longitudNombre = leer16(entrada);
+    uint16_t longitudClave = leer16(entrada + 2);
+    const uint8_t *nombre = entrada + 4;
+
+    if (longitudNombre == longitudEmisor && memcmp(nombre, emisor, longitudEmisor) == 0 &&
+        verificarFirma(certificado, nombre + longitudNombre, longitudClave) == 0)
+    {
+      *banderas = 0;
+      return 0;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef BUNDLE_CA_H
+#define BUNDLE_CA_H
+
+#include <stdint.h>
+#include "mbedtls/x509_crt.h"
+
+/**
+ * @file bundle_ca.h
+ * @brief Validacion de certificados contra un bundle de CA indexado
+ *
+ * data/cert/bundleUp.py --indexed antepone a las entradas del bundle
+ * (longitudes, sujeto DER y clave publica DER) un indice ordenado por el
+ * hash FNV-1a de 32 bits del sujeto:
+ *
+ *   "CAIX" | cantidad (u16) | cantidad x { hash (u32), desplazamiento (u32) } | entradas
+ *
+ * Todos los campos son big-endian y el desplazamiento se cuenta desde el
+ * inicio del bundle. El emisor de un certificado se busca con una
+ * busqueda binaria sobre el indice, leido directamente desde flash: no se
+ * recorre el bundle al arrancar ni se reserva memoria para punteros como
+ * hace esp_crt_bundle.
+ */
+
+/**
+ * @brief Indica si el bundle tiene el indice de sujetos
+ */
+bool bundleCAIndexado(const uint8_t *bundle);
+
+/**
+ * @brief Hash FNV-1a de 32 bits de un nombre DER, la clave del indice
+ */
+uint32_t hashSujetoCA(const uint8_t *nombre, size_t longitud);
+
+/**
+ * @brief Callback para mbedtls_ssl_conf_verify() que valida con el bundle indexado
+ *
+ * Igual que esp_crt_bundle: solo actua sobre el certificado cuyo emisor no
+ * esta entre las CA de confianza, busca ese emisor en el bundle y, si la
+ * firma del certificado se verifica con su clave publica, lo da por
+ * confiable. Cualquier otro error de la cadena se conserva.
+ *
+ * @param bundle Bundle indexado, el argumento de mbedtls_ssl_conf_verify()
+ */
+int verificarConBundleCA(void *bundle, mbedtls_x509_crt *certificado, int profundidad, uint32_t *banderas);
+
+#endif
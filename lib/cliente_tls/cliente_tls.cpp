@@ -0,0 +1,422 @@
+#include "cliente_tls.h"
+
+#include <WiFi.h>
+#include "lwip/sockets.h"
+#include "esp_crt_bundle.h"
+#include "bundle_ca.h"
+#include "esp_timer.h"
+
+#define TIMEOUT_TLS_DEFECTO_MS 10000 ///< Timeout de conexion si no se configura otro
+
+ClienteTLS::ClienteTLS(void)
+    : bundleCA(NULL), timeoutMs(TIMEOUT_TLS_DEFECTO_MS), handshakeUs(0), inicializado(false),
+      conectado(false), sesionValida(false), reanudada(false), bytePendiente(-1), direccionResuelta(0)
+{
+  mbedtls_net_init(&red);
+  mbedtls_ssl_session_init(&sesion);
+  mbedtls_x509_crt_init(&cadenaVacia);
+}
+
+ClienteTLS::~ClienteTLS(void)
+{
+  cerrar(true);
+  mbedtls_ssl_session_free(&sesion);
+  mbedtls_x509_crt_free(&cadenaVacia);
+  if (inicializado)
+  {
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_config_free(&configuracion);
+    mbedtls_ctr_drbg_free(&generador);
+    mbedtls_entropy_free(&entropia);
+  }
+}
+
+void ClienteTLS::establecerBundleCA(const uint8_t *bundle)
+{
+  bundleCA = bundle;
+}
+
+void ClienteTLS::establecerTimeout(uint32_t timeout)
+{
+  timeoutMs = timeout;
+}
+
+/**
+ * @brief Crea los contextos de mbedTLS la primera vez que se conecta
+ *
+ * mbedtls_ssl_setup() reserva los buffers de registros; se hace una sola
+ * vez y las conexiones siguientes solo reinician el contexto.
+ */
+bool ClienteTLS::inicializar(void)
+{
+  if (inicializado)
+  {
+    return true;
+  }
+
+  mbedtls_ssl_init(&ssl);
+  mbedtls_ssl_config_init(&configuracion);
+  mbedtls_entropy_init(&entropia);
+  mbedtls_ctr_drbg_init(&generador);
+
+  static const char personalizacion[] = "cliente_tls";
+  if (mbedtls_ctr_drbg_seed(&generador, mbedtls_entropy_func, &entropia,
+                            (const unsigned char *)personalizacion, sizeof(personalizacion) - 1) != 0 ||
+      mbedtls_ssl_config_defaults(&configuracion, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                  MBEDTLS_SSL_PRESET_DEFAULT) != 0)
+  {
+    return false;
+  }
+
+  mbedtls_ssl_conf_authmode(&configuracion, MBEDTLS_SSL_VERIFY_REQUIRED);
+  mbedtls_ssl_conf_rng(&configuracion, mbedtls_ctr_drbg_random, &generador);
+  mbedtls_ssl_conf_session_tickets(&configuracion, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+
+  if (bundleCAIndexado(bundleCA))
+  {
+    // mbedTLS solo valida la cadena si hay CA configuradas: basta una vacia,
+    // el emisor real lo aporta el callback desde el bundle
+    mbedtls_ssl_conf_ca_chain(&configuracion, &cadenaVacia, NULL);
+    mbedtls_ssl_conf_verify(&configuracion, verificarConBundleCA, (void *)bundleCA);
+  }
+  else if (bundleCA != NULL)
+  {
+    arduino_esp_crt_bundle_set(bundleCA);
+    arduino_esp_crt_bundle_attach(&configuracion);
+  }
+
+  if (mbedtls_ssl_setup(&ssl, &configuracion) != 0)
+  {
+    return false;
+  }
+
+  inicializado = true;
+  return true;
+}
+
+/**
+ * @brief Espera a que el socket quede listo para leer o escribir
+ */
+bool ClienteTLS::esperarSocket(bool escritura, uint32_t esperaMs)
+{
+  fd_set conjunto;
+  FD_ZERO(&conjunto);
+  FD_SET(red.fd, &conjunto);
+
+  struct timeval espera;
+  espera.tv_sec = esperaMs / 1000;
+  espera.tv_usec = (esperaMs % 1000) * 1000;
+
+  int listo = escritura ? select(red.fd + 1, NULL, &conjunto, NULL, &espera)
+                        : select(red.fd + 1, &conjunto, NULL, NULL, &espera);
+  return listo > 0;
+}
+
+/**
+ * @brief Abre un socket TCP no bloqueante con timeout de conexion
+ * @return 0 si conecto, -1 si fallo
+ */
+int ClienteTLS::abrirSocket(IPAddress ip, uint16_t puerto)
+{
+  red.fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (red.fd < 0)
+  {
+    return -1;
+  }
+
+  if (mbedtls_net_set_nonblock(&red) != 0)
+  {
+    return -1;
+  }
+
+  struct sockaddr_in direccion;
+  memset(&direccion, 0, sizeof(direccion));
+  direccion.sin_family = AF_INET;
+  direccion.sin_port = htons(puerto);
+  direccion.sin_addr.s_addr = (uint32_t)ip;
+
+  if (::connect(red.fd, (struct sockaddr *)&direccion, sizeof(direccion)) != 0 && errno != EINPROGRESS)
+  {
+    return -1;
+  }
+
+  if (!esperarSocket(true, timeoutMs))
+  {
+    return -1;
+  }
+
+  int error = 0;
+  socklen_t longitud = sizeof(error);
+  if (getsockopt(red.fd, SOL_SOCKET, SO_ERROR, &error, &longitud) != 0 || error != 0)
+  {
+    return -1;
+  }
+
+  // MQTT envia paquetes pequenos: no esperar a llenar segmentos
+  int sinRetardo = 1;
+  setsockopt(red.fd, IPPROTO_TCP, TCP_NODELAY, &sinRetardo, sizeof(sinRetardo));
+  return 0;
+}
+
+int ClienteTLS::conectar(IPAddress ip, uint16_t puerto, const char *nombreServidor)
+{
+  cerrar(true);
+
+  if (!inicializar() || mbedtls_ssl_session_reset(&ssl) != 0)
+  {
+    return 0;
+  }
+
+  if (abrirSocket(ip, puerto) != 0)
+  {
+    cerrar(false);
+    return 0;
+  }
+
+  mbedtls_ssl_set_hostname(&ssl, nombreServidor);
+  mbedtls_ssl_set_bio(&ssl, &red, mbedtls_net_send, mbedtls_net_recv, NULL);
+
+  // Ofrecer la sesion anterior; si el servidor no la acepta, mbedTLS hace
+  // un handshake completo sin intervencion
+  bool sesionOfrecida = sesionValida && mbedtls_ssl_set_session(&ssl, &sesion) == 0;
+
+  int64_t inicioUs = esp_timer_get_time();
+  int64_t limiteUs = inicioUs + (int64_t)timeoutMs * 1000;
+  int resultado;
+  while ((resultado = mbedtls_ssl_handshake(&ssl)) != 0)
+  {
+    int64_t restanteUs = limiteUs - esp_timer_get_time();
+    if ((resultado != MBEDTLS_ERR_SSL_WANT_READ && resultado != MBEDTLS_ERR_SSL_WANT_WRITE) || restanteUs <= 0)
+    {
+      // Una sesion rechazada con error no debe reintentarse
+      if (sesionOfrecida)
+      {
+        olvidarSesion();
+      }
+      cerrar(false);
+      return 0;
+    }
+    esperarSocket(resultado == MBEDTLS_ERR_SSL_WANT_WRITE, (uint32_t)(restanteUs / 1000) + 1);
+  }
+  handshakeUs = (uint32_t)(esp_timer_get_time() - inicioUs);
+
+  // El servidor confirma la reanudacion devolviendo el mismo ID de sesion
+  mbedtls_ssl_session nueva;
+  mbedtls_ssl_session_init(&nueva);
+  if (mbedtls_ssl_get_session(&ssl, &nueva) == 0)
+  {
+    reanudada = sesionOfrecida && nueva.id_len > 0 && nueva.id_len == sesion.id_len &&
+                memcmp(nueva.id, sesion.id, nueva.id_len) == 0;
+    mbedtls_ssl_session_free(&sesion);
+    sesion = nueva;
+    sesionValida = true;
+  }
+  else
+  {
+    reanudada = false;
+    mbedtls_ssl_session_free(&nueva);
+  }
+
+  conectado = true;
+  bytePendiente = -1;
+  return 1;
+}
+
+int ClienteTLS::connect(IPAddress ip, uint16_t port)
+{
+  return conectar(ip, port, NULL);
+}
+
+void ClienteTLS::establecerDireccionResuelta(IPAddress ip)
+{
+  direccionResuelta = (uint32_t)ip;
+}
+
+int ClienteTLS::connect(const char *host, uint16_t port)
+{
+  IPAddress ip(direccionResuelta);
+  if (direccionResuelta == 0 && !WiFi.hostByName(host, ip))
+  {
+    return 0;
+  }
+  return conectar(ip, port, host);
+}
+
+size_t ClienteTLS::write(uint8_t dato)
+{
+  return write(&dato, 1);
+}
+
+size_t ClienteTLS::write(const uint8_t *buf, size_t size)
+{
+  size_t escritos = 0;
+  uint32_t inicioMs = millis();
+
+  while (conectado && escritos < size)
+  {
+    int resultado = mbedtls_ssl_write(&ssl, buf + escritos, size - escritos);
+    if (resultado > 0)
+    {
+      escritos += resultado;
+    }
+    else if ((resultado == MBEDTLS_ERR_SSL_WANT_WRITE || resultado == MBEDTLS_ERR_SSL_WANT_READ) &&
+             millis() - inicioMs < timeoutMs)
+    {
+      esperarSocket(resultado == MBEDTLS_ERR_SSL_WANT_WRITE, 10);
+    }
+    else
+    {
+      cerrar(false);
+    }
+  }
+
+  return escritos;
+}
+
+int ClienteTLS::available(void)
+{
+  if (!conectado)
+  {
+    return 0;
+  }
+
+  // Procesar los registros que hayan llegado sin consumir datos
+  int resultado = mbedtls_ssl_read(&ssl, NULL, 0);
+  if (resultado < 0 && resultado != MBEDTLS_ERR_SSL_WANT_READ && resultado != MBEDTLS_ERR_SSL_WANT_WRITE)
+  {
+    cerrar(resultado != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY);
+    return bytePendiente >= 0 ? 1 : 0;
+  }
+
+  return (int)mbedtls_ssl_get_bytes_avail(&ssl) + (bytePendiente >= 0 ? 1 : 0);
+}
+
+int ClienteTLS::read(void)
+{
+  uint8_t dato;
+  return read(&dato, 1) == 1 ? dato : -1;
+}
+
+int ClienteTLS::read(uint8_t *buf, size_t size)
+{
+  if (size == 0)
+  {
+    return 0;
+  }
+
+  size_t leidos = 0;
+  if (bytePendiente >= 0)
+  {
+    buf[leidos++] = (uint8_t)bytePendiente;
+    bytePendiente = -1;
+  }
+
+  if (!conectado || leidos == size)
+  {
+    return leidos > 0 ? (int)leidos : -1;
+  }
+
+  int resultado = mbedtls_ssl_read(&ssl, buf + leidos, size - leidos);
+  if (resultado > 0)
+  {
+    leidos += resultado;
+  }
+  else if (resultado != MBEDTLS_ERR_SSL_WANT_READ && resultado != MBEDTLS_ERR_SSL_WANT_WRITE)
+  {
+    cerrar(resultado != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY);
+  }
+
+  return leidos > 0 ? (int)leidos : -1;
+}
+
+int ClienteTLS::peek(void)
+{
+  if (bytePendiente < 0)
+  {
+    int dato = read();
+    if (dato < 0)
+    {
+      return -1;
+    }
+    bytePendiente = (int16_t)dato;
+  }
+  return bytePendiente;
+}
+
+void ClienteTLS::flush(void)
+{
+  // Las escrituras salen completas en write(); no hay nada que vaciar
+}
+
+void ClienteTLS::stop(void)
+{
+  cerrar(true);
+}
+
+uint8_t ClienteTLS::connected(void)
+{
+  if (conectado)
+  {
+    available();
+  }
+  return conectado || bytePendiente >= 0;
+}
+
+ClienteTLS::operator bool(void)
+{
+  return connected();
+}
+
+void ClienteTLS::cerrar(bool notificar)
+{
+  if (conectado && notificar)
+  {
+    mbedtls_ssl_close_notify(&ssl);
+  }
+  conectado = false;
+  mbedtls_net_free(&red);
+}
+
+bool ClienteTLS::haySesionGuardada(void) const
+{
+  return sesionValida;
+}
+
+bool ClienteTLS::ultimaConexionReanudada(void) const
+{
+  return reanudada;
+}
+
+uint32_t ClienteTLS::duracionUltimoHandshakeUs(void) const
+{
+  return handshakeUs;
+}
+
+void ClienteTLS::olvidarSesion(void)
+{
+  mbedtls_ssl_session_free(&sesion);
+  mbedtls_ssl_session_init(&sesion);
+  sesionValida = false;
+}
+
+size_t ClienteTLS::exportarSesion(uint8_t *destino, size_t capacidad) const
+{
+  size_t longitud = 0;
+  if (!sesionValida || mbedtls_ssl_session_save(&sesion, destino, capacidad, &longitud) != 0)
+  {
+    return 0;
+  }
+  return longitud;
+}
+
+bool ClienteTLS::importarSesion(const uint8_t *origen, size_t longitud)
+{
+  olvidarSesion();
+  if (longitud == 0 || mbedtls_ssl_session_load(&sesion, origen, longitud) != 0)
+  {
+    olvidarSesion();
+    return false;
+  }
+  sesionValida = true;
+  return true;
+}
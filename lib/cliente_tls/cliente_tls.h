@@ -0,0 +1,140 @@
+#ifndef CLIENTE_TLS_H
+#define CLIENTE_TLS_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+
+/**
+ * @file cliente_tls.h
+ * @brief Cliente TLS sobre mbedTLS con reanudacion de sesion
+ *
+ * Sustituye a WiFiClientSecure para PubSubClient. Tras cada handshake
+ * completo guarda la sesion negociada (ID de sesion y, si el servidor la
+ * emite, el ticket RFC 5077) y la ofrece en la siguiente conexion. Si el
+ * servidor la acepta, la reconexion se salta el intercambio de claves y
+ * la validacion de la cadena de certificados, que en el ESP32 cuestan
+ * segundos de CPU y varios KB de heap.
+ *
+ * La sesion puede exportarse a un buffer (memoria RTC, NVS) para
+ * reanudarla tambien despues de un reinicio o de un sueno profundo. El
+ * buffer contiene el secreto maestro de la sesion: no debe salir del
+ * dispositivo.
+ *
+ * Los contextos de mbedTLS se crean una sola vez y se reutilizan entre
+ * conexiones, sin volver a reservar los buffers de registros.
+ */
+class ClienteTLS : public Client
+{
+public:
+  ClienteTLS(void);
+  ~ClienteTLS(void);
+
+  /**
+   * @brief Bundle de certificados CA para validar al servidor
+   *
+   * Acepta el formato de esp_crt_bundle y el indexado de bundleUp.py
+   * --indexed (ver bundle_ca.h), que se reconoce por su marca. Debe
+   * fijarse antes de la primera conexion.
+   */
+  void establecerBundleCA(const uint8_t *bundle);
+
+  /**
+   * @brief Tiempo maximo para conectar el socket y completar el handshake
+   */
+  void establecerTimeout(uint32_t timeoutMs);
+
+  /**
+   * @brief Conecta a una IP ya resuelta, validando el certificado contra un nombre
+   * @param ip Direccion del servidor
+   * @param puerto Puerto TCP
+   * @param nombreServidor Nombre para SNI y verificacion del certificado
+   * @return 1 si la conexion TLS quedo establecida, 0 si fallo
+   */
+  int conectar(IPAddress ip, uint16_t puerto, const char *nombreServidor);
+
+  /**
+   * @brief Fija la IP que usara connect(host) en lugar de consultar el DNS
+   *
+   * El nombre se sigue usando para SNI y para validar el certificado. Con
+   * IPAddress() (0.0.0.0) se vuelve a resolver en cada conexion.
+   */
+  void establecerDireccionResuelta(IPAddress ip);
+
+  // Interfaz Client de Arduino
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+  size_t write(uint8_t dato) override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available(void) override;
+  int read(void) override;
+  int read(uint8_t *buf, size_t size) override;
+  int peek(void) override;
+  void flush(void) override;
+  void stop(void) override;
+  uint8_t connected(void) override;
+  operator bool(void) override;
+
+  /**
+   * @brief Indica si hay una sesion guardada para ofrecer al reconectar
+   */
+  bool haySesionGuardada(void) const;
+
+  /**
+   * @brief Indica si la ultima conexion reanudo la sesion guardada
+   */
+  bool ultimaConexionReanudada(void) const;
+
+  /**
+   * @brief Duracion del ultimo handshake en microsegundos
+   */
+  uint32_t duracionUltimoHandshakeUs(void) const;
+
+  /**
+   * @brief Descarta la sesion guardada; el siguiente handshake sera completo
+   */
+  void olvidarSesion(void);
+
+  /**
+   * @brief Serializa la sesion guardada
+   * @param destino Buffer de salida
+   * @param capacidad Tamano del buffer
+   * @return Bytes escritos, 0 si no hay sesion o no cabe
+   */
+  size_t exportarSesion(uint8_t *destino, size_t capacidad) const;
+
+  /**
+   * @brief Restaura una sesion serializada con exportarSesion()
+   * @return true si la sesion es valida y quedo guardada
+   */
+  bool importarSesion(const uint8_t *origen, size_t longitud);
+
+private:
+  bool inicializar(void);
+  int abrirSocket(IPAddress ip, uint16_t puerto);
+  bool esperarSocket(bool escritura, uint32_t esperaMs);
+  void cerrar(bool notificar);
+
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config configuracion;
+  mbedtls_entropy_context entropia;
+  mbedtls_ctr_drbg_context generador;
+  mbedtls_net_context red;
+  mbedtls_ssl_session sesion;
+  mbedtls_x509_crt cadenaVacia; ///< Cadena de CA vacia para el bundle indexado
+
+  const uint8_t *bundleCA;
+  uint32_t timeoutMs;
+  uint32_t handshakeUs;
+  bool inicializado;
+  bool conectado;
+  bool sesionValida;
+  bool reanudada;
+  int16_t bytePendiente;      ///< Byte leido por peek(), -1 si no hay
+  uint32_t direccionResuelta; ///< IP fijada para connect(host), 0 si se usa DNS
+};
+
+#endif
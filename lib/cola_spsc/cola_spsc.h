@@ -0,0 +1,97 @@
+#ifndef COLA_SPSC_H
+#define COLA_SPSC_H
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @file cola_spsc.h
+ * @brief Cola circular sin bloqueos de un productor y un consumidor
+ *
+ * Pensada para pasar registros de tamano fijo entre dos tareas de FreeRTOS
+ * que pueden correr en nucleos distintos. Solo una tarea puede encolar y
+ * solo una puede desencolar; con esa restriccion no hace falta ningun
+ * mutex ni seccion critica.
+ *
+ * @tparam T Tipo del elemento (copiable, de tamano fijo)
+ * @tparam N Capacidad de la cola; debe ser potencia de dos
+ */
+template <typename T, uint32_t N>
+class ColaSPSC
+{
+  static_assert(N > 0 && (N & (N - 1)) == 0, "La capacidad de ColaSPSC debe ser potencia de dos");
+
+public:
+  ColaSPSC(void) : indiceEscritura(0), indiceLectura(0)
+  {
+  }
+
+  /**
+   * @brief Agrega un elemento al final de la cola (solo productor)
+   * @param elemento Elemento a copiar en la cola
+   * @return true si se encolo, false si la cola estaba llena
+   */
+  bool encolar(const T &elemento)
+  {
+    uint32_t escritura = indiceEscritura.load(std::memory_order_relaxed);
+    if (escritura - indiceLectura.load(std::memory_order_acquire) >= N)
+    {
+      return false;
+    }
+
+    elementos[escritura & (N - 1)] = elemento;
+    indiceEscritura.store(escritura + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Extrae el elemento mas antiguo de la cola (solo consumidor)
+   * @param elemento Destino donde se copia el elemento
+   * @return true si habia un elemento, false si la cola estaba vacia
+   */
+  bool desencolar(T &elemento)
+  {
+    uint32_t lectura = indiceLectura.load(std::memory_order_relaxed);
+    if (indiceEscritura.load(std::memory_order_acquire) == lectura)
+    {
+      return false;
+    }
+
+    elemento = elementos[lectura & (N - 1)];
+    indiceLectura.store(lectura + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Numero de elementos pendientes (aproximado si se consulta
+   *        mientras la otra tarea opera)
+   */
+  uint32_t tamano(void) const
+  {
+    return indiceEscritura.load(std::memory_order_acquire) -
+           indiceLectura.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Indica si no hay elementos pendientes
+   */
+  bool vacia(void) const
+  {
+    return tamano() == 0;
+  }
+
+  /**
+   * @brief Capacidad maxima de la cola
+   */
+  static uint32_t capacidad(void)
+  {
+    return N;
+  }
+
+private:
+  T elementos[N];
+  std::atomic<uint32_t> indiceEscritura; ///< Solo lo modifica el productor
+  std::atomic<uint32_t> indiceLectura;   ///< Solo lo modifica el consumidor
+};
+
+#endif
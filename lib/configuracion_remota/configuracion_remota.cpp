@@ -0,0 +1,298 @@
+#include "configuracion_remota.h"
+
+#include <string.h>
+#include <Preferences.h>
+#include "enrutador_comandos.h"
+
+#define ESPACIO_NVS "config"                                                ///< Espacio de nombres en NVS
+#define CLAVE_NVS_FIRMA "firma"                                             ///< Clave de la firma
+#define CLAVE_NVS_DATOS "datos"                                             ///< Clave de la estructura
+#define FIRMA_CONFIGURACION (0x43464700UL ^ sizeof(ConfiguracionDispositivo)) ///< Cambia si cambia la estructura
+
+/**
+ * @brief Interpreta un entero sin signo de a lo sumo maximo
+ */
+static bool interpretarNatural(const uint8_t *valor, unsigned int longitud, int32_t maximo, int32_t &destino)
+{
+  return interpretarEntero(valor, longitud, destino) && destino >= 0 && destino <= maximo;
+}
+
+/**
+ * @brief Copia un prefijo de topico; rechaza comodines, controles y el vacio
+ */
+static bool copiarPrefijo(const uint8_t *valor, unsigned int longitud, char *destino)
+{
+  if (longitud == 0 || longitud >= LONGITUD_PREFIJO_CONFIGURACION)
+  {
+    return false;
+  }
+  for (unsigned int i = 0; i < longitud; i++)
+  {
+    if (valor[i] < ' ' || valor[i] == '+' || valor[i] == '#')
+    {
+      return false;
+    }
+  }
+  memcpy(destino, valor, longitud);
+  destino[longitud] = '\0';
+  return true;
+}
+
+/**
+ * @brief Interpreta un decimal con signo y punto opcionales, sin exponente
+ */
+static bool interpretarDecimal(const uint8_t *valor, unsigned int longitud, float &destino)
+{
+  unsigned int i = 0;
+  bool negativo = longitud > 0 && valor[0] == '-';
+  if (negativo || (longitud > 0 && valor[0] == '+'))
+  {
+    i++;
+  }
+
+  float resultado = 0.0f;
+  float escala = 0.0f; // 0 en la parte entera; luego el peso del siguiente decimal
+  unsigned int digitos = 0;
+  for (; i < longitud; i++)
+  {
+    if (valor[i] == '.' && escala == 0.0f)
+    {
+      escala = 0.1f;
+    }
+    else if (valor[i] >= '0' && valor[i] <= '9' && digitos < 9)
+    {
+      if (escala == 0.0f)
+      {
+        resultado = resultado * 10.0f + (valor[i] - '0');
+      }
+      else
+      {
+        resultado += (valor[i] - '0') * escala;
+        escala *= 0.1f;
+      }
+      digitos++;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  if (digitos == 0)
+  {
+    return false;
+  }
+  destino = negativo ? -resultado : resultado;
+  return true;
+}
+
+/**
+ * @brief Interpreta canal,tipo,umbral[,histeresis[,salida]]
+ */
+static bool interpretarRegla(const uint8_t *valor, unsigned int longitud, Regla &regla)
+{
+  regla.histeresis = 0.0f;
+  regla.salida = SALIDA_NINGUNA;
+
+  uint8_t campo = 0;
+  unsigned int inicio = 0;
+  while (inicio <= longitud)
+  {
+    const uint8_t *coma = (const uint8_t *)memchr(valor + inicio, ',', longitud - inicio);
+    unsigned int fin = coma != NULL ? (unsigned int)(coma - valor) : longitud;
+    const uint8_t *texto = valor + inicio;
+    unsigned int largo = fin - inicio;
+    int32_t numero = 0;
+    bool valido;
+    switch (campo)
+    {
+    case 0:
+      valido = interpretarNatural(texto, largo, MAX_CANALES_REGLAS - 1, numero);
+      regla.canal = (uint8_t)numero;
+      break;
+    case 1:
+      valido = true;
+      if (cargaIgual(texto, largo, "mayor"))
+      {
+        regla.tipo = REGLA_MAYOR;
+      }
+      else if (cargaIgual(texto, largo, "menor"))
+      {
+        regla.tipo = REGLA_MENOR;
+      }
+      else if (cargaIgual(texto, largo, "cambio"))
+      {
+        regla.tipo = REGLA_CAMBIO;
+      }
+      else
+      {
+        valido = false;
+      }
+      break;
+    case 2:
+      valido = interpretarDecimal(texto, largo, regla.umbral);
+      break;
+    case 3:
+      valido = interpretarDecimal(texto, largo, regla.histeresis);
+      break;
+    case 4:
+      valido = interpretarNatural(texto, largo, MAX_SALIDAS_REGLAS - 1, numero);
+      regla.salida = (uint8_t)numero;
+      break;
+    default:
+      valido = false;
+      break;
+    }
+    if (!valido)
+    {
+      return false;
+    }
+    campo++;
+    inicio = fin + 1;
+  }
+  return campo >= 3 && MotorReglas::reglaValida(regla);
+}
+
+/**
+ * @brief Aplica un par clave=valor a la configuracion
+ * @param reglasVistas Bit por cada reglaN recibida
+ */
+static bool aplicarPar(const uint8_t *clave, unsigned int largoClave, const uint8_t *valor, unsigned int largoValor,
+                       ConfiguracionDispositivo &configuracion, uint32_t &reglasVistas)
+{
+  int32_t numero;
+  if (cargaIgual(clave, largoClave, "version"))
+  {
+    if (!interpretarNatural(valor, largoValor, INT32_MAX, numero) || numero == 0)
+    {
+      return false;
+    }
+    configuracion.version = (uint32_t)numero;
+  }
+  else if (cargaIgual(clave, largoClave, "muestras"))
+  {
+    if (!interpretarNatural(valor, largoValor, UINT8_MAX, numero))
+    {
+      return false;
+    }
+    configuracion.muestrasPorEntrega = (uint8_t)numero;
+  }
+  else if (cargaIgual(clave, largoClave, "periodoMs"))
+  {
+    if (!interpretarNatural(valor, largoValor, UINT16_MAX, numero))
+    {
+      return false;
+    }
+    configuracion.periodoMuestreoMs = (uint16_t)numero;
+  }
+  else if (cargaIgual(clave, largoClave, "desfaseMs"))
+  {
+    if (!interpretarNatural(valor, largoValor, UINT16_MAX, numero))
+    {
+      return false;
+    }
+    configuracion.desfaseSensoresMs = (uint16_t)numero;
+  }
+  else if (cargaIgual(clave, largoClave, "keepAliveS"))
+  {
+    if (!interpretarNatural(valor, largoValor, UINT16_MAX, numero))
+    {
+      return false;
+    }
+    configuracion.keepAliveS = (uint16_t)numero;
+  }
+  else if (largoClave == 8 && memcmp(clave, "prefijo", 7) == 0 && clave[7] >= '0' &&
+           clave[7] < '0' + MAX_PREFIJOS_CONFIGURACION)
+  {
+    return copiarPrefijo(valor, largoValor, configuracion.prefijos[clave[7] - '0']);
+  }
+  else if (largoClave == 6 && memcmp(clave, "regla", 5) == 0 && clave[5] >= '0' && clave[5] < '0' + MAX_REGLAS)
+  {
+    uint8_t indice = clave[5] - '0';
+    reglasVistas |= 1UL << indice;
+    return interpretarRegla(valor, largoValor, configuracion.reglas[indice]);
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+bool interpretarConfiguracion(const uint8_t *carga, unsigned int longitud, ConfiguracionDispositivo &configuracion)
+{
+  bool conVersion = false;
+  uint32_t reglasVistas = 0;
+  unsigned int inicio = 0;
+  while (inicio < longitud)
+  {
+    unsigned int fin = inicio;
+    while (fin < longitud && carga[fin] != ';' && carga[fin] != '\n' && carga[fin] != '\r')
+    {
+      fin++;
+    }
+
+    if (fin > inicio)
+    {
+      const uint8_t *igual = (const uint8_t *)memchr(carga + inicio, '=', fin - inicio);
+      if (igual == NULL)
+      {
+        return false;
+      }
+      unsigned int largoClave = (unsigned int)(igual - (carga + inicio));
+      if (!aplicarPar(carga + inicio, largoClave, igual + 1, fin - inicio - largoClave - 1, configuracion,
+                      reglasVistas))
+      {
+        return false;
+      }
+      conVersion = conVersion || cargaIgual(carga + inicio, largoClave, "version");
+    }
+    inicio = fin + 1;
+  }
+
+  // Las reglas recibidas reemplazan a todas las anteriores y deben ser regla0..reglaN-1
+  uint8_t numeroReglas = 0;
+  while (numeroReglas < MAX_REGLAS && (reglasVistas & (1UL << numeroReglas)))
+  {
+    numeroReglas++;
+  }
+  if (reglasVistas != (1UL << numeroReglas) - 1)
+  {
+    return false;
+  }
+  configuracion.numeroReglas = numeroReglas;
+  return conVersion;
+}
+
+bool cargarConfiguracion(ConfiguracionDispositivo &configuracion)
+{
+  Preferences preferencias;
+  if (!preferencias.begin(ESPACIO_NVS, true))
+  {
+    return false;
+  }
+
+  ConfiguracionDispositivo guardada;
+  bool valida = preferencias.getUInt(CLAVE_NVS_FIRMA, 0) == FIRMA_CONFIGURACION &&
+                preferencias.getBytes(CLAVE_NVS_DATOS, &guardada, sizeof(guardada)) == sizeof(guardada);
+  preferencias.end();
+
+  if (valida)
+  {
+    configuracion = guardada;
+  }
+  return valida;
+}
+
+bool guardarConfiguracion(const ConfiguracionDispositivo &configuracion)
+{
+  Preferences preferencias;
+  if (!preferencias.begin(ESPACIO_NVS, false))
+  {
+    return false;
+  }
+
+  bool guardada = preferencias.putBytes(CLAVE_NVS_DATOS, &configuracion, sizeof(configuracion)) == sizeof(configuracion) &&
+                  preferencias.putUInt(CLAVE_NVS_FIRMA, FIRMA_CONFIGURACION) == sizeof(uint32_t);
+  preferencias.end();
+  return guardada;
+}
@@ -0,0 +1,74 @@
+#ifndef CONFIGURACION_REMOTA_H
+#define CONFIGURACION_REMOTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "motor_reglas.h"
+
+/**
+ * @file configuracion_remota.h
+ * @brief Configuracion de muestreo y topicos recibida por MQTT y guardada en NVS
+ *
+ * La configuracion llega como texto en un topico retenido propio de cada
+ * equipo: pares clave=valor separados por ';' o por saltos de linea, p. ej.
+ *
+ *   version=3;muestras=20;periodoMs=25;prefijo0=PLANTA_B/http/
+ *
+ * Claves: version (obligatoria, distinta de 0), muestras, periodoMs,
+ * desfaseMs, keepAliveS, prefijo0 a prefijo3 y regla0 a regla7. Cada regla
+ * es canal,tipo,umbral[,histeresis[,salida]], con tipo mayor, menor o
+ * cambio (ver motor_reglas.h), p. ej. regla0=0,mayor,150,5,0; las reglas
+ * van numeradas desde 0 sin huecos. Se interpreta sobre los
+ * valores por defecto que da la aplicacion, de modo que el mensaje
+ * describe la configuracion completa: una clave que falta vuelve al valor
+ * de compilacion. Una clave desconocida, un numero que no cabe en su
+ * campo o un prefijo invalido rechazan el mensaje entero. Los limites que
+ * dependen de la aplicacion (ventana de los filtros, largo de los topicos)
+ * los comprueba quien la aplica.
+ *
+ * El broker reenvia el mensaje retenido en cada reconexion: quien aplica
+ * la configuracion no hace nada si la version es la que ya tiene.
+ *
+ * La estructura se guarda tal cual en NVS (Preferences), junto a una firma
+ * que cambia si cambia su tamano.
+ */
+
+#define MAX_PREFIJOS_CONFIGURACION 4      ///< Prefijos de topico configurables
+#define LONGITUD_PREFIJO_CONFIGURACION 32 ///< Prefijo mas largo, con el terminador
+
+/**
+ * @brief Configuracion aplicable en marcha, en binario
+ */
+struct ConfiguracionDispositivo
+{
+  uint32_t version;           ///< 0: valores de compilacion, sin configuracion remota
+  uint16_t periodoMuestreoMs; ///< Periodo de sondeo de los sensores
+  uint16_t desfaseSensoresMs; ///< Desfase entre las tareas de cada grupo de sensores
+  uint16_t keepAliveS;        ///< Keep alive MQTT en segundos
+  uint8_t muestrasPorEntrega; ///< Ventana de los filtros y lecturas por entrega
+  uint8_t numeroReglas;       ///< Reglas de alarma en uso
+  char prefijos[MAX_PREFIJOS_CONFIGURACION][LONGITUD_PREFIJO_CONFIGURACION]; ///< Prefijos de topico
+  Regla reglas[MAX_REGLAS];   ///< Ya interpretadas; canal y salida los valida la aplicacion
+};
+
+/**
+ * @brief Interpreta un mensaje de configuracion
+ * @param carga Carga del mensaje, sin terminador nulo
+ * @param longitud Longitud de la carga
+ * @param configuracion Entra con los valores por defecto; sale con los del mensaje
+ * @return false si el mensaje es invalido; configuracion puede quedar a medio escribir
+ */
+bool interpretarConfiguracion(const uint8_t *carga, unsigned int longitud, ConfiguracionDispositivo &configuracion);
+
+/**
+ * @brief Lee de NVS la ultima configuracion guardada
+ * @return false si no hay ninguna o es de otra version de la estructura
+ */
+bool cargarConfiguracion(ConfiguracionDispositivo &configuracion);
+
+/**
+ * @brief Guarda la configuracion en NVS
+ */
+bool guardarConfiguracion(const ConfiguracionDispositivo &configuracion);
+
+#endif
@@ -0,0 +1,268 @@
+#include "dht_rmt.h"
+
+#include "driver/gpio.h"
+
+#define DIVISOR_RELOJ_RMT 80          ///< APB de 80 MHz / 80 = 1 tick por us
+#define FILTRO_RUIDO_RMT 100          ///< Pulsos de menos de 100 ciclos APB (1,25 us) se ignoran
+#define UMBRAL_FIN_TRAMA_US 250       ///< Linea quieta este tiempo = fin de trama
+#define TAMANO_ANILLO_RMT 512         ///< Bytes del anillo de recepcion por canal
+#define PULSO_INICIO_DHT11_US 20000   ///< Pulso bajo de inicio del DHT11 (>= 18 ms)
+#define PULSO_INICIO_DHT2X_US 1100    ///< Pulso bajo de inicio del DHT21/DHT22 (>= 1 ms)
+#define UMBRAL_BIT_UNO_US 48          ///< Un "0" dura 26-28 us en alto y un "1", 70 us
+#define BITS_TRAMA_DHT 40             ///< 16 de humedad, 16 de temperatura y 8 de checksum
+
+LectorDHTRMT::LectorDHTRMT(void) : cantidad(0), iniciado(false), disparoMs(0), fallidas(0)
+{
+}
+
+int8_t LectorDHTRMT::agregarSensor(uint8_t pin, uint8_t modelo)
+{
+  if (iniciado || cantidad >= MAX_SENSORES_DHT_RMT)
+  {
+    return -1;
+  }
+
+  Sensor &sensor = sensores[cantidad];
+  sensor.pin = pin;
+  sensor.modelo = modelo;
+  sensor.anillo = NULL;
+  sensor.capturando = false;
+  sensor.nueva = false;
+  sensor.estado = DHT_SIN_DATOS;
+  sensor.temperatura = NAN;
+  sensor.humedad = NAN;
+  return (int8_t)cantidad++;
+}
+
+bool LectorDHTRMT::iniciar(uint32_t esperaInicialMs)
+{
+  for (uint8_t i = 0; i < cantidad; i++)
+  {
+    Sensor &sensor = sensores[i];
+    rmt_channel_t canal = (rmt_channel_t)i;
+
+    rmt_config_t configuracion = RMT_DEFAULT_CONFIG_RX((gpio_num_t)sensor.pin, canal);
+    configuracion.clk_div = DIVISOR_RELOJ_RMT;
+    configuracion.rx_config.filter_en = true;
+    configuracion.rx_config.filter_ticks_thresh = FILTRO_RUIDO_RMT;
+    configuracion.rx_config.idle_threshold = UMBRAL_FIN_TRAMA_US;
+
+    if (rmt_config(&configuracion) != ESP_OK ||
+        rmt_driver_install(canal, TAMANO_ANILLO_RMT, 0) != ESP_OK ||
+        rmt_get_ringbuf_handle(canal, &sensor.anillo) != ESP_OK)
+    {
+      return false;
+    }
+
+    // El RMT escucha el pin por la matriz GPIO; como salida de drenador
+    // abierto la CPU puede bajar la linea sin desconectar la entrada
+    gpio_set_direction((gpio_num_t)sensor.pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_pull_mode((gpio_num_t)sensor.pin, GPIO_PULLUP_ONLY);
+    gpio_set_level((gpio_num_t)sensor.pin, 1);
+  }
+
+  // Primer disparo pasado esperaInicialMs
+  disparoMs = millis() - INTERVALO_MINIMO_DHT_MS + esperaInicialMs;
+  iniciado = true;
+  return true;
+}
+
+void LectorDHTRMT::actualizar(uint32_t ahoraMs)
+{
+  if (!iniciado || cantidad == 0)
+  {
+    return;
+  }
+
+  bool pendientes = false;
+  for (uint8_t i = 0; i < cantidad; i++)
+  {
+    if (sensores[i].capturando)
+    {
+      recoger(i, ahoraMs);
+      pendientes = pendientes || sensores[i].capturando;
+    }
+  }
+
+  if (pendientes || (int32_t)(ahoraMs - disparoMs) < INTERVALO_MINIMO_DHT_MS)
+  {
+    return;
+  }
+  disparar(ahoraMs);
+}
+
+bool LectorDHTRMT::lectura(uint8_t indice, float &temperatura, float &humedad)
+{
+  if (indice >= cantidad || !sensores[indice].nueva)
+  {
+    return false;
+  }
+
+  sensores[indice].nueva = false;
+  temperatura = sensores[indice].temperatura;
+  humedad = sensores[indice].humedad;
+  return true;
+}
+
+uint8_t LectorDHTRMT::cantidadSensores(void) const
+{
+  return cantidad;
+}
+
+EstadoDHT LectorDHTRMT::estado(uint8_t indice) const
+{
+  return indice < cantidad ? sensores[indice].estado : DHT_SIN_DATOS;
+}
+
+uint32_t LectorDHTRMT::errores(void) const
+{
+  return fallidas;
+}
+
+/**
+ * @brief Genera el pulso de inicio en todos los sensores y arranca la captura
+ *
+ * Todas las lineas se bajan juntas y se sueltan una tras otra, arrancando
+ * cada canal justo antes de soltar su linea: el sensor tarda 20-40 us en
+ * responder, de sobra para poner en marcha el siguiente canal.
+ */
+void LectorDHTRMT::disparar(uint32_t ahoraMs)
+{
+  uint32_t pulsoUs = PULSO_INICIO_DHT2X_US;
+  for (uint8_t i = 0; i < cantidad; i++)
+  {
+    // Descartar restos de un disparo anterior (p. ej. solo el flanco propio)
+    size_t longitud = 0;
+    void *resto;
+    while ((resto = xRingbufferReceive(sensores[i].anillo, &longitud, 0)) != NULL)
+    {
+      vRingbufferReturnItem(sensores[i].anillo, resto);
+    }
+
+    if (sensores[i].modelo == MODELO_DHT11)
+    {
+      pulsoUs = PULSO_INICIO_DHT11_US;
+    }
+    gpio_set_level((gpio_num_t)sensores[i].pin, 0);
+  }
+
+  if (pulsoUs >= 10000)
+  {
+    delay(pulsoUs / 1000); // Cede la CPU durante el pulso largo del DHT11
+  }
+  else
+  {
+    delayMicroseconds(pulsoUs);
+  }
+
+  for (uint8_t i = 0; i < cantidad; i++)
+  {
+    rmt_rx_start((rmt_channel_t)i, true);
+    gpio_set_level((gpio_num_t)sensores[i].pin, 1);
+    sensores[i].capturando = true;
+  }
+  disparoMs = ahoraMs;
+}
+
+/**
+ * @brief Recoge y decodifica la trama de un sensor si ya llego
+ */
+void LectorDHTRMT::recoger(uint8_t indice, uint32_t ahoraMs)
+{
+  Sensor &sensor = sensores[indice];
+
+  size_t longitud = 0;
+  rmt_item32_t *items = (rmt_item32_t *)xRingbufferReceive(sensor.anillo, &longitud, 0);
+  if (items != NULL)
+  {
+    sensor.estado = decodificar(items, longitud / sizeof(rmt_item32_t), sensor);
+    vRingbufferReturnItem(sensor.anillo, items);
+  }
+  else if (ahoraMs - disparoMs <= TIMEOUT_TRAMA_DHT_MS)
+  {
+    return;
+  }
+  else
+  {
+    sensor.estado = DHT_SIN_RESPUESTA;
+  }
+
+  rmt_rx_stop((rmt_channel_t)indice);
+  sensor.capturando = false;
+  if (sensor.estado == DHT_VALIDA)
+  {
+    sensor.nueva = true;
+  }
+  else
+  {
+    fallidas++;
+  }
+}
+
+/**
+ * @brief Convierte los pulsos capturados en temperatura y humedad
+ *
+ * Trama: bajo de respuesta (80 us), alto de respuesta (80 us) y 40 bits,
+ * cada uno un bajo de 50 us seguido de un alto cuyo ancho es el valor del
+ * bit. El alto final queda sin terminar (duracion 0) al cerrar la trama.
+ * Se toman los ultimos 40 altos completos, lo que descarta el alto de
+ * respuesta y el corto flanco propio que pueda haberse capturado al soltar
+ * la linea.
+ */
+EstadoDHT LectorDHTRMT::decodificar(const rmt_item32_t *items, size_t cantidad, Sensor &sensor)
+{
+  uint64_t bits = 0;
+  uint8_t altos = 0;
+  for (size_t i = 0; i < cantidad; i++)
+  {
+    if (items[i].level0 == 1 && items[i].duration0 > 0)
+    {
+      bits = (bits << 1) | (items[i].duration0 > UMBRAL_BIT_UNO_US ? 1 : 0);
+      altos = altos < UINT8_MAX ? altos + 1 : altos;
+    }
+    if (items[i].level1 == 1 && items[i].duration1 > 0)
+    {
+      bits = (bits << 1) | (items[i].duration1 > UMBRAL_BIT_UNO_US ? 1 : 0);
+      altos = altos < UINT8_MAX ? altos + 1 : altos;
+    }
+  }
+
+  if (altos <= 1)
+  {
+    return DHT_SIN_RESPUESTA; // Solo el flanco de soltar la linea
+  }
+  if (altos < BITS_TRAMA_DHT)
+  {
+    return DHT_TRAMA_INVALIDA;
+  }
+
+  uint8_t datos[5];
+  for (uint8_t i = 0; i < 5; i++)
+  {
+    datos[i] = (uint8_t)(bits >> (32 - 8 * i));
+  }
+  if ((uint8_t)(datos[0] + datos[1] + datos[2] + datos[3]) != datos[4])
+  {
+    return DHT_ERROR_CHECKSUM;
+  }
+
+  if (sensor.modelo == MODELO_DHT11)
+  {
+    sensor.humedad = datos[0] + datos[1] * 0.1f;
+    sensor.temperatura = datos[2] + (datos[3] & 0x0F) * 0.1f;
+    if (datos[3] & 0x80)
+    {
+      sensor.temperatura = -sensor.temperatura;
+    }
+  }
+  else
+  {
+    sensor.humedad = ((datos[0] << 8) | datos[1]) * 0.1f;
+    sensor.temperatura = (((datos[2] & 0x7F) << 8) | datos[3]) * 0.1f;
+    if (datos[2] & 0x80)
+    {
+      sensor.temperatura = -sensor.temperatura;
+    }
+  }
+  return DHT_VALIDA;
+}
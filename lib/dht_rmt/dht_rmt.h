@@ -0,0 +1,131 @@
+#ifndef DHT_RMT_H
+#define DHT_RMT_H
+
+#include <Arduino.h>
+#include "driver/rmt.h"
+
+/**
+ * @file dht_rmt.h
+ * @brief Lectura de varios DHT11/DHT21/DHT22 en paralelo con el periferico RMT
+ *
+ * Cada sensor usa un canal de recepcion RMT propio. La CPU solo genera el
+ * pulso de inicio, igual para todos los sensores a la vez; la trama de 40
+ * bits la mide el RMT con resolucion de 1 us mientras las interrupciones
+ * siguen activas, y se decodifica al recogerla desde el anillo del driver.
+ * No hay esperas con las interrupciones desactivadas como en la libreria
+ * DHT por software.
+ *
+ * El lector dispara una nueva lectura como mucho cada
+ * INTERVALO_MINIMO_DHT_MS, el minimo que admiten los sensores entre
+ * lecturas. Entre disparos actualizar() solo recoge tramas y lectura()
+ * devuelve false, de modo que nunca se entrega un valor repetido ni un NaN.
+ */
+
+// Modelos de sensor soportados
+#define MODELO_DHT11 11 ///< DHT11: resolucion de 1 %HR y 1 C
+#define MODELO_DHT21 21 ///< DHT21 / AM2301: decimas de %HR y de C
+#define MODELO_DHT22 22 ///< DHT22 / AM2302: mismo formato que el DHT21
+
+#define MAX_SENSORES_DHT_RMT 4       ///< Sensores por lector (un canal RMT cada uno)
+#define INTERVALO_MINIMO_DHT_MS 2000 ///< Minimo entre lecturas de un mismo sensor
+#define TIMEOUT_TRAMA_DHT_MS 10      ///< Espera maxima de la trama (dura ~5 ms)
+
+/**
+ * @brief Resultado de la ultima lectura de un sensor
+ */
+enum EstadoDHT : uint8_t
+{
+  DHT_SIN_DATOS = 0,  ///< Aun no se completo ninguna lectura
+  DHT_VALIDA,         ///< Trama completa con checksum correcto
+  DHT_SIN_RESPUESTA,  ///< El sensor no respondio dentro del timeout
+  DHT_TRAMA_INVALIDA, ///< Menos de 40 bits o pulsos fuera de rango
+  DHT_ERROR_CHECKSUM  ///< 40 bits recibidos con checksum incorrecto
+};
+
+/**
+ * @brief Lector de un grupo de sensores DHT disparados a la vez
+ */
+class LectorDHTRMT
+{
+public:
+  LectorDHTRMT(void);
+
+  /**
+   * @brief Registra un sensor; debe llamarse antes de iniciar()
+   * @param pin Pin de datos (con pull-up, externo o interno)
+   * @param modelo MODELO_DHT11, MODELO_DHT21 o MODELO_DHT22
+   * @return Indice del sensor, o -1 si ya hay MAX_SENSORES_DHT_RMT
+   */
+  int8_t agregarSensor(uint8_t pin, uint8_t modelo);
+
+  /**
+   * @brief Configura un canal RMT de recepcion por sensor
+   *
+   * Usa los canales RMT 0 en adelante, en el orden de agregarSensor().
+   * La primera lectura se dispara pasado esperaInicialMs, para dar tiempo
+   * a que los sensores recien alimentados se estabilicen.
+   *
+   * @param esperaInicialMs Espera hasta el primer disparo
+   * @return true si todos los canales quedaron instalados
+   */
+  bool iniciar(uint32_t esperaInicialMs = INTERVALO_MINIMO_DHT_MS);
+
+  /**
+   * @brief Recoge las tramas recibidas y dispara la siguiente lectura
+   *
+   * No bloquea salvo durante el pulso de inicio (1,1 ms para DHT21/DHT22;
+   * con un DHT11 son 20 ms, que se esperan cediendo la CPU).
+   *
+   * @param ahoraMs Tiempo actual en milisegundos
+   */
+  void actualizar(uint32_t ahoraMs);
+
+  /**
+   * @brief Entrega la lectura valida recibida desde la consulta anterior
+   * @param indice Sensor devuelto por agregarSensor()
+   * @param temperatura Temperatura en grados Celsius
+   * @param humedad Humedad relativa en porcentaje
+   * @return true si hay una lectura nueva; false si no la hay o fallo
+   */
+  bool lectura(uint8_t indice, float &temperatura, float &humedad);
+
+  /**
+   * @brief Sensores registrados con agregarSensor()
+   */
+  uint8_t cantidadSensores(void) const;
+
+  /**
+   * @brief Resultado de la ultima lectura del sensor
+   */
+  EstadoDHT estado(uint8_t indice) const;
+
+  /**
+   * @brief Lecturas fallidas de todos los sensores desde el arranque
+   */
+  uint32_t errores(void) const;
+
+private:
+  struct Sensor
+  {
+    uint8_t pin;
+    uint8_t modelo;
+    RingbufHandle_t anillo; ///< Anillo donde el driver RMT deja la trama
+    bool capturando;        ///< Disparado y a la espera de su trama
+    bool nueva;             ///< Hay una lectura valida sin entregar
+    EstadoDHT estado;
+    float temperatura;
+    float humedad;
+  };
+
+  void disparar(uint32_t ahoraMs);
+  void recoger(uint8_t indice, uint32_t ahoraMs);
+  static EstadoDHT decodificar(const rmt_item32_t *items, size_t cantidad, Sensor &sensor);
+
+  Sensor sensores[MAX_SENSORES_DHT_RMT];
+  uint8_t cantidad;
+  bool iniciado;
+  uint32_t disparoMs; ///< Instante del ultimo disparo (o del primero, si aun no hubo)
+  uint32_t fallidas;
+};
+
+#endif
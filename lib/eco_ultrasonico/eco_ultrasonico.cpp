@@ -0,0 +1,67 @@
+#include "eco_ultrasonico.h"
+
+#include "esp_timer.h"
+
+EcoUltrasonico::EcoUltrasonico(uint8_t pinDisparo, uint8_t pinEco, uint32_t timeoutUs)
+    : pinDisparo(pinDisparo), pinEco(pinEco), timeoutUs(timeoutUs),
+      disparoUs(0), subidaUs(0), bajadaUs(0), estado(ECO_INACTIVO)
+{
+}
+
+void EcoUltrasonico::iniciar(void)
+{
+  attachInterruptArg(digitalPinToInterrupt(pinEco), isrEco, this, CHANGE);
+}
+
+void EcoUltrasonico::disparar(void)
+{
+  subidaUs = 0;
+  bajadaUs = 0;
+  estado = ECO_ESPERANDO;
+
+  // Pulso de disparo de ~25 us
+  digitalWrite(pinDisparo, LOW);
+  delayMicroseconds(5);
+  digitalWrite(pinDisparo, HIGH);
+  delayMicroseconds(25);
+  digitalWrite(pinDisparo, LOW);
+
+  disparoUs = esp_timer_get_time();
+}
+
+EstadoEco EcoUltrasonico::consultar(void)
+{
+  if (estado == ECO_ESPERANDO && esp_timer_get_time() - disparoUs > (int64_t)timeoutUs)
+  {
+    // El eco tarda en subir unos cientos de us tras el disparo; el margen
+    // del timeout lo cubre de sobra
+    estado = ECO_SIN_RESPUESTA;
+  }
+
+  return estado;
+}
+
+uint32_t EcoUltrasonico::duracionUs(void) const
+{
+  return (uint32_t)(bajadaUs - subidaUs);
+}
+
+void IRAM_ATTR EcoUltrasonico::isrEco(void *argumento)
+{
+  EcoUltrasonico *eco = static_cast<EcoUltrasonico *>(argumento);
+  if (eco->estado != ECO_ESPERANDO)
+  {
+    return;
+  }
+
+  int64_t ahoraUs = esp_timer_get_time();
+  if (digitalRead(eco->pinEco) == HIGH)
+  {
+    eco->subidaUs = ahoraUs;
+  }
+  else if (eco->subidaUs != 0)
+  {
+    eco->bajadaUs = ahoraUs;
+    eco->estado = ECO_COMPLETO;
+  }
+}
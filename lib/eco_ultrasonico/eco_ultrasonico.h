@@ -0,0 +1,76 @@
+#ifndef ECO_ULTRASONICO_H
+#define ECO_ULTRASONICO_H
+
+#include <Arduino.h>
+
+/**
+ * @file eco_ultrasonico.h
+ * @brief Medicion del eco ultrasonico por interrupcion, sin pulseIn()
+ *
+ * Una interrupcion por flanco en el pin de eco registra el instante de
+ * subida y de bajada con esp_timer_get_time(). La CPU solo interviene para
+ * generar el pulso de disparo; el ancho del eco se mide en segundo plano
+ * mientras el resto del sistema sigue trabajando.
+ */
+
+/**
+ * @brief Estado de una medicion de eco
+ */
+enum EstadoEco : uint8_t
+{
+  ECO_INACTIVO = 0, ///< No hay medicion en curso
+  ECO_ESPERANDO,    ///< Disparo enviado, esperando los flancos del eco
+  ECO_COMPLETO,     ///< Se capturaron ambos flancos
+  ECO_SIN_RESPUESTA ///< Vencio el timeout sin eco completo
+};
+
+/**
+ * @brief Medidor de eco de un sensor ultrasonico tipo HC-SR04
+ */
+class EcoUltrasonico
+{
+public:
+  /**
+   * @param pinDisparo Pin de disparo (salida)
+   * @param pinEco Pin de eco (entrada con interrupcion)
+   * @param timeoutUs Duracion maxima del eco, segun el alcance del sensor
+   */
+  EcoUltrasonico(uint8_t pinDisparo, uint8_t pinEco, uint32_t timeoutUs);
+
+  /**
+   * @brief Instala la interrupcion del pin de eco
+   *
+   * Los pines deben estar configurados con pinMode() antes de llamarla.
+   */
+  void iniciar(void);
+
+  /**
+   * @brief Genera el pulso de disparo e inicia una medicion
+   */
+  void disparar(void);
+
+  /**
+   * @brief Consulta el estado de la medicion en curso
+   *
+   * Pasa a ECO_SIN_RESPUESTA si ya vencio el timeout sin eco completo.
+   */
+  EstadoEco consultar(void);
+
+  /**
+   * @brief Duracion del ultimo eco completo en microsegundos
+   */
+  uint32_t duracionUs(void) const;
+
+private:
+  static void IRAM_ATTR isrEco(void *argumento);
+
+  uint8_t pinDisparo;
+  uint8_t pinEco;
+  uint32_t timeoutUs;
+  int64_t disparoUs;            ///< Instante del disparo
+  volatile int64_t subidaUs;    ///< Flanco de subida del eco (0 si aun no llega)
+  volatile int64_t bajadaUs;    ///< Flanco de bajada del eco (0 si aun no llega)
+  volatile EstadoEco estado;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "enrutador_comandos.h"
+
+#include <string.h>
+
+EnrutadorComandos::EnrutadorComandos(void) : numeroRutas(0)
+{
+  memset(tabla, -1, sizeof(tabla));
+}
+
+uint32_t EnrutadorComandos::calcularHash(const char *texto)
+{
+  // FNV-1a de 32 bits
+  uint32_t hash = 2166136261UL;
+  while (*texto != '\0')
+  {
+    hash ^= (uint8_t)*texto++;
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+/**
+ * @brief Busca la ranura de un topico
+ * @return Ranura con el topico, o -(ranura libre + 1) si no esta
+ */
+int EnrutadorComandos::buscar(const char *topico, uint32_t hash) const
+{
+  uint32_t ranura = hash & (TAMANO_TABLA_RUTAS - 1);
+  for (;;)
+  {
+    int8_t indice = tabla[ranura];
+    if (indice < 0)
+    {
+      return -(int)ranura - 1;
+    }
+
+    const Ruta &ruta = rutasRegistradas[indice];
+    if (ruta.hash == hash && strcmp(ruta.topico, topico) == 0)
+    {
+      return (int)ranura;
+    }
+
+    // La tabla nunca se llena, asi que siempre hay una ranura libre que corta el sondeo
+    ranura = (ranura + 1) & (TAMANO_TABLA_RUTAS - 1);
+  }
+}
+
+bool EnrutadorComandos::registrar(const char *topico, ManejadorComando manejador, void *contexto)
+{
+  if (topico == NULL || manejador == NULL || numeroRutas >= MAX_RUTAS_COMANDOS)
+  {
+    return false;
+  }
+
+  uint32_t hash = calcularHash(topico);
+  int ranura = buscar(topico, hash);
+  if (ranura >= 0)
+  {
+    return false;
+  }
+
+  Ruta &ruta = rutasRegistradas[numeroRutas];
+  ruta.topico = topico;
+  ruta.hash = hash;
+  ruta.manejador = manejador;
+  ruta.contexto = contexto;
+  tabla[-ranura - 1] = (int8_t)numeroRutas++;
+
+  return true;
+}
+
+bool EnrutadorComandos::despachar(const char *topico, const uint8_t *carga, unsigned int longitud) const
+{
+  if (topico == NULL)
+  {
+    return false;
+  }
+
+  int ranura = buscar(topico, calcularHash(topico));
+  if (ranura < 0)
+  {
+    return false;
+  }
+
+  const Ruta &ruta = rutasRegistradas[tabla[ranura]];
+  ruta.manejador(carga, longitud, ruta.contexto);
+  return true;
+}
+
+uint8_t EnrutadorComandos::rutas(void) const
+{
+  return numeroRutas;
+}
+
+const char *EnrutadorComandos::topico(uint8_t indice) const
+{
+  return indice < numeroRutas ? rutasRegistradas[indice].topico : NULL;
+}
+
+bool cargaIgual(const uint8_t *carga, unsigned int longitud, const char *literal)
+{
+  size_t largo = strlen(literal);
+  return longitud == largo && memcmp(carga, literal, largo) == 0;
+}
+
+bool interpretarBooleano(const uint8_t *carga, unsigned int longitud, bool &valor)
+{
+  if (cargaIgual(carga, longitud, "true") || cargaIgual(carga, longitud, "1"))
+  {
+    valor = true;
+    return true;
+  }
+  if (cargaIgual(carga, longitud, "false") || cargaIgual(carga, longitud, "0"))
+  {
+    valor = false;
+    return true;
+  }
+  return false;
+}
+
+bool interpretarEntero(const uint8_t *carga, unsigned int longitud, int32_t &valor)
+{
+  unsigned int i = 0;
+  bool negativo = false;
+  if (longitud > 0 && (carga[0] == '-' || carga[0] == '+'))
+  {
+    negativo = carga[0] == '-';
+    i = 1;
+  }
+  if (i >= longitud)
+  {
+    return false;
+  }
+
+  int64_t acumulado = 0;
+  for (; i < longitud; i++)
+  {
+    if (carga[i] < '0' || carga[i] > '9')
+    {
+      return false;
+    }
+    acumulado = acumulado * 10 + (carga[i] - '0');
+    if (acumulado > 2147483648LL)
+    {
+      return false;
+    }
+  }
+
+  if (negativo)
+  {
+    acumulado = -acumulado;
+  }
+  if (acumulado > 2147483647LL)
+  {
+    return false;
+  }
+
+  valor = (int32_t)acumulado;
+  return true;
+}
+
+/**
+ * @brief Valor de un digito hexadecimal, -1 si no lo es
+ */
+static int valorHexadecimal(uint8_t digito)
+{
+  if (digito >= '0' && digito <= '9')
+  {
+    return digito - '0';
+  }
+  if (digito >= 'a' && digito <= 'f')
+  {
+    return digito - 'a' + 10;
+  }
+  if (digito >= 'A' && digito <= 'F')
+  {
+    return digito - 'A' + 10;
+  }
+  return -1;
+}
+
+bool interpretarHexadecimal(const uint8_t *carga, unsigned int longitud, uint8_t *destino, size_t bytes)
+{
+  if (longitud != 2 * bytes)
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < bytes; i++)
+  {
+    int alto = valorHexadecimal(carga[2 * i]);
+    int bajo = valorHexadecimal(carga[2 * i + 1]);
+    if (alto < 0 || bajo < 0)
+    {
+      return false;
+    }
+    destino[i] = (uint8_t)(alto << 4 | bajo);
+  }
+  return true;
+}
@@ -0,0 +1,95 @@
+#ifndef ENRUTADOR_COMANDOS_H
+#define ENRUTADOR_COMANDOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file enrutador_comandos.h
+ * @brief Despacho de mensajes MQTT entrantes por topico, sin memoria dinamica
+ *
+ * Cada topico de control se registra una vez con su manejador. Al llegar un
+ * mensaje el topico se busca en una tabla hash precalculada (FNV-1a con
+ * sondeo lineal), de modo que el costo no crece con el numero de topicos.
+ * La carga se entrega tal cual esta en el buffer de PubSubClient, sin
+ * copiarla; las funciones interpretar* la analizan en su lugar.
+ *
+ * Los topicos registrados deben vivir mientras viva el enrutador (literales
+ * o buffers globales).
+ */
+
+#define MAX_RUTAS_COMANDOS 32 ///< Topicos registrables
+#define TAMANO_TABLA_RUTAS 64 ///< Ranuras de la tabla hash (potencia de dos, > MAX_RUTAS_COMANDOS)
+
+/**
+ * @brief Firma de un manejador de comandos
+ * @param carga Carga del mensaje, sin terminador nulo
+ * @param longitud Longitud de la carga en bytes
+ * @param contexto Puntero registrado junto con el topico
+ */
+typedef void (*ManejadorComando)(const uint8_t *carga, unsigned int longitud, void *contexto);
+
+class EnrutadorComandos
+{
+public:
+  EnrutadorComandos(void);
+
+  /**
+   * @brief Registra el manejador de un topico
+   * @return false si la tabla esta llena, el topico ya existe o faltan datos
+   */
+  bool registrar(const char *topico, ManejadorComando manejador, void *contexto = NULL);
+
+  /**
+   * @brief Entrega un mensaje al manejador de su topico
+   * @return false si el topico no tiene manejador
+   */
+  bool despachar(const char *topico, const uint8_t *carga, unsigned int longitud) const;
+
+  /// Numero de topicos registrados
+  uint8_t rutas(void) const;
+
+  /// Topico registrado en la posicion indice (orden de registro), para suscribirse
+  const char *topico(uint8_t indice) const;
+
+private:
+  struct Ruta
+  {
+    const char *topico;
+    uint32_t hash;
+    ManejadorComando manejador;
+    void *contexto;
+  };
+
+  static uint32_t calcularHash(const char *texto);
+  int buscar(const char *topico, uint32_t hash) const;
+
+  Ruta rutasRegistradas[MAX_RUTAS_COMANDOS];
+  int8_t tabla[TAMANO_TABLA_RUTAS]; ///< Indice en rutasRegistradas, -1 si la ranura esta libre
+  uint8_t numeroRutas;
+};
+
+/**
+ * @brief Compara la carga con un literal, sin copiarla
+ */
+bool cargaIgual(const uint8_t *carga, unsigned int longitud, const char *literal);
+
+/**
+ * @brief Interpreta "true"/"false" o "1"/"0"
+ * @return false si la carga no es un booleano
+ */
+bool interpretarBooleano(const uint8_t *carga, unsigned int longitud, bool &valor);
+
+/**
+ * @brief Interpreta un entero decimal con signo opcional
+ * @return false si la carga no es un entero o desborda 32 bits
+ */
+bool interpretarEntero(const uint8_t *carga, unsigned int longitud, int32_t &valor);
+
+/**
+ * @brief Interpreta exactamente 2 * bytes digitos hexadecimales (mayusculas o minusculas)
+ * @return false si la carga no tiene esa forma; destino puede quedar a medio escribir
+ */
+bool interpretarHexadecimal(const uint8_t *carga, unsigned int longitud, uint8_t *destino, size_t bytes);
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef ESTADISTICA_VENTANA_H
+#define ESTADISTICA_VENTANA_H
+
+#include <stdint.h>
+#include <math.h>
+
+/**
+ * @file estadistica_ventana.h
+ * @brief Estadisticas por ventanas de tiempo fijas, con el algoritmo de Welford
+ *
+ * EstadisticaWelford acumula cantidad, minimo, maximo, media y varianza en
+ * una pasada, sin guardar las muestras y sin la cancelacion numerica de
+ * sumar x y x^2 por separado.
+ *
+ * VentanaEstadistica reparte las muestras en ventanas alineadas a
+ * multiplos de su duracion segun la marca de cada muestra: con marcas UTC,
+ * una ventana de un minuto empieza en cada minuto del reloj. Una muestra de
+ * otra ventana, o de otro dominio de marca (monotonica o UTC), cierra la
+ * ventana en curso.
+ */
+
+/**
+ * @brief Cantidad, minimo, maximo, media y varianza en linea (Welford)
+ */
+class EstadisticaWelford
+{
+public:
+  EstadisticaWelford(void)
+  {
+    reiniciar();
+  }
+
+  void agregar(float muestra)
+  {
+    n++;
+    float delta = muestra - mediaActual;
+    mediaActual += delta / n;
+    m2 += delta * (muestra - mediaActual);
+    minimoActual = muestra < minimoActual ? muestra : minimoActual;
+    maximoActual = muestra > maximoActual ? muestra : maximoActual;
+  }
+
+  uint32_t cantidad(void) const
+  {
+    return n;
+  }
+
+  /// NaN sin muestras
+  float minimo(void) const
+  {
+    return n > 0 ? minimoActual : NAN;
+  }
+
+  /// NaN sin muestras
+  float maximo(void) const
+  {
+    return n > 0 ? maximoActual : NAN;
+  }
+
+  /// NaN sin muestras
+  float media(void) const
+  {
+    return n > 0 ? mediaActual : NAN;
+  }
+
+  /**
+   * @brief Desviacion estandar muestral (n - 1); 0 con menos de dos muestras
+   */
+  float desviacion(void) const
+  {
+    return n > 1 ? sqrtf(m2 / (n - 1)) : 0.0f;
+  }
+
+  void reiniciar(void)
+  {
+    n = 0;
+    mediaActual = 0.0f;
+    m2 = 0.0f;
+    minimoActual = INFINITY;
+    maximoActual = -INFINITY;
+  }
+
+private:
+  uint32_t n;
+  float mediaActual;
+  float m2; ///< Suma de los cuadrados de las desviaciones a la media
+  float minimoActual;
+  float maximoActual;
+};
+
+/**
+ * @brief Estadisticas de una ventana ya cerrada
+ */
+struct ResumenVentana
+{
+  int64_t inicioUs; ///< Comienzo de la ventana, en el dominio de las marcas
+  bool utc;         ///< inicioUs es UTC (us desde 1970); si no, monotonico
+  uint32_t cantidad;
+  float minimo;
+  float maximo;
+  float media;
+  float desviacion;
+};
+
+/**
+ * @brief Ventana de tiempo fija sobre marcas en microsegundos
+ */
+class VentanaEstadistica
+{
+public:
+  VentanaEstadistica(void) : inicioUs(0), utc(false)
+  {
+  }
+
+  /**
+   * @brief Agrega una muestra; si es de otra ventana, antes cierra la actual
+   * @param marcaUs Marca de la muestra
+   * @param marcaUTC La marca es UTC
+   * @param valor Valor de la muestra
+   * @param duracionUs Duracion de la ventana
+   * @param cerrada Recibe la ventana cerrada, si se cerro alguna
+   * @return true si se cerro una ventana con muestras
+   */
+  bool agregar(int64_t marcaUs, bool marcaUTC, float valor, int64_t duracionUs, ResumenVentana &cerrada)
+  {
+    int64_t inicio = marcaUs - modulo(marcaUs, duracionUs);
+    bool cerro = false;
+    if (estadistica.cantidad() > 0 && (inicio != inicioUs || marcaUTC != utc))
+    {
+      cerro = cerrar(cerrada);
+    }
+    if (estadistica.cantidad() == 0)
+    {
+      inicioUs = inicio;
+      utc = marcaUTC;
+    }
+    estadistica.agregar(valor);
+    return cerro;
+  }
+
+  /**
+   * @brief Indica si la ventana ya termino segun la hora actual
+   * @param ahoraUs Hora actual
+   * @param ahoraUTC ahoraUs es UTC; con otro dominio que el de la ventana, esta vence
+   * @param duracionUs Duracion de la ventana
+   * @param graciaUs Tiempo extra para las muestras que aun esten en camino
+   */
+  bool vencida(int64_t ahoraUs, bool ahoraUTC, int64_t duracionUs, int64_t graciaUs) const
+  {
+    return estadistica.cantidad() > 0 && (ahoraUTC != utc || ahoraUs >= inicioUs + duracionUs + graciaUs);
+  }
+
+  /**
+   * @brief Entrega la ventana en curso y empieza una vacia
+   * @return false si no tenia muestras
+   */
+  bool cerrar(ResumenVentana &cerrada)
+  {
+    if (estadistica.cantidad() == 0)
+    {
+      return false;
+    }
+    cerrada.inicioUs = inicioUs;
+    cerrada.utc = utc;
+    cerrada.cantidad = estadistica.cantidad();
+    cerrada.minimo = estadistica.minimo();
+    cerrada.maximo = estadistica.maximo();
+    cerrada.media = estadistica.media();
+    cerrada.desviacion = estadistica.desviacion();
+    estadistica.reiniciar();
+    return true;
+  }
+
+private:
+  /// Resto no negativo, para alinear tambien marcas negativas
+  static int64_t modulo(int64_t valor, int64_t divisor)
+  {
+    int64_t resto = valor % divisor;
+    return resto < 0 ? resto + divisor : resto;
+  }
+
+  EstadisticaWelford estadistica;
+  int64_t inicioUs;
+  bool utc;
+};
+
+#endif
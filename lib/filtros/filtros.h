@@ -0,0 +1,361 @@
+#ifndef FILTROS_H
+#define FILTROS_H
+
+#include <stdint.h>
+#include <math.h>
+
+/**
+ * @file filtros.h
+ * @brief Filtros incrementales para lecturas de sensores
+ *
+ * Todos los filtros comparten la misma interfaz:
+ * - agregar(muestra): incorpora una lectura; las lecturas NaN se descartan
+ *   y devuelve false si la muestra no se uso
+ * - valor(): estimacion actual, NaN si aun no hay muestras validas
+ * - validas(): numero de muestras validas que respaldan la estimacion
+ * - reiniciar(): vuelve al estado inicial
+ *
+ * No reservan memoria dinamica; el tamano de ventana es un parametro de
+ * plantilla. En los filtros con ventana, cambiarVentana() usa en marcha
+ * solo las primeras n posiciones (1 <= n <= N).
+ */
+
+/**
+ * @brief Mediana movil de las ultimas N muestras validas
+ *
+ * Mantiene la ventana en un arreglo circular y una copia ordenada. Cada
+ * muestra localiza su posicion por busqueda binaria (O(log N)) y desplaza
+ * como mucho N elementos, que para ventanas de sensores (N <= 32) son unas
+ * pocas palabras de memoria.
+ *
+ * @tparam N Tamano de la ventana
+ */
+template <uint8_t N>
+class FiltroMediana
+{
+  static_assert(N > 0, "La ventana de FiltroMediana no puede ser vacia");
+
+public:
+  FiltroMediana(void) : ventanaActiva(N)
+  {
+    reiniciar();
+  }
+
+  bool agregar(float muestra)
+  {
+    if (isnan(muestra))
+    {
+      return false;
+    }
+
+    if (cantidad == ventanaActiva)
+    {
+      // Sacar de la copia ordenada la muestra mas antigua, que se sobrescribe
+      uint8_t posicion = buscar(ventana[siguiente]);
+      for (uint8_t i = posicion; i + 1 < cantidad; i++)
+      {
+        ordenadas[i] = ordenadas[i + 1];
+      }
+      cantidad--;
+    }
+
+    uint8_t posicion = buscar(muestra);
+    for (uint8_t i = cantidad; i > posicion; i--)
+    {
+      ordenadas[i] = ordenadas[i - 1];
+    }
+    ordenadas[posicion] = muestra;
+    cantidad++;
+
+    ventana[siguiente] = muestra;
+    siguiente = (uint8_t)((siguiente + 1) % ventanaActiva);
+    return true;
+  }
+
+  float valor(void) const
+  {
+    if (cantidad == 0)
+    {
+      return NAN;
+    }
+    if (cantidad % 2 == 1)
+    {
+      return ordenadas[cantidad / 2];
+    }
+    return (ordenadas[cantidad / 2 - 1] + ordenadas[cantidad / 2]) / 2.0f;
+  }
+
+  uint8_t validas(void) const
+  {
+    return cantidad;
+  }
+
+  void reiniciar(void)
+  {
+    cantidad = 0;
+    siguiente = 0;
+  }
+
+  /**
+   * @brief Cambia la ventana en uso; si cambia, el filtro se reinicia
+   * @param n Muestras de la ventana, de 1 a N
+   */
+  void cambiarVentana(uint8_t n)
+  {
+    n = n < 1 ? 1 : n > N ? N : n;
+    if (n != ventanaActiva)
+    {
+      ventanaActiva = n;
+      reiniciar();
+    }
+  }
+
+private:
+  /// Primera posicion de la copia ordenada cuyo valor no es menor que v
+  uint8_t buscar(float v) const
+  {
+    uint8_t bajo = 0, alto = cantidad;
+    while (bajo < alto)
+    {
+      uint8_t medio = (uint8_t)((bajo + alto) / 2);
+      if (ordenadas[medio] < v)
+        bajo = medio + 1;
+      else
+        alto = medio;
+    }
+    return bajo;
+  }
+
+  float ventana[N];   ///< Muestras en orden de llegada (circular)
+  float ordenadas[N]; ///< Las mismas muestras ordenadas de menor a mayor
+  uint8_t ventanaActiva; ///< Posiciones de la ventana en uso
+  uint8_t cantidad;      ///< Muestras validas en la ventana
+  uint8_t siguiente;     ///< Posicion de la ventana que se sobrescribe
+};
+
+/**
+ * @brief Promedio movil exponencial (EWMA)
+ *
+ * valor = valor + alfa * (muestra - valor). O(1) en tiempo y memoria. Un
+ * alfa de 2 / (N + 1) equivale aproximadamente a un promedio de N muestras.
+ */
+class FiltroEWMA
+{
+public:
+  /**
+   * @param alfa Peso de la muestra nueva, en (0, 1]
+   */
+  explicit FiltroEWMA(float alfa = 0.25f) : alfa(alfa)
+  {
+    reiniciar();
+  }
+
+  bool agregar(float muestra)
+  {
+    if (isnan(muestra))
+    {
+      return false;
+    }
+
+    // La primera muestra valida inicializa el filtro sin sesgo hacia cero
+    estimacion = cantidad == 0 ? muestra : estimacion + alfa * (muestra - estimacion);
+    if (cantidad < UINT8_MAX)
+    {
+      cantidad++;
+    }
+    return true;
+  }
+
+  float valor(void) const
+  {
+    return cantidad == 0 ? NAN : estimacion;
+  }
+
+  uint8_t validas(void) const
+  {
+    return cantidad;
+  }
+
+  void reiniciar(void)
+  {
+    estimacion = 0.0f;
+    cantidad = 0;
+  }
+
+private:
+  float alfa;
+  float estimacion;
+  uint8_t cantidad;
+};
+
+/**
+ * @brief Promedio movil de N muestras con rechazo de valores atipicos
+ *
+ * Lleva la suma y la suma de cuadrados de la ventana para obtener media y
+ * desviacion en O(1). Una vez que hay al menos min(ventana, 4) muestras,
+ * descarta las que se alejan de la media mas de k desviaciones (con un
+ * piso de desviacionMinima para no rechazar todo cuando la senal esta
+ * quieta). Si se rechaza media ventana seguida se asume un cambio
+ * real de la senal y la ventana se reinicia con la muestra nueva. Las
+ * sumas se recalculan al dar cada vuelta a la ventana para que no
+ * acumulen error de redondeo.
+ *
+ * @tparam N Tamano de la ventana
+ */
+template <uint8_t N>
+class FiltroMediaRobusta
+{
+  static_assert(N > 0, "La ventana de FiltroMediaRobusta no puede ser vacia");
+
+public:
+  /**
+   * @param k Numero de desviaciones a partir del cual una muestra es atipica
+   * @param desviacionMinima Desviacion minima supuesta, en unidades de la senal
+   */
+  explicit FiltroMediaRobusta(float k = 3.0f, float desviacionMinima = 0.0f)
+      : k(k), desviacionMinima(desviacionMinima), ventanaActiva(N)
+  {
+    reiniciar();
+  }
+
+  bool agregar(float muestra)
+  {
+    if (isnan(muestra))
+    {
+      return false;
+    }
+
+    if (cantidad >= minimoParaRechazo())
+    {
+      float desviacion = sqrtf(varianza());
+      if (desviacion < desviacionMinima)
+      {
+        desviacion = desviacionMinima;
+      }
+      if (fabsf(muestra - media()) > k * desviacion)
+      {
+        rechazadas++;
+        if (++rechazosSeguidos < limiteRechazosSeguidos())
+        {
+          return false;
+        }
+
+        // Cambio sostenido: descartar la historia y seguir a la senal
+        uint32_t totalRechazadas = rechazadas - rechazosSeguidos;
+        reiniciar();
+        rechazadas = totalRechazadas;
+      }
+    }
+    rechazosSeguidos = 0;
+
+    if (cantidad == ventanaActiva)
+    {
+      suma -= ventana[siguiente];
+      sumaCuadrados -= ventana[siguiente] * ventana[siguiente];
+    }
+    else
+    {
+      cantidad++;
+    }
+
+    ventana[siguiente] = muestra;
+    suma += muestra;
+    sumaCuadrados += muestra * muestra;
+
+    siguiente = (uint8_t)((siguiente + 1) % ventanaActiva);
+    if (siguiente == 0)
+    {
+      recalcular();
+    }
+    return true;
+  }
+
+  float valor(void) const
+  {
+    return cantidad == 0 ? NAN : media();
+  }
+
+  uint8_t validas(void) const
+  {
+    return cantidad;
+  }
+
+  /// Muestras descartadas por atipicas desde el ultimo reinicio
+  uint32_t atipicas(void) const
+  {
+    return rechazadas;
+  }
+
+  void reiniciar(void)
+  {
+    suma = 0.0f;
+    sumaCuadrados = 0.0f;
+    cantidad = 0;
+    siguiente = 0;
+    rechazadas = 0;
+    rechazosSeguidos = 0;
+  }
+
+  /**
+   * @brief Cambia la ventana en uso; si cambia, el filtro se reinicia
+   * @param n Muestras de la ventana, de 1 a N
+   */
+  void cambiarVentana(uint8_t n)
+  {
+    n = n < 1 ? 1 : n > N ? N : n;
+    if (n != ventanaActiva)
+    {
+      ventanaActiva = n;
+      reiniciar();
+    }
+  }
+
+private:
+  /// Muestras necesarias antes de rechazar atipicos
+  uint8_t minimoParaRechazo(void) const
+  {
+    return ventanaActiva < 4 ? ventanaActiva : 4;
+  }
+
+  /// Rechazos seguidos que se toman como un cambio real de la senal
+  uint8_t limiteRechazosSeguidos(void) const
+  {
+    return ventanaActiva / 2 > 2 ? ventanaActiva / 2 : 2;
+  }
+
+  float media(void) const
+  {
+    return suma / cantidad;
+  }
+
+  float varianza(void) const
+  {
+    float m = media();
+    float v = sumaCuadrados / cantidad - m * m;
+    return v > 0.0f ? v : 0.0f;
+  }
+
+  void recalcular(void)
+  {
+    suma = 0.0f;
+    sumaCuadrados = 0.0f;
+    for (uint8_t i = 0; i < cantidad; i++)
+    {
+      suma += ventana[i];
+      sumaCuadrados += ventana[i] * ventana[i];
+    }
+  }
+
+  float k;
+  float desviacionMinima;
+  uint8_t ventanaActiva; ///< Posiciones de la ventana en uso
+  float ventana[N];
+  float suma;
+  float sumaCuadrados;
+  uint8_t cantidad;
+  uint8_t siguiente;
+  uint8_t rechazosSeguidos;
+  uint32_t rechazadas;
+};
+
+#endif
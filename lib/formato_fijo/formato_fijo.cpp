@@ -0,0 +1,89 @@
+#include "formato_fijo.h"
+
+#include <math.h>
+
+#define LIMITE_CENTESIMAS 20000000.0f ///< Mayor modulo admitido: sus centesimas caben en int32_t con margen
+#define BASE_BLOQUE_64 1000000000ULL  ///< 10^9: los 9 digitos bajos caben en uint32_t
+#define DIGITOS_BLOQUE_64 9           ///< Digitos de cada bloque de BASE_BLOQUE_64
+
+size_t formatearEntero(char *destino, size_t capacidad, uint32_t valor)
+{
+  char digitos[10];
+  size_t n = 0;
+  do
+  {
+    digitos[n++] = (char)('0' + valor % 10);
+    valor /= 10;
+  } while (valor > 0);
+
+  if (n > capacidad)
+  {
+    return 0;
+  }
+  for (size_t i = 0; i < n; i++)
+  {
+    destino[i] = digitos[n - 1 - i];
+  }
+  return n;
+}
+
+size_t formatearEntero64(char *destino, size_t capacidad, uint64_t valor)
+{
+  if (valor <= UINT32_MAX)
+  {
+    return formatearEntero(destino, capacidad, (uint32_t)valor);
+  }
+
+  uint64_t altos = valor / BASE_BLOQUE_64;
+  uint32_t bajos = (uint32_t)(valor - altos * BASE_BLOQUE_64);
+  size_t n = formatearEntero64(destino, capacidad, altos);
+  if (n == 0 || n + DIGITOS_BLOQUE_64 > capacidad)
+  {
+    return 0;
+  }
+
+  // El bloque bajo lleva sus ceros a la izquierda
+  for (size_t i = DIGITOS_BLOQUE_64; i > 0; i--)
+  {
+    destino[n + i - 1] = (char)('0' + bajos % 10);
+    bajos /= 10;
+  }
+  return n + DIGITOS_BLOQUE_64;
+}
+
+size_t formatearCentesimas(char *destino, size_t capacidad, float valor)
+{
+  // Tambien descarta NaN: toda comparacion con NaN es falsa
+  if (!(fabsf(valor) <= LIMITE_CENTESIMAS))
+  {
+    return 0;
+  }
+
+  // Unico paso en punto flotante: escalar y redondear
+  int32_t centesimas = (int32_t)(valor * 100.0f + (valor < 0.0f ? -0.5f : 0.5f));
+  bool negativo = centesimas < 0;
+  uint32_t modulo = negativo ? (uint32_t)(-(int64_t)centesimas) : (uint32_t)centesimas;
+
+  size_t escritos = 0;
+  if (negativo)
+  {
+    if (capacidad < 1)
+    {
+      return 0;
+    }
+    destino[escritos++] = '-';
+  }
+
+  size_t enteros = formatearEntero(destino + escritos, capacidad - escritos, modulo / 100);
+  if (enteros == 0 || escritos + enteros + 3 > capacidad)
+  {
+    return 0;
+  }
+  escritos += enteros;
+
+  uint32_t decimales = modulo % 100;
+  destino[escritos++] = '.';
+  destino[escritos++] = (char)('0' + decimales / 10);
+  destino[escritos++] = (char)('0' + decimales % 10);
+  return escritos;
+}
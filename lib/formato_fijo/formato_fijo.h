@@ -0,0 +1,51 @@
+#ifndef FORMATO_FIJO_H
+#define FORMATO_FIJO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file formato_fijo.h
+ * @brief Conversion de lecturas a texto en centesimas con aritmetica entera
+ *
+ * Sustituye a snprintf("%.2f") en el camino de publicacion. El printf de
+ * punto flotante de newlib es lento y usa mucha pila; aqui el valor se
+ * redondea una sola vez a centesimas y los digitos salen con divisiones
+ * enteras. Ninguna funcion reserva memoria ni termina con '\0' salvo que
+ * se indique.
+ */
+
+#define MAX_CARACTERES_CENTESIMAS 12 ///< "-20000000.00": signo, 8 enteros, punto y 2 decimales
+#define MAX_CARACTERES_ENTERO64 20   ///< Digitos de UINT64_MAX
+
+/**
+ * @brief Escribe un entero sin signo en decimal
+ * @return Caracteres escritos, 0 si no caben
+ */
+size_t formatearEntero(char *destino, size_t capacidad, uint32_t valor);
+
+/**
+ * @brief Escribe un entero de 64 bits sin signo en decimal
+ *
+ * Los valores de 32 bits van por formatearEntero(); los mayores hacen una
+ * division de 64 bits por cada 9 digitos, no una por digito.
+ *
+ * @return Caracteres escritos, 0 si no caben
+ */
+size_t formatearEntero64(char *destino, size_t capacidad, uint64_t valor);
+
+/**
+ * @brief Escribe un valor con dos decimales, como "%.2f"
+ *
+ * Redondea a la centesima mas cercana (las mitades se alejan de cero). Los
+ * valores NaN, infinitos o de modulo mayor que 2e7 no se
+ * escriben.
+ *
+ * @param destino Buffer de salida
+ * @param capacidad Tamano del buffer
+ * @param valor Lectura en unidades de ingenieria
+ * @return Caracteres escritos, 0 si el valor no es representable o no cabe
+ */
+size_t formatearCentesimas(char *destino, size_t capacidad, float valor);
+
+#endif
@@ -0,0 +1,120 @@
+#include "histograma_latencia.h"
+
+#include "esp_timer.h"
+
+HistogramaLatencia::HistogramaLatencia(void) : maximo(0)
+{
+  for (uint8_t i = 0; i < CUBETAS_HISTOGRAMA; i++)
+  {
+    cuentas[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief Cubeta de una duracion
+ *
+ * Los valores menores que SUBCUBETAS_HISTOGRAMA tienen cubeta propia; a
+ * partir de ahi cada potencia de dos se parte en SUBCUBETAS_HISTOGRAMA
+ * cubetas iguales segun los dos bits que siguen al mas significativo.
+ */
+uint8_t HistogramaLatencia::cubeta(uint32_t duracionUs)
+{
+  if (duracionUs < SUBCUBETAS_HISTOGRAMA)
+  {
+    return (uint8_t)duracionUs;
+  }
+
+  uint8_t exponente = (uint8_t)(31 - __builtin_clz(duracionUs));
+  uint8_t sub = (uint8_t)((duracionUs >> (exponente - 2)) & (SUBCUBETAS_HISTOGRAMA - 1));
+  return (uint8_t)((exponente - 1) * SUBCUBETAS_HISTOGRAMA + sub);
+}
+
+uint32_t HistogramaLatencia::cotaSuperior(uint8_t indice)
+{
+  if (indice < SUBCUBETAS_HISTOGRAMA)
+  {
+    return indice;
+  }
+
+  uint8_t exponente = (uint8_t)(indice / SUBCUBETAS_HISTOGRAMA + 1);
+  uint32_t sub = indice % SUBCUBETAS_HISTOGRAMA;
+  uint32_t ancho = 1UL << (exponente - 2);
+  return ((SUBCUBETAS_HISTOGRAMA + sub) << (exponente - 2)) + (ancho - 1);
+}
+
+void HistogramaLatencia::registrar(uint32_t duracionUs)
+{
+  cuentas[cubeta(duracionUs)].fetch_add(1, std::memory_order_relaxed);
+
+  // Un solo escritor: no hace falta comparar e intercambiar
+  if (duracionUs > maximo.load(std::memory_order_relaxed))
+  {
+    maximo.store(duracionUs, std::memory_order_relaxed);
+  }
+}
+
+void HistogramaLatencia::registrarDesde(int64_t inicioUs)
+{
+  int64_t duracion = esp_timer_get_time() - inicioUs;
+  registrar(duracion > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)duracion);
+}
+
+void HistogramaLatencia::resumirYReiniciar(ResumenLatencia &resumen)
+{
+  uint32_t copia[CUBETAS_HISTOGRAMA];
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < CUBETAS_HISTOGRAMA; i++)
+  {
+    copia[i] = cuentas[i].exchange(0, std::memory_order_relaxed);
+    total += copia[i];
+  }
+
+  resumen.cantidad = total;
+  resumen.p50Us = 0;
+  resumen.p99Us = 0;
+  resumen.maximoUs = maximo.exchange(0, std::memory_order_relaxed);
+  if (total == 0)
+  {
+    return;
+  }
+
+  // Rango (base 1) de cada percentil, redondeado hacia arriba
+  uint32_t rango50 = (total + 1) / 2;
+  uint32_t rango99 = (uint32_t)(((uint64_t)total * 99 + 99) / 100);
+  uint32_t acumulado = 0;
+  bool medianaEncontrada = false;
+  for (uint8_t i = 0; i < CUBETAS_HISTOGRAMA; i++)
+  {
+    acumulado += copia[i];
+    if (!medianaEncontrada && acumulado >= rango50)
+    {
+      resumen.p50Us = cotaSuperior(i);
+      medianaEncontrada = true;
+    }
+    if (acumulado >= rango99)
+    {
+      resumen.p99Us = cotaSuperior(i);
+      break;
+    }
+  }
+
+  // La cota de la cubeta puede superar al maximo real
+  if (resumen.p50Us > resumen.maximoUs)
+  {
+    resumen.p50Us = resumen.maximoUs;
+  }
+  if (resumen.p99Us > resumen.maximoUs)
+  {
+    resumen.p99Us = resumen.maximoUs;
+  }
+}
+
+CronometroLatencia::CronometroLatencia(HistogramaLatencia &histograma)
+    : histograma(histograma), inicioUs(esp_timer_get_time())
+{
+}
+
+CronometroLatencia::~CronometroLatencia(void)
+{
+  histograma.registrarDesde(inicioUs);
+}
@@ -0,0 +1,73 @@
+#ifndef HISTOGRAMA_LATENCIA_H
+#define HISTOGRAMA_LATENCIA_H
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @file histograma_latencia.h
+ * @brief Histograma de latencias de cubetas fijas, barato de registrar
+ *
+ * Las cubetas son logaritmicas con cuatro subdivisiones por potencia de dos
+ * (error relativo maximo de 25 %), de 1 us a mas de una hora, en memoria
+ * fija. Registrar cuesta un clz y un incremento atomico, asi que puede
+ * usarse en la ruta de adquisicion.
+ *
+ * Una sola tarea registra en cada histograma; otra puede tomar el resumen y
+ * reiniciarlo a la vez sin perder cuentas.
+ */
+
+#define SUBCUBETAS_HISTOGRAMA 4                        ///< Subdivisiones por potencia de dos
+#define CUBETAS_HISTOGRAMA (31 * SUBCUBETAS_HISTOGRAMA) ///< Cubre todo uint32_t
+
+/**
+ * @brief Resumen de un intervalo de medicion, en microsegundos
+ */
+struct ResumenLatencia
+{
+  uint32_t cantidad; ///< Mediciones en el intervalo
+  uint32_t p50Us;    ///< Mediana (cota superior de su cubeta)
+  uint32_t p99Us;    ///< Percentil 99 (cota superior de su cubeta)
+  uint32_t maximoUs; ///< Maximo exacto
+};
+
+class HistogramaLatencia
+{
+public:
+  HistogramaLatencia(void);
+
+  /// Registra una medicion en microsegundos
+  void registrar(uint32_t duracionUs);
+
+  /// Registra el tiempo transcurrido desde inicioUs (esp_timer_get_time())
+  void registrarDesde(int64_t inicioUs);
+
+  /**
+   * @brief Resume lo registrado desde el ultimo resumen y vacia el histograma
+   * @param resumen Destino del resumen; todo en 0 si no hubo mediciones
+   */
+  void resumirYReiniciar(ResumenLatencia &resumen);
+
+private:
+  static uint8_t cubeta(uint32_t duracionUs);
+  static uint32_t cotaSuperior(uint8_t indice);
+
+  std::atomic<uint32_t> cuentas[CUBETAS_HISTOGRAMA];
+  std::atomic<uint32_t> maximo;
+};
+
+/**
+ * @brief Mide la duracion de un bloque y la registra al salir de el
+ */
+class CronometroLatencia
+{
+public:
+  explicit CronometroLatencia(HistogramaLatencia &histograma);
+  ~CronometroLatencia(void);
+
+private:
+  HistogramaLatencia &histograma;
+  int64_t inicioUs;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "monitor_memoria.h"
+
+#include "esp_heap_caps.h"
+
+MonitorMemoria monitorMemoria;
+
+#if MODO_CONTEO_RESERVAS
+// Con -Wl,--wrap=X el enlazador dirige toda llamada a X, tambien las de las
+// librerias precompiladas (mbedTLS, lwIP, libstdc++), hacia __wrap_X
+extern "C"
+{
+  void *__real_malloc(size_t tamano);
+  void *__real_calloc(size_t cantidad, size_t tamano);
+  void *__real_realloc(void *puntero, size_t tamano);
+
+  void *__wrap_malloc(size_t tamano)
+  {
+    monitorMemoria.contarReserva();
+    return __real_malloc(tamano);
+  }
+
+  void *__wrap_calloc(size_t cantidad, size_t tamano)
+  {
+    monitorMemoria.contarReserva();
+    return __real_calloc(cantidad, tamano);
+  }
+
+  void *__wrap_realloc(void *puntero, size_t tamano)
+  {
+    monitorMemoria.contarReserva();
+    return __real_realloc(puntero, tamano);
+  }
+}
+#endif
+
+MonitorMemoria::MonitorMemoria(void)
+    : numeroTareas(0), nombresZonas(NULL), numeroZonas(0), armado(false), zonasAbiertas(0), reservas(0)
+{
+  portMUX_TYPE inicial = portMUX_INITIALIZER_UNLOCKED;
+  cerrojo = inicial;
+  for (uint8_t i = 0; i < MAX_ZONAS_MONITOR; i++)
+  {
+    reservasZonas[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void MonitorMemoria::definirZonas(const char *const *nombres, uint8_t cantidad)
+{
+  nombresZonas = nombres;
+  numeroZonas = cantidad < MAX_ZONAS_MONITOR ? cantidad : MAX_ZONAS_MONITOR;
+}
+
+bool MonitorMemoria::registrarTarea(const char *nombre)
+{
+  bool registrada = false;
+  portENTER_CRITICAL(&cerrojo);
+  uint8_t indice = numeroTareas.load(std::memory_order_relaxed);
+  if (indice < MAX_TAREAS_MONITOR)
+  {
+    tabla[indice].nombre = nombre;
+    tabla[indice].manejador = xTaskGetCurrentTaskHandle();
+    tabla[indice].zona = SIN_ZONA;
+    // Publicar la entrada completa antes de contarla: contarReserva() la lee sin cerrojo
+    numeroTareas.store(indice + 1, std::memory_order_release);
+    registrada = true;
+  }
+  portEXIT_CRITICAL(&cerrojo);
+  return registrada;
+}
+
+void MonitorMemoria::armar(void)
+{
+  reservas.store(0, std::memory_order_relaxed);
+  armado.store(true, std::memory_order_release);
+}
+
+void MonitorMemoria::leerHeap(EstadoHeap &estado) const
+{
+  estado.libre = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  estado.minimoLibre = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+  estado.bloqueMayor = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  estado.fragmentacion = estado.libre > 0 ? (uint8_t)(100 - (uint64_t)estado.bloqueMayor * 100 / estado.libre) : 0;
+}
+
+uint8_t MonitorMemoria::tareas(void) const
+{
+  return numeroTareas.load(std::memory_order_acquire);
+}
+
+const char *MonitorMemoria::nombreTarea(uint8_t indice) const
+{
+  return indice < tareas() ? tabla[indice].nombre : NULL;
+}
+
+uint32_t MonitorMemoria::pilaLibreMinima(uint8_t indice) const
+{
+  // En ESP-IDF la pila se mide en bytes, no en palabras
+  return indice < tareas() ? (uint32_t)uxTaskGetStackHighWaterMark(tabla[indice].manejador) : 0;
+}
+
+uint8_t MonitorMemoria::zonas(void) const
+{
+  return numeroZonas;
+}
+
+const char *MonitorMemoria::nombreZona(uint8_t zona) const
+{
+  return zona < numeroZonas ? nombresZonas[zona] : NULL;
+}
+
+uint32_t MonitorMemoria::tomarReservas(void)
+{
+  return reservas.exchange(0, std::memory_order_relaxed);
+}
+
+uint32_t MonitorMemoria::tomarReservasZona(uint8_t zona)
+{
+  return zona < MAX_ZONAS_MONITOR ? reservasZonas[zona].exchange(0, std::memory_order_relaxed) : 0;
+}
+
+/**
+ * @brief Ranura de la tarea que llama, -1 si no esta registrada
+ */
+int8_t MonitorMemoria::ranuraActual(void) const
+{
+  TaskHandle_t actual = xTaskGetCurrentTaskHandle();
+  uint8_t cantidad = tareas();
+  for (uint8_t i = 0; i < cantidad; i++)
+  {
+    if (tabla[i].manejador == actual)
+    {
+      return (int8_t)i;
+    }
+  }
+  return -1;
+}
+
+void MonitorMemoria::contarReserva(void)
+{
+  // Antes de armar() tampoco corre el planificador de FreeRTOS en los constructores globales
+  if (!armado.load(std::memory_order_acquire))
+  {
+    return;
+  }
+  reservas.fetch_add(1, std::memory_order_relaxed);
+
+  if (zonasAbiertas.load(std::memory_order_relaxed) == 0)
+  {
+    return;
+  }
+  int8_t ranura = ranuraActual();
+  if (ranura >= 0)
+  {
+    uint8_t zona = tabla[ranura].zona;
+    if (zona < MAX_ZONAS_MONITOR)
+    {
+      reservasZonas[zona].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+#if MODO_CONTEO_RESERVAS
+ZonaSinReservas::ZonaSinReservas(uint8_t zona) : ranura(monitorMemoria.ranuraActual()), anterior(SIN_ZONA)
+{
+  if (ranura >= 0)
+  {
+    anterior = monitorMemoria.tabla[ranura].zona;
+    monitorMemoria.tabla[ranura].zona = zona;
+    monitorMemoria.zonasAbiertas.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+ZonaSinReservas::~ZonaSinReservas(void)
+{
+  if (ranura >= 0)
+  {
+    monitorMemoria.tabla[ranura].zona = anterior;
+    monitorMemoria.zonasAbiertas.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+#endif
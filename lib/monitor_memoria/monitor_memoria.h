@@ -0,0 +1,144 @@
+#ifndef MONITOR_MEMORIA_H
+#define MONITOR_MEMORIA_H
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * @file monitor_memoria.h
+ * @brief Marcas de agua del heap y de las pilas, y conteo de reservas en las rutas calientes
+ *
+ * La fragmentacion del heap tras dias de TLS no se ve en la memoria libre
+ * sino en el bloque libre mas grande: leerHeap() da ambos, junto al minimo
+ * historico. Cada tarea que se registra aporta la marca de agua de su pila
+ * (lo minimo que le quedo libre, en bytes).
+ *
+ * Con MODO_CONTEO_RESERVAS el firmware se enlaza con
+ * -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc (env
+ * esp32dev_reservas) y cada reserva pasa por este modulo. Desde armar(),
+ * al terminar setup(), se cuentan todas; las que ocurren dentro de una
+ * ZonaSinReservas se atribuyen ademas a esa zona. El objetivo es cero por
+ * zona en regimen: cualquier cuenta senala una reserva en una ruta que no
+ * deberia tenerla. Las reservas de otras tareas (WiFi, lwIP) no cuentan en
+ * la zona abierta de una tarea registrada.
+ */
+
+#ifndef MODO_CONTEO_RESERVAS
+#define MODO_CONTEO_RESERVAS 0 ///< 1: contar malloc/calloc/realloc (requiere el --wrap del enlazador)
+#endif
+#define MAX_TAREAS_MONITOR 6 ///< Tareas con marca de agua de pila
+#define MAX_ZONAS_MONITOR 8  ///< Zonas sin reservas distintas
+#define SIN_ZONA 0xFF        ///< Zona de una tarea fuera de toda ZonaSinReservas
+
+/**
+ * @brief Estado del heap de 8 bits (MALLOC_CAP_8BIT)
+ */
+struct EstadoHeap
+{
+  uint32_t libre;        ///< Bytes libres ahora
+  uint32_t minimoLibre;  ///< Menor libre desde el arranque
+  uint32_t bloqueMayor;  ///< Mayor bloque que se puede reservar de una vez
+  uint8_t fragmentacion; ///< 100 - bloqueMayor * 100 / libre
+};
+
+class MonitorMemoria
+{
+public:
+  MonitorMemoria(void);
+
+  /**
+   * @brief Nombres de las zonas, indexados por el numero que recibe ZonaSinReservas
+   * @param nombres Arreglo estatico de cantidad nombres
+   */
+  void definirZonas(const char *const *nombres, uint8_t cantidad);
+
+  /**
+   * @brief Registra la tarea que llama, para su marca de agua y sus zonas
+   * @return false si la tabla esta llena
+   */
+  bool registrarTarea(const char *nombre);
+
+  /**
+   * @brief Empieza a contar reservas; llamar al terminar setup()
+   */
+  void armar(void);
+
+  void leerHeap(EstadoHeap &estado) const;
+
+  uint8_t tareas(void) const;
+  const char *nombreTarea(uint8_t indice) const;
+
+  /**
+   * @brief Menor pila libre que tuvo la tarea, en bytes
+   */
+  uint32_t pilaLibreMinima(uint8_t indice) const;
+
+  uint8_t zonas(void) const;
+  const char *nombreZona(uint8_t zona) const;
+
+  /**
+   * @brief Reservas desde armar() o desde la llamada anterior, en todas las tareas
+   */
+  uint32_t tomarReservas(void);
+
+  /**
+   * @brief Reservas dentro de la zona desde la llamada anterior
+   */
+  uint32_t tomarReservasZona(uint8_t zona);
+
+  /**
+   * @brief Cuenta una reserva; lo llaman los envoltorios de malloc
+   */
+  void contarReserva(void);
+
+private:
+  friend class ZonaSinReservas;
+
+  struct Tarea
+  {
+    const char *nombre;
+    TaskHandle_t manejador;
+    volatile uint8_t zona; ///< Zona abierta de la tarea, SIN_ZONA si ninguna
+  };
+
+  int8_t ranuraActual(void) const;
+
+  portMUX_TYPE cerrojo;
+  Tarea tabla[MAX_TAREAS_MONITOR];
+  std::atomic<uint8_t> numeroTareas;
+  const char *const *nombresZonas;
+  uint8_t numeroZonas;
+
+  std::atomic<bool> armado;
+  std::atomic<uint32_t> zonasAbiertas;
+  std::atomic<uint32_t> reservas;
+  std::atomic<uint32_t> reservasZonas[MAX_ZONAS_MONITOR];
+};
+
+extern MonitorMemoria monitorMemoria;
+
+/**
+ * @brief Marca un bloque como ruta caliente: sus reservas se atribuyen a la zona
+ *
+ * Las zonas se anidan; cuenta la mas interna. Sin MODO_CONTEO_RESERVAS no
+ * hace nada y no cuesta nada.
+ */
+class ZonaSinReservas
+{
+public:
+#if MODO_CONTEO_RESERVAS
+  explicit ZonaSinReservas(uint8_t zona);
+  ~ZonaSinReservas(void);
+
+private:
+  int8_t ranura;
+  uint8_t anterior;
+#else
+  explicit ZonaSinReservas(uint8_t zona)
+  {
+    (void)zona;
+  }
+#endif
+};
+
+#endif
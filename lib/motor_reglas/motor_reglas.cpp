@@ -0,0 +1,122 @@
+#include "motor_reglas.h"
+
+#include <math.h>
+#include <string.h>
+
+MotorReglas::MotorReglas(void) : numeroReglas(0), canalesConReglas(0), salidas(0)
+{
+}
+
+bool MotorReglas::reglaValida(const Regla &regla)
+{
+  return regla.canal < MAX_CANALES_REGLAS && regla.tipo < NUMERO_TIPOS_REGLA &&
+         (regla.salida < MAX_SALIDAS_REGLAS || regla.salida == SALIDA_NINGUNA) && isfinite(regla.umbral) &&
+         isfinite(regla.histeresis) && regla.histeresis >= 0.0f;
+}
+
+bool MotorReglas::cargar(const Regla *nuevas, uint8_t cantidad)
+{
+  numeroReglas = 0;
+  canalesConReglas = 0;
+  salidas = 0;
+  if (cantidad > MAX_REGLAS)
+  {
+    return false;
+  }
+  for (uint8_t i = 0; i < cantidad; i++)
+  {
+    if (!reglaValida(nuevas[i]))
+    {
+      return false;
+    }
+  }
+
+  memcpy(reglas, nuevas, cantidad * sizeof(Regla));
+  memset(estados, 0, sizeof(estados));
+  for (uint8_t i = 0; i < cantidad; i++)
+  {
+    canalesConReglas |= 1UL << reglas[i].canal;
+  }
+  numeroReglas = cantidad;
+  return true;
+}
+
+/**
+ * @brief Actualiza el estado de una regla con una lectura
+ * @param evaluado Recibe el valor comparado: la lectura o su ritmo de cambio
+ * @return true si la regla cambio de estado
+ */
+bool MotorReglas::condicion(uint8_t indice, float valor, int64_t instanteUs, float &evaluado)
+{
+  const Regla &regla = reglas[indice];
+  Estado &estado = estados[indice];
+
+  evaluado = valor;
+  if (regla.tipo == REGLA_CAMBIO)
+  {
+    bool conRitmo = estado.conAnterior && instanteUs > estado.anteriorUs;
+    if (conRitmo)
+    {
+      evaluado = fabsf(valor - estado.anterior) * 1e6f / (float)(instanteUs - estado.anteriorUs);
+    }
+    estado.anterior = valor;
+    estado.anteriorUs = instanteUs;
+    estado.conAnterior = true;
+    if (!conRitmo)
+    {
+      return false;
+    }
+  }
+
+  bool activa;
+  if (regla.tipo == REGLA_MENOR)
+  {
+    activa = estado.activa ? evaluado <= regla.umbral + regla.histeresis : evaluado < regla.umbral;
+  }
+  else
+  {
+    activa = estado.activa ? evaluado >= regla.umbral - regla.histeresis : evaluado > regla.umbral;
+  }
+
+  if (activa == estado.activa)
+  {
+    return false;
+  }
+  estado.activa = activa;
+  return true;
+}
+
+uint8_t MotorReglas::evaluar(uint8_t canal, float valor, int64_t instanteUs, CambioRegla *cambios)
+{
+  if (canal >= MAX_CANALES_REGLAS || !(canalesConReglas & (1UL << canal)) || isnan(valor))
+  {
+    return 0;
+  }
+
+  uint8_t numeroCambios = 0;
+  for (uint8_t i = 0; i < numeroReglas; i++)
+  {
+    float evaluado;
+    if (reglas[i].canal != canal || !condicion(i, valor, instanteUs, evaluado))
+    {
+      continue;
+    }
+    cambios[numeroCambios].regla = i;
+    cambios[numeroCambios].activa = estados[i].activa;
+    cambios[numeroCambios].valor = evaluado;
+    numeroCambios++;
+  }
+
+  if (numeroCambios > 0)
+  {
+    salidas = 0;
+    for (uint8_t i = 0; i < numeroReglas; i++)
+    {
+      if (estados[i].activa && reglas[i].salida != SALIDA_NINGUNA)
+      {
+        salidas |= 1UL << reglas[i].salida;
+      }
+    }
+  }
+  return numeroCambios;
+}
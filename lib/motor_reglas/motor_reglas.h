@@ -0,0 +1,133 @@
+#ifndef MOTOR_REGLAS_H
+#define MOTOR_REGLAS_H
+
+#include <stdint.h>
+
+/**
+ * @file motor_reglas.h
+ * @brief Reglas de alarma con histeresis evaluadas en el equipo con cada lectura
+ *
+ * Cada regla vigila un canal y pasa de liberada a activa, o al reves,
+ * segun su tipo:
+ * - REGLA_MAYOR: se activa con valor > umbral y se libera con
+ *   valor < umbral - histeresis
+ * - REGLA_MENOR: se activa con valor < umbral y se libera con
+ *   valor > umbral + histeresis
+ * - REGLA_CAMBIO: igual que REGLA_MAYOR sobre el ritmo de cambio entre
+ *   dos lecturas, en valor absoluto y en unidades por segundo
+ *
+ * Una regla puede manejar una salida: la salida esta activa mientras lo
+ * este alguna de sus reglas. Que es cada canal y cada salida lo define la
+ * aplicacion.
+ *
+ * Las reglas se validan y se indexan por canal una sola vez, en cargar();
+ * evaluar() con un canal sin reglas solo prueba un bit. Sin memoria
+ * dinamica, ni siquiera al cargar.
+ */
+
+#define MAX_REGLAS 8          ///< Reglas cargadas a la vez
+#define MAX_CANALES_REGLAS 32 ///< Canales que pueden tener reglas (un bit por canal)
+#define MAX_SALIDAS_REGLAS 32 ///< Salidas que pueden manejar las reglas (un bit por salida)
+#define SALIDA_NINGUNA 0xFF   ///< La regla solo da alarma
+
+/**
+ * @brief Condicion de una regla
+ */
+enum TipoRegla : uint8_t
+{
+  REGLA_MAYOR = 0, ///< Valor por encima del umbral
+  REGLA_MENOR,     ///< Valor por debajo del umbral
+  REGLA_CAMBIO,    ///< Ritmo de cambio por encima del umbral
+  NUMERO_TIPOS_REGLA
+};
+
+/**
+ * @brief Regla ya interpretada, tal como se guarda en la configuracion
+ */
+struct Regla
+{
+  uint8_t canal;    ///< Canal que vigila
+  uint8_t tipo;     ///< TipoRegla
+  uint8_t salida;   ///< Salida que maneja, o SALIDA_NINGUNA
+  float umbral;     ///< Valor, o unidades por segundo en REGLA_CAMBIO
+  float histeresis; ///< Margen para liberarse, >= 0
+};
+
+/**
+ * @brief Cambio de estado de una regla
+ */
+struct CambioRegla
+{
+  uint8_t regla; ///< Indice en el arreglo que recibio cargar()
+  bool activa;   ///< Estado nuevo
+  float valor;   ///< Valor (o ritmo, en REGLA_CAMBIO) que lo provoco
+};
+
+class MotorReglas
+{
+public:
+  MotorReglas(void);
+
+  /**
+   * @brief Reemplaza las reglas; todas empiezan liberadas
+   * @param reglas Reglas a copiar
+   * @param cantidad A lo sumo MAX_REGLAS
+   * @return false si alguna es invalida; entonces no queda ninguna
+   */
+  bool cargar(const Regla *reglas, uint8_t cantidad);
+
+  /**
+   * @brief Indica si una regla es aceptable, sin cargarla
+   */
+  static bool reglaValida(const Regla &regla);
+
+  /**
+   * @brief Evalua las reglas de un canal con una lectura nueva
+   * @param canal Canal de la lectura
+   * @param valor Lectura; NaN no cambia nada
+   * @param instanteUs Instante de la lectura, para el ritmo de cambio
+   * @param cambios Recibe los cambios de estado, hasta MAX_REGLAS
+   * @return Cantidad de cambios
+   */
+  uint8_t evaluar(uint8_t canal, float valor, int64_t instanteUs, CambioRegla *cambios);
+
+  /**
+   * @brief Salidas activas, un bit por salida
+   */
+  uint32_t salidasActivas(void) const
+  {
+    return salidas;
+  }
+
+  uint8_t cantidad(void) const
+  {
+    return numeroReglas;
+  }
+
+  const Regla &regla(uint8_t indice) const
+  {
+    return reglas[indice];
+  }
+
+private:
+  /**
+   * @brief Estado de evaluacion de una regla
+   */
+  struct Estado
+  {
+    float anterior;     ///< Ultima lectura, para REGLA_CAMBIO
+    int64_t anteriorUs; ///< Instante de la ultima lectura
+    bool conAnterior;   ///< Ya hubo una lectura
+    bool activa;
+  };
+
+  bool condicion(uint8_t indice, float valor, int64_t instanteUs, float &evaluado);
+
+  Regla reglas[MAX_REGLAS];
+  Estado estados[MAX_REGLAS];
+  uint8_t numeroReglas;
+  uint32_t canalesConReglas; ///< Bit por canal con alguna regla
+  uint32_t salidas;          ///< Bit por salida activa
+};
+
+#endif
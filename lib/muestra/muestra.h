@@ -0,0 +1,36 @@
+#ifndef MUESTRA_H
+#define MUESTRA_H
+
+#include <stdint.h>
+
+/**
+ * @file muestra.h
+ * @brief Registro de tamano fijo para una lectura de sensor
+ *
+ * Es la unidad que la tarea de adquisicion entrega a la tarea de red. El
+ * canal identifica el sensor y el topico; su significado lo define la
+ * tabla de canales de la aplicacion.
+ *
+ * La marca se toma al completar la lectura con el reloj monotonico en
+ * microsegundos (RelojUTC::monotonicoUs()) y se convierte a UTC en cuanto
+ * hay hora valida, antes de salir a la red o a flash. Una marca que no se
+ * pudo convertir solo tiene sentido dentro de su arranque.
+ */
+
+#define MUESTRA_UTC 0x01 ///< marcaTiempoUs ya esta en UTC (us desde 1970)
+
+/**
+ * @brief Lectura de un canal de sensor lista para publicar
+ */
+struct Muestra
+{
+  int64_t marcaTiempoUs; ///< Instante de adquisicion: UTC con MUESTRA_UTC, si no monotonico
+  float valor;           ///< Valor de la lectura en unidades de ingenieria
+  uint8_t canal;         ///< Identificador del canal de sensor
+  uint8_t banderas;      ///< MUESTRA_*
+  uint16_t arranque;     ///< Arranque en que se tomo la marca (RelojUTC::arranque())
+};
+
+static_assert(sizeof(Muestra) == 16, "Muestra es el registro del almacen en flash: cuidar su tamano");
+
+#endif
@@ -0,0 +1,111 @@
+#include "planificador.h"
+
+#include <stddef.h>
+
+Planificador::Planificador(void) : numeroTareas(0)
+{
+}
+
+int Planificador::agregarTarea(const char *nombre, uint32_t periodoMs, FuncionTarea funcion,
+                               uint32_t desfaseMs)
+{
+  if (numeroTareas >= MAX_TAREAS_PLANIFICADOR || funcion == NULL)
+  {
+    return -1;
+  }
+
+  TareaPlanificada &tarea = tareas[numeroTareas];
+  tarea.nombre = nombre;
+  tarea.funcion = funcion;
+  tarea.periodoMs = periodoMs;
+  tarea.proximaEjecucionMs = desfaseMs;
+  tarea.activa = true;
+
+  return numeroTareas++;
+}
+
+void Planificador::cambiarPeriodo(int indice, uint32_t periodoMs)
+{
+  if (indice < 0 || indice >= numeroTareas)
+  {
+    return;
+  }
+
+  // Reprogramar respecto al periodo nuevo sin esperar el vencimiento viejo
+  TareaPlanificada &tarea = tareas[indice];
+  tarea.proximaEjecucionMs = tarea.proximaEjecucionMs - tarea.periodoMs + periodoMs;
+  tarea.periodoMs = periodoMs;
+}
+
+void Planificador::reprogramar(int indice, uint32_t proximaEjecucionMs)
+{
+  if (indice >= 0 && indice < numeroTareas)
+  {
+    tareas[indice].proximaEjecucionMs = proximaEjecucionMs;
+  }
+}
+
+void Planificador::activarTarea(int indice, bool activa)
+{
+  if (indice >= 0 && indice < numeroTareas)
+  {
+    tareas[indice].activa = activa;
+  }
+}
+
+void Planificador::iniciar(uint32_t ahoraMs)
+{
+  for (uint8_t i = 0; i < numeroTareas; i++)
+  {
+    tareas[i].proximaEjecucionMs += ahoraMs;
+  }
+}
+
+void Planificador::ejecutar(uint32_t ahoraMs)
+{
+  for (uint8_t i = 0; i < numeroTareas; i++)
+  {
+    TareaPlanificada &tarea = tareas[i];
+
+    // Comparacion con signo para tolerar el desborde de millis()
+    if (!tarea.activa || (int32_t)(ahoraMs - tarea.proximaEjecucionMs) < 0)
+    {
+      continue;
+    }
+
+    tarea.funcion(ahoraMs);
+
+    // Mantener la cadencia; si la tarea se atraso mas de un periodo, no
+    // intentar recuperar las ejecuciones perdidas en rafaga
+    tarea.proximaEjecucionMs += tarea.periodoMs;
+    if ((int32_t)(ahoraMs - tarea.proximaEjecucionMs) >= 0)
+    {
+      tarea.proximaEjecucionMs = ahoraMs + tarea.periodoMs;
+    }
+  }
+}
+
+uint32_t Planificador::msHastaProximaTarea(uint32_t ahoraMs) const
+{
+  uint32_t minimo = UINT32_MAX;
+
+  for (uint8_t i = 0; i < numeroTareas; i++)
+  {
+    if (!tareas[i].activa)
+    {
+      continue;
+    }
+
+    int32_t restante = (int32_t)(tareas[i].proximaEjecucionMs - ahoraMs);
+    if (restante <= 0)
+    {
+      return 0;
+    }
+    if ((uint32_t)restante < minimo)
+    {
+      minimo = (uint32_t)restante;
+    }
+  }
+
+  return minimo;
+}
@@ -0,0 +1,107 @@
+#ifndef PLANIFICADOR_H
+#define PLANIFICADOR_H
+
+#include <stdint.h>
+
+/**
+ * @file planificador.h
+ * @brief Planificador cooperativo de tareas periodicas basado en ticks
+ *
+ * Cada tarea registrada tiene su propio periodo y se ejecuta cuando este
+ * vence. Las tareas deben devolver el control de inmediato (maquinas de
+ * estado), de modo que el bucle principal pueda seguir atendiendo MQTT
+ * entre ejecuciones.
+ */
+
+#define MAX_TAREAS_PLANIFICADOR 8 ///< Numero maximo de tareas registrables
+
+/**
+ * @brief Firma de una tarea planificada
+ * @param ahoraMs Marca de tiempo (millis) del tick que la ejecuta
+ */
+typedef void (*FuncionTarea)(uint32_t ahoraMs);
+
+/**
+ * @brief Descriptor de una tarea periodica
+ */
+struct TareaPlanificada
+{
+  const char *nombre;           ///< Nombre para diagnostico
+  FuncionTarea funcion;         ///< Funcion a ejecutar en cada vencimiento
+  uint32_t periodoMs;           ///< Periodo de ejecucion en milisegundos
+  uint32_t proximaEjecucionMs;  ///< Instante del proximo vencimiento
+  bool activa;                  ///< Permite pausar la tarea sin eliminarla
+};
+
+/**
+ * @brief Planificador cooperativo con tabla fija de tareas
+ *
+ * No reserva memoria dinamica: las tareas viven en un arreglo fijo de
+ * MAX_TAREAS_PLANIFICADOR elementos.
+ */
+class Planificador
+{
+public:
+  Planificador(void);
+
+  /**
+   * @brief Registra una nueva tarea periodica
+   * @param nombre Nombre de la tarea
+   * @param periodoMs Periodo en milisegundos
+   * @param funcion Funcion de la tarea
+   * @param desfaseMs Retardo de la primera ejecucion, para escalonar tareas
+   * @return Indice de la tarea o -1 si la tabla esta llena
+   */
+  int agregarTarea(const char *nombre, uint32_t periodoMs, FuncionTarea funcion,
+                   uint32_t desfaseMs = 0);
+
+  /**
+   * @brief Cambia el periodo de una tarea ya registrada
+   * @param indice Indice devuelto por agregarTarea()
+   * @param periodoMs Nuevo periodo en milisegundos
+   */
+  void cambiarPeriodo(int indice, uint32_t periodoMs);
+
+  /**
+   * @brief Fija el proximo vencimiento de una tarea ya registrada
+   * @param indice Indice devuelto por agregarTarea()
+   * @param proximaEjecucionMs Marca de tiempo (millis) de la proxima ejecucion
+   */
+  void reprogramar(int indice, uint32_t proximaEjecucionMs);
+
+  /**
+   * @brief Activa o pausa una tarea
+   * @param indice Indice devuelto por agregarTarea()
+   * @param activa true para ejecutarla, false para pausarla
+   */
+  void activarTarea(int indice, bool activa);
+
+  /**
+   * @brief Fija el instante de referencia de todas las tareas registradas
+   *
+   * Debe llamarse una vez terminada la inicializacion, para que los
+   * desfases se cuenten desde ese momento y no desde el arranque.
+   *
+   * @param ahoraMs Marca de tiempo actual (millis)
+   */
+  void iniciar(uint32_t ahoraMs);
+
+  /**
+   * @brief Ejecuta todas las tareas cuyo periodo haya vencido
+   * @param ahoraMs Marca de tiempo actual (millis)
+   */
+  void ejecutar(uint32_t ahoraMs);
+
+  /**
+   * @brief Calcula cuanto falta para el proximo vencimiento
+   * @param ahoraMs Marca de tiempo actual (millis)
+   * @return Milisegundos hasta la tarea mas proxima (0 si ya vencio)
+   */
+  uint32_t msHastaProximaTarea(uint32_t ahoraMs) const;
+
+private:
+  TareaPlanificada tareas[MAX_TAREAS_PLANIFICADOR];
+  uint8_t numeroTareas;
+};
+
+#endif
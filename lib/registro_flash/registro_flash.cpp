@@ -0,0 +1,257 @@
+#include "registro_flash.h"
+
+#include <LittleFS.h>
+#include <string.h>
+
+#define MAGIA_PAGINA 0x52504731UL ///< "RPG1"
+#define MAGIA_ESTADO 0x52455331UL ///< "RES1"
+
+RegistroFlash::RegistroFlash(const char *directorio, uint16_t tamanoRegistro, uint16_t segmentos,
+                             uint16_t paginasPorSegmento)
+    : directorio(directorio), tamanoRegistro(tamanoRegistro), segmentos(segmentos),
+      paginasPorSegmento(paginasPorSegmento), registrosEnRAM(0), cantidadPaginaLectura(0),
+      ultimoLeido(0), montado(false)
+{
+  memset(&estado, 0, sizeof(estado));
+}
+
+bool RegistroFlash::iniciar(void)
+{
+  if (!LittleFS.begin(true))
+  {
+    return false;
+  }
+  montado = true;
+  LittleFS.mkdir(directorio);
+
+  char ruta[48];
+  snprintf(ruta, sizeof(ruta), "%s/estado", directorio);
+  File archivo = LittleFS.open(ruta, "r");
+  bool valido = false;
+  if (archivo)
+  {
+    valido = archivo.read((uint8_t *)&estado, sizeof(estado)) == sizeof(estado) &&
+             estado.magia == MAGIA_ESTADO && estado.tamanoRegistro == tamanoRegistro &&
+             estado.paginasEscritas - estado.paginaLectura <= (uint32_t)segmentos * paginasPorSegmento;
+    archivo.close();
+  }
+
+  if (!valido)
+  {
+    // Primer arranque o cambio de formato: empezar con el anillo vacio
+    memset(&estado, 0, sizeof(estado));
+    estado.magia = MAGIA_ESTADO;
+    estado.tamanoRegistro = tamanoRegistro;
+    guardarEstado();
+  }
+
+  return true;
+}
+
+uint16_t RegistroFlash::registrosPorPagina(void) const
+{
+  return (uint16_t)((TAMANO_PAGINA_REGISTRO - sizeof(CabeceraPagina)) / tamanoRegistro);
+}
+
+bool RegistroFlash::agregar(const void *registro)
+{
+  if (!montado)
+  {
+    return false;
+  }
+
+  // Una pagina llena que no se pudo escribir sigue en RAM: sin lugar hasta escribirla
+  if (registrosEnRAM >= registrosPorPagina() && !escribirPagina())
+  {
+    return false;
+  }
+
+  memcpy(pagina + sizeof(CabeceraPagina) + (size_t)registrosEnRAM * tamanoRegistro, registro, tamanoRegistro);
+  registrosEnRAM++;
+
+  return registrosEnRAM < registrosPorPagina() || escribirPagina();
+}
+
+bool RegistroFlash::sincronizar(void)
+{
+  return !montado || escribirPagina();
+}
+
+void RegistroFlash::rutaSegmento(uint32_t numero, char *ruta, size_t capacidad) const
+{
+  uint32_t ranura = numero % ((uint32_t)segmentos * paginasPorSegmento);
+  snprintf(ruta, capacidad, "%s/seg%02u.bin", directorio, (unsigned)(ranura / paginasPorSegmento));
+}
+
+uint32_t RegistroFlash::desplazamientoPagina(uint32_t numero) const
+{
+  uint32_t ranura = numero % ((uint32_t)segmentos * paginasPorSegmento);
+  return (ranura % paginasPorSegmento) * (uint32_t)TAMANO_PAGINA_REGISTRO;
+}
+
+/**
+ * @brief Cierra la pagina en RAM escribiendola completa en su ranura del anillo
+ */
+bool RegistroFlash::escribirPagina(void)
+{
+  if (registrosEnRAM == 0)
+  {
+    return true;
+  }
+
+  CabeceraPagina cabecera = {MAGIA_PAGINA, estado.paginasEscritas, registrosEnRAM, tamanoRegistro};
+  memcpy(pagina, &cabecera, sizeof(cabecera));
+
+  size_t usados = sizeof(cabecera) + (size_t)registrosEnRAM * tamanoRegistro;
+  memset(pagina + usados, 0xFF, sizeof(pagina) - usados);
+
+  char ruta[48];
+  rutaSegmento(estado.paginasEscritas, ruta, sizeof(ruta));
+  File archivo = LittleFS.exists(ruta) ? LittleFS.open(ruta, "r+") : LittleFS.open(ruta, "w");
+  if (!archivo)
+  {
+    return false;
+  }
+
+  bool escrita = archivo.seek(desplazamientoPagina(estado.paginasEscritas), SeekSet) &&
+                 archivo.write(pagina, sizeof(pagina)) == sizeof(pagina);
+  archivo.close();
+  if (!escrita)
+  {
+    return false;
+  }
+
+  registrosEnRAM = 0;
+  estado.paginasEscritas++;
+
+  // Anillo lleno: la pagina recien escrita piso a la mas antigua
+  uint32_t capacidad = (uint32_t)segmentos * paginasPorSegmento;
+  if (estado.paginasEscritas - estado.paginaLectura > capacidad)
+  {
+    estado.paginaLectura = estado.paginasEscritas - capacidad;
+    estado.registroLectura = 0;
+    estado.paginasPerdidas++;
+    cantidadPaginaLectura = 0;
+    ultimoLeido = 0;
+  }
+
+  guardarEstado();
+  return true;
+}
+
+bool RegistroFlash::leerCabecera(uint32_t numero, CabeceraPagina &cabecera)
+{
+  char ruta[48];
+  rutaSegmento(numero, ruta, sizeof(ruta));
+  File archivo = LittleFS.open(ruta, "r");
+  if (!archivo)
+  {
+    return false;
+  }
+
+  bool leida = archivo.seek(desplazamientoPagina(numero), SeekSet) &&
+               archivo.read((uint8_t *)&cabecera, sizeof(cabecera)) == sizeof(cabecera);
+  archivo.close();
+
+  return leida && cabecera.magia == MAGIA_PAGINA && cabecera.numero == numero &&
+         cabecera.tamanoRegistro == tamanoRegistro && cabecera.cantidad <= registrosPorPagina();
+}
+
+uint16_t RegistroFlash::leer(void *destino, uint16_t maximo)
+{
+  ultimoLeido = 0;
+
+  while (montado && estado.paginaLectura != estado.paginasEscritas)
+  {
+    if (cantidadPaginaLectura == 0)
+    {
+      CabeceraPagina cabecera;
+      cantidadPaginaLectura = leerCabecera(estado.paginaLectura, cabecera) ? cabecera.cantidad : 0;
+    }
+
+    if (estado.registroLectura >= cantidadPaginaLectura)
+    {
+      // Pagina consumida o ilegible: pasar a la siguiente
+      estado.paginaLectura++;
+      estado.registroLectura = 0;
+      cantidadPaginaLectura = 0;
+      guardarEstado();
+      continue;
+    }
+
+    uint16_t cantidad = cantidadPaginaLectura - estado.registroLectura;
+    if (cantidad > maximo)
+    {
+      cantidad = maximo;
+    }
+
+    char ruta[48];
+    rutaSegmento(estado.paginaLectura, ruta, sizeof(ruta));
+    File archivo = LittleFS.open(ruta, "r");
+    if (!archivo)
+    {
+      return 0;
+    }
+
+    size_t bytes = (size_t)cantidad * tamanoRegistro;
+    uint32_t desplazamiento = desplazamientoPagina(estado.paginaLectura) + sizeof(CabeceraPagina) +
+                              (uint32_t)estado.registroLectura * tamanoRegistro;
+    bool leido = archivo.seek(desplazamiento, SeekSet) && archivo.read((uint8_t *)destino, bytes) == bytes;
+    archivo.close();
+
+    ultimoLeido = leido ? cantidad : 0;
+    return ultimoLeido;
+  }
+
+  return 0;
+}
+
+void RegistroFlash::confirmar(uint16_t cantidad)
+{
+  if (cantidad > ultimoLeido)
+  {
+    cantidad = ultimoLeido;
+  }
+  ultimoLeido = 0;
+
+  estado.registroLectura += cantidad;
+  if (cantidadPaginaLectura > 0 && estado.registroLectura >= cantidadPaginaLectura)
+  {
+    estado.paginaLectura++;
+    estado.registroLectura = 0;
+    cantidadPaginaLectura = 0;
+    guardarEstado();
+  }
+}
+
+bool RegistroFlash::vacio(void) const
+{
+  return estado.paginaLectura == estado.paginasEscritas && registrosEnRAM == 0;
+}
+
+uint32_t RegistroFlash::paginasPendientes(void) const
+{
+  return estado.paginasEscritas - estado.paginaLectura;
+}
+
+uint16_t RegistroFlash::registrosEnMemoria(void) const
+{
+  return registrosEnRAM;
+}
+
+uint32_t RegistroFlash::paginasPerdidas(void) const
+{
+  return estado.paginasPerdidas;
+}
+
+void RegistroFlash::guardarEstado(void)
+{
+  char ruta[48];
+  snprintf(ruta, sizeof(ruta), "%s/estado", directorio);
+  File archivo = LittleFS.open(ruta, "w");
+  if (archivo)
+  {
+    archivo.write((const uint8_t *)&estado, sizeof(estado));
+    archivo.close();
+  }
+}
@@ -0,0 +1,147 @@
+#ifndef REGISTRO_FLASH_H
+#define REGISTRO_FLASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file registro_flash.h
+ * @brief Registro circular de solo-agregar en LittleFS para almacenar y reenviar
+ *
+ * Guarda registros de tamano fijo mientras no hay conexion y los entrega
+ * en lotes al volver. El espacio se reparte en paginas de TAMANO_PAGINA_REGISTRO
+ * bytes, distribuidas en varios archivos de segmento que se recorren en
+ * anillo; cuando el anillo se llena se pierde la pagina mas antigua.
+ *
+ * - Las escrituras se acumulan en una pagina en RAM y van a flash de a una
+ *   pagina completa, siempre en un desplazamiento alineado a pagina.
+ * - Recorrer los segmentos en anillo reparte el desgaste, y LittleFS
+ *   agrega su propia nivelacion de desgaste por debajo.
+ * - Los punteros de escritura y lectura se guardan en un archivo de estado
+ *   al cerrar o consumir cada pagina; tras un reinicio se puede repetir a
+ *   lo sumo una pagina ya enviada, nunca perder una confirmada.
+ *
+ * No es seguro para varias tareas: debe usarlo una sola (tarea de red).
+ */
+
+#define TAMANO_PAGINA_REGISTRO 4096 ///< Unidad de escritura en flash, en bytes
+
+class RegistroFlash
+{
+public:
+  /**
+   * @param directorio Directorio de LittleFS para segmentos y estado
+   * @param tamanoRegistro Tamano de cada registro en bytes
+   * @param segmentos Numero de archivos de segmento del anillo
+   * @param paginasPorSegmento Paginas de TAMANO_PAGINA_REGISTRO por segmento
+   */
+  RegistroFlash(const char *directorio, uint16_t tamanoRegistro, uint16_t segmentos,
+                uint16_t paginasPorSegmento);
+
+  /**
+   * @brief Monta LittleFS y recupera los punteros guardados
+   * @return false si no se pudo montar el sistema de archivos
+   */
+  bool iniciar(void);
+
+  /**
+   * @brief Agrega un registro a la pagina en RAM; la escribe si se llena
+   *
+   * Si la pagina llena no se pudo escribir, cada llamada la reintenta y
+   * descarta el registro mientras siga fallando.
+   *
+   * @return false si la escritura de la pagina fallo o el registro se descarto
+   */
+  bool agregar(const void *registro);
+
+  /**
+   * @brief Escribe en flash la pagina en RAM aunque no este llena
+   *
+   * La pagina queda cerrada y los registros siguientes van a la proxima.
+   */
+  bool sincronizar(void);
+
+  /**
+   * @brief Lee registros pendientes sin consumirlos
+   *
+   * Lee a partir del puntero de lectura y dentro de una sola pagina. Los
+   * registros siguen pendientes hasta confirmar(). Solo se leen paginas ya
+   * escritas en flash; llamar a sincronizar() para incluir la de RAM.
+   *
+   * @param destino Buffer para hasta maximo registros
+   * @param maximo Maximo de registros a leer
+   * @return Registros leidos, 0 si no hay pendientes en flash
+   */
+  uint16_t leer(void *destino, uint16_t maximo);
+
+  /**
+   * @brief Consume los registros entregados por el ultimo leer()
+   * @param cantidad Registros efectivamente enviados
+   */
+  void confirmar(uint16_t cantidad);
+
+  /**
+   * @brief Indica si no queda nada por enviar, ni en flash ni en RAM
+   */
+  bool vacio(void) const;
+
+  /**
+   * @brief Paginas cerradas en flash que aun no se consumieron por completo
+   */
+  uint32_t paginasPendientes(void) const;
+
+  /**
+   * @brief Registros en la pagina en RAM, aun no escritos en flash
+   */
+  uint16_t registrosEnMemoria(void) const;
+
+  /**
+   * @brief Paginas perdidas por llenarse el anillo desde el inicio
+   */
+  uint32_t paginasPerdidas(void) const;
+
+private:
+  /**
+   * @brief Cabecera de cada pagina en flash
+   */
+  struct CabeceraPagina
+  {
+    uint32_t magia;          ///< Identifica una pagina valida
+    uint32_t numero;         ///< Numero de pagina global (monotono)
+    uint16_t cantidad;       ///< Registros validos en la pagina
+    uint16_t tamanoRegistro; ///< Tamano de registro con que se escribio
+  };
+
+  /**
+   * @brief Punteros persistidos del anillo
+   */
+  struct Estado
+  {
+    uint32_t magia;
+    uint32_t paginasEscritas;  ///< Paginas cerradas desde el formateo (monotono)
+    uint32_t paginaLectura;    ///< Primera pagina no consumida (monotono)
+    uint16_t registroLectura;  ///< Primer registro no consumido de paginaLectura
+    uint16_t tamanoRegistro;
+    uint32_t paginasPerdidas;
+  };
+
+  bool escribirPagina(void);
+  bool leerCabecera(uint32_t numero, CabeceraPagina &cabecera);
+  void rutaSegmento(uint32_t numero, char *ruta, size_t capacidad) const;
+  uint32_t desplazamientoPagina(uint32_t numero) const;
+  void guardarEstado(void);
+  uint16_t registrosPorPagina(void) const;
+
+  const char *directorio;
+  uint16_t tamanoRegistro;
+  uint16_t segmentos;
+  uint16_t paginasPorSegmento;
+  Estado estado;
+  uint16_t registrosEnRAM;
+  uint16_t cantidadPaginaLectura; ///< Registros de paginaLectura (0: sin leer)
+  uint16_t ultimoLeido;           ///< Registros entregados por el ultimo leer()
+  bool montado;
+  uint8_t pagina[TAMANO_PAGINA_REGISTRO];
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "reloj_utc.h"
+
+#include <sys/time.h>
+#include "esp_attr.h"
+#include "esp_sntp.h"
+#include "esp_system.h"
+
+#define MAGIA_ARRANQUE 0x52454C4FUL ///< Marca de contadorArranque valido en memoria RTC
+#define MICROSEGUNDOS_POR_SEGUNDO 1000000LL
+
+RelojUTC relojUTC;
+
+// Sobreviven al sueno profundo y a los reinicios por software, no al corte de alimentacion
+RTC_NOINIT_ATTR static uint32_t magiaArranque;
+RTC_NOINIT_ATTR static uint16_t contadorArranque;
+
+RelojUTC::RelojUTC(void) : desfaseUs(0), valido(false), idArranque(0), totalSincronizaciones(0), correccionUs(0)
+{
+  portMUX_TYPE inicial = portMUX_INITIALIZER_UNLOCKED;
+  cerrojo = inicial;
+}
+
+void RelojUTC::iniciar(void)
+{
+  // Tras un corte la memoria RTC es basura: un valor al azar hace improbable
+  // repetir el identificador de un arranque anterior que dejo marcas en flash
+  if (magiaArranque != MAGIA_ARRANQUE)
+  {
+    magiaArranque = MAGIA_ARRANQUE;
+    contadorArranque = (uint16_t)esp_random();
+  }
+  idArranque = ++contadorArranque;
+
+  struct timeval hora;
+  if (gettimeofday(&hora, NULL) == 0 && hora.tv_sec >= EPOCA_MINIMA_VALIDA_S)
+  {
+    int64_t utcUs = (int64_t)hora.tv_sec * MICROSEGUNDOS_POR_SEGUNDO + hora.tv_usec;
+    portENTER_CRITICAL(&cerrojo);
+    desfaseUs = utcUs - monotonicoUs();
+    valido = true;
+    portEXIT_CRITICAL(&cerrojo);
+  }
+}
+
+void RelojUTC::sincronizar(const char *servidorPrincipal, const char *servidorSecundario)
+{
+  sntp_set_time_sync_notification_cb(alSincronizar);
+  configTime(0, 0, servidorPrincipal, servidorSecundario);
+}
+
+/**
+ * @brief Callback del SNTP: la hora del sistema ya se ajusto a la recibida
+ *
+ * Corre en la tarea de lwIP.
+ */
+void RelojUTC::alSincronizar(struct timeval *hora)
+{
+  relojUTC.fijarDesfase((int64_t)hora->tv_sec * MICROSEGUNDOS_POR_SEGUNDO + hora->tv_usec, monotonicoUs());
+}
+
+void RelojUTC::fijarDesfase(int64_t utcUs, int64_t monotonicoUs)
+{
+  int64_t nuevo = utcUs - monotonicoUs;
+
+  portENTER_CRITICAL(&cerrojo);
+  int64_t cambio = valido ? nuevo - desfaseUs : 0;
+  correccionUs = cambio > INT32_MAX ? INT32_MAX : cambio < INT32_MIN ? INT32_MIN : (int32_t)cambio;
+  desfaseUs = nuevo;
+  valido = true;
+  totalSincronizaciones++;
+  portEXIT_CRITICAL(&cerrojo);
+}
+
+uint16_t RelojUTC::arranque(void) const
+{
+  return idArranque;
+}
+
+bool RelojUTC::horaValida(void) const
+{
+  portENTER_CRITICAL(&cerrojo);
+  bool resultado = valido;
+  portEXIT_CRITICAL(&cerrojo);
+  return resultado;
+}
+
+bool RelojUTC::aUTC(int64_t monotonicoUs, uint16_t arranque, int64_t &utcUs) const
+{
+  if (arranque != idArranque)
+  {
+    return false;
+  }
+
+  portENTER_CRITICAL(&cerrojo);
+  bool resultado = valido;
+  int64_t desfase = desfaseUs;
+  portEXIT_CRITICAL(&cerrojo);
+
+  if (resultado)
+  {
+    utcUs = monotonicoUs + desfase;
+  }
+  return resultado;
+}
+
+bool RelojUTC::ahoraUTC(int64_t &utcUs) const
+{
+  return aUTC(monotonicoUs(), idArranque, utcUs);
+}
+
+uint32_t RelojUTC::sincronizaciones(void) const
+{
+  portENTER_CRITICAL(&cerrojo);
+  uint32_t resultado = totalSincronizaciones;
+  portEXIT_CRITICAL(&cerrojo);
+  return resultado;
+}
+
+int32_t RelojUTC::ultimaCorreccionUs(void) const
+{
+  portENTER_CRITICAL(&cerrojo);
+  int32_t resultado = correccionUs;
+  portEXIT_CRITICAL(&cerrojo);
+  return resultado;
+}
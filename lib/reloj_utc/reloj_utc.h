@@ -0,0 +1,104 @@
+#ifndef RELOJ_UTC_H
+#define RELOJ_UTC_H
+
+#include <Arduino.h>
+
+/**
+ * @file reloj_utc.h
+ * @brief Hora UTC en microsegundos sobre el reloj monotonico, sincronizada por SNTP
+ *
+ * Las muestras se marcan con esp_timer_get_time(): microsegundos desde el
+ * arranque, monotonico y barato de leer desde cualquier tarea. La hora
+ * UTC es ese valor mas un desfase, que se fija en cada sincronizacion
+ * SNTP. Asi una marca tomada antes de la primera sincronizacion se puede
+ * convertir despues, siempre que sea del mismo arranque: cada arranque
+ * (incluido cada despertar del sueno profundo) tiene un identificador
+ * propio, que viaja con la marca.
+ *
+ * Tras un despertar o un reinicio por software la hora del sistema sigue
+ * valida (la mantiene el temporizador RTC) y el desfase se toma de ella
+ * sin esperar al SNTP.
+ *
+ * El desfase se escribe desde la tarea de lwIP (callback del SNTP) y se
+ * lee desde las demas: se protege con una seccion critica.
+ */
+
+#define EPOCA_MINIMA_VALIDA_S 1704067200L ///< 2024-01-01: una hora del sistema anterior no esta sincronizada
+
+class RelojUTC
+{
+public:
+  RelojUTC(void);
+
+  /**
+   * @brief Asigna el identificador de arranque y toma la hora del sistema si es valida
+   *
+   * Llamar al comienzo de setup(), antes de tomar muestras.
+   */
+  void iniciar(void);
+
+  /**
+   * @brief Arranca el cliente SNTP; llamar con la pila de red ya iniciada
+   * @param servidorPrincipal Servidor NTP
+   * @param servidorSecundario Servidor NTP de respaldo, o NULL
+   */
+  void sincronizar(const char *servidorPrincipal, const char *servidorSecundario);
+
+  /**
+   * @brief Microsegundos desde el arranque (esp_timer)
+   */
+  static int64_t monotonicoUs(void)
+  {
+    return esp_timer_get_time();
+  }
+
+  /**
+   * @brief Identificador de este arranque; distinto en cada reinicio o despertar
+   */
+  uint16_t arranque(void) const;
+
+  /**
+   * @brief Indica si hay desfase, del SNTP o de la hora que sobrevivio al reinicio
+   */
+  bool horaValida(void) const;
+
+  /**
+   * @brief Convierte una marca monotonica a UTC
+   * @param monotonicoUs Valor de monotonicoUs() al tomar la marca
+   * @param arranque Arranque en que se tomo la marca
+   * @param utcUs Microsegundos desde 1970-01-01 UTC
+   * @return false si aun no hay hora valida o la marca es de otro arranque
+   */
+  bool aUTC(int64_t monotonicoUs, uint16_t arranque, int64_t &utcUs) const;
+
+  /**
+   * @brief Hora UTC actual en microsegundos
+   * @return false si aun no hay hora valida
+   */
+  bool ahoraUTC(int64_t &utcUs) const;
+
+  /**
+   * @brief Sincronizaciones SNTP desde el arranque
+   */
+  uint32_t sincronizaciones(void) const;
+
+  /**
+   * @brief Cambio del desfase en la ultima sincronizacion (deriva corregida)
+   */
+  int32_t ultimaCorreccionUs(void) const;
+
+private:
+  static void alSincronizar(struct timeval *hora);
+  void fijarDesfase(int64_t utcUs, int64_t monotonicoUs);
+
+  mutable portMUX_TYPE cerrojo;
+  int64_t desfaseUs; ///< UTC menos monotonico
+  bool valido;
+  uint16_t idArranque;
+  uint32_t totalSincronizaciones;
+  int32_t correccionUs;
+};
+
+extern RelojUTC relojUTC;
+
+#endif
@@ -0,0 +1,337 @@
+#include "servidor_modbus.h"
+
+#include <string.h>
+
+#define LONGITUD_MBAP 7 ///< Cabecera MBAP: transaccion, protocolo, longitud y unidad
+
+// Codigos de funcion
+#define FUNCION_LEER_COILS 0x01
+#define FUNCION_LEER_HOLDING 0x03
+#define FUNCION_LEER_INPUT 0x04
+#define FUNCION_ESCRIBIR_COIL 0x05
+#define FUNCION_ESCRIBIR_REGISTRO 0x06
+#define FUNCION_ESCRIBIR_COILS 0x0F
+#define FUNCION_ESCRIBIR_REGISTROS 0x10
+
+// Codigos de excepcion
+#define EXCEPCION_FUNCION_ILEGAL 0x01
+#define EXCEPCION_DIRECCION_ILEGAL 0x02
+#define EXCEPCION_VALOR_ILEGAL 0x03
+
+// Limites por peticion de la especificacion Modbus
+#define MAX_COILS_LECTURA 2000
+#define MAX_REGISTROS_LECTURA 125
+#define MAX_COILS_ESCRITURA 1968
+#define MAX_REGISTROS_ESCRITURA 123
+
+static uint16_t leerBE16(const uint8_t *datos)
+{
+  return (uint16_t)((datos[0] << 8) | datos[1]);
+}
+
+static void escribirBE16(uint8_t *datos, uint16_t valor)
+{
+  datos[0] = (uint8_t)(valor >> 8);
+  datos[1] = (uint8_t)(valor & 0xFF);
+}
+
+/**
+ * @brief Arma una respuesta de excepcion
+ * @return Longitud de la PDU de excepcion
+ */
+static uint16_t excepcion(uint8_t funcion, uint8_t codigo, uint8_t *respuesta)
+{
+  respuesta[0] = funcion | 0x80;
+  respuesta[1] = codigo;
+  return 2;
+}
+
+ServidorModbus::ServidorModbus(TablaRegistros &tabla, uint16_t puerto)
+    : tabla(tabla), servidor(puerto, MAX_CLIENTES_MODBUS), peticiones(0), iniciado(false)
+{
+  for (uint8_t i = 0; i < MAX_CLIENTES_MODBUS; i++)
+  {
+    conexiones[i].recibidos = 0;
+    conexiones[i].ultimaActividadMs = 0;
+  }
+}
+
+void ServidorModbus::iniciar(void)
+{
+  if (!iniciado)
+  {
+    servidor.begin();
+    servidor.setNoDelay(true);
+    iniciado = true;
+  }
+}
+
+void ServidorModbus::atender(uint32_t ahoraMs)
+{
+  if (!iniciado)
+  {
+    return;
+  }
+
+  aceptarClientes(ahoraMs);
+  for (uint8_t i = 0; i < MAX_CLIENTES_MODBUS; i++)
+  {
+    atenderCliente(conexiones[i], ahoraMs);
+  }
+}
+
+/**
+ * @brief Asigna cada conexion entrante a una ranura libre
+ *
+ * Si no hay ranura libre se cierra la ranura inactiva hace mas tiempo, para
+ * que un SCADA caido no deje fuera a los demas.
+ */
+void ServidorModbus::aceptarClientes(uint32_t ahoraMs)
+{
+  for (;;)
+  {
+    WiFiClient nuevo = servidor.available();
+    if (!nuevo)
+    {
+      return;
+    }
+
+    uint8_t elegida = 0;
+    for (uint8_t i = 0; i < MAX_CLIENTES_MODBUS; i++)
+    {
+      if (!conexiones[i].cliente.connected())
+      {
+        elegida = i;
+        break;
+      }
+      if (ahoraMs - conexiones[i].ultimaActividadMs > ahoraMs - conexiones[elegida].ultimaActividadMs)
+      {
+        elegida = i;
+      }
+    }
+
+    ConexionModbus &conexion = conexiones[elegida];
+    conexion.cliente.stop();
+    conexion.cliente = nuevo;
+    conexion.cliente.setNoDelay(true);
+    conexion.recibidos = 0;
+    conexion.ultimaActividadMs = ahoraMs;
+  }
+}
+
+void ServidorModbus::atenderCliente(ConexionModbus &conexion, uint32_t ahoraMs)
+{
+  if (!conexion.cliente.connected())
+  {
+    return;
+  }
+
+  int disponibles = conexion.cliente.available();
+  if (disponibles <= 0)
+  {
+    if (ahoraMs - conexion.ultimaActividadMs > TIMEOUT_CLIENTE_MODBUS_MS)
+    {
+      conexion.cliente.stop();
+    }
+    return;
+  }
+
+  size_t espacio = sizeof(conexion.buffer) - conexion.recibidos;
+  int leidos = conexion.cliente.read(conexion.buffer + conexion.recibidos,
+                                     (size_t)disponibles < espacio ? (size_t)disponibles : espacio);
+  if (leidos <= 0)
+  {
+    return;
+  }
+  conexion.recibidos += (uint16_t)leidos;
+  conexion.ultimaActividadMs = ahoraMs;
+
+  // Responder todas las tramas completas del buffer
+  while (conexion.recibidos >= LONGITUD_MBAP)
+  {
+    uint16_t protocolo = leerBE16(conexion.buffer + 2);
+    uint16_t longitud = leerBE16(conexion.buffer + 4);
+    if (protocolo != 0 || longitud < 2 || longitud > TAMANO_ADU_MODBUS - 6)
+    {
+      // Trama invalida: no hay forma fiable de resincronizar el flujo
+      conexion.cliente.stop();
+      conexion.recibidos = 0;
+      return;
+    }
+
+    uint16_t total = 6 + longitud;
+    if (conexion.recibidos < total)
+    {
+      return;
+    }
+
+    uint16_t longitudPDU = procesarPDU(conexion.buffer + LONGITUD_MBAP, longitud - 1,
+                                       respuesta + LONGITUD_MBAP);
+    memcpy(respuesta, conexion.buffer, 4); // Transaccion y protocolo
+    escribirBE16(respuesta + 4, longitudPDU + 1);
+    respuesta[6] = conexion.buffer[6]; // Unidad
+    conexion.cliente.write(respuesta, LONGITUD_MBAP + longitudPDU);
+    peticiones++;
+
+    conexion.recibidos -= total;
+    memmove(conexion.buffer, conexion.buffer + total, conexion.recibidos);
+  }
+}
+
+/**
+ * @brief Ejecuta una PDU contra la tabla y arma la PDU de respuesta
+ * @return Longitud de la PDU de respuesta
+ */
+uint16_t ServidorModbus::procesarPDU(const uint8_t *peticion, uint16_t longitud, uint8_t *respuesta)
+{
+  uint8_t funcion = peticion[0];
+  if (longitud < 5)
+  {
+    return excepcion(funcion, longitud < 1 ? EXCEPCION_FUNCION_ILEGAL : EXCEPCION_VALOR_ILEGAL, respuesta);
+  }
+
+  uint16_t direccion = leerBE16(peticion + 1);
+  uint16_t cantidad = leerBE16(peticion + 3);
+  respuesta[0] = funcion;
+
+  switch (funcion)
+  {
+  case FUNCION_LEER_COILS:
+  {
+    if (cantidad == 0 || cantidad > MAX_COILS_LECTURA)
+    {
+      return excepcion(funcion, EXCEPCION_VALOR_ILEGAL, respuesta);
+    }
+    if (!TablaRegistros::enRango(direccion, cantidad, NUMERO_COILS))
+    {
+      return excepcion(funcion, EXCEPCION_DIRECCION_ILEGAL, respuesta);
+    }
+
+    uint8_t bytes = (uint8_t)((cantidad + 7) / 8);
+    respuesta[1] = bytes;
+    memset(respuesta + 2, 0, bytes);
+    for (uint16_t i = 0; i < cantidad; i++)
+    {
+      if (tabla.coil(direccion + i))
+      {
+        respuesta[2 + i / 8] |= (uint8_t)(1 << (i % 8));
+      }
+    }
+    return 2 + bytes;
+  }
+
+  case FUNCION_LEER_HOLDING:
+  case FUNCION_LEER_INPUT:
+  {
+    if (cantidad == 0 || cantidad > MAX_REGISTROS_LECTURA)
+    {
+      return excepcion(funcion, EXCEPCION_VALOR_ILEGAL, respuesta);
+    }
+
+    uint16_t registros[MAX_REGISTROS_LECTURA];
+    bool leidos = funcion == FUNCION_LEER_HOLDING ? tabla.leerHolding(direccion, cantidad, registros)
+                                                  : tabla.leerInput(direccion, cantidad, registros);
+    if (!leidos)
+    {
+      return excepcion(funcion, EXCEPCION_DIRECCION_ILEGAL, respuesta);
+    }
+
+    respuesta[1] = (uint8_t)(cantidad * 2);
+    for (uint16_t i = 0; i < cantidad; i++)
+    {
+      escribirBE16(respuesta + 2 + 2 * i, registros[i]);
+    }
+    return 2 + cantidad * 2;
+  }
+
+  case FUNCION_ESCRIBIR_COIL:
+  {
+    // Aqui "cantidad" es el valor: 0xFF00 enciende, 0x0000 apaga
+    if (cantidad != 0xFF00 && cantidad != 0x0000)
+    {
+      return excepcion(funcion, EXCEPCION_VALOR_ILEGAL, respuesta);
+    }
+    if (direccion >= NUMERO_COILS)
+    {
+      return excepcion(funcion, EXCEPCION_DIRECCION_ILEGAL, respuesta);
+    }
+
+    tabla.escribirCoil(direccion, cantidad == 0xFF00);
+    memcpy(respuesta, peticion, 5);
+    return 5;
+  }
+
+  case FUNCION_ESCRIBIR_REGISTRO:
+  {
+    // Aqui "cantidad" es el valor del registro
+    if (!tabla.escribirHolding(direccion, 1, &cantidad))
+    {
+      return excepcion(funcion, EXCEPCION_DIRECCION_ILEGAL, respuesta);
+    }
+    memcpy(respuesta, peticion, 5);
+    return 5;
+  }
+
+  case FUNCION_ESCRIBIR_COILS:
+  {
+    uint8_t bytes = longitud > 5 ? peticion[5] : 0;
+    if (cantidad == 0 || cantidad > MAX_COILS_ESCRITURA || bytes != (cantidad + 7) / 8 || longitud < 6 + bytes)
+    {
+      return excepcion(funcion, EXCEPCION_VALOR_ILEGAL, respuesta);
+    }
+    if (!TablaRegistros::enRango(direccion, cantidad, NUMERO_COILS))
+    {
+      return excepcion(funcion, EXCEPCION_DIRECCION_ILEGAL, respuesta);
+    }
+
+    for (uint16_t i = 0; i < cantidad; i++)
+    {
+      tabla.escribirCoil(direccion + i, (peticion[6 + i / 8] >> (i % 8)) & 1);
+    }
+    memcpy(respuesta, peticion, 5);
+    return 5;
+  }
+
+  case FUNCION_ESCRIBIR_REGISTROS:
+  {
+    uint8_t bytes = longitud > 5 ? peticion[5] : 0;
+    if (cantidad == 0 || cantidad > MAX_REGISTROS_ESCRITURA || bytes != cantidad * 2 || longitud < 6 + bytes)
+    {
+      return excepcion(funcion, EXCEPCION_VALOR_ILEGAL, respuesta);
+    }
+
+    uint16_t registros[MAX_REGISTROS_ESCRITURA];
+    for (uint16_t i = 0; i < cantidad; i++)
+    {
+      registros[i] = leerBE16(peticion + 6 + 2 * i);
+    }
+    if (!tabla.escribirHolding(direccion, cantidad, registros))
+    {
+      return excepcion(funcion, EXCEPCION_DIRECCION_ILEGAL, respuesta);
+    }
+    memcpy(respuesta, peticion, 5);
+    return 5;
+  }
+
+  default:
+    return excepcion(funcion, EXCEPCION_FUNCION_ILEGAL, respuesta);
+  }
+}
+
+uint8_t ServidorModbus::clientesConectados(void)
+{
+  uint8_t total = 0;
+  for (uint8_t i = 0; i < MAX_CLIENTES_MODBUS; i++)
+  {
+    if (conexiones[i].cliente.connected())
+    {
+      total++;
+    }
+  }
+  return total;
+}
+
+uint32_t ServidorModbus::peticionesAtendidas(void) const
+{
+  return peticiones;
+}
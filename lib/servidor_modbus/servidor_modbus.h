@@ -0,0 +1,67 @@
+#ifndef SERVIDOR_MODBUS_H
+#define SERVIDOR_MODBUS_H
+
+#include <WiFi.h>
+#include "tabla_registros.h"
+
+/**
+ * @file servidor_modbus.h
+ * @brief Esclavo Modbus TCP sobre una TablaRegistros
+ *
+ * Atiende hasta MAX_CLIENTES_MODBUS clientes a la vez sin bloquear: cada
+ * llamada a atender() acepta conexiones nuevas, lee lo disponible de cada
+ * cliente y responde las peticiones completas. Las respuestas salen de la
+ * tabla en memoria, asi que un sondeo nunca espera al broker ni al sensor.
+ *
+ * Funciones soportadas: 01 (leer bobinas), 03 (leer retencion), 04 (leer
+ * entradas), 05 (escribir bobina), 06 (escribir registro), 15 (escribir
+ * bobinas) y 16 (escribir registros). El identificador de unidad se ignora.
+ */
+
+#define PUERTO_MODBUS 502              ///< Puerto estandar de Modbus TCP
+#define MAX_CLIENTES_MODBUS 4          ///< Clientes SCADA simultaneos
+#define TAMANO_ADU_MODBUS 260          ///< Maximo de una trama Modbus TCP (MBAP + PDU)
+#define TIMEOUT_CLIENTE_MODBUS_MS 60000 ///< Inactividad tras la cual se cierra un cliente
+
+class ServidorModbus
+{
+public:
+  ServidorModbus(TablaRegistros &tabla, uint16_t puerto = PUERTO_MODBUS);
+
+  /// Abre el puerto; llamar con la red ya disponible
+  void iniciar(void);
+
+  /**
+   * @brief Acepta clientes y responde las peticiones completas; no bloquea
+   * @param ahoraMs Tiempo actual en milisegundos
+   */
+  void atender(uint32_t ahoraMs);
+
+  /// Clientes conectados en este momento
+  uint8_t clientesConectados(void);
+
+  /// Peticiones respondidas desde el inicio (incluidas las de excepcion)
+  uint32_t peticionesAtendidas(void) const;
+
+private:
+  struct ConexionModbus
+  {
+    WiFiClient cliente;
+    uint8_t buffer[TAMANO_ADU_MODBUS];
+    uint16_t recibidos;
+    uint32_t ultimaActividadMs;
+  };
+
+  void aceptarClientes(uint32_t ahoraMs);
+  void atenderCliente(ConexionModbus &conexion, uint32_t ahoraMs);
+  uint16_t procesarPDU(const uint8_t *peticion, uint16_t longitud, uint8_t *respuesta);
+
+  TablaRegistros &tabla;
+  WiFiServer servidor;
+  ConexionModbus conexiones[MAX_CLIENTES_MODBUS];
+  uint8_t respuesta[TAMANO_ADU_MODBUS];
+  uint32_t peticiones;
+  bool iniciado;
+};
+
+#endif
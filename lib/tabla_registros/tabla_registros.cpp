@@ -0,0 +1,48 @@
+#include "tabla_registros.h"
+
+#include <string.h>
+
+TablaRegistros::TablaRegistros(void)
+{
+  for (uint16_t i = 0; i < NUMERO_COILS; i++)
+  {
+    coils[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+bool TablaRegistros::coil(uint16_t direccion) const
+{
+  return direccion < NUMERO_COILS && coils[direccion].load(std::memory_order_acquire) != 0;
+}
+
+void TablaRegistros::escribirCoil(uint16_t direccion, bool valor)
+{
+  if (direccion < NUMERO_COILS)
+  {
+    coils[direccion].store(valor ? 1 : 0, std::memory_order_release);
+  }
+}
+
+bool TablaRegistros::leerHolding(uint16_t inicio, uint16_t cantidad, uint16_t *destino) const
+{
+  return holding.leer(inicio, cantidad, destino);
+}
+
+bool TablaRegistros::escribirHolding(uint16_t inicio, uint16_t cantidad, const uint16_t *origen)
+{
+  return holding.escribir(inicio, cantidad, origen);
+}
+
+bool TablaRegistros::leerInput(uint16_t inicio, uint16_t cantidad, uint16_t *destino) const
+{
+  return input.leer(inicio, cantidad, destino);
+}
+
+bool TablaRegistros::escribirInputFlotante(uint16_t direccion, float valor)
+{
+  uint32_t bits;
+  memcpy(&bits, &valor, sizeof(bits));
+
+  uint16_t palabras[2] = {(uint16_t)(bits >> 16), (uint16_t)(bits & 0xFFFF)};
+  return input.escribir(direccion, 2, palabras);
+}
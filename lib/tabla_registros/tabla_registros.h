@@ -0,0 +1,140 @@
+#ifndef TABLA_REGISTROS_H
+#define TABLA_REGISTROS_H
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @file tabla_registros.h
+ * @brief Mapa de registros en memoria compartido por MQTT y Modbus TCP
+ *
+ * Guarda bobinas (coils), registros de retencion (holding) y registros de
+ * entrada (input) con la numeracion de Modbus, empezando en 0. Las lecturas
+ * son O(1) y no bloquean a quien escribe:
+ *
+ * - Cada bobina es un atomico independiente; puede escribirla cualquier tarea.
+ * - Los registros de entrada y de retencion se protegen con un contador de
+ *   secuencia (seqlock), de modo que un bloque leido nunca mezcla dos
+ *   escrituras (por ejemplo las dos mitades de un float). Cada area admite
+ *   un solo escritor: la adquisicion escribe las entradas y el servidor
+ *   Modbus la retencion.
+ */
+
+#ifndef NUMERO_COILS
+#define NUMERO_COILS 16 ///< Bobinas disponibles
+#endif
+#ifndef NUMERO_REGISTROS_HOLDING
+#define NUMERO_REGISTROS_HOLDING 32 ///< Registros de retencion disponibles
+#endif
+#ifndef NUMERO_REGISTROS_INPUT
+#define NUMERO_REGISTROS_INPUT 64 ///< Registros de entrada disponibles
+#endif
+
+class TablaRegistros
+{
+public:
+  TablaRegistros(void);
+
+  /// Indica si [inicio, inicio + cantidad) cabe en un area de tamano total
+  static bool enRango(uint16_t inicio, uint16_t cantidad, uint16_t total)
+  {
+    return cantidad > 0 && (uint32_t)inicio + cantidad <= total;
+  }
+
+  bool coil(uint16_t direccion) const;
+  void escribirCoil(uint16_t direccion, bool valor);
+
+  /**
+   * @brief Copia un bloque de registros de retencion, coherente entre si
+   * @return false si el bloque se sale del area
+   */
+  bool leerHolding(uint16_t inicio, uint16_t cantidad, uint16_t *destino) const;
+
+  /**
+   * @brief Escribe un bloque de registros de retencion (un solo escritor)
+   * @return false si el bloque se sale del area
+   */
+  bool escribirHolding(uint16_t inicio, uint16_t cantidad, const uint16_t *origen);
+
+  /**
+   * @brief Copia un bloque de registros de entrada, coherente entre si
+   * @return false si el bloque se sale del area
+   */
+  bool leerInput(uint16_t inicio, uint16_t cantidad, uint16_t *destino) const;
+
+  /**
+   * @brief Escribe un float en dos registros de entrada, palabra alta primero
+   *
+   * Es el orden "ABCD" que esperan la mayoria de clientes SCADA.
+   *
+   * @return false si los dos registros no caben en el area
+   */
+  bool escribirInputFlotante(uint16_t direccion, float valor);
+
+private:
+  /**
+   * @brief Bloque de registros protegido por contador de secuencia
+   */
+  template <uint16_t N>
+  struct AreaRegistros
+  {
+    std::atomic<uint32_t> secuencia;
+    std::atomic<uint16_t> registros[N];
+
+    AreaRegistros(void) : secuencia(0)
+    {
+      for (uint16_t i = 0; i < N; i++)
+      {
+        registros[i].store(0, std::memory_order_relaxed);
+      }
+    }
+
+    bool leer(uint16_t inicio, uint16_t cantidad, uint16_t *destino) const
+    {
+      if (!enRango(inicio, cantidad, N))
+      {
+        return false;
+      }
+
+      uint32_t antes;
+      uint32_t despues;
+      do
+      {
+        antes = secuencia.load(std::memory_order_acquire);
+        for (uint16_t i = 0; i < cantidad; i++)
+        {
+          destino[i] = registros[inicio + i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        despues = secuencia.load(std::memory_order_relaxed);
+      } while ((antes & 1) != 0 || antes != despues);
+
+      return true;
+    }
+
+    bool escribir(uint16_t inicio, uint16_t cantidad, const uint16_t *origen)
+    {
+      if (!enRango(inicio, cantidad, N))
+      {
+        return false;
+      }
+
+      uint32_t actual = secuencia.load(std::memory_order_relaxed);
+      secuencia.store(actual + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (uint16_t i = 0; i < cantidad; i++)
+      {
+        registros[inicio + i].store(origen[i], std::memory_order_relaxed);
+      }
+      secuencia.store(actual + 2, std::memory_order_release);
+
+      return true;
+    }
+  };
+
+  std::atomic<uint8_t> coils[NUMERO_COILS];
+  AreaRegistros<NUMERO_REGISTROS_HOLDING> holding;
+  AreaRegistros<NUMERO_REGISTROS_INPUT> input;
+};
+
+#endif
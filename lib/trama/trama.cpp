@@ -0,0 +1,285 @@
+#include "trama.h"
+
+#include <math.h>
+#include <string.h>
+#include "formato_fijo.h"
+
+
+/**
+ * @brief Escritor acotado sobre un buffer fijo
+ *
+ * Cualquier escritura que no quepa marca el escritor como desbordado y las
+ * siguientes se ignoran; el resultado se valida una sola vez al final.
+ *
+ * Con una salida el buffer es solo un bloque: al llenarse se entrega a la
+ * salida y se reutiliza, y un fallo de la salida cuenta como desborde. Sin
+ * buffer (destino NULL) solo se cuentan los bytes.
+ */
+struct Escritor
+{
+  uint8_t *destino;
+  size_t capacidad;
+  size_t longitud; ///< Bytes en el buffer
+  size_t total;    ///< Bytes escritos desde el inicio
+  bool desbordado;
+  SalidaTrama salida;
+  void *contexto;
+
+  void bytes(const void *datos, size_t n)
+  {
+    if (desbordado)
+    {
+      return;
+    }
+    total += n;
+    if (destino == NULL)
+    {
+      return;
+    }
+
+    const uint8_t *origen = (const uint8_t *)datos;
+    while (longitud + n > capacidad)
+    {
+      if (salida == NULL)
+      {
+        desbordado = true;
+        return;
+      }
+      size_t parte = capacidad - longitud;
+      memcpy(destino + longitud, origen, parte);
+      longitud = capacidad;
+      origen += parte;
+      n -= parte;
+      if (!vaciar())
+      {
+        return;
+      }
+    }
+    memcpy(destino + longitud, origen, n);
+    longitud += n;
+  }
+
+  /// Entrega el bloque a la salida
+  bool vaciar(void)
+  {
+    if (longitud > 0 && !desbordado && !salida(contexto, destino, longitud))
+    {
+      desbordado = true;
+    }
+    longitud = 0;
+    return !desbordado;
+  }
+
+  void byte(uint8_t b)
+  {
+    bytes(&b, 1);
+  }
+
+  void texto(const char *cadena)
+  {
+    bytes(cadena, strlen(cadena));
+  }
+
+  /// Valor con dos decimales; null si no es representable (NaN, infinito)
+  void centesimas(float valor)
+  {
+    char digitos[MAX_CARACTERES_CENTESIMAS];
+    size_t n = formatearCentesimas(digitos, sizeof(digitos), valor);
+    if (n == 0)
+    {
+      texto("null");
+      return;
+    }
+    bytes(digitos, n);
+  }
+
+  void entero(uint64_t valor)
+  {
+    char digitos[MAX_CARACTERES_ENTERO64];
+    bytes(digitos, formatearEntero64(digitos, sizeof(digitos), valor));
+  }
+
+  /// Cabecera CBOR: tipo mayor en los 3 bits altos y argumento minimo
+  void cabeceraCBOR(uint8_t tipoMayor, uint64_t argumento)
+  {
+    uint8_t tipo = (uint8_t)(tipoMayor << 5);
+    if (argumento < 24)
+    {
+      byte(tipo | (uint8_t)argumento);
+    }
+    else if (argumento <= 0xFF)
+    {
+      byte(tipo | 24);
+      byte((uint8_t)argumento);
+    }
+    else if (argumento <= 0xFFFF)
+    {
+      byte(tipo | 25);
+      byte((uint8_t)(argumento >> 8));
+      byte((uint8_t)argumento);
+    }
+    else if (argumento <= 0xFFFFFFFF)
+    {
+      byte(tipo | 26);
+      byte((uint8_t)(argumento >> 24));
+      byte((uint8_t)(argumento >> 16));
+      byte((uint8_t)(argumento >> 8));
+      byte((uint8_t)argumento);
+    }
+    else
+    {
+      byte(tipo | 27);
+      for (int8_t desplazamiento = 56; desplazamiento >= 0; desplazamiento -= 8)
+      {
+        byte((uint8_t)(argumento >> desplazamiento));
+      }
+    }
+  }
+
+  /// Entero sin signo en decimal (JSON) o CBOR; null si no hay valor
+  void marca(FormatoTrama formato, bool presente, uint64_t valor)
+  {
+    if (formato == TRAMA_CBOR)
+    {
+      if (presente)
+      {
+        cabeceraCBOR(0, valor);
+      }
+      else
+      {
+        byte(0xF6); // null
+      }
+    }
+    else if (presente)
+    {
+      entero(valor);
+    }
+    else
+    {
+      texto("null");
+    }
+  }
+
+  void textoCBOR(const char *cadena)
+  {
+    size_t n = strlen(cadena);
+    cabeceraCBOR(3, (uint32_t)n);
+    bytes(cadena, n);
+  }
+
+  void flotanteCBOR(float valor)
+  {
+    uint32_t bits;
+    memcpy(&bits, &valor, sizeof(bits));
+    byte(0xFA);
+    byte((uint8_t)(bits >> 24));
+    byte((uint8_t)(bits >> 16));
+    byte((uint8_t)(bits >> 8));
+    byte((uint8_t)bits);
+  }
+};
+
+static bool marcaUTC(const Muestra &muestra)
+{
+  return (muestra.banderas & MUESTRA_UTC) != 0;
+}
+
+/**
+ * @brief Marca UTC mas antigua del lote
+ * @return false si ninguna muestra tiene hora UTC
+ */
+static bool marcaReferencia(const Muestra *muestras, uint16_t cantidad, int64_t &referencia)
+{
+  bool hay = false;
+  for (uint16_t i = 0; i < cantidad; i++)
+  {
+    if (marcaUTC(muestras[i]) && (!hay || muestras[i].marcaTiempoUs < referencia))
+    {
+      referencia = muestras[i].marcaTiempoUs;
+      hay = true;
+    }
+  }
+  return hay;
+}
+
+static void codificarJSON(Escritor &escritor, uint32_t secuencia, bool hayReferencia, int64_t referencia,
+                          const Muestra *muestras, uint16_t cantidad)
+{
+  escritor.texto("{\"s\":");
+  escritor.entero(secuencia);
+  escritor.texto(",\"t\":");
+  escritor.marca(TRAMA_JSON, hayReferencia, (uint64_t)referencia);
+  escritor.texto(",\"m\":[");
+
+  for (uint16_t i = 0; i < cantidad; i++)
+  {
+    escritor.texto(i == 0 ? "[" : ",[");
+    escritor.entero(muestras[i].canal);
+    escritor.byte(',');
+    escritor.marca(TRAMA_JSON, marcaUTC(muestras[i]), (uint64_t)(muestras[i].marcaTiempoUs - referencia));
+    escritor.byte(',');
+    escritor.centesimas(muestras[i].valor);
+    escritor.byte(']');
+  }
+
+  escritor.texto("]}");
+}
+
+static void codificarCBOR(Escritor &escritor, uint32_t secuencia, bool hayReferencia, int64_t referencia,
+                          const Muestra *muestras, uint16_t cantidad)
+{
+  escritor.cabeceraCBOR(5, 3); // Mapa de 3 pares
+  escritor.textoCBOR("s");
+  escritor.cabeceraCBOR(0, secuencia);
+  escritor.textoCBOR("t");
+  escritor.marca(TRAMA_CBOR, hayReferencia, (uint64_t)referencia);
+  escritor.textoCBOR("m");
+  escritor.cabeceraCBOR(4, cantidad);
+
+  for (uint16_t i = 0; i < cantidad; i++)
+  {
+    escritor.cabeceraCBOR(4, 3);
+    escritor.cabeceraCBOR(0, muestras[i].canal);
+    escritor.marca(TRAMA_CBOR, marcaUTC(muestras[i]), (uint64_t)(muestras[i].marcaTiempoUs - referencia));
+    escritor.flotanteCBOR(muestras[i].valor);
+  }
+}
+
+static void codificar(Escritor &escritor, FormatoTrama formato, uint32_t secuencia, const Muestra *muestras,
+                      uint16_t cantidad)
+{
+  int64_t referencia = 0;
+  bool hayReferencia = marcaReferencia(muestras, cantidad, referencia);
+
+  if (formato == TRAMA_CBOR)
+  {
+    codificarCBOR(escritor, secuencia, hayReferencia, referencia, muestras, cantidad);
+  }
+  else
+  {
+    codificarJSON(escritor, secuencia, hayReferencia, referencia, muestras, cantidad);
+  }
+}
+
+size_t codificarTrama(FormatoTrama formato, uint8_t *destino, size_t capacidad, uint32_t secuencia,
+                      const Muestra *muestras, uint8_t cantidad)
+{
+  Escritor escritor = {destino, capacidad, 0, 0, false, NULL, NULL};
+  codificar(escritor, formato, secuencia, muestras, cantidad);
+  return escritor.desbordado ? 0 : escritor.longitud;
+}
+
+size_t medirTrama(FormatoTrama formato, uint32_t secuencia, const Muestra *muestras, uint16_t cantidad)
+{
+  Escritor escritor = {NULL, 0, 0, 0, false, NULL, NULL};
+  codificar(escritor, formato, secuencia, muestras, cantidad);
+  return escritor.total;
+}
+
+bool emitirTrama(FormatoTrama formato, uint8_t *bloque, size_t tamanoBloque, SalidaTrama salida, void *contexto,
+                 uint32_t secuencia, const Muestra *muestras, uint16_t cantidad)
+{
+  Escritor escritor = {bloque, tamanoBloque, 0, 0, false, salida, contexto};
+  codificar(escritor, formato, secuencia, muestras, cantidad);
+  return escritor.vaciar();
+}
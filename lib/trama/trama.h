@@ -0,0 +1,92 @@
+#ifndef TRAMA_H
+#define TRAMA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "muestra.h"
+
+/**
+ * @file trama.h
+ * @brief Tramas de telemetria por lotes en JSON compacto o CBOR
+ *
+ * Una trama agrupa todas las muestras de un ciclo en una sola
+ * publicacion. Ambos formatos llevan el mismo contenido:
+ *
+ * - "s": numero de secuencia de la trama
+ * - "t": instante de referencia de la trama, en us desde 1970-01-01 UTC
+ * - "m": lista de muestras [canal, dt, valor], donde dt es el
+ *   desplazamiento en us del instante de adquisicion de la muestra
+ *   respecto de "t"
+ *
+ * JSON: {"s":12,"t":1718035200123456,"m":[[0,0,23.45],[1,200125,21.10]]}
+ *
+ * CBOR (RFC 8949): mapa de 3 claves de texto con el mismo significado; "m"
+ * es un arreglo de arreglos [uint, uint, float32]. Los valores NaN se
+ * codifican como null en JSON y como NaN en CBOR. En JSON los valores van
+ * con dos decimales, formateados con aritmetica entera (formato_fijo.h).
+ *
+ * Solo las muestras con MUESTRA_UTC tienen una hora que el receptor pueda
+ * usar; las demas llevan dt null. Si ninguna la tiene, "t" es null.
+ *
+ * Las funciones escriben en un buffer provisto por quien llama y no
+ * reservan memoria. Una trama mas grande que cualquier buffer disponible
+ * se emite por bloques: medirTrama() da su longitud (la cabecera MQTT la
+ * necesita antes de la carga) y emitirTrama() la codifica de nuevo,
+ * entregando un bloque a la vez.
+ */
+
+/**
+ * @brief Formato de codificacion de una trama
+ */
+enum FormatoTrama : uint8_t
+{
+  TRAMA_JSON = 0,
+  TRAMA_CBOR
+};
+
+/**
+ * @brief Codifica un lote de muestras en una trama
+ *
+ * La marca de referencia es la de la muestra UTC mas antigua, de modo
+ * que todos los dt son no negativos.
+ *
+ * @param formato Formato de salida
+ * @param destino Buffer de salida
+ * @param capacidad Tamano del buffer en bytes
+ * @param secuencia Numero de secuencia de la trama
+ * @param muestras Muestras a incluir
+ * @param cantidad Numero de muestras
+ * @return Bytes escritos, 0 si la trama no cabe en el buffer
+ */
+size_t codificarTrama(FormatoTrama formato, uint8_t *destino, size_t capacidad, uint32_t secuencia,
+                      const Muestra *muestras, uint8_t cantidad);
+
+/**
+ * @brief Destino de los bloques de emitirTrama()
+ * @param contexto Puntero de quien llama a emitirTrama()
+ * @param datos Bloque de la trama
+ * @param longitud Bytes del bloque
+ * @return false para abortar la emision
+ */
+typedef bool (*SalidaTrama)(void *contexto, const uint8_t *datos, size_t longitud);
+
+/**
+ * @brief Longitud exacta de una trama, sin codificarla en memoria
+ */
+size_t medirTrama(FormatoTrama formato, uint32_t secuencia, const Muestra *muestras, uint16_t cantidad);
+
+/**
+ * @brief Codifica una trama y la entrega por bloques de hasta tamanoBloque bytes
+ *
+ * Emite exactamente medirTrama() bytes con los mismos argumentos.
+ *
+ * @param bloque Buffer de trabajo
+ * @param tamanoBloque Tamano del buffer de trabajo
+ * @param salida Destino de cada bloque
+ * @param contexto Se pasa sin cambios a la salida
+ * @return true si la salida acepto todos los bloques
+ */
+bool emitirTrama(FormatoTrama formato, uint8_t *bloque, size_t tamanoBloque, SalidaTrama salida, void *contexto,
+                 uint32_t secuencia, const Muestra *muestras, uint16_t cantidad);
+
+#endif
@@ -7,26 +7,56 @@
  *
  * @description
  * Este codigo implementa un sistema de monitoreo remoto utilizando un ESP32 que:
- * - Se conecta a WiFi y MQTT de forma segura
+ * - Se conecta a WiFi y MQTT de forma segura, reanudando la sesion TLS
+ *   en las reconexiones
  * - Lee sensores de temperatura, humedad y distancia
  * - Publica datos en tiempo real a traves de MQTT
  * - Implementa protocolos Modbus y HTTP para comunicacion
  *
  * @note Para compilar este codigo, es necesario generar el bundle de certificados
- *       usando el script generate_cert_bundle.py que crea el archivo _binary_data_cert_bundle_start
+ *       data/cert/bundle con el script bundleUp.py; se enlaza como _binary_data_cert_bundle_start
  *
- * @see generate_cert_bundle.py
+ * @see data/cert/bundleUp.py
  * @see secrets.h
  */
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WiFiClientSecure.h>
 #include <PubSubClient.h>
 #include "secrets.h"
-#include <DHT.h>
 #include <OneWire.h>
 #include <DallasTemperature.h>
+#include "planificador.h"
+#include "cola_spsc.h"
+#include "muestra.h"
+#include "eco_ultrasonico.h"
+#include "dht_rmt.h"
+#include "filtros.h"
+#include "canal_sensor.h"
+#include "banda_muerta.h"
+#include "trama.h"
+#include "formato_fijo.h"
+#include "cliente_tls.h"
+#include "cliente_qos1.h"
+#include "backoff.h"
+#include "registro_flash.h"
+#include "enrutador_comandos.h"
+#include "tabla_registros.h"
+#include "servidor_modbus.h"
+#include "histograma_latencia.h"
+#include "bitacora.h"
+#include "reloj_utc.h"
+#include "monitor_memoria.h"
+#include "actualizacion_ota.h"
+#include "configuracion_remota.h"
+#include "estadistica_ventana.h"
+#include "motor_reglas.h"
+#include "esp_sleep.h"
+#include "esp_netif.h"
+#include "esp_netif_net_stack.h"
+#include "lwip/dhcp.h"
+#include <type_traits>
+#include <time.h>
 
 /* ============================================================================
  * CONFIGURACION DE PINES Y CONSTANTES
@@ -41,14 +71,195 @@
 #define PIN_LED_INDICADOR 2        ///< Pin del LED indicador de estado
 
 // Configuracion de sensores
-#define TIPO_DHT DHT21           ///< Tipo de sensor DHT (DHT21, DHT22, DHT11)
-#define NUMERO_MUESTRAS 10       ///< Numero de muestras para promediar lecturas
-#define DELAY_ENTRE_MUESTRAS 50  ///< Delay entre muestras en milisegundos
-#define DELAY_ENTRE_SENSORES 200 ///< Delay entre lecturas de diferentes sensores
+#define TIPO_DHT MODELO_DHT21    ///< Tipo de sensor DHT (MODELO_DHT21, MODELO_DHT22, MODELO_DHT11)
+#define NUMERO_MUESTRAS 10       ///< Numero de muestras para promediar lecturas (por defecto; ver configuracion remota)
+#define DELAY_ENTRE_MUESTRAS 50  ///< Periodo entre muestras de un mismo sensor en milisegundos (por defecto)
+#define DELAY_ENTRE_SENSORES 200 ///< Desfase entre las tareas de diferentes sensores en milisegundos (por defecto)
+#define TIMEOUT_ECO_US 25000     ///< Espera maxima del eco: ida y vuelta a 4 m (alcance del HC-SR04)
+#define LECTURAS_DHT_POR_ENTREGA 2 ///< Lecturas DHT nuevas (una cada 2 s) por entrega
+
+// Configuracion de actuadores
+#define TOPICO_COIL_LED "EIE_SEDE1_modbus/1/coil/0" ///< Topico de control del LED indicador
+#define TIEMPO_LED_APAGADO_MS 5000                 ///< Tiempo minimo apagado tras un comando "false"
+#define PERIODO_ACTUADORES_MS 10                   ///< Espera maxima entre revisiones de las bobinas
+#define COIL_LED 0                                 ///< Bobina de la tabla de registros que controla el LED
+
+// Configuracion de sensores DS18B20
+#ifndef MODO_DS18B20_ASINCRONO
+#define MODO_DS18B20_ASINCRONO 1 ///< 1: conversion sin bloqueo, 0: requestTemperatures() bloqueante
+#endif
+#define RESOLUCION_DS18B20_DEFECTO 12 ///< Resolucion (9-12 bits) si un sensor no tiene una asignada
+#define MAX_SENSORES_ONEWIRE 16       ///< Maximo de DS18B20 en el bus PIN_ONE_WIRE_TEMP
+
+// Configuracion de filtros
+#ifndef PUBLICAR_CADA_MUESTRA
+#define PUBLICAR_CADA_MUESTRA 0 ///< 1: entregar el valor filtrado en cada muestra, 0: cada NUMERO_MUESTRAS
+#endif
+#define K_ATIPICOS 3.0f                   ///< Desviaciones a partir de las cuales una muestra es atipica
+#define DESVIACION_MINIMA_TEMPERATURA 0.3f ///< Piso de desviacion para temperaturas en C
+#define ALFA_EWMA_HUMEDAD 0.2f            ///< Peso de cada muestra nueva de humedad
+static_assert(NUMERO_MUESTRAS >= 1 && NUMERO_MUESTRAS <= VENTANA_FILTRO_CANAL,
+              "NUMERO_MUESTRAS no cabe en la ventana de los filtros (VENTANA_FILTRO_CANAL)");
+
+/// Lecturas por entrega de un grupo: nunca sola en sueno profundo, siempre con PUBLICAR_CADA_MUESTRA
+#define LECTURAS_POR_ENTREGA(n) (MODO_SUENO_PROFUNDO ? 0 : PUBLICAR_CADA_MUESTRA ? 1 : (n))
 
 // Configuracion de comunicacion
-#define KEEP_ALIVE_MQTT 1500   ///< Keep alive del cliente MQTT en segundos
-#define TIEMPO_RECONEXION 5000 ///< Tiempo de espera para reconexion MQTT
+#define KEEP_ALIVE_MQTT 1500   ///< Keep alive del cliente MQTT en segundos (por defecto)
+#define PREFIJO_ID_CLIENTE "ESP32-" ///< Prefijo del ID de cliente MQTT; le sigue la MAC del eFuse
+#define LONGITUD_ID_CLIENTE 20      ///< Prefijo, 12 digitos hexadecimales y el terminador
+#ifndef QOS_DATOS
+#define QOS_DATOS 1 ///< 1: datos con QoS 1 y ventana de mensajes en vuelo (ClienteQoS1), 0: QoS 0
+#endif
+#define TIEMPO_RECONEXION 1000          ///< Espera base entre reintentos de conexion (se duplica en cada fallo)
+#define TIEMPO_RECONEXION_MAXIMO 60000  ///< Tope de la espera entre reintentos de conexion
+#define TIMEOUT_ASOCIACION_WIFI 15000   ///< Tiempo maximo para asociarse a la red WiFi
+#define TIMEOUT_TLS_MS 10000   ///< Tiempo maximo de conexion TCP + handshake TLS
+#define LONGITUD_TOPICO_CANAL 48  ///< Topico de canal o de servicio mas largo, con el terminador
+#ifndef SERVIDOR_NTP_PRINCIPAL
+#define SERVIDOR_NTP_PRINCIPAL "pool.ntp.org" ///< Servidor SNTP de la hora UTC de las muestras
+#endif
+#ifndef SERVIDOR_NTP_SECUNDARIO
+#define SERVIDOR_NTP_SECUNDARIO "time.google.com" ///< Servidor SNTP de respaldo
+#endif
+
+// Reconexion rapida con los datos de la ultima asociacion
+#ifndef REUSAR_CONCESION_DHCP
+#define REUSAR_CONCESION_DHCP 0 ///< 1: configurar como IP estatica la ultima concesion DHCP mientras siga vigente
+#endif
+#define TIMEOUT_ASOCIACION_DIRIGIDA 3000 ///< Espera de la asociacion dirigida antes de volver al escaneo
+#define TTL_IP_BROKER_S 3600             ///< Vigencia de la IP resuelta del broker (lwIP no expone el TTL)
+#define INTENTOS_MQTT_CON_CACHE 3        ///< Fallos MQTT tras una reconexion rapida antes de volver a DHCP
+
+// Reanudacion de sesion TLS
+#ifndef REANUDACION_TLS_RTC
+#define REANUDACION_TLS_RTC 1     ///< 1: conservar la sesion TLS en memoria RTC (sobrevive al sueno profundo)
+#endif
+#define TAMANO_SESION_TLS_RTC 2048 ///< Espacio en memoria RTC para la sesion serializada
+
+// Configuracion de tareas FreeRTOS
+#define NUCLEO_RED 0                ///< Nucleo de la tarea de red (junto a la pila WiFi)
+#define NUCLEO_ADQUISICION 1        ///< Nucleo de la tarea de adquisicion de sensores
+#define PILA_TAREA_RED 8192         ///< Pila de la tarea de red en bytes (TLS)
+#define PILA_TAREA_ADQUISICION 4096 ///< Pila de la tarea de adquisicion en bytes
+#define PRIORIDAD_TAREA_RED 1       ///< Prioridad de la tarea de red
+#define PRIORIDAD_TAREA_ADQUISICION 2 ///< Prioridad de la tarea de adquisicion
+#define CAPACIDAD_COLA_MUESTRAS 256 ///< Muestras en transito o en espera de conexion (potencia de dos)
+#define PILA_TAREA_MODBUS 4096      ///< Pila de la tarea del servidor Modbus en bytes
+#define PERIODO_MODBUS_MS 5         ///< Periodo de atencion de los clientes Modbus
+#define PILA_TAREA_BITACORA 2048    ///< Pila de la tarea que vacia la bitacora en bytes
+#define PRIORIDAD_TAREA_BITACORA 0  ///< Prioridad de la tarea de bitacora (la del idle)
+#define PERIODO_BITACORA_MS 20      ///< Periodo de vaciado de la bitacora al UART
+#define SUFIJO_TOPICO_BITACORA "bitacora" ///< Topico del reenvio de la bitacora (NIVEL_LOG_MQTT)
+#define LINEAS_BITACORA_POR_CICLO 4 ///< Lineas de bitacora reenviadas por vuelta de la tarea de red
+
+// Diagnostico
+#define VELOCIDAD_SERIAL 921600 ///< Baudios del puerto serie de depuracion
+#ifndef INTERVALO_DIAGNOSTICO_MS
+#define INTERVALO_DIAGNOSTICO_MS 60000UL ///< Periodo de publicacion del diagnostico (0: no publicar)
+#endif
+#define SUFIJO_TOPICO_DIAGNOSTICO "diagnostico" ///< Topico de latencias, memoria y reconexiones
+#define TAMANO_DIAGNOSTICO 896                           ///< Buffer del JSON de diagnostico en bytes
+
+// Modo de bajo consumo por ciclos de sueno profundo
+#ifndef MODO_SUENO_PROFUNDO
+#define MODO_SUENO_PROFUNDO 0 ///< 1: despertar, muestrear, publicar una trama y dormir; 0: operacion continua
+#endif
+#ifndef PERIODO_SUENO_S
+#define PERIODO_SUENO_S 300 ///< Periodo entre despertares en segundos
+#endif
+#define VENTANA_MUESTREO_SUENO_MS 1000               ///< Muestreo por despertar (cubre una conversion DS18B20 de 12 bits)
+#define TIMEOUT_CONEXION_SUENO_MS 20000              ///< Maximo despierto esperando WiFi y MQTT
+#define TIMEOUT_CONFIRMACIONES_SUENO_MS 2000         ///< Maximo esperando los PUBACK antes de dormir
+#define REENVIOS_POR_DESPERTAR 2                     ///< Rafagas del registro offline por despertar
+#define SUFIJO_TOPICO_CICLO_SUENO "ciclo"             ///< Topico del reporte de tiempo despierto
+#define MAGIA_ESTADO_SUENO (0x53554500UL ^ sizeof(EstadoSuenoRTC)) ///< Cambia si cambia la estructura
+
+// Servidor Modbus TCP
+#ifndef MODO_MODBUS_TCP
+#define MODO_MODBUS_TCP 1 ///< 1: servir la tabla de registros por Modbus TCP (puerto 502)
+#endif
+
+// Configuracion de reporte por cambio
+#ifndef MODO_BANDA_MUERTA
+#define MODO_BANDA_MUERTA 1 ///< 1: publicar solo cambios y latidos, 0: publicar cada muestra
+#endif
+#define LATIDO_MS 60000UL   ///< Silencio maximo de un topico antes de republicar su valor
+
+// Agregacion en el equipo: estadisticas por ventana de tiempo en lugar de cada valor
+#ifndef MODO_AGREGACION
+#define MODO_AGREGACION 1 ///< 1: publicar n/min/max/media/desviacion por ventana y cada valor solo a pedido
+#endif
+#define AGREGACION_ACTIVA (MODO_AGREGACION && !MODO_SUENO_PROFUNDO) ///< Las ventanas necesitan el equipo despierto
+#define SUFIJO_PUBLICACION_CRUDA "/crudo" ///< Tras PREFIJO_TOPICO_CONTROL e ID: "true" publica ademas cada valor; "false" ya no
+#define GRACIA_CIERRE_VENTANA_MS 1000 ///< Espera tras el fin de una ventana por muestras aun en la cola
+#define LONGITUD_SUFIJO_VENTANA 8     ///< Sufijo de ventana mas largo, con la barra y el terminador
+#define CAPACIDAD_RESUMENES 64        ///< Ventanas cerradas en espera de publicacion (potencia de dos)
+
+// Reglas de alarma evaluadas en el equipo con cada lectura (las carga la configuracion remota)
+#define SUFIJO_TOPICO_ALARMA "alarma" ///< Topico de los cambios de estado de las reglas
+#define CAPACIDAD_COLA_ALARMAS 16     ///< Alarmas en espera de publicacion (potencia de dos)
+
+// Configuracion de publicacion por lotes
+#define PUBLICACION_INDIVIDUAL 0 ///< Un publish por muestra, en el topico de su canal
+#define PUBLICACION_LOTE_JSON 1  ///< Una trama JSON por ciclo en el topico de tramas
+#define PUBLICACION_LOTE_CBOR 2  ///< Una trama CBOR por ciclo en el topico de tramas
+#ifndef MODO_PUBLICACION
+#define MODO_PUBLICACION PUBLICACION_INDIVIDUAL
+#endif
+#ifndef MARCA_TIEMPO_INDIVIDUAL
+#define MARCA_TIEMPO_INDIVIDUAL 0 ///< 1: publicacion individual como {"v":valor,"t":us UTC}; 0: solo el valor
+#endif
+#define SUFIJO_TOPICO_TRAMA "lote"                                 ///< Topico de las tramas por lotes
+#define MAX_MUESTRAS_TRAMA 32                                      ///< Muestras maximas por trama
+#define TAMANO_TRAMA 768                                           ///< Buffer de codificacion de tramas en bytes
+#define TAMANO_BUFFER_MQTT 1024                                    ///< Buffer de paquetes de PubSubClient al arrancar
+#define TAMANO_BUFFER_MQTT_MINIMO 256                              ///< Menor buffer aceptado por topicoBufferMQTT
+#define TAMANO_BUFFER_MQTT_MAXIMO 8192                             ///< Mayor buffer aceptado por topicoBufferMQTT
+#define PREFIJO_TOPICO_CONTROL "EIE_SEDE1_http/config/"            ///< Le siguen el ID de cliente MQTT y el sufijo
+#define SUFIJO_BUFFER_MQTT "/bufferMQTT"                           ///< Cambia el buffer de PubSubClient en marcha
+#define TAMANO_BLOQUE_TRAMA 256                                    ///< Bloque de las tramas enviadas por flujo
+
+// Configuracion del almacen offline en flash
+#ifndef MODO_ALMACEN_OFFLINE
+#define MODO_ALMACEN_OFFLINE 1 ///< 1: guardar en LittleFS lo que no se pudo publicar, 0: descartarlo
+#endif
+#define DIRECTORIO_REGISTRO "/offline"            ///< Directorio del registro en LittleFS
+#define SEGMENTOS_REGISTRO 8                      ///< Archivos de segmento del anillo
+#define PAGINAS_POR_SEGMENTO 8                    ///< Paginas de 4 KB por segmento (256 KB en total)
+#define INTERVALO_SINCRONIZACION_MS 30000UL       ///< Maximo tiempo de una pagina parcial en RAM
+#define INTERVALO_REENVIO_MS 250                  ///< Separacion minima entre rafagas de reenvio
+#define MAX_MUESTRAS_REENVIO 128                  ///< Muestras por trama de reenvio (se envia por flujo)
+#define SUFIJO_TOPICO_REENVIO "historico"         ///< Topico de las tramas reenviadas desde flash
+#define DIRECTORIO_RESUMENES "/resumenes"         ///< Directorio del registro de ventanas cerradas sin conexion
+#define SEGMENTOS_RESUMENES 4                     ///< Archivos de segmento del registro de ventanas
+#define PAGINAS_POR_SEGMENTO_RESUMENES 8          ///< Paginas de 4 KB por segmento (128 KB en total)
+#define MAX_RESUMENES_REENVIO 8                   ///< Ventanas por rafaga de reenvio, una por publish
+#define RESUMENES_OFFLINE (MODO_ALMACEN_OFFLINE && AGREGACION_ACTIVA) ///< Ventanas a flash sin conexion
+
+// Actualizacion del firmware por MQTT
+#ifndef MODO_OTA
+#define MODO_OTA 1 ///< 1: aceptar firmware por MQTT y validar cada firmware nuevo antes de confirmarlo
+#endif
+#define OTA_POR_MQTT (MODO_OTA && !MODO_SUENO_PROFUNDO) ///< La transferencia necesita el equipo despierto
+#define PREFIJO_TOPICO_OTA "EIE_SEDE1_http/ota/" ///< Le siguen el ID de cliente MQTT y el sufijo de cada topico
+#define SUFIJO_OTA_INICIO "/inicio" ///< "<bytes> <sha256 hex>" inicia o reanuda; "cancelar" aborta
+#define SUFIJO_OTA_BLOQUE "/bloque" ///< Desplazamiento (4 bytes, big endian) seguido de los datos
+#define SUFIJO_OTA_ESTADO "/estado" ///< Estado de la actualizacion y pedido del siguiente bloque
+#define LONGITUD_TOPICO_OTA (sizeof(PREFIJO_TOPICO_OTA) + LONGITUD_ID_CLIENTE + sizeof(SUFIJO_OTA_INICIO))
+#define SOBRECOSTO_BLOQUE_OTA (8 + LONGITUD_TOPICO_OTA + 4) ///< Cabecera, topico y desplazamiento de un bloque
+#define PILA_TAREA_OTA 4096                ///< Pila de la tarea que escribe la imagen en bytes
+#define PRIORIDAD_TAREA_OTA 0              ///< Prioridad de la tarea de escritura (la del idle)
+#define PERIODO_OTA_MS 10                  ///< Espera de la tarea de escritura sin bloques pendientes
+#define REPETICION_PEDIDO_OTA_MS 5000      ///< Espera de un bloque pedido antes de volver a pedirlo
+#define ESPERA_REINICIO_OTA_MS 2000        ///< Entre anunciar la imagen lista y reiniciar con ella
+#define TIEMPO_VALIDACION_OTA_MS 300000UL  ///< Plazo de un firmware nuevo para conectar a MQTT antes de revertir
+
+// Configuracion remota: topico retenido por equipo, guardada en NVS
+#define PREFIJO_TOPICO_CONFIGURACION "EIE_config/" ///< Le sigue el ID de cliente MQTT
+#define PERIODO_MUESTREO_MINIMO_MS 10              ///< Menor periodo de sondeo aceptado
+#define DESFASE_SENSORES_MAXIMO_MS 10000           ///< Mayor desfase entre grupos de sensores aceptado
+#define KEEP_ALIVE_MINIMO_S 10                     ///< Menor keep alive MQTT aceptado
 
 /* ============================================================================
  * DECLARACION DE VARIABLES GLOBALES
@@ -58,418 +269,3545 @@
  * @brief Bundle de certificados CA para conexion segura
  *
  * @important CONFIGURACION DEL BUNDLE DE CERTIFICADOS:
- * Este archivo se genera automaticamente usando el script generate_cert_bundle.py
- * ubicado en la carpeta scripts/ del proyecto. El script:
+ * data/cert/bundle se genera con data/cert/bundleUp.py y se incluye en el
+ * build con COMPONENT_EMBED_TXTFILES. Va en formato indexado (--indexed):
+ * el emisor del certificado del broker se busca por hash del sujeto con
+ * una busqueda binaria (ver bundle_ca.h).
  *
- * 1. Lee certificados desde la carpeta ssl_certs/
- * 2. Los combina en un bundle
- * 3. Genera el archivo _binary_data_cert_bundle_start
- * 4. Este archivo se incluye automaticamente en el build
+ * Para regenerarlo con solo las CA de la cadena del broker:
+ * python3 data/cert/bundleUp.py -i cacrt_all.pem -s "CN=ISRG Root X1" --indexed
+ * o, sin volver a leer los certificados:
+ * python3 data/cert/bundleUp.py -r data/cert/bundle -s "ISRG Root X1" --indexed
  *
- * Para regenerar el bundle:
- * python3 scripts/generate_cert_bundle.py
- *
- * @see scripts/generate_cert_bundle.py
- * @see ssl_certs/
+ * @see data/cert/bundleUp.py
  */
 extern const uint8_t rootca_crt_bundle_start[] asm("_binary_data_cert_bundle_start");
 
 // Instancias de sensores
 OneWire oneWire(PIN_ONE_WIRE_TEMP);
 DallasTemperature sensoresTemperatura(&oneWire);
-DHT sensorDHT1(PIN_DHT_SENSOR_1, TIPO_DHT);
-DHT sensorDHT2(PIN_DHT_SENSOR_2, TIPO_DHT);
+LectorDHTRMT lectorDHT; ///< Ambos DHT, leidos en paralelo por RMT (canales 0 y 1)
+EcoUltrasonico ecoUltrasonico(PIN_TRIGGER_ULTRASONICO, PIN_ECHO_ULTRASONICO, TIMEOUT_ECO_US);
 
 // Clientes de red
-WiFiClientSecure clienteWiFiSeguro;
-PubSubClient clienteMQTT(clienteWiFiSeguro);
+ClienteTLS clienteTLS;
+ClienteQoS1 clienteQoS1(clienteTLS); ///< Publica los datos con QoS 1; PubSubClient va por encima
+PubSubClient clienteMQTT(clienteQoS1);
+char idClienteMQTT[LONGITUD_ID_CLIENTE]; ///< Unico por chip, lo arma configurarMQTT()
+
+// Manejadores de los topicos de control; solo lo usa la tarea de red
+EnrutadorComandos enrutadorComandos;
+
+/**
+ * @brief Registros compartidos por MQTT y Modbus TCP
+ *
+ * - Bobinas: actuadores (COIL_LED); las escriben los comandos MQTT y los
+ *   clientes Modbus, y actualizarActuadores() las aplica desde la tarea de
+ *   adquisicion.
+ * - Entradas: ultimo valor filtrado de cada canal en REGISTRO_INPUT_CANAL();
+ *   las escribe la tarea de adquisicion.
+ * - Retencion: de uso libre para los clientes Modbus.
+ */
+TablaRegistros tablaRegistros;
+ServidorModbus servidorModbus(tablaRegistros);
+
+/**
+ * @brief Grupos de canales de sensor, uno por controlador (ver GRUPOS_SENSORES)
+ */
+enum GrupoSensor : uint8_t
+{
+  GRUPO_DISTANCIA = 0,
+  GRUPO_DHT,
+  GRUPO_ONEWIRE,
+  NUMERO_GRUPOS
+};
+
+/**
+ * @brief Latencias por etapa y contadores del intervalo de diagnostico
+ *
+ * Los histogramas de lectura los llena la tarea de adquisicion y el resto
+ * la tarea de red, que es la que los resume y reinicia al publicar.
+ */
+struct Diagnostico
+{
+  HistogramaLatencia lecturas[NUMERO_GRUPOS]; ///< Cada ejecucion de la tarea de un grupo
+  HistogramaLatencia publicacion;      ///< Cada publish() de datos
+  HistogramaLatencia handshakeTLS;     ///< Cada conexion TLS lograda
+  HistogramaLatencia bucleMQTT;        ///< Cada clienteMQTT.loop()
+  uint32_t publicacionesFallidas;      ///< publish() que devolvieron false, por intervalo
+  uint32_t reconexionesWiFi;           ///< Asociaciones WiFi desde el arranque
+  uint32_t reconexionesMQTT;           ///< Sesiones MQTT desde el arranque
+  uint32_t ultimaPublicacionMs;        ///< Inicio del intervalo en curso
+};
+
+Diagnostico diagnostico = {};
+char bufferDiagnostico[TAMANO_DIAGNOSTICO]; ///< Salida del JSON de diagnostico
+
+/**
+ * @brief Rutas calientes vigiladas por monitorMemoria con MODO_CONTEO_RESERVAS
+ *
+ * En regimen ninguna deberia reservar memoria; el diagnostico informa las
+ * reservas de cada una por intervalo.
+ */
+enum ZonaCaliente : uint8_t
+{
+  ZONA_ADQUISICION = 0, ///< Cada vuelta del planificador de sensores
+  ZONA_RED,             ///< Vuelta de la tarea de red con MQTT conectado
+  ZONA_CALLBACK,        ///< callbackMQTT() y sus manejadores
+  ZONA_PUBLICACION,     ///< Funciones de publicacion de datos
+  ZONA_REENVIO,         ///< Lectura del registro offline para reenviarlo
+  NUMERO_ZONAS
+};
+
+/// Nombre de cada zona en el diagnostico, indexado por ZonaCaliente
+const char *const NOMBRES_ZONAS[NUMERO_ZONAS] = {"adquisicion", "red", "callback", "publicacion", "reenvio"};
+
+/**
+ * @brief Estado del LED indicador; solo lo usa la tarea de adquisicion
+ *
+ * Tras apagarse el LED queda apagado al menos TIEMPO_LED_APAGADO_MS; si la
+ * bobina vuelve a encenderse en ese lapso se aplica al vencer, en lugar de
+ * bloquear la tarea esperando.
+ */
+struct EstadoLED
+{
+  bool encendido;        ///< Salida actual del pin
+  bool bloqueado;        ///< Dentro del lapso de apagado minimo
+  uint32_t desbloqueoMs; ///< Fin del lapso de apagado minimo
+};
+
+EstadoLED estadoLED = {};
+
+/**
+ * @brief Salidas que pueden manejar las reglas de alarma
+ */
+enum SalidaRegla : uint8_t
+{
+  SALIDA_LED = 0, ///< PIN_LED_INDICADOR, compartido con la bobina COIL_LED
+  NUMERO_SALIDAS
+};
+
+/// Pin de cada salida, indexado por SalidaRegla
+const uint8_t PINES_SALIDAS[NUMERO_SALIDAS] = {PIN_LED_INDICADOR};
+
+static_assert(NUMERO_SALIDAS <= MAX_SALIDAS_REGLAS, "El motor de reglas no tiene bits para todas las salidas");
+
+/**
+ * @brief Estados de la maquina de conexion WiFi/MQTT de la tarea de red
+ */
+enum EstadoConexion : uint8_t
+{
+  CONEXION_WIFI_INICIO = 0, ///< Iniciar la asociacion a la red WiFi
+  CONEXION_WIFI_ESPERANDO,  ///< Asociacion en curso
+  CONEXION_MQTT_PENDIENTE,  ///< WiFi listo, esperando el proximo intento MQTT
+  CONEXION_MQTT_CONECTADA   ///< Sesion MQTT activa
+};
+
+/**
+ * @brief Estado de la conexion; solo lo usa la tarea de red
+ */
+struct Conexion
+{
+  EstadoConexion estado;
+  uint32_t inicioEstadoMs;   ///< Entrada al estado actual
+  uint32_t proximoIntentoMs; ///< Instante a partir del cual se puede reintentar
+};
+
+Conexion conexion = {CONEXION_WIFI_INICIO, 0, 0};
+
+/**
+ * @brief Datos de la ultima asociacion, en memoria RTC
+ *
+ * Permiten asociarse sin escanear (BSSID y canal conocidos), sin esperar
+ * al DHCP (REUSAR_CONCESION_DHCP) y sin consultar el DNS del broker. Se
+ * conservan durante el sueno profundo; un arranque en frio los borra.
+ *
+ * La concesion solo se reusa hasta la mitad de su duracion (T1, cuando el
+ * propio cliente DHCP la renovaria): pasado ese punto el servidor podria
+ * habersela dado a otro equipo.
+ */
+struct CacheRed
+{
+  uint32_t magia;        ///< MAGIA_CACHE_RED si el punto de acceso es valido
+  uint8_t bssid[6];      ///< Punto de acceso de la ultima asociacion
+  uint8_t canal;         ///< Canal del punto de acceso
+  uint32_t ip;           ///< Concesion DHCP obtenida
+  uint32_t concesionVenceS; ///< time() a partir del cual no se reusa ip, 0 si no se conoce
+  uint32_t puertaEnlace;
+  uint32_t mascara;
+  uint32_t dns;
+  uint32_t ipBroker;     ///< IP resuelta del broker, 0 si no hay
+  uint32_t brokerVenceS; ///< time() a partir del cual se vuelve a resolver
+};
+
+#define MAGIA_CACHE_RED 0x52454432UL ///< "RED2"
+RTC_DATA_ATTR CacheRed cacheRed;
+bool asociacionDirigida = false; ///< El intento en curso usa cacheRed
+bool concesionReusada = false;   ///< El intento en curso usa cacheRed.ip como IP estatica
+Backoff backoffWiFi(TIEMPO_RECONEXION, TIEMPO_RECONEXION_MAXIMO);
+Backoff backoffMQTT(TIEMPO_RECONEXION, TIEMPO_RECONEXION_MAXIMO);
+
+#if REANUDACION_TLS_RTC
+/**
+ * @brief Sesion TLS serializada en memoria RTC
+ *
+ * Se conserva durante el sueno profundo para reanudar la sesion al
+ * despertar. Contiene el secreto maestro de la sesion.
+ */
+RTC_DATA_ATTR uint8_t sesionTLSRTC[TAMANO_SESION_TLS_RTC];
+RTC_DATA_ATTR uint16_t longitudSesionTLSRTC = 0;
+#endif
+
+// Planificador cooperativo de las tareas de sensores
+Planificador planificador;
+
+/**
+ * @brief Canales de sensor que la tarea de adquisicion entrega a la de red
+ */
+enum CanalSensor : uint8_t
+{
+  CANAL_DISTANCIA = 0,
+  CANAL_TEMPERATURA_SEDE1,
+  CANAL_HUMEDAD_SEDE1,
+  CANAL_TEMPERATURA_SEDE2,
+  CANAL_HUMEDAD_SEDE2,
+  CANAL_ONEWIRE_BASE, ///< Primer DS18B20; el sensor N usa CANAL_ONEWIRE_BASE + N
+  NUMERO_CANALES = CANAL_ONEWIRE_BASE + MAX_SENSORES_ONEWIRE
+};
+
+/// Primer registro de entrada de un canal: cada canal ocupa dos (float, palabra alta primero)
+#define REGISTRO_INPUT_CANAL(canal) (2 * (canal))
+static_assert(REGISTRO_INPUT_CANAL(NUMERO_CANALES) <= NUMERO_REGISTROS_INPUT,
+              "La tabla de registros no tiene entradas para todos los canales");
+
+/**
+ * @brief Prefijos de topico compartidos por los canales
+ */
+enum PrefijoTopico : uint8_t
+{
+  PREFIJO_SEDE1_HTTP = 0,
+  PREFIJO_SEDE2_HTTP,
+  PREFIJO_SEDE1_HOLDING,
+  NUMERO_PREFIJOS
+};
+
+static_assert(NUMERO_PREFIJOS <= MAX_PREFIJOS_CONFIGURACION,
+              "La configuracion remota no tiene lugar para todos los prefijos");
+
+/// Texto por defecto de cada prefijo, indexado por PrefijoTopico; la configuracion remota lo puede cambiar
+const char *const PREFIJOS_TOPICO[NUMERO_PREFIJOS] = {
+    "EIE_SEDE1_http/",
+    "EIE_SEDE2_http/",
+    "EIE_SEDE1_modbus/1/holding/",
+};
+
+/**
+ * @brief Registro de canales: topico, filtro y reporte, indexado por CanalSensor
+ *
+ * La ultima entrada vale para todos los DS18B20; su topico termina en el
+ * indice del sensor en el bus.
+ */
+constexpr DescriptorCanal REGISTRO_CANALES[CANAL_ONEWIRE_BASE + 1] = {
+    {PREFIJO_SEDE1_HTTP, "numeric", FILTRO_MEDIANA, 0.0f, 0.0f, {1.0f, LATIDO_MS}},                                 // Distancia (cm)
+    {PREFIJO_SEDE1_HTTP, "temp", FILTRO_MEDIA_ROBUSTA, K_ATIPICOS, DESVIACION_MINIMA_TEMPERATURA, {0.2f, LATIDO_MS}}, // Temperatura sede 1 (C)
+    {PREFIJO_SEDE1_HTTP, "humidity", FILTRO_EWMA, ALFA_EWMA_HUMEDAD, 0.0f, {1.0f, LATIDO_MS}},                      // Humedad sede 1 (%)
+    {PREFIJO_SEDE2_HTTP, "temp", FILTRO_MEDIA_ROBUSTA, K_ATIPICOS, DESVIACION_MINIMA_TEMPERATURA, {0.2f, LATIDO_MS}}, // Temperatura sede 2 (C)
+    {PREFIJO_SEDE2_HTTP, "humidity", FILTRO_EWMA, ALFA_EWMA_HUMEDAD, 0.0f, {1.0f, LATIDO_MS}},                      // Humedad sede 2 (%)
+    {PREFIJO_SEDE1_HOLDING, NULL, FILTRO_MEDIA_ROBUSTA, K_ATIPICOS, DESVIACION_MINIMA_TEMPERATURA,
+     {0.1f, LATIDO_MS}}, // DS18B20 N (C)
+};
+
+/**
+ * @brief Registro de grupos: canales, periodo y ciclo de entrega de cada sensor, indexado por GrupoSensor
+ *
+ * El DHT entrega temperatura y humedad de cada sede, en el orden de
+ * CanalSensor; sus lecturas llegan cada INTERVALO_MINIMO_DHT_MS.
+ */
+constexpr DescriptorGrupo GRUPOS_SENSORES[NUMERO_GRUPOS] = {
+    {"distancia", CANAL_DISTANCIA, 1, DELAY_ENTRE_MUESTRAS, LECTURAS_POR_ENTREGA(NUMERO_MUESTRAS)},
+    {"dht", CANAL_TEMPERATURA_SEDE1, 4, DELAY_ENTRE_MUESTRAS, LECTURAS_POR_ENTREGA(LECTURAS_DHT_POR_ENTREGA)},
+    {"onewire", CANAL_ONEWIRE_BASE, MAX_SENSORES_ONEWIRE, DELAY_ENTRE_MUESTRAS, LECTURAS_POR_ENTREGA(NUMERO_MUESTRAS)},
+};
+
+/**
+ * @brief Comprueba en compilacion que los grupos cubren los canales en orden y sin huecos
+ */
+constexpr bool gruposContiguos(uint8_t grupo, uint8_t siguienteCanal)
+{
+  return grupo == NUMERO_GRUPOS
+             ? siguienteCanal == NUMERO_CANALES
+             : GRUPOS_SENSORES[grupo].primerCanal == siguienteCanal &&
+                   gruposContiguos(grupo + 1, siguienteCanal + GRUPOS_SENSORES[grupo].canales);
+}
+static_assert(gruposContiguos(0, 0), "GRUPOS_SENSORES debe cubrir todos los canales en orden");
+
+/**
+ * @brief Ventana de agregacion: se publica en el topico del canal mas "/" y el sufijo
+ */
+struct DescriptorVentana
+{
+  const char *sufijo;  ///< Menos de LONGITUD_SUFIJO_VENTANA - 1 caracteres
+  uint32_t duracionMs; ///< Las ventanas se alinean a multiplos de su duracion
+};
+
+/// Ventanas de agregacion de cada canal, independientes entre si
+constexpr DescriptorVentana VENTANAS_AGREGACION[] = {
+    {"10s", 10000UL},
+    {"1m", 60000UL},
+    {"15m", 900000UL},
+};
+#define NUMERO_VENTANAS (sizeof(VENTANAS_AGREGACION) / sizeof(VENTANAS_AGREGACION[0]))
+
+/**
+ * @brief Topico completo de cada canal, armado por armarTopicos() con los prefijos de la configuracion
+ *
+ * Publicar no concatena ni formatea topicos: solo toma el puntero de aqui.
+ * Tras el arranque solo lo usa la tarea de red.
+ */
+char topicosCanales[NUMERO_CANALES][LONGITUD_TOPICO_CANAL];
+
+/**
+ * @brief Topicos que publica el equipo fuera de los canales, tras el prefijo PREFIJO_SEDE1_HTTP
+ *
+ * Los arma armarTopicos(), como los de los canales; solo los usa la tarea de red.
+ */
+struct TopicosServicio
+{
+  char trama[LONGITUD_TOPICO_CANAL];       ///< SUFIJO_TOPICO_TRAMA
+  char reenvio[LONGITUD_TOPICO_CANAL];     ///< SUFIJO_TOPICO_REENVIO
+  char diagnostico[LONGITUD_TOPICO_CANAL]; ///< SUFIJO_TOPICO_DIAGNOSTICO
+  char bitacora[LONGITUD_TOPICO_CANAL];    ///< SUFIJO_TOPICO_BITACORA
+  char cicloSueno[LONGITUD_TOPICO_CANAL];  ///< SUFIJO_TOPICO_CICLO_SUENO
+  char alarma[LONGITUD_TOPICO_CANAL];      ///< SUFIJO_TOPICO_ALARMA
+};
+
+TopicosServicio topicosServicio;
+
+/**
+ * @brief Configuracion en uso: la de compilacion, la guardada en NVS o la ultima recibida
+ *
+ * Tras el arranque solo la usa la tarea de red; la tarea de adquisicion
+ * recibe la parte de muestreo por colaConfiguracion.
+ */
+ConfiguracionDispositivo configuracion;
+ConfiguracionDispositivo configuracionPedida; ///< Recibida en el callback, la aplica aplicarConfiguracion()
+bool configuracionPendiente = false;          ///< configuracionPedida aun no aplicada
+ColaSPSC<ConfiguracionDispositivo, 2> colaConfiguracion; ///< De la tarea de red a la de adquisicion
+char topicoConfiguracion[sizeof(PREFIJO_TOPICO_CONFIGURACION) + LONGITUD_ID_CLIENTE]; ///< Propio de este equipo
+
+// Topico del buffer de PubSubClient propio de este equipo, PREFIJO_TOPICO_CONTROL + ID + sufijo
+char topicoBufferMQTT[sizeof(PREFIJO_TOPICO_CONTROL) + LONGITUD_ID_CLIENTE + sizeof(SUFIJO_BUFFER_MQTT)];
+
+#if AGREGACION_ACTIVA
+// Topico de la publicacion cruda propio de este equipo, PREFIJO_TOPICO_CONTROL + ID + sufijo
+char topicoPublicacionCruda[sizeof(PREFIJO_TOPICO_CONTROL) + LONGITUD_ID_CLIENTE + sizeof(SUFIJO_PUBLICACION_CRUDA)];
+#endif
+
+// Topicos de la actualizacion propios de este equipo, PREFIJO_TOPICO_OTA + ID + sufijo; los arma configurarComandos()
+char topicoOTAInicio[LONGITUD_TOPICO_OTA];
+char topicoOTABloque[LONGITUD_TOPICO_OTA];
+char topicoOTAEstado[LONGITUD_TOPICO_OTA];
+int tareasGrupos[NUMERO_GRUPOS]; ///< Indice en el planificador de la tarea de cada grupo
+
+// Valor en texto de la publicacion en curso, con MARCA_TIEMPO_INDIVIDUAL en {"v":...,"t":...}; solo lo usa la tarea de red
+char cargaPublicacion[MAX_CARACTERES_CENTESIMAS + MAX_CARACTERES_ENTERO64 + sizeof("{\"v\":,\"t\":}")];
+
+// Ultimo valor publicado por canal; solo lo usa la tarea de red
+ReportePorCambio reportesCanales[NUMERO_CANALES];
+
+#if AGREGACION_ACTIVA
+// Ventana en curso de cada canal y duracion, y buffers de su publicacion; solo los usa la tarea de red
+VentanaEstadistica ventanasCanales[NUMERO_CANALES][NUMERO_VENTANAS];
+char topicoResumen[LONGITUD_TOPICO_CANAL + LONGITUD_SUFIJO_VENTANA];
+char cargaResumen[4 * MAX_CARACTERES_CENTESIMAS + 2 * MAX_CARACTERES_ENTERO64 +
+                  sizeof("{\"n\":,\"min\":,\"max\":,\"media\":,\"desv\":,\"t\":}")];
+
+/**
+ * @brief Ventana cerrada en espera de publicacion
+ */
+struct ResumenPendiente
+{
+  ResumenVentana resumen;
+  uint8_t canal;   ///< CanalSensor
+  uint8_t ventana; ///< Indice en VENTANAS_AGREGACION
+};
+
+// Ventanas cerradas sin publicar, y la que se esta reintentando; solo las usa la tarea de red
+ColaSPSC<ResumenPendiente, CAPACIDAD_RESUMENES> colaResumenes;
+ResumenPendiente resumenPendiente;
+bool hayResumenPendiente = false;
+bool resumenReintentando = false; ///< El aviso del fallo ya se dio
+uint32_t resumenesDescartados = 0; ///< Ventanas perdidas por cola llena
+
+static_assert(CAPACIDAD_RESUMENES >= NUMERO_CANALES * NUMERO_VENTANAS,
+              "La cola de resumenes debe admitir el cierre simultaneo de todas las ventanas");
+#endif
+bool publicacionCruda = !AGREGACION_ACTIVA; ///< Publicar cada valor; con agregacion, solo a pedido
+
+/**
+ * @brief Trama por lotes en construccion; solo la usa la tarea de red
+ *
+ * Las muestras se guardan tal cual y se codifican al publicar, para poder
+ * registrar en la banda muerta solo las que realmente salieron.
+ */
+struct TramaPendiente
+{
+  Muestra muestras[MAX_MUESTRAS_TRAMA]; ///< Muestras acumuladas del ciclo
+  uint8_t cantidad;                     ///< Muestras en la trama
+  uint32_t inicioMs;                    ///< Llegada de la primera muestra
+  uint32_t secuencia;                   ///< Secuencia de la proxima trama
+};
+
+TramaPendiente tramaPendiente = {};
+uint8_t bufferTrama[TAMANO_TRAMA];        ///< Salida del codificador de tramas
+uint8_t bloqueTrama[TAMANO_BLOQUE_TRAMA]; ///< Bloque de trabajo de las tramas enviadas por flujo
+
+/// Buffer de PubSubClient pedido por topicoBufferMQTT, 0 si no hay cambio pendiente
+uint16_t tamanoBufferMQTTPedido = 0;
+
+// Muestras en transito de la tarea de adquisicion a la tarea de red
+ColaSPSC<Muestra, CAPACIDAD_COLA_MUESTRAS> colaMuestras;
+
+/**
+ * @brief Cambio de estado de una regla, de la tarea de adquisicion a la de red
+ */
+struct EventoAlarma
+{
+  int64_t marcaTiempoUs; ///< Instante de la lectura que lo provoco (RelojUTC::monotonicoUs())
+  float valor;           ///< Valor o ritmo de cambio comparado con el umbral
+  uint8_t regla;         ///< Indice en la configuracion
+  uint8_t canal;         ///< Canal de la regla
+  bool activa;           ///< Estado nuevo de la regla
+  uint16_t arranque;     ///< Arranque en que se tomo la marca
+};
+
+// Cambios de estado de las reglas: se publican antes que cualquier muestra
+ColaSPSC<EventoAlarma, CAPACIDAD_COLA_ALARMAS> colaAlarmas;
+volatile uint32_t alarmasDescartadas = 0; ///< Alarmas perdidas por cola llena
+
+// Reglas en uso; solo las usa la tarea de adquisicion
+MotorReglas motorReglas;
+uint32_t salidasReglas = 0; ///< Bit por SalidaRegla activa, ya aplicado a los pines
+
+// Alarma que no se pudo publicar, para reintentarla; y su carga. Solo las usa la tarea de red
+EventoAlarma alarmaPendiente;
+bool hayAlarmaPendiente = false;
+bool alarmaReintentando = false; ///< El aviso del fallo ya se dio
+char cargaAlarma[MAX_CARACTERES_CENTESIMAS + MAX_CARACTERES_ENTERO64 + 2 * 3 +
+                 sizeof("{\"regla\":,\"canal\":,\"activa\":false,\"v\":,\"t\":}")];
+volatile uint32_t muestrasDescartadas = 0; ///< Muestras perdidas por cola llena
+
+#if MODO_ALMACEN_OFFLINE
+/**
+ * @brief Registro en flash de las muestras no publicadas; solo lo usa la tarea de red
+ *
+ * Se llena mientras no hay conexion o cuando un publish falla, y se vacia
+ * en rafagas por el topico de reenvio tras reconectar.
+ */
+RegistroFlash registroOffline(DIRECTORIO_REGISTRO, sizeof(Muestra), SEGMENTOS_REGISTRO, PAGINAS_POR_SEGMENTO);
+bool registroOfflineListo = false;           ///< LittleFS montado y punteros recuperados
+uint32_t ultimaSincronizacionMs = 0;         ///< Ultima escritura forzada de la pagina en RAM
+uint32_t ultimoReenvioMs = 0;                ///< Ultima rafaga de reenvio
+uint32_t secuenciaReenvio = 0;                 ///< Secuencia de la proxima trama de reenvio
+Muestra muestrasReenvio[MAX_MUESTRAS_REENVIO]; ///< Muestras leidas de flash para la rafaga en curso
+
+/**
+ * @brief Rafaga de reenvio enviada con QoS 1 que espera su PUBACK
+ *
+ * Las muestras siguen en el registro hasta el PUBACK: si la conexion cae
+ * antes, la misma rafaga se vuelve a leer y enviar.
+ */
+struct ReenvioEnVuelo
+{
+  uint16_t identificador; ///< Identificador QoS 1 de la trama, 0 si no hay ninguna
+  uint16_t cantidad;      ///< Muestras de la trama, a confirmar en el registro
+};
+
+ReenvioEnVuelo reenvioEnVuelo = {};
+
+#if RESUMENES_OFFLINE
+/**
+ * @brief Registro en flash de las ventanas cerradas sin conexion; solo lo usa la tarea de red
+ *
+ * Con agregacion y sin publicacion cruda lo que se conserva de un corte
+ * son las ventanas, no las muestras: se vuelven a publicar en sus topicos
+ * de ventana, con su "t" original, tras reconectar.
+ */
+RegistroFlash registroResumenes(DIRECTORIO_RESUMENES, sizeof(ResumenPendiente), SEGMENTOS_RESUMENES,
+                                PAGINAS_POR_SEGMENTO_RESUMENES);
+bool registroResumenesListo = false;                 ///< Punteros recuperados
+uint32_t ultimoReenvioResumenesMs = 0;               ///< Ultima rafaga de reenvio de ventanas
+ResumenPendiente resumenesReenvio[MAX_RESUMENES_REENVIO]; ///< Ventanas leidas de flash para la rafaga en curso
+#endif
+#endif
+
+// Filtro de cada canal, construido desde REGISTRO_CANALES en inicializarCanales()
+CanalFiltrado canales[NUMERO_CANALES];
+
+/**
+ * @brief Estado que sobrevive al sueno profundo (modo MODO_SUENO_PROFUNDO)
+ *
+ * Los filtros se copian tal cual (son trivialmente copiables), de modo que
+ * cada despertar sigue la ventana y la estimacion del anterior en lugar de
+ * arrancar en frio. La sesion TLS va aparte, en sesionTLSRTC.
+ */
+struct EstadoSuenoRTC
+{
+  uint32_t magia;                ///< MAGIA_ESTADO_SUENO si el contenido es valido
+  uint32_t ciclos;               ///< Despertares desde el ultimo arranque en frio
+  uint32_t secuenciaTrama;       ///< Secuencia de la proxima trama por lotes
+  uint32_t secuenciaReenvio;     ///< Secuencia de la proxima trama de reenvio
+  uint32_t despiertoAnteriorMs;  ///< Tiempo despierto medido en el ciclo anterior
+  uint8_t sensoresOneWire;       ///< Sensores enumerados cuando se guardaron los filtros
+  CanalFiltrado canales[NUMERO_CANALES];
+};
+
+#if MODO_SUENO_PROFUNDO
+static_assert(std::is_trivially_copyable<EstadoSuenoRTC>::value,
+              "EstadoSuenoRTC debe poder copiarse byte a byte a memoria RTC");
+RTC_DATA_ATTR uint8_t estadoSuenoRTC[sizeof(EstadoSuenoRTC)] __attribute__((aligned(4)));
+#endif
+
+// Direcciones ROM de los DS18B20, enumeradas una sola vez en setup()
+DeviceAddress direccionesOneWire[MAX_SENSORES_ONEWIRE];
+uint8_t numeroSensoresOneWire = 0;
+
+/**
+ * @brief Resolucion en bits de cada DS18B20, por indice en el bus
+ *
+ * Menos bits reducen el tiempo de conversion (9 bits: ~94 ms, 12 bits:
+ * ~750 ms) a cambio de precision (0.5 C frente a 0.0625 C).
+ */
+const uint8_t RESOLUCION_SENSORES_ONEWIRE[] = {12};
+#define NUMERO_RESOLUCIONES_ONEWIRE (sizeof(RESOLUCION_SENSORES_ONEWIRE) / sizeof(RESOLUCION_SENSORES_ONEWIRE[0]))
+
+/**
+ * @brief Estado de la conversion asincrona del bus OneWire
+ */
+struct EstadoConversionOneWire
+{
+  bool enCurso;              ///< Hay una conversion iniciada sin leer
+  uint32_t inicioMs;         ///< Instante en que se inicio la conversion
+  uint32_t duracionMs;       ///< Tiempo maximo de conversion a la resolucion configurada
+  bool alimentacionParasita; ///< En modo parasito el bus no informa fin de conversion
+};
+
+EstadoConversionOneWire conversionOneWire = {false, 0, 0, false};
+
+#if MODO_OTA
+/**
+ * @brief Ultimo mensaje en topicoOTAEstado; solo lo usa la tarea de red
+ */
+struct AvisoOTA
+{
+  bool vigente;          ///< false: volver a publicar (sesion MQTT nueva)
+  EstadoOTA estado;      ///< Estado publicado
+  uint32_t pedido;       ///< Desplazamiento pedido, en OTA_RECIBIENDO
+  uint32_t publicadoMs;  ///< Momento de la publicacion
+};
+
+AvisoOTA avisoOTA = {};
+bool validacionOTAPendiente = false; ///< El firmware en ejecucion es nuevo y aun no conecto a MQTT
+
+/// Nombre de cada estado en topicoOTAEstado, indexado por EstadoOTA
+const char *const NOMBRES_ESTADO_OTA[] = {"inactiva", "preparando", "recibiendo", "lista", "fallida"};
+#endif
 
 /* ============================================================================
  * PROTOTIPOS DE FUNCIONES
  * ============================================================================ */
 
-void configurarWiFi(void);
-void configurarMQTT(void);
-void reconectarMQTT(void);
-void leerDistanciaYPublicar(void);
-void leerTemperaturaYHumedad(void);
-void leerTemperaturaOneWire(void);
-void callbackMQTT(char *topic, byte *payload, unsigned int length);
-void imprimirSeparador(int longitud);
+void configurarWiFi(void);
+void configurarMQTT(void);
+bool reconectarMQTT(void);
+void mostrarInformacionRed(void);
+void iniciarAsociacionWiFi(void);
+uint32_t duracionConcesionDHCP(void);
+void prepararDireccionBroker(void);
+void cambiarEstadoConexion(EstadoConexion estado, uint32_t ahoraMs, uint32_t esperaMs);
+void gestionarConexion(uint32_t ahoraMs);
+void inicializarCanales(void);
+void configurarSensoresOneWire(void);
+void callbackMQTT(char *topic, byte *payload, unsigned int length);
+void configurarComandos(void);
+void comandoLED(const uint8_t *carga, unsigned int longitud, void *contexto);
+void comandoBufferMQTT(const uint8_t *carga, unsigned int longitud, void *contexto);
+void aplicarBufferMQTT(void);
+void comandoConfiguracion(const uint8_t *carga, unsigned int longitud, void *contexto);
+void configuracionPorDefecto(ConfiguracionDispositivo &destino);
+bool configuracionValida(const ConfiguracionDispositivo &candidata);
+void aplicarConfiguracion(void);
+void aplicarMuestreo(const ConfiguracionDispositivo &nueva);
+uint32_t periodoTramaMs(void);
+bool armarTopicoCanal(const ConfiguracionDispositivo &origen, uint8_t canal, char *destino);
+bool armarTopicoServicio(const ConfiguracionDispositivo &origen, const char *sufijo, char *destino);
+void armarTopicos(const ConfiguracionDispositivo &origen);
+void comandoInicioOTA(const uint8_t *carga, unsigned int longitud, void *contexto);
+void comandoBloqueOTA(const uint8_t *carga, unsigned int longitud, void *contexto);
+void atenderOTA(uint32_t ahoraMs);
+void validarFirmware(bool conectado, uint32_t ahoraMs);
+void actualizarActuadores(uint32_t ahoraMs);
+void imprimirSeparador(int longitud);
+void encolarMuestra(uint8_t canal, float valor, int64_t instanteUs);
+void entregarValorCanal(uint8_t canal, float valor, int64_t instanteUs);
+void publicarMuestra(const Muestra &muestra);
+void almacenarOffline(const Muestra &muestra);
+void sincronizarOffline(uint32_t ahoraMs, bool forzar);
+void reenviarOffline(uint32_t ahoraMs);
+bool atenderReenvioEnVuelo(void);
+bool muestraReportable(const Muestra &muestra);
+bool resolverMarca(Muestra &muestra);
+void registrarPublicacion(const Muestra &muestra);
+void agregarMuestraTrama(const Muestra &muestra);
+void acumularMuestra(const Muestra &muestra);
+void cerrarVentanasVencidas(void);
+void encolarResumen(uint8_t canal, uint8_t ventana, const ResumenVentana &resumen);
+void publicarResumenes(void);
+void reenviarResumenesOffline(uint32_t ahoraMs);
+void comandoPublicacionCruda(const uint8_t *carga, unsigned int longitud, void *contexto);
+void publicarTrama(void);
+void aplicarReglas(const ConfiguracionDispositivo &nueva);
+bool evaluarReglas(uint8_t canal, float lectura, int64_t instanteUs);
+void accionarSalidas(void);
+void publicarAlarmas(void);
+bool publicarMedido(const char *topico, const uint8_t *carga, size_t longitud);
+uint16_t publicarTramaPorFlujo(const char *topico, uint32_t secuencia, const Muestra *muestras, uint16_t cantidad);
+void publicarDiagnostico(uint32_t ahoraMs);
+const char *topicoCanal(uint8_t canal);
+const DescriptorCanal &descriptorCanal(uint8_t canal);
+void tareaAdquisicion(void *parametro);
+void tareaRed(void *parametro);
+void tareaModbus(void *parametro);
+void tareaBitacora(void *parametro);
+void tareaOTA(void *parametro);
+void ejecutarCicloSueno(void);
+void entregarTodosLosCanales(void);
+void reenviarBitacora(void);
+
+/* ============================================================================
+ * FUNCIONES AUXILIARES
+ * ============================================================================ */
+
+/**
+ * @brief Imprime una linea separadora de caracteres
+ * @param longitud Numero de caracteres a imprimir
+ */
+void imprimirSeparador(int longitud)
+{
+  static const char SEPARADOR[] = "================================================================";
+  LOG_INFO("%.*s", longitud < (int)sizeof(SEPARADOR) - 1 ? longitud : (int)sizeof(SEPARADOR) - 1, SEPARADOR);
+}
+
+/**
+ * @brief Entrega una lectura a la tarea de red a traves de la cola
+ *
+ * Solo debe llamarse desde la tarea de adquisicion (unico productor de la
+ * cola y unico escritor de los registros de entrada). Si la cola esta llena
+ * la muestra se descarta y se contabiliza, sin esperar.
+ *
+ * @param canal Canal de sensor (CanalSensor)
+ * @param valor Valor de la lectura
+ * @param instanteUs Instante de adquisicion (RelojUTC::monotonicoUs())
+ */
+void encolarMuestra(uint8_t canal, float valor, int64_t instanteUs)
+{
+  Muestra muestra;
+  muestra.marcaTiempoUs = instanteUs;
+  muestra.valor = valor;
+  muestra.canal = canal;
+  muestra.banderas = 0;
+  muestra.arranque = relojUTC.arranque();
+  resolverMarca(muestra);
+
+  // La tabla siempre tiene el ultimo valor, aunque la cola este llena
+  tablaRegistros.escribirInputFlotante(REGISTRO_INPUT_CANAL(canal), valor);
+
+  if (!colaMuestras.encolar(muestra))
+  {
+    muestrasDescartadas++;
+  }
+}
+
+/**
+ * @brief Devuelve el topico MQTT de un canal
+ * @param canal Canal de sensor (CanalSensor)
+ * @return Topico del canal o NULL si el canal no existe
+ */
+const char *topicoCanal(uint8_t canal)
+{
+  return canal < NUMERO_CANALES ? topicosCanales[canal] : NULL;
+}
+
+/**
+ * @brief Entrega a la tarea de red el valor filtrado de un canal
+ *
+ * Destino de las TareaSensor. Un NaN indica que el canal no acepto muestras
+ * desde la ultima entrega: no se entrega nada, para no repetir valores de
+ * un sensor que dejo de responder.
+ *
+ * @param canal Canal de sensor (CanalSensor)
+ * @param valor Valor filtrado o NaN
+ * @param instanteUs Instante de la ultima lectura del valor
+ */
+void entregarValorCanal(uint8_t canal, float valor, int64_t instanteUs)
+{
+  if (isnan(valor))
+  {
+    // Por numero: los topicos los puede rearmar la tarea de red en cualquier momento
+    LOG_AVISO("-> Canal %u sin lecturas validas en el ciclo - No se publica", canal);
+    return;
+  }
+
+  LOG_DEPURACION("-> Canal %u: %.2f", canal, valor);
+  encolarMuestra(canal, valor, instanteUs);
+}
+
+/**
+ * @brief Devuelve la entrada del registro de un canal
+ * @param canal Canal de sensor valido (CanalSensor)
+ */
+const DescriptorCanal &descriptorCanal(uint8_t canal)
+{
+  return REGISTRO_CANALES[canal < CANAL_ONEWIRE_BASE ? canal : (uint8_t)CANAL_ONEWIRE_BASE];
+}
+
+/**
+ * @brief Pasa a UTC la marca de una muestra si ya hay hora valida
+ *
+ * Una muestra tomada antes de la primera sincronizacion SNTP se
+ * convierte en cuanto la hay, siempre que sea de este arranque; las de
+ * arranques anteriores leidas de flash quedan sin hora (dt null).
+ *
+ * @return true si la marca esta en UTC
+ */
+bool resolverMarca(Muestra &muestra)
+{
+  if (!(muestra.banderas & MUESTRA_UTC) && relojUTC.aUTC(muestra.marcaTiempoUs, muestra.arranque, muestra.marcaTiempoUs))
+  {
+    muestra.banderas |= MUESTRA_UTC;
+  }
+  return (muestra.banderas & MUESTRA_UTC) != 0;
+}
+
+/**
+ * @brief Aplica la banda muerta del canal a una muestra
+ *
+ * Sin MODO_BANDA_MUERTA toda muestra es reportable. El latido se mide con
+ * millis() en la tarea de red: es el silencio del topico, no la distancia
+ * entre marcas de adquisicion.
+ *
+ * @param muestra Muestra candidata
+ * @return true si la muestra debe publicarse
+ */
+bool muestraReportable(const Muestra &muestra)
+{
+#if MODO_BANDA_MUERTA
+  return reportesCanales[muestra.canal].debePublicar(descriptorCanal(muestra.canal).reporte,
+                                                     muestra.valor, millis());
+#else
+  (void)muestra;
+  return true;
+#endif
+}
+
+/**
+ * @brief Registra en la banda muerta una muestra publicada con exito
+ * @param muestra Muestra publicada
+ */
+void registrarPublicacion(const Muestra &muestra)
+{
+#if MODO_BANDA_MUERTA
+  reportesCanales[muestra.canal].registrarPublicacion(muestra.valor, millis());
+#else
+  (void)muestra;
+#endif
+}
+
+/**
+ * @brief Publica una muestra en el topico de su canal
+ *
+ * Con MODO_BANDA_MUERTA la muestra se omite si no se aleja del ultimo
+ * valor publicado mas que la banda muerta del canal y el latido aun no
+ * vence. Solo debe llamarse desde la tarea de red.
+ *
+ * La carga es el valor solo, como lo esperan los suscriptores de los
+ * topicos de canal; con MARCA_TIEMPO_INDIVIDUAL lleva ademas la marca UTC
+ * de adquisicion ("t": null si aun no hay hora).
+ *
+ * @param muestra Muestra extraida de la cola
+ */
+void publicarMuestra(const Muestra &muestra)
+{
+  ZonaSinReservas zona(ZONA_PUBLICACION);
+  const char *topico = topicoCanal(muestra.canal);
+  if (topico == NULL || !muestraReportable(muestra))
+  {
+    return;
+  }
+
+  Muestra resuelta = muestra;
+  resolverMarca(resuelta);
+
+  // Centesimas con aritmetica entera, sin el printf de punto flotante
+#if MARCA_TIEMPO_INDIVIDUAL
+  char *cursor = cargaPublicacion;
+  char *fin = cargaPublicacion + sizeof(cargaPublicacion);
+  memcpy(cursor, "{\"v\":", 5);
+  cursor += 5;
+  size_t digitos = formatearCentesimas(cursor, fin - cursor, resuelta.valor);
+  if (digitos == 0)
+  {
+    return;
+  }
+  cursor += digitos;
+  memcpy(cursor, ",\"t\":", 5);
+  cursor += 5;
+  if (resuelta.banderas & MUESTRA_UTC)
+  {
+    cursor += formatearEntero64(cursor, fin - cursor, (uint64_t)resuelta.marcaTiempoUs);
+  }
+  else
+  {
+    memcpy(cursor, "null", 4);
+    cursor += 4;
+  }
+  *cursor++ = '}';
+  size_t longitud = cursor - cargaPublicacion;
+#else
+  size_t longitud = formatearCentesimas(cargaPublicacion, sizeof(cargaPublicacion), resuelta.valor);
+  if (longitud == 0)
+  {
+    return;
+  }
+#endif
+
+  if (publicarMedido(topico, (const uint8_t *)cargaPublicacion, longitud))
+  {
+    registrarPublicacion(muestra);
+    LOG_DEPURACION("-> Publicado %s = %.*s", topico, (int)longitud, cargaPublicacion);
+  }
+  else
+  {
+    LOG_AVISO("-> Error publicando %s", topico);
+    almacenarOffline(resuelta);
+  }
+}
+
+/**
+ * @brief Suma una muestra a las ventanas de su canal y publica las que cierra
+ *
+ * Sin AGREGACION_ACTIVA no hace nada. Las ventanas se alinean a la marca
+ * de la muestra, UTC en cuanto hay hora. Solo debe llamarse desde la tarea
+ * de red, con cada muestra de la cola, este o no conectada: una ventana que
+ * cierra sin conexion va al registro de ventanas en flash (ver
+ * encolarResumen()).
+ *
+ * @param muestra Muestra extraida de la cola
+ */
+void acumularMuestra(const Muestra &muestra)
+{
+#if AGREGACION_ACTIVA
+  if (muestra.canal >= NUMERO_CANALES)
+  {
+    return;
+  }
+
+  Muestra resuelta = muestra;
+  bool utc = resolverMarca(resuelta);
+  for (uint8_t v = 0; v < NUMERO_VENTANAS; v++)
+  {
+    ResumenVentana resumen;
+    if (ventanasCanales[muestra.canal][v].agregar(resuelta.marcaTiempoUs, utc, resuelta.valor,
+                                                  (int64_t)VENTANAS_AGREGACION[v].duracionMs * 1000, resumen))
+    {
+      encolarResumen(muestra.canal, v, resumen);
+    }
+  }
+#else
+  (void)muestra;
+#endif
+}
+
+/**
+ * @brief Publica las ventanas que vencieron sin que llegara una muestra de la siguiente
+ *
+ * Evita que un canal que deja de entregar retenga su ultima ventana. Solo
+ * debe llamarse desde la tarea de red, despues de vaciar la cola.
+ */
+void cerrarVentanasVencidas(void)
+{
+#if AGREGACION_ACTIVA
+  int64_t ahoraUs;
+  bool utc = relojUTC.ahoraUTC(ahoraUs);
+  if (!utc)
+  {
+    ahoraUs = RelojUTC::monotonicoUs();
+  }
+
+  for (uint8_t canal = 0; canal < NUMERO_CANALES; canal++)
+  {
+    for (uint8_t v = 0; v < NUMERO_VENTANAS; v++)
+    {
+      ResumenVentana resumen;
+      if (ventanasCanales[canal][v].vencida(ahoraUs, utc, (int64_t)VENTANAS_AGREGACION[v].duracionMs * 1000,
+                                            (int64_t)GRACIA_CIERRE_VENTANA_MS * 1000) &&
+          ventanasCanales[canal][v].cerrar(resumen))
+      {
+        encolarResumen(canal, v, resumen);
+      }
+    }
+  }
+#endif
+}
+
+/**
+ * @brief Deja una ventana cerrada en espera hasta poder publicarla
+ *
+ * Con conexion va a colaResumenes. Sin conexion, o con la cola llena, va
+ * al registro de ventanas en flash si lo hay (RESUMENES_OFFLINE). Las de
+ * canales sin topico se descartan aqui; las que no caben en ningun lado se
+ * cuentan en resumenesDescartados.
+ *
+ * @param canal Canal de sensor (CanalSensor)
+ * @param ventana Indice en VENTANAS_AGREGACION
+ * @param resumen Estadisticas de la ventana
+ */
+void encolarResumen(uint8_t canal, uint8_t ventana, const ResumenVentana &resumen)
+{
+#if AGREGACION_ACTIVA
+  const char *topico = topicoCanal(canal);
+  if (topico == NULL || topico[0] == '\0')
+  {
+    return;
+  }
+
+  ResumenPendiente pendiente;
+  memset(&pendiente, 0, sizeof(pendiente));
+  pendiente.resumen = resumen;
+  pendiente.canal = canal;
+  pendiente.ventana = ventana;
+  if (conexion.estado == CONEXION_MQTT_CONECTADA && colaResumenes.encolar(pendiente))
+  {
+    return;
+  }
+#if RESUMENES_OFFLINE
+  if (registroResumenesListo && registroResumenes.agregar(&pendiente))
+  {
+    return;
+  }
+#else
+  if (conexion.estado != CONEXION_MQTT_CONECTADA && colaResumenes.encolar(pendiente))
+  {
+    return;
+  }
+#endif
+  resumenesDescartados++;
+#else
+  (void)canal;
+  (void)ventana;
+  (void)resumen;
+#endif
+}
+
+#if AGREGACION_ACTIVA
+/**
+ * @brief Publica una ventana cerrada como {"n":..,"min":..,"max":..,"media":..,"desv":..,"t":..}
+ *
+ * "t" es el comienzo de la ventana en us UTC, o null si se armo antes de
+ * tener hora.
+ *
+ * @return false si el publish fallo y hay que reintentar; una ventana que
+ *         no se puede armar se descarta y devuelve true
+ */
+bool publicarResumen(const ResumenPendiente &pendiente)
+{
+  const ResumenVentana &resumen = pendiente.resumen;
+  const char *topico = topicoCanal(pendiente.canal);
+  if (topico == NULL || topico[0] == '\0')
+  {
+    return true;
+  }
+
+  size_t largoTopico = strlen(topico);
+  size_t largoSufijo = strlen(VENTANAS_AGREGACION[pendiente.ventana].sufijo);
+  if (largoTopico + 1 + largoSufijo >= sizeof(topicoResumen))
+  {
+    return true;
+  }
+  memcpy(topicoResumen, topico, largoTopico);
+  topicoResumen[largoTopico] = '/';
+  memcpy(topicoResumen + largoTopico + 1, VENTANAS_AGREGACION[pendiente.ventana].sufijo, largoSufijo + 1);
+
+  // Campos de ancho acotado: cargaResumen tiene lugar para el peor caso
+  char *cursor = cargaResumen;
+  char *fin = cargaResumen + sizeof(cargaResumen);
+  memcpy(cursor, "{\"n\":", 5);
+  cursor += 5;
+  cursor += formatearEntero(cursor, fin - cursor, resumen.cantidad);
+  const char *const campos[] = {",\"min\":", ",\"max\":", ",\"media\":", ",\"desv\":"};
+  const float valores[] = {resumen.minimo, resumen.maximo, resumen.media, resumen.desviacion};
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    size_t largo = strlen(campos[i]);
+    memcpy(cursor, campos[i], largo);
+    cursor += largo;
+    size_t digitos = formatearCentesimas(cursor, fin - cursor, valores[i]);
+    if (digitos == 0)
+    {
+      return true;
+    }
+    cursor += digitos;
+  }
+  memcpy(cursor, ",\"t\":", 5);
+  cursor += 5;
+  if (resumen.utc)
+  {
+    cursor += formatearEntero64(cursor, fin - cursor, (uint64_t)resumen.inicioUs);
+  }
+  else
+  {
+    memcpy(cursor, "null", 4);
+    cursor += 4;
+  }
+  *cursor++ = '}';
+  size_t longitud = cursor - cargaResumen;
+
+  if (!publicarMedido(topicoResumen, (const uint8_t *)cargaResumen, longitud))
+  {
+    return false;
+  }
+  LOG_DEPURACION("-> Publicado %s = %.*s", topicoResumen, (int)longitud, cargaResumen);
+  return true;
+}
+#endif
+
+/**
+ * @brief Publica las ventanas cerradas en espera, en orden
+ *
+ * Una ventana que no se pudo publicar (p. ej. con la ventana de QoS 1
+ * llena) se reintenta en la siguiente llamada, antes que las demas; el
+ * aviso se da una sola vez por ventana. Solo debe llamarse desde la tarea
+ * de red con MQTT conectado.
+ */
+void publicarResumenes(void)
+{
+#if AGREGACION_ACTIVA
+  ZonaSinReservas zona(ZONA_PUBLICACION);
+  for (;;)
+  {
+    if (!hayResumenPendiente && !colaResumenes.desencolar(resumenPendiente))
+    {
+      return;
+    }
+    hayResumenPendiente = true;
+
+    if (!publicarResumen(resumenPendiente))
+    {
+      if (!resumenReintentando)
+      {
+        LOG_AVISO("-> Error publicando %s - Se reintenta", topicoResumen);
+        resumenReintentando = true;
+      }
+      else
+      {
+        LOG_DEPURACION("-> Reintento fallido de %s", topicoResumen);
+      }
+      return;
+    }
+    hayResumenPendiente = false;
+    resumenReintentando = false;
+  }
+#endif
+}
+
+/**
+ * @brief Publica las alarmas en espera, cada una como {"regla":..,"canal":..,"activa":..,"v":..,"t":..}
+ *
+ * "t" es el instante de la lectura en us UTC, o null sin hora. Una alarma
+ * que no se pudo publicar se reintenta en la siguiente llamada, antes que
+ * las demas; el aviso se da una sola vez por alarma. Solo debe llamarse
+ * desde la tarea de red con MQTT conectado, antes de publicar muestras.
+ */
+void publicarAlarmas(void)
+{
+  ZonaSinReservas zona(ZONA_PUBLICACION);
+  for (;;)
+  {
+    if (!hayAlarmaPendiente && !colaAlarmas.desencolar(alarmaPendiente))
+    {
+      return;
+    }
+    hayAlarmaPendiente = true;
+
+    char *cursor = cargaAlarma;
+    char *fin = cargaAlarma + sizeof(cargaAlarma);
+    memcpy(cursor, "{\"regla\":", 9);
+    cursor += 9;
+    cursor += formatearEntero(cursor, fin - cursor, alarmaPendiente.regla);
+    memcpy(cursor, ",\"canal\":", 9);
+    cursor += 9;
+    cursor += formatearEntero(cursor, fin - cursor, alarmaPendiente.canal);
+    const char *estado = alarmaPendiente.activa ? ",\"activa\":true,\"v\":" : ",\"activa\":false,\"v\":";
+    size_t largo = strlen(estado);
+    memcpy(cursor, estado, largo);
+    cursor += largo;
+    size_t digitos = formatearCentesimas(cursor, fin - cursor, alarmaPendiente.valor);
+    if (digitos == 0)
+    {
+      // Fuera del rango de las centesimas: no se puede publicar
+      hayAlarmaPendiente = false;
+      continue;
+    }
+    cursor += digitos;
+    memcpy(cursor, ",\"t\":", 5);
+    cursor += 5;
+    int64_t utcUs;
+    if (relojUTC.aUTC(alarmaPendiente.marcaTiempoUs, alarmaPendiente.arranque, utcUs))
+    {
+      cursor += formatearEntero64(cursor, fin - cursor, (uint64_t)utcUs);
+    }
+    else
+    {
+      memcpy(cursor, "null", 4);
+      cursor += 4;
+    }
+    *cursor++ = '}';
+    size_t longitud = cursor - cargaAlarma;
+
+    if (!publicarMedido(topicosServicio.alarma, (const uint8_t *)cargaAlarma, longitud))
+    {
+      if (!alarmaReintentando)
+      {
+        LOG_AVISO("-> Error publicando la alarma de la regla %u - Se reintenta", alarmaPendiente.regla);
+        alarmaReintentando = true;
+      }
+      else
+      {
+        LOG_DEPURACION("-> Reintento fallido de la alarma de la regla %u", alarmaPendiente.regla);
+      }
+      return;
+    }
+    hayAlarmaPendiente = false;
+    alarmaReintentando = false;
+    LOG_INFO("-> Alarma %.*s", (int)longitud, cargaAlarma);
+  }
+}
+
+/**
+ * @brief Agrega una muestra a la trama por lotes en construccion
+ *
+ * Aplica la banda muerta igual que la publicacion individual. Si la trama
+ * esta llena se publica antes de agregar la muestra. Solo debe llamarse
+ * desde la tarea de red.
+ *
+ * @param muestra Muestra extraida de la cola
+ */
+void agregarMuestraTrama(const Muestra &muestra)
+{
+  ZonaSinReservas zona(ZONA_PUBLICACION);
+  if (topicoCanal(muestra.canal) == NULL || !muestraReportable(muestra))
+  {
+    return;
+  }
+
+  if (tramaPendiente.cantidad >= MAX_MUESTRAS_TRAMA)
+  {
+    publicarTrama();
+  }
+
+  if (tramaPendiente.cantidad == 0)
+  {
+    tramaPendiente.inicioMs = millis();
+  }
+  tramaPendiente.muestras[tramaPendiente.cantidad++] = muestra;
+}
+
+/**
+ * @brief Codifica y publica la trama por lotes en el topico de tramas
+ *
+ * Usa bufferTrama, preasignado, para la codificacion; si la trama no cabe
+ * se envia por flujo, codificada por bloques directo al socket. La trama
+ * se descarta tras el intento, salga o no.
+ */
+void publicarTrama(void)
+{
+  ZonaSinReservas zona(ZONA_PUBLICACION);
+  if (tramaPendiente.cantidad == 0)
+  {
+    return;
+  }
+
+  // Las muestras tomadas antes de la sincronizacion SNTP aun pueden pasar a UTC
+  for (uint8_t i = 0; i < tramaPendiente.cantidad; i++)
+  {
+    resolverMarca(tramaPendiente.muestras[i]);
+  }
+
+  FormatoTrama formato = MODO_PUBLICACION == PUBLICACION_LOTE_CBOR ? TRAMA_CBOR : TRAMA_JSON;
+  uint32_t secuencia = tramaPendiente.secuencia++;
+  size_t longitud = codificarTrama(formato, bufferTrama, sizeof(bufferTrama), secuencia, tramaPendiente.muestras,
+                                   tramaPendiente.cantidad);
+
+  bool publicada;
+  if (longitud == 0)
+  {
+    publicada = publicarTramaPorFlujo(topicosServicio.trama, secuencia, tramaPendiente.muestras, tramaPendiente.cantidad) != 0;
+  }
+  else
+  {
+    publicada = publicarMedido(topicosServicio.trama, bufferTrama, longitud);
+  }
+
+  if (publicada)
+  {
+    for (uint8_t i = 0; i < tramaPendiente.cantidad; i++)
+    {
+      registrarPublicacion(tramaPendiente.muestras[i]);
+    }
+    LOG_DEPURACION("-> Trama publicada: %u muestras%s", tramaPendiente.cantidad, longitud == 0 ? " por flujo" : "");
+  }
+  else
+  {
+    LOG_AVISO("-> Error publicando trama por lotes");
+    for (uint8_t i = 0; i < tramaPendiente.cantidad; i++)
+    {
+      almacenarOffline(tramaPendiente.muestras[i]);
+    }
+  }
+
+  tramaPendiente.cantidad = 0;
+}
+
+/**
+ * @brief Publica datos midiendo la latencia de publish()
+ *
+ * Con QOS_DATOS el mensaje sale con QoS 1 por la ventana de ClienteQoS1,
+ * sin esperar su PUBACK. Si la ventana esta llena se atienden primero los
+ * PUBACK ya llegados; si sigue llena el publish falla y el llamador lo
+ * guarda en el registro offline, como con cualquier otro fallo.
+ *
+ * @return true si el mensaje salio (o quedo en vuelo con QoS 1)
+ */
+bool publicarMedido(const char *topico, const uint8_t *carga, size_t longitud)
+{
+  bool publicado;
+  {
+    CronometroLatencia cronometro(diagnostico.publicacion);
+#if QOS_DATOS
+    if (clienteQoS1.enVuelo() >= VENTANA_QOS1)
+    {
+      clienteMQTT.loop();
+    }
+    publicado = clienteQoS1.publicar(topico, carga, longitud);
+#else
+    publicado = clienteMQTT.publish(topico, carga, (unsigned int)longitud);
+#endif
+  }
+
+  if (!publicado)
+  {
+    diagnostico.publicacionesFallidas++;
+  }
+  return publicado;
+}
+
+/**
+ * @brief Salida de emitirTrama(): escribe el bloque en el paquete MQTT abierto
+ */
+bool escribirBloqueMQTT(void *contexto, const uint8_t *datos, size_t longitud)
+{
+  (void)contexto;
+#if QOS_DATOS
+  return clienteQoS1.write(datos, longitud) == longitud;
+#else
+  return clienteMQTT.write(datos, longitud) == longitud;
+#endif
+}
+
+/**
+ * @brief Publica una trama por flujo, sin armarla entera en memoria
+ *
+ * La trama se codifica dos veces: una para medirla, porque la cabecera
+ * MQTT lleva la longitud, y otra para escribirla en bloques de
+ * TAMANO_BLOQUE_TRAMA bytes directo al socket TLS. No la limita el buffer
+ * de PubSubClient ni bufferTrama. Con QOS_DATOS sale con QoS 1, pero sin
+ * copia para reenviarla: ver ClienteQoS1::estadoFlujo().
+ *
+ * @return Identificador QoS 1 del mensaje (1 con QoS 0), 0 si no salio
+ */
+uint16_t publicarTramaPorFlujo(const char *topico, uint32_t secuencia, const Muestra *muestras, uint16_t cantidad)
+{
+  ZonaSinReservas zona(ZONA_PUBLICACION);
+  FormatoTrama formato = MODO_PUBLICACION == PUBLICACION_LOTE_CBOR ? TRAMA_CBOR : TRAMA_JSON;
+  size_t longitud = medirTrama(formato, secuencia, muestras, cantidad);
+
+  uint16_t identificador;
+  {
+    CronometroLatencia cronometro(diagnostico.publicacion);
+#if QOS_DATOS
+    if (clienteQoS1.enVuelo() >= VENTANA_QOS1)
+    {
+      clienteMQTT.loop();
+    }
+    identificador = clienteQoS1.iniciarPublicacion(topico, longitud);
+    if (identificador != 0)
+    {
+      emitirTrama(formato, bloqueTrama, sizeof(bloqueTrama), escribirBloqueMQTT, NULL, secuencia, muestras, cantidad);
+      if (!clienteQoS1.terminarPublicacion())
+      {
+        identificador = 0;
+      }
+    }
+#else
+    identificador = clienteMQTT.beginPublish(topico, (unsigned int)longitud, false) ? 1 : 0;
+    if (identificador != 0 &&
+        !emitirTrama(formato, bloqueTrama, sizeof(bloqueTrama), escribirBloqueMQTT, NULL, secuencia, muestras, cantidad))
+    {
+      clienteQoS1.stop(); // Paquete truncado: el flujo MQTT ya no es valido
+      identificador = 0;
+    }
+    else if (identificador != 0)
+    {
+      clienteMQTT.endPublish();
+    }
+#endif
+  }
+
+  if (identificador == 0)
+  {
+    diagnostico.publicacionesFallidas++;
+  }
+  return identificador;
+}
+
+/**
+ * @brief Agrega al JSON de diagnostico el resumen de una etapa
+ * @return Bytes escritos, o 0 si no cupo
+ */
+size_t agregarEtapaDiagnostico(char *destino, size_t capacidad, const char *nombre, HistogramaLatencia &histograma)
+{
+  ResumenLatencia resumen;
+  histograma.resumirYReiniciar(resumen);
+
+  int escritos = snprintf(destino, capacidad, "\"%s\":[%u,%u,%u,%u],", nombre, (unsigned)resumen.cantidad,
+                          (unsigned)resumen.p50Us, (unsigned)resumen.p99Us, (unsigned)resumen.maximoUs);
+  return escritos > 0 && (size_t)escritos < capacidad ? (size_t)escritos : 0;
+}
+
+/**
+ * @brief Agrega al JSON de diagnostico un par "nombre":valor seguido de coma
+ * @return Bytes escritos, o 0 si no cupo
+ */
+size_t agregarContadorDiagnostico(char *destino, size_t capacidad, const char *nombre, uint32_t valor)
+{
+  int escritos = snprintf(destino, capacidad, "\"%s\":%u,", nombre, (unsigned)valor);
+  return escritos > 0 && (size_t)escritos < capacidad ? (size_t)escritos : 0;
+}
+
+/**
+ * @brief Cierra un objeto del JSON de diagnostico abierto con '{'
+ * @return Nueva posicion del cursor
+ */
+char *cerrarObjetoDiagnostico(char *cursor)
+{
+  if (cursor[-1] == ',')
+  {
+    cursor[-1] = '}'; // Reemplaza la ultima coma
+    return cursor;
+  }
+  *cursor = '}'; // Objeto vacio; quien llama deja lugar para este byte
+  return cursor + 1;
+}
+
+/**
+ * @brief Publica en el topico de diagnostico el resumen del intervalo y lo reinicia
+ *
+ * Por etapa se envia [cantidad, p50, p99, maximo] en microsegundos; la
+ * cantidad dividida por "intervalo" da el ritmo de la etapa. Se agregan la
+ * memoria libre, su minimo historico, el mayor bloque libre y la
+ * fragmentacion en porcentaje, los contadores de reconexion, las
+ * sincronizaciones SNTP con la ultima correccion del reloj y en "pilas" lo
+ * minimo que le quedo libre a la pila de cada tarea, en bytes. Con
+ * MODO_CONTEO_RESERVAS tambien van las reservas del intervalo, en total y
+ * por zona caliente; una zona con reservas se avisa en la bitacora.
+ *
+ * @param ahoraMs Tiempo actual en milisegundos
+ */
+void publicarDiagnostico(uint32_t ahoraMs)
+{
+  if (INTERVALO_DIAGNOSTICO_MS == 0 || ahoraMs - diagnostico.ultimaPublicacionMs < INTERVALO_DIAGNOSTICO_MS)
+  {
+    return;
+  }
+
+  uint32_t intervaloMs = ahoraMs - diagnostico.ultimaPublicacionMs;
+  diagnostico.ultimaPublicacionMs = ahoraMs;
+
+  char *cursor = bufferDiagnostico;
+  char *fin = bufferDiagnostico + sizeof(bufferDiagnostico);
+  cursor += snprintf(cursor, fin - cursor, "{\"intervalo\":%u,\"etapas\":{", (unsigned)intervaloMs);
+  for (uint8_t g = 0; g < NUMERO_GRUPOS; g++)
+  {
+    cursor += agregarEtapaDiagnostico(cursor, fin - cursor, GRUPOS_SENSORES[g].nombre, diagnostico.lecturas[g]);
+  }
+  cursor += agregarEtapaDiagnostico(cursor, fin - cursor, "publish", diagnostico.publicacion);
+  cursor += agregarEtapaDiagnostico(cursor, fin - cursor, "tls", diagnostico.handshakeTLS);
+  cursor += agregarEtapaDiagnostico(cursor, fin - cursor, "loop", diagnostico.bucleMQTT);
+  cursor[-1] = '}'; // Reemplaza la ultima coma
+
+  // Se reserva lugar para cerrar "pilas", "zonas" y el objeto raiz
+  fin -= 3;
+  EstadoHeap heap;
+  monitorMemoria.leerHeap(heap);
+  int escritos = snprintf(cursor, fin - cursor,
+                          ",\"heap\":%u,\"heapMin\":%u,\"bloqueMax\":%u,\"frag\":%u,\"reconWiFi\":%u,\"reconMQTT\":%u,"
+                          "\"pubFallidas\":%u,\"descartadas\":%u,\"logDescartadas\":%u,\"erroresDHT\":%u,"
+                          "\"enVuelo\":%u,\"pubAck\":%u,\"reenvios\":%u,\"sntp\":%u,\"correccionUs\":%d,\"pilas\":{",
+                          (unsigned)heap.libre, (unsigned)heap.minimoLibre, (unsigned)heap.bloqueMayor,
+                          (unsigned)heap.fragmentacion, (unsigned)diagnostico.reconexionesWiFi, (unsigned)diagnostico.reconexionesMQTT,
+                          (unsigned)diagnostico.publicacionesFallidas, (unsigned)muestrasDescartadas,
+                          (unsigned)bitacora.descartadas(), (unsigned)lectorDHT.errores(),
+                          (unsigned)clienteQoS1.enVuelo(), (unsigned)clienteQoS1.confirmadas(),
+                          (unsigned)clienteQoS1.reenviadas(), (unsigned)relojUTC.sincronizaciones(),
+                          (int)relojUTC.ultimaCorreccionUs());
+  if (escritos <= 0 || escritos >= fin - cursor)
+  {
+    LOG_ERROR("-> Diagnostico no cabe en el buffer - Descartado");
+    return;
+  }
+  cursor += escritos;
+  for (uint8_t i = 0; i < monitorMemoria.tareas(); i++)
+  {
+    cursor += agregarContadorDiagnostico(cursor, fin - cursor, monitorMemoria.nombreTarea(i),
+                                         monitorMemoria.pilaLibreMinima(i));
+  }
+  cursor = cerrarObjetoDiagnostico(cursor);
+
+#if MODO_CONTEO_RESERVAS
+  escritos = snprintf(cursor, fin - cursor, ",\"reservas\":%u,\"zonas\":{", (unsigned)monitorMemoria.tomarReservas());
+  if (escritos <= 0 || escritos >= fin - cursor)
+  {
+    LOG_ERROR("-> Diagnostico no cabe en el buffer - Descartado");
+    return;
+  }
+  cursor += escritos;
+  for (uint8_t z = 0; z < monitorMemoria.zonas(); z++)
+  {
+    uint32_t reservas = monitorMemoria.tomarReservasZona(z);
+    if (reservas > 0)
+    {
+      LOG_AVISO("-> %u reservas de memoria en la zona %s", (unsigned)reservas, monitorMemoria.nombreZona(z));
+    }
+    cursor += agregarContadorDiagnostico(cursor, fin - cursor, monitorMemoria.nombreZona(z), reservas);
+  }
+  cursor = cerrarObjetoDiagnostico(cursor);
+#endif
+  *cursor++ = '}';
+  diagnostico.publicacionesFallidas = 0;
+
+  clienteMQTT.publish(topicosServicio.diagnostico, (const uint8_t *)bufferDiagnostico,
+                      (unsigned int)(cursor - bufferDiagnostico));
+}
+
+/**
+ * @brief Reenvia por el topico de bitacora las lineas de nivel NIVEL_LOG_MQTT o mas graves
+ *
+ * A lo sumo LINEAS_BITACORA_POR_CICLO por llamada. No registra sus propios
+ * fallos en la bitacora, para no realimentarse.
+ */
+void reenviarBitacora(void)
+{
+#if NIVEL_LOG_MQTT > NIVEL_LOG_NINGUNO
+  char linea[MAX_LINEA_BITACORA];
+  for (uint8_t i = 0; i < LINEAS_BITACORA_POR_CICLO; i++)
+  {
+    size_t longitud = bitacora.siguienteLineaMQTT(linea, sizeof(linea));
+    if (longitud == 0)
+    {
+      return;
+    }
+    clienteMQTT.publish(topicosServicio.bitacora, (const uint8_t *)linea, (unsigned int)longitud);
+  }
+#endif
+}
+
+/**
+ * @brief Guarda en el registro de flash una muestra que no se pudo publicar
+ *
+ * La muestra ya paso la banda muerta; se registra como publicada para que
+ * las siguientes se comparen contra ella. La escritura en flash ocurre de
+ * a una pagina completa, en la tarea de red, lejos de la adquisicion. Se
+ * guarda con la marca en UTC si ya hay hora; si no, el reenvio aun puede
+ * convertirla mientras no haya un reinicio.
+ *
+ * @param muestra Muestra no publicada
+ */
+void almacenarOffline(const Muestra &muestra)
+{
+#if MODO_ALMACEN_OFFLINE
+  Muestra resuelta = muestra;
+  resolverMarca(resuelta);
+  if (registroOfflineListo && registroOffline.agregar(&resuelta))
+  {
+    registrarPublicacion(muestra);
+    return;
+  }
+  LOG_ERROR("-> Error guardando muestra en flash - Descartada");
+#else
+  (void)muestra;
+#endif
+}
+
+/**
+ * @brief Escribe en flash la pagina parcial en RAM si corresponde
+ *
+ * Sin forzar, solo escribe cada INTERVALO_SINCRONIZACION_MS, para acotar
+ * lo que se pierde si se corta la alimentacion sin gastar paginas casi
+ * vacias.
+ *
+ * @param ahoraMs Tiempo actual en milisegundos
+ * @param forzar true para escribir ya (por ejemplo al reconectar)
+ */
+void sincronizarOffline(uint32_t ahoraMs, bool forzar)
+{
+#if MODO_ALMACEN_OFFLINE
+  bool muestrasEnRAM = registroOfflineListo && registroOffline.registrosEnMemoria() > 0;
+  bool resumenesEnRAM = false;
+#if RESUMENES_OFFLINE
+  resumenesEnRAM = registroResumenesListo && registroResumenes.registrosEnMemoria() > 0;
+#endif
+  if (!muestrasEnRAM && !resumenesEnRAM)
+  {
+    ultimaSincronizacionMs = ahoraMs;
+    return;
+  }
+  if (forzar || ahoraMs - ultimaSincronizacionMs >= INTERVALO_SINCRONIZACION_MS)
+  {
+    if (muestrasEnRAM && !registroOffline.sincronizar())
+    {
+      LOG_ERROR("-> Error escribiendo pagina del registro offline");
+    }
+#if RESUMENES_OFFLINE
+    if (resumenesEnRAM && !registroResumenes.sincronizar())
+    {
+      LOG_ERROR("-> Error escribiendo pagina del registro de ventanas");
+    }
+#endif
+    ultimaSincronizacionMs = ahoraMs;
+  }
+#else
+  (void)ahoraMs;
+  (void)forzar;
+#endif
+}
+
+/**
+ * @brief Reenvia una rafaga de muestras guardadas en flash
+ *
+ * Publica hasta MAX_MUESTRAS_REENVIO muestras en una sola trama por
+ * el topico de reenvio, con sus marcas de tiempo originales, y a lo sumo una
+ * rafaga cada INTERVALO_REENVIO_MS para no saturar al broker. La trama se
+ * envia por flujo, sin armarla en memoria. Las muestras solo se consumen
+ * del registro cuando el publish sale o, con QOS_DATOS, cuando llega su
+ * PUBACK (ver atenderReenvioEnVuelo()).
+ *
+ * @param ahoraMs Tiempo actual en milisegundos
+ */
+void reenviarOffline(uint32_t ahoraMs)
+{
+#if MODO_ALMACEN_OFFLINE
+  ZonaSinReservas zona(ZONA_REENVIO);
+  if (!registroOfflineListo || ahoraMs - ultimoReenvioMs < INTERVALO_REENVIO_MS || !atenderReenvioEnVuelo())
+  {
+    return;
+  }
+  ultimoReenvioMs = ahoraMs;
+
+  uint16_t cantidad = registroOffline.leer(muestrasReenvio, MAX_MUESTRAS_REENVIO);
+  if (cantidad == 0)
+  {
+    return;
+  }
+  for (uint16_t i = 0; i < cantidad; i++)
+  {
+    resolverMarca(muestrasReenvio[i]);
+  }
+
+  uint16_t identificador = publicarTramaPorFlujo(topicosServicio.reenvio, secuenciaReenvio, muestrasReenvio, cantidad);
+  if (identificador == 0)
+  {
+    LOG_AVISO("-> Error reenviando muestras desde flash - Se reintentara");
+    return;
+  }
+
+  secuenciaReenvio++;
+#if QOS_DATOS
+  reenvioEnVuelo.identificador = identificador;
+  reenvioEnVuelo.cantidad = cantidad;
+#else
+  registroOffline.confirmar(cantidad);
+  LOG_INFO("-> Reenviadas %u muestras desde flash (%u paginas pendientes)", cantidad,
+           (unsigned)registroOffline.paginasPendientes());
+#endif
+#else
+  (void)ahoraMs;
+#endif
+}
+
+/**
+ * @brief Consume del registro la rafaga de reenvio cuyo PUBACK ya llego
+ *
+ * Si la conexion cayo antes del PUBACK la rafaga no se consume y el
+ * siguiente reenvio la vuelve a leer.
+ *
+ * @return false si la rafaga anterior aun espera su PUBACK
+ */
+bool atenderReenvioEnVuelo(void)
+{
+#if MODO_ALMACEN_OFFLINE
+  if (reenvioEnVuelo.identificador == 0)
+  {
+    return true;
+  }
+
+  switch (clienteQoS1.estadoFlujo(reenvioEnVuelo.identificador))
+  {
+  case FLUJO_EN_VUELO:
+    return false;
+  case FLUJO_CONFIRMADO:
+    registroOffline.confirmar(reenvioEnVuelo.cantidad);
+    LOG_INFO("-> Reenviadas %u muestras desde flash (%u paginas pendientes)", reenvioEnVuelo.cantidad,
+             (unsigned)registroOffline.paginasPendientes());
+    break;
+  default:
+    LOG_AVISO("-> Reenvio desde flash sin PUBACK - Se repetira");
+    break;
+  }
+  reenvioEnVuelo.identificador = 0;
+#endif
+  return true;
+}
+
+/**
+ * @brief Vuelve a publicar una rafaga de ventanas guardadas en flash durante un corte
+ *
+ * Cada ventana sale en su topico de ventana, como si acabara de cerrarse,
+ * con su "t" original. Solo con colaResumenes vacia, para no adelantarse a
+ * las ventanas en curso, y a lo sumo una rafaga cada INTERVALO_REENVIO_MS.
+ * Se consumen del registro las que salieron; la primera que falla corta la
+ * rafaga y se repite en la siguiente. Solo la tarea de red con MQTT
+ * conectado.
+ *
+ * @param ahoraMs Tiempo actual en milisegundos
+ */
+void reenviarResumenesOffline(uint32_t ahoraMs)
+{
+#if RESUMENES_OFFLINE
+  ZonaSinReservas zona(ZONA_REENVIO);
+  if (!registroResumenesListo || hayResumenPendiente || !colaResumenes.vacia() ||
+      ahoraMs - ultimoReenvioResumenesMs < INTERVALO_REENVIO_MS)
+  {
+    return;
+  }
+  ultimoReenvioResumenesMs = ahoraMs;
+
+  uint16_t cantidad = registroResumenes.leer(resumenesReenvio, MAX_RESUMENES_REENVIO);
+  if (cantidad == 0)
+  {
+    return;
+  }
+  uint16_t enviadas = 0;
+  while (enviadas < cantidad && publicarResumen(resumenesReenvio[enviadas]))
+  {
+    enviadas++;
+  }
+
+  registroResumenes.confirmar(enviadas);
+  if (enviadas < cantidad)
+  {
+    LOG_DEPURACION("-> Reenvio de ventanas desde flash cortado tras %u - Se reintentara", enviadas);
+    return;
+  }
+  LOG_DEPURACION("-> Reenviadas %u ventanas desde flash (%u paginas pendientes)", enviadas,
+                 (unsigned)registroResumenes.paginasPendientes());
+#else
+  (void)ahoraMs;
+#endif
+}
+
+/* ============================================================================
+ * FUNCIONES PRINCIPALES
+ * ============================================================================ */
+
+/**
+ * @brief Funcion de callback para mensajes MQTT entrantes
+ *
+ * Esta funcion se ejecuta cada vez que se recibe un mensaje MQTT en los
+ * topicos a los que esta suscrito el ESP32. Entrega el mensaje al manejador
+ * de su topico a traves de enrutadorComandos.
+ *
+ * @param topic Topico MQTT donde se recibio el mensaje
+ * @param payload Puntero al array de bytes del mensaje
+ * @param length Longitud del payload en bytes
+ *
+ * @note La carga se analiza en el buffer de PubSubClient, sin copiarla ni
+ *       reservar memoria, sea cual sea su longitud
+ */
+void callbackMQTT(char *topic, byte *payload, unsigned int length)
+{
+  ZonaSinReservas zona(ZONA_CALLBACK);
+#if OTA_POR_MQTT
+  // Los bloques de firmware son binarios y llegan por miles: no van a la bitacora
+  if (strcmp(topic, topicoOTABloque) != 0)
+#endif
+  {
+    LOG_INFO("Mensaje recibido en topico %s: %.*s", topic, (int)length, (const char *)payload);
+  }
+
+  if (!enrutadorComandos.despachar(topic, payload, length))
+  {
+    LOG_AVISO("-> Topico sin manejador - Mensaje ignorado");
+  }
+}
+
+/**
+ * @brief Registra los manejadores de los topicos de control
+ *
+ * Debe llamarse antes de iniciar la tarea de red; reconectarMQTT() se
+ * suscribe a cada topico registrado.
+ */
+void configurarComandos(void)
+{
+  enrutadorComandos.registrar(TOPICO_COIL_LED, comandoLED);
+  // Propio de cada equipo: el buffer que cabe depende de su memoria libre
+  snprintf(topicoBufferMQTT, sizeof(topicoBufferMQTT), PREFIJO_TOPICO_CONTROL "%s" SUFIJO_BUFFER_MQTT, idClienteMQTT);
+  enrutadorComandos.registrar(topicoBufferMQTT, comandoBufferMQTT);
+#if AGREGACION_ACTIVA
+  snprintf(topicoPublicacionCruda, sizeof(topicoPublicacionCruda), PREFIJO_TOPICO_CONTROL "%s" SUFIJO_PUBLICACION_CRUDA,
+           idClienteMQTT);
+  enrutadorComandos.registrar(topicoPublicacionCruda, comandoPublicacionCruda);
+#endif
+  // Propio de cada equipo: requiere el ID de cliente que arma configurarMQTT()
+  snprintf(topicoConfiguracion, sizeof(topicoConfiguracion), PREFIJO_TOPICO_CONFIGURACION "%s", idClienteMQTT);
+  enrutadorComandos.registrar(topicoConfiguracion, comandoConfiguracion);
+#if OTA_POR_MQTT
+  // Tambien propios: cada equipo pide sus bloques y el anuncio solo lo actualiza a el
+  snprintf(topicoOTAInicio, sizeof(topicoOTAInicio), PREFIJO_TOPICO_OTA "%s" SUFIJO_OTA_INICIO, idClienteMQTT);
+  snprintf(topicoOTABloque, sizeof(topicoOTABloque), PREFIJO_TOPICO_OTA "%s" SUFIJO_OTA_BLOQUE, idClienteMQTT);
+  snprintf(topicoOTAEstado, sizeof(topicoOTAEstado), PREFIJO_TOPICO_OTA "%s" SUFIJO_OTA_ESTADO, idClienteMQTT);
+  enrutadorComandos.registrar(topicoOTAInicio, comandoInicioOTA);
+  enrutadorComandos.registrar(topicoOTABloque, comandoBloqueOTA);
+#endif
+}
+
+/**
+ * @brief Manejador del topico del LED indicador
+ *
+ * "true" enciende la bobina COIL_LED y "false" la apaga; el efecto sobre el
+ * pin lo aplica actualizarActuadores(), igual que si la bobina la hubiera
+ * escrito un cliente Modbus.
+ *
+ * @param carga Carga del mensaje
+ * @param longitud Longitud de la carga
+ * @param contexto No utilizado
+ */
+void comandoLED(const uint8_t *carga, unsigned int longitud, void *contexto)
+{
+  (void)contexto;
+
+  if (cargaIgual(carga, longitud, "true"))
+  {
+    tablaRegistros.escribirCoil(COIL_LED, true);
+    LOG_INFO("-> Comando 'true' recibido");
+  }
+  else if (cargaIgual(carga, longitud, "false"))
+  {
+    tablaRegistros.escribirCoil(COIL_LED, false);
+    LOG_INFO("-> Comando 'false' recibido");
+  }
+  else
+  {
+    LOG_AVISO("-> Payload no reconocido - Comando ignorado");
+  }
+}
+
+/**
+ * @brief Manejador de topicoPublicacionCruda: cada valor ademas de las ventanas
+ *
+ * "true" vuelve a publicar cada valor como sin agregacion (con la banda
+ * muerta y MODO_PUBLICACION), "false" deja solo las ventanas. Las
+ * ventanas se publican siempre.
+ *
+ * @param carga Carga del mensaje
+ * @param longitud Longitud de la carga
+ * @param contexto No utilizado
+ */
+void comandoPublicacionCruda(const uint8_t *carga, unsigned int longitud, void *contexto)
+{
+  (void)contexto;
+
+  if (cargaIgual(carga, longitud, "true"))
+  {
+    publicacionCruda = true;
+  }
+  else if (cargaIgual(carga, longitud, "false"))
+  {
+    publicacionCruda = false;
+  }
+  else
+  {
+    LOG_AVISO("-> Payload no reconocido - Comando ignorado");
+    return;
+  }
+  LOG_INFO("-> Publicacion de cada valor %s", publicacionCruda ? "activada" : "desactivada");
+}
+
+/**
+ * @brief Manejador de topicoBufferMQTT: nuevo tamano del buffer de PubSubClient
+ *
+ * La carga es el tamano en bytes, entre TAMANO_BUFFER_MQTT_MINIMO y
+ * TAMANO_BUFFER_MQTT_MAXIMO. El cambio queda pendiente: el mensaje en
+ * curso vive en ese mismo buffer, y aplicarBufferMQTT() lo reasigna al
+ * salir de loop().
+ *
+ * @param carga Carga del mensaje
+ * @param longitud Longitud de la carga
+ * @param contexto No utilizado
+ */
+void comandoBufferMQTT(const uint8_t *carga, unsigned int longitud, void *contexto)
+{
+  (void)contexto;
+
+  int32_t tamano;
+  if (!interpretarEntero(carga, longitud, tamano) || tamano < TAMANO_BUFFER_MQTT_MINIMO ||
+      tamano > TAMANO_BUFFER_MQTT_MAXIMO)
+  {
+    LOG_AVISO("-> Tamano de buffer MQTT fuera de rango - Comando ignorado");
+    return;
+  }
+  tamanoBufferMQTTPedido = (uint16_t)tamano;
+}
+
+/**
+ * @brief Aplica el tamano de buffer pedido por topicoBufferMQTT, si lo hay
+ *
+ * Solo debe llamarse desde la tarea de red, fuera de clienteMQTT.loop().
+ * Si la reserva falla PubSubClient conserva el buffer anterior.
+ */
+void aplicarBufferMQTT(void)
+{
+  if (tamanoBufferMQTTPedido == 0)
+  {
+    return;
+  }
+
+  uint16_t tamano = tamanoBufferMQTTPedido;
+  tamanoBufferMQTTPedido = 0;
+  if (clienteMQTT.setBufferSize(tamano))
+  {
+    LOG_INFO("-> Buffer MQTT de %u bytes", tamano);
+  }
+  else
+  {
+    LOG_ERROR("-> Sin memoria para un buffer MQTT de %u bytes - Se conserva el de %u", tamano,
+              clienteMQTT.getBufferSize());
+  }
+}
+
+/**
+ * @brief Configuracion de compilacion, la que rige sin configuracion remota
+ */
+void configuracionPorDefecto(ConfiguracionDispositivo &destino)
+{
+  memset(&destino, 0, sizeof(destino));
+  destino.periodoMuestreoMs = DELAY_ENTRE_MUESTRAS;
+  destino.desfaseSensoresMs = DELAY_ENTRE_SENSORES;
+  destino.keepAliveS = KEEP_ALIVE_MQTT;
+  destino.muestrasPorEntrega = NUMERO_MUESTRAS;
+  for (uint8_t p = 0; p < NUMERO_PREFIJOS; p++)
+  {
+    snprintf(destino.prefijos[p], sizeof(destino.prefijos[p]), "%s", PREFIJOS_TOPICO[p]);
+  }
+}
+
+/**
+ * @brief Comprueba los limites que dependen de la aplicacion
+ *
+ * Las muestras deben caber en la ventana de los filtros, cada topico de
+ * canal y de servicio en LONGITUD_TOPICO_CANAL y cada regla debe vigilar
+ * un canal y manejar una salida que existan.
+ */
+bool configuracionValida(const ConfiguracionDispositivo &candidata)
+{
+  if (candidata.muestrasPorEntrega < 1 || candidata.muestrasPorEntrega > VENTANA_FILTRO_CANAL ||
+      candidata.periodoMuestreoMs < PERIODO_MUESTREO_MINIMO_MS ||
+      candidata.desfaseSensoresMs > DESFASE_SENSORES_MAXIMO_MS || candidata.keepAliveS < KEEP_ALIVE_MINIMO_S ||
+      candidata.numeroReglas > MAX_REGLAS)
+  {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < candidata.numeroReglas; i++)
+  {
+    const Regla &regla = candidata.reglas[i];
+    if (!MotorReglas::reglaValida(regla) || regla.canal >= NUMERO_CANALES ||
+        (regla.salida != SALIDA_NINGUNA && regla.salida >= NUMERO_SALIDAS))
+    {
+      return false;
+    }
+  }
+
+  char topico[LONGITUD_TOPICO_CANAL];
+  for (uint8_t canal = 0; canal < NUMERO_CANALES; canal++)
+  {
+    if (!armarTopicoCanal(candidata, canal, topico))
+    {
+      return false;
+    }
+  }
+  const char *const sufijos[] = {SUFIJO_TOPICO_TRAMA, SUFIJO_TOPICO_REENVIO, SUFIJO_TOPICO_DIAGNOSTICO,
+                                 SUFIJO_TOPICO_BITACORA, SUFIJO_TOPICO_CICLO_SUENO, SUFIJO_TOPICO_ALARMA};
+  for (uint8_t i = 0; i < sizeof(sufijos) / sizeof(sufijos[0]); i++)
+  {
+    if (!armarTopicoServicio(candidata, sufijos[i], topico))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Manejador del topico de configuracion propio del equipo (retenido)
+ *
+ * El mensaje se interpreta sobre la configuracion de compilacion (ver
+ * configuracion_remota.h). Uno invalido se descarta entero; uno con la
+ * version en uso, como el que el broker reenvia en cada reconexion, no
+ * cambia nada. El resto queda pendiente para aplicarConfiguracion().
+ *
+ * @param carga Carga del mensaje
+ * @param longitud Longitud de la carga
+ * @param contexto No utilizado
+ */
+void comandoConfiguracion(const uint8_t *carga, unsigned int longitud, void *contexto)
+{
+  (void)contexto;
+
+  ConfiguracionDispositivo recibida;
+  configuracionPorDefecto(recibida);
+  if (!interpretarConfiguracion(carga, longitud, recibida))
+  {
+    LOG_AVISO("-> Configuracion mal formada - Ignorada");
+    return;
+  }
+  if (!configuracionValida(recibida))
+  {
+    LOG_AVISO("-> Configuracion %u fuera de rango - Ignorada", (unsigned)recibida.version);
+    return;
+  }
+  if (recibida.version == configuracion.version)
+  {
+    LOG_DEPURACION("-> Configuracion %u ya aplicada", (unsigned)recibida.version);
+    return;
+  }
+
+  configuracionPedida = recibida;
+  configuracionPendiente = true;
+}
+
+/**
+ * @brief Aplica la configuracion pedida por comandoConfiguracion(), si la hay
+ *
+ * Solo debe llamarse desde la tarea de red, fuera de clienteMQTT.loop():
+ * rearma los topicos que usa esa tarea, pasa el muestreo a la tarea de
+ * adquisicion y guarda la configuracion en NVS. El keep alive rige desde
+ * la proxima sesion MQTT.
+ */
+void aplicarConfiguracion(void)
+{
+  if (!configuracionPendiente)
+  {
+    return;
+  }
+  configuracionPendiente = false;
+
+  configuracion = configuracionPedida;
+  armarTopicos(configuracion);
+  // Con topicos nuevos el siguiente valor de cada canal se publica siempre
+  for (uint8_t i = 0; i < NUMERO_CANALES; i++)
+  {
+    reportesCanales[i].reiniciar();
+  }
+#if !MODO_SUENO_PROFUNDO
+  // En modo de sueno el muestreo nuevo rige desde el proximo despertar
+  if (!colaConfiguracion.encolar(configuracion))
+  {
+    LOG_AVISO("-> Cola de configuracion llena - El muestreo no cambia");
+  }
+#endif
+  if (!guardarConfiguracion(configuracion))
+  {
+    LOG_ERROR("-> No se pudo guardar la configuracion en NVS");
+  }
+
+  LOG_INFO("-> Configuracion %u: %u muestras cada %u ms, desfase %u ms, keep-alive %u s, %u reglas",
+           (unsigned)configuracion.version, configuracion.muestrasPorEntrega, configuracion.periodoMuestreoMs,
+           configuracion.desfaseSensoresMs, configuracion.keepAliveS, configuracion.numeroReglas);
+}
+
+/**
+ * @brief Espera maxima para completar un ciclo de todas las tareas
+ */
+uint32_t periodoTramaMs(void)
+{
+  return (uint32_t)configuracion.muestrasPorEntrega * configuracion.periodoMuestreoMs;
+}
+
+#if OTA_POR_MQTT
+/**
+ * @brief Manejador de topicoOTAInicio: anuncia una imagen o cancela la transferencia
+ *
+ * La carga es "<bytes> <sha256>", con el hash en 64 digitos hexadecimales,
+ * o "cancelar". Anunciar otra vez la imagen en curso la reanuda: el
+ * siguiente mensaje en topicoOTAEstado pide el bloque que falta.
+ *
+ * @param carga Carga del mensaje
+ * @param longitud Longitud de la carga
+ * @param contexto No utilizado
+ */
+void comandoInicioOTA(const uint8_t *carga, unsigned int longitud, void *contexto)
+{
+  (void)contexto;
+
+  if (cargaIgual(carga, longitud, "cancelar"))
+  {
+    actualizacionOTA.cancelar();
+    LOG_INFO("-> Actualizacion de firmware cancelada");
+    return;
+  }
+
+  unsigned int espacio = 0;
+  while (espacio < longitud && carga[espacio] != ' ')
+  {
+    espacio++;
+  }
+  int32_t tamano;
+  uint8_t hash[LONGITUD_HASH_OTA];
+  if (espacio >= longitud || !interpretarEntero(carga, espacio, tamano) || tamano <= 0 ||
+      !interpretarHexadecimal(carga + espacio + 1, longitud - espacio - 1, hash, sizeof(hash)))
+  {
+    LOG_AVISO("-> Anuncio de firmware invalido - Comando ignorado");
+    return;
+  }
+
+  if (!actualizacionOTA.iniciar((uint32_t)tamano, hash))
+  {
+    LOG_AVISO("-> Hay otra imagen en curso o lista - Cancelarla antes");
+    return;
+  }
+  avisoOTA.vigente = false; // Responder enseguida con el pedido del siguiente bloque
+  LOG_INFO("-> Actualizacion de firmware de %u bytes desde el byte %u", (unsigned)tamano,
+           (unsigned)actualizacionOTA.siguienteDesplazamiento());
+}
+
+/**
+ * @brief Manejador de topicoOTABloque: un bloque de la imagen
+ *
+ * Los cuatro primeros bytes son el desplazamiento del bloque, en big
+ * endian. Solo se acepta el bloque pedido; uno repetido o tardio se
+ * descarta sin mas, porque el pedido siguiente ya lo corrige.
+ *
+ * @param carga Carga del mensaje
+ * @param longitud Longitud de la carga
+ * @param contexto No utilizado
+ */
+void comandoBloqueOTA(const uint8_t *carga, unsigned int longitud, void *contexto)
+{
+  (void)contexto;
+
+  if (longitud <= 4 || longitud - 4 > TAMANO_BLOQUE_OTA)
+  {
+    LOG_AVISO("-> Bloque de firmware de %u bytes - Descartado", longitud);
+    return;
+  }
+  uint32_t desplazamiento = (uint32_t)carga[0] << 24 | (uint32_t)carga[1] << 16 | (uint32_t)carga[2] << 8 | carga[3];
+  if (!actualizacionOTA.recibirBloque(desplazamiento, carga + 4, (uint16_t)(longitud - 4)))
+  {
+    LOG_DEPURACION("-> Bloque de firmware en %u descartado (se espera %u)", (unsigned)desplazamiento,
+                   (unsigned)actualizacionOTA.siguienteDesplazamiento());
+  }
+}
+#endif
+
+/**
+ * @brief Publica en topicoOTAEstado los cambios de la actualizacion y pide bloques
+ *
+ * En OTA_RECIBIENDO cada mensaje pide un bloque: el que empieza en
+ * "offset", de a lo sumo "max" bytes (lo que cabe en el buffer MQTT). Se
+ * pide el siguiente en cuanto hay lugar en la cola de escritura, y se
+ * repite el pedido si el bloque no llega en REPETICION_PEDIDO_OTA_MS o si
+ * la sesion MQTT es nueva. Con la imagen lista, reinicia tras
+ * ESPERA_REINICIO_OTA_MS para dar tiempo a que salga el aviso.
+ *
+ * Solo debe llamarse desde la tarea de red, con MQTT conectado.
+ *
+ * @param ahoraMs Tiempo actual en milisegundos
+ */
+void atenderOTA(uint32_t ahoraMs)
+{
+#if OTA_POR_MQTT
+  EstadoOTA estado = actualizacionOTA.estado();
+  if (estado == OTA_PREPARANDO || (estado == OTA_RECIBIENDO && !actualizacionOTA.aceptaBloque()))
+  {
+    return; // Se avisa al quedar lugar para el bloque
+  }
+
+  uint32_t siguiente = actualizacionOTA.siguienteDesplazamiento();
+  if (avisoOTA.vigente && estado == avisoOTA.estado &&
+      (estado != OTA_RECIBIENDO ||
+       (siguiente == avisoOTA.pedido && ahoraMs - avisoOTA.publicadoMs < REPETICION_PEDIDO_OTA_MS)))
+  {
+    if (estado == OTA_LISTA && ahoraMs - avisoOTA.publicadoMs >= ESPERA_REINICIO_OTA_MS)
+    {
+      LOG_INFO("-> Reiniciando con el firmware nuevo");
+      ESP.restart();
+    }
+    return;
+  }
+
+  char mensaje[128];
+  int longitud;
+  if (estado == OTA_RECIBIENDO)
+  {
+    uint32_t cabe = clienteMQTT.getBufferSize() - SOBRECOSTO_BLOQUE_OTA;
+    longitud = snprintf(mensaje, sizeof(mensaje), "{\"estado\":\"%s\",\"offset\":%u,\"tamano\":%u,\"max\":%u}",
+                        NOMBRES_ESTADO_OTA[estado], (unsigned)siguiente, (unsigned)actualizacionOTA.tamano(),
+                        (unsigned)(cabe < TAMANO_BLOQUE_OTA ? cabe : TAMANO_BLOQUE_OTA));
+  }
+  else if (estado == OTA_FALLIDA)
+  {
+    longitud = snprintf(mensaje, sizeof(mensaje), "{\"estado\":\"%s\",\"motivo\":\"%s\"}", NOMBRES_ESTADO_OTA[estado],
+                        actualizacionOTA.motivo());
+  }
+  else
+  {
+    longitud = snprintf(mensaje, sizeof(mensaje), "{\"estado\":\"%s\"}", NOMBRES_ESTADO_OTA[estado]);
+  }
+
+  if (longitud <= 0 || !clienteMQTT.publish(topicoOTAEstado, (const uint8_t *)mensaje, (unsigned int)longitud))
+  {
+    return; // Se reintenta en la proxima vuelta
+  }
+  if (estado != avisoOTA.estado)
+  {
+    if (estado == OTA_FALLIDA)
+    {
+      LOG_ERROR("-> Actualizacion de firmware fallida: %s", actualizacionOTA.motivo());
+    }
+    else if (estado == OTA_LISTA)
+    {
+      LOG_INFO("-> Firmware nuevo verificado (%u bytes)", (unsigned)actualizacionOTA.tamano());
+    }
+  }
+  avisoOTA.vigente = true;
+  avisoOTA.estado = estado;
+  avisoOTA.pedido = siguiente;
+  avisoOTA.publicadoMs = ahoraMs;
+#else
+  (void)ahoraMs;
+#endif
+}
+
+#if MODO_OTA
+/**
+ * @brief Deja la validacion del firmware nuevo a validarFirmware()
+ *
+ * Sin esto el nucleo de Arduino lo da por bueno al arrancar, antes de
+ * saber si logra conectarse.
+ */
+extern "C" bool verifyRollbackLater(void)
+{
+  return true;
+}
+#endif
+
+/**
+ * @brief Confirma un firmware recien actualizado o vuelve al anterior
+ *
+ * El firmware nuevo se da por bueno con la primera sesion MQTT: para
+ * entonces funcionan WiFi, TLS y el broker, y con ellos el camino de la
+ * proxima actualizacion. Si no lo logra en TIEMPO_VALIDACION_OTA_MS se
+ * marca invalido y se reinicia en el anterior; si se cuelga o se reinicia
+ * antes, el bootloader vuelve al anterior por su cuenta.
+ *
+ * @param conectado Hay sesion MQTT
+ * @param ahoraMs Tiempo actual en milisegundos
+ */
+void validarFirmware(bool conectado, uint32_t ahoraMs)
+{
+#if MODO_OTA
+  if (!validacionOTAPendiente)
+  {
+    return;
+  }
+
+  if (conectado)
+  {
+    validacionOTAPendiente = false;
+    if (ActualizacionOTA::confirmarArranque())
+    {
+      LOG_INFO("-> Firmware nuevo confirmado");
+    }
+    else
+    {
+      LOG_ERROR("-> No se pudo confirmar el firmware nuevo");
+    }
+  }
+  else if (ahoraMs >= TIEMPO_VALIDACION_OTA_MS)
+  {
+    LOG_ERROR("-> Firmware nuevo sin MQTT en %u s - Volviendo al anterior", (unsigned)(ahoraMs / 1000));
+    ActualizacionOTA::revertir();
+  }
+#else
+  (void)conectado;
+  (void)ahoraMs;
+#endif
+}
+
+/**
+ * @brief Lleva los actuadores al estado de sus bobinas y de las reglas
+ *
+ * Al apagarse, el LED queda apagado al menos TIEMPO_LED_APAGADO_MS; un
+ * encendido pedido en ese lapso espera a que venza. Solo la tarea de
+ * adquisicion: la llama en cada vuelta, a lo sumo cada
+ * PERIODO_ACTUADORES_MS, y en el acto con cada cambio de las reglas.
+ *
+ * @param ahoraMs Tiempo actual en milisegundos
+ */
+void actualizarActuadores(uint32_t ahoraMs)
+{
+  if (estadoLED.bloqueado && (int32_t)(ahoraMs - estadoLED.desbloqueoMs) >= 0)
+  {
+    estadoLED.bloqueado = false;
+  }
+
+  // Una regla activa sobre el LED lo mantiene encendido aunque la bobina este apagada
+  bool deseado = tablaRegistros.coil(COIL_LED) || (salidasReglas & (1UL << SALIDA_LED));
+  if (!deseado && estadoLED.encendido)
+  {
+    digitalWrite(PIN_LED_INDICADOR, LOW);
+    estadoLED.encendido = false;
+    estadoLED.bloqueado = true;
+    estadoLED.desbloqueoMs = ahoraMs + TIEMPO_LED_APAGADO_MS;
+    LOG_INFO("-> LED apagado");
+  }
+  else if (deseado && !estadoLED.encendido && !estadoLED.bloqueado)
+  {
+    digitalWrite(PIN_LED_INDICADOR, HIGH);
+    estadoLED.encendido = true;
+    LOG_INFO("-> LED encendido");
+  }
+}
+
+/**
+ * @brief Configura e inicia la conexion WiFi
+ *
+ * Solo lanza la asociacion y regresa: la espera, los reintentos y la
+ * informacion de red los maneja gestionarConexion() desde la tarea de red.
+ */
+void configurarWiFi(void)
+{
+  imprimirSeparador(50);
+  LOG_INFO("CONFIGURANDO CONEXION WiFi");
+  imprimirSeparador(50);
+
+  // Los reintentos los gobierna la maquina de conexion con su backoff; la
+  // configuracion va a cacheRed, no a NVS, para no escribir flash en cada intento
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);
+
+  LOG_INFO("Red WiFi: %s", wifissid);
+
+  // Inicializar generador de numeros aleatorios (fluctuacion del backoff)
+  randomSeed(micros());
+
+  imprimirSeparador(50);
+}
+
+/**
+ * @brief Lanza la asociacion WiFi, dirigida si hay datos en cacheRed
+ *
+ * Con BSSID y canal conocidos el driver no escanea, y con la concesion
+ * anterior como IP estatica, si REUSAR_CONCESION_DHCP y aun no vence, no
+ * espera al DHCP. Sin cache se hace la asociacion normal con DHCP.
+ */
+void iniciarAsociacionWiFi(void)
+{
+  asociacionDirigida = cacheRed.magia == MAGIA_CACHE_RED;
+  concesionReusada = false;
+  if (!asociacionDirigida)
+  {
+    LOG_INFO("-> Asociando a la red WiFi (escaneo y DHCP)...");
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());
+    WiFi.begin(wifissid, wifipass);
+    return;
+  }
+
+  LOG_INFO("-> Asociando a la red WiFi (canal %u, sin escaneo)...", cacheRed.canal);
+  if (REUSAR_CONCESION_DHCP && cacheRed.ip != 0 && cacheRed.concesionVenceS != 0 &&
+      (int32_t)((uint32_t)time(NULL) - cacheRed.concesionVenceS) < 0)
+  {
+    concesionReusada = true;
+    WiFi.config(IPAddress(cacheRed.ip), IPAddress(cacheRed.puertaEnlace), IPAddress(cacheRed.mascara),
+                IPAddress(cacheRed.dns));
+  }
+  else
+  {
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());
+  }
+  WiFi.begin(wifissid, wifipass, cacheRed.canal, cacheRed.bssid, true);
+}
+
+/**
+ * @brief Duracion en segundos de la concesion DHCP de la interfaz de estacion, 0 si no se conoce
+ */
+uint32_t duracionConcesionDHCP(void)
+{
+  esp_netif_t *interfaz = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+  struct netif *netif = interfaz != NULL ? (struct netif *)esp_netif_get_netif_impl(interfaz) : NULL;
+  struct dhcp *dhcp = netif != NULL ? netif_dhcp_data(netif) : NULL;
+  return dhcp != NULL ? dhcp->offered_t0_lease : 0;
+}
+
+/**
+ * @brief Muestra la informacion de la red al quedar asociado y la guarda en cacheRed
+ */
+void mostrarInformacionRed(void)
+{
+  LOG_INFO("-> WiFi conectado exitosamente%s", asociacionDirigida ? " (reconexion rapida)" : "");
+  LOG_INFO("Informacion de red:");
+  LOG_INFO("  * Direccion IP: %s", WiFi.localIP().toString().c_str());
+  LOG_INFO("  * Direccion DNS: %s", WiFi.dnsIP().toString().c_str());
+
+  // El broker se resuelve de nuevo solo si cambio la red
+  if (!asociacionDirigida)
+  {
+    cacheRed.ipBroker = 0;
+  }
+
+  memcpy(cacheRed.bssid, WiFi.BSSID(), sizeof(cacheRed.bssid));
+  cacheRed.canal = (uint8_t)WiFi.channel();
+  // Una concesion reusada conserva su vencimiento; una nueva lo toma del DHCP
+  if (!concesionReusada)
+  {
+    uint32_t concesionS = duracionConcesionDHCP();
+    cacheRed.concesionVenceS = concesionS > 0 ? (uint32_t)time(NULL) + concesionS / 2 : 0;
+  }
+  cacheRed.ip = (uint32_t)WiFi.localIP();
+  cacheRed.puertaEnlace = (uint32_t)WiFi.gatewayIP();
+  cacheRed.mascara = (uint32_t)WiFi.subnetMask();
+  cacheRed.dns = (uint32_t)WiFi.dnsIP();
+  cacheRed.magia = MAGIA_CACHE_RED;
+}
+
+/**
+ * @brief Entrega a clienteTLS la IP del broker, resolviendola solo si vencio
+ *
+ * Si la resolucion falla, clienteTLS vuelve a consultar el DNS al conectar.
+ */
+void prepararDireccionBroker(void)
+{
+  uint32_t ahoraS = (uint32_t)time(NULL);
+  if (cacheRed.ipBroker == 0 || (int32_t)(ahoraS - cacheRed.brokerVenceS) >= 0)
+  {
+    IPAddress ip;
+    if (WiFi.hostByName(mqtt_host, ip))
+    {
+      cacheRed.ipBroker = (uint32_t)ip;
+      cacheRed.brokerVenceS = ahoraS + TTL_IP_BROKER_S;
+      LOG_INFO("  * Servidor MQTT: %s (DNS)", ip.toString().c_str());
+    }
+    else
+    {
+      cacheRed.ipBroker = 0;
+      LOG_AVISO("  * Error resolviendo servidor MQTT");
+    }
+  }
+
+  clienteTLS.establecerDireccionResuelta(IPAddress(cacheRed.ipBroker));
+}
+
+/**
+ * @brief Configura la conexion MQTT segura
+ *
+ * Esta funcion configura el cliente MQTT con:
+ * - Certificados CA para conexion segura
+ * - Parametros de conexion del servidor
+ * - Configuracion de keep-alive
+ * - Funcion de callback para mensajes entrantes
+ * - ID de cliente unico por chip, para que dos equipos no se expulsen
+ *   mutuamente del broker
+ */
+void configurarMQTT(void)
+{
+  LOG_INFO("CONFIGURANDO CONEXION MQTT SEGURA");
+  imprimirSeparador(50);
+
+  // Configurar certificados CA para conexion segura
+  clienteTLS.establecerBundleCA(rootca_crt_bundle_start);
+  clienteTLS.establecerTimeout(TIMEOUT_TLS_MS);
+
+#if REANUDACION_TLS_RTC
+  // Recuperar la sesion TLS anterior al sueno profundo, si la hay
+  if (longitudSesionTLSRTC > 0 && clienteTLS.importarSesion(sesionTLSRTC, longitudSesionTLSRTC))
+  {
+    LOG_INFO("-> Sesion TLS recuperada de memoria RTC");
+  }
+#endif
+
+  // Configurar servidor MQTT
+  clienteMQTT.setServer(mqtt_host, mqtt_port);
+  clienteMQTT.setKeepAlive(configuracion.keepAliveS);
+  clienteMQTT.setBufferSize(TAMANO_BUFFER_MQTT);
+  clienteMQTT.setCallback(callbackMQTT);
+
+  // La MAC del eFuse viene con el primer byte en la parte baja
+  uint64_t mac = ESP.getEfuseMac();
+  snprintf(idClienteMQTT, sizeof(idClienteMQTT), PREFIJO_ID_CLIENTE "%02X%02X%02X%02X%02X%02X",
+           (unsigned)(uint8_t)mac, (unsigned)(uint8_t)(mac >> 8), (unsigned)(uint8_t)(mac >> 16),
+           (unsigned)(uint8_t)(mac >> 24), (unsigned)(uint8_t)(mac >> 32), (unsigned)(uint8_t)(mac >> 40));
+
+  LOG_INFO("-> Cliente MQTT configurado");
+  LOG_INFO("  * ID de cliente: %s", idClienteMQTT);
+  LOG_INFO("  * Servidor: %s", mqtt_host);
+  LOG_INFO("  * Puerto: %d", mqtt_port);
+  LOG_INFO("  * Keep-alive: %u segundos", (unsigned)configuracion.keepAliveS);
+  imprimirSeparador(50);
+}
+
+/**
+ * @brief Hace un intento de conexion al servidor MQTT
+ *
+ * La sesion es persistente (cleanSession = false): el broker conserva las
+ * suscripciones y los mensajes QoS 1 pendientes entre conexiones.
+ *
+ * Si el intento tiene exito:
+ * - Reenvia los mensajes QoS 1 que quedaron sin PUBACK
+ * - Se suscribe a los topicos necesarios
+ * - Publica mensajes de prueba para verificar la conexion
+ * - Guarda la sesion TLS negociada
+ *
+ * No espera ni reintenta: eso lo decide gestionarConexion() con su
+ * backoff.
+ *
+ * @return true si la sesion MQTT quedo establecida
+ */
+bool reconectarMQTT(void)
+{
+  LOG_INFO("Intentando conexion MQTT...");
+
+  // El keep alive va en el CONNECT: uno cambiado por configuracion rige desde aqui
+  clienteMQTT.setKeepAlive(configuracion.keepAliveS);
+
+  // Intentar conectar con credenciales, sin testamento y con sesion persistente
+  if (!clienteMQTT.connect(idClienteMQTT, mqtt_user, mqtt_pass, NULL, 0, false, NULL, false))
+  {
+    LOG_AVISO("-> Error de conexion MQTT, codigo: %d", clienteMQTT.state());
+    return false;
+  }
+
+  LOG_INFO("-> Conectado exitosamente");
+  LOG_INFO("  * Handshake TLS %s en %u ms",
+           clienteTLS.ultimaConexionReanudada() ? "reanudado" : "completo",
+                (unsigned)(clienteTLS.duracionUltimoHandshakeUs() / 1000));
+  diagnostico.handshakeTLS.registrar(clienteTLS.duracionUltimoHandshakeUs());
+  diagnostico.reconexionesMQTT++;
+
+  uint8_t reenviados = clienteQoS1.reenviarPendientes();
+  if (reenviados > 0)
+  {
+    LOG_INFO("-> Reenviados %u mensajes QoS 1 sin confirmar", reenviados);
+  }
+
+#if REANUDACION_TLS_RTC
+  // Guardar la sesion negociada para el proximo despertar
+  longitudSesionTLSRTC = (uint16_t)clienteTLS.exportarSesion(sesionTLSRTC, sizeof(sesionTLSRTC));
+#endif
+
+  // Suscribirse a los topicos de control registrados
+  for (uint8_t i = 0; i < enrutadorComandos.rutas(); i++)
+  {
+    if (clienteMQTT.subscribe(enrutadorComandos.topico(i)))
+    {
+      LOG_INFO("-> Suscrito a topico de control %s", enrutadorComandos.topico(i));
+    }
+  }
+
+#if !MODO_SUENO_PROFUNDO
+  // Publicar mensajes de prueba HTTP (no en cada despertar del modo de sueno)
+  LOG_INFO("Publicando mensajes de prueba HTTP:");
+  clienteMQTT.publish("EIE_SEDE1_http/alphanumeric", "Sistema ESP32 operativo");
+  clienteMQTT.publish("EIE_SEDE2_http/numeric", "123.45");
+  clienteMQTT.publish("EIE_SEDE2_http/int", "123");
+  clienteMQTT.publish("EIE_SEDE2_http/boolean", "true");
+  // Hora UTC en segundos; null hasta la primera sincronizacion SNTP
+  char ejemploJSON[80];
+  char segundos[MAX_CARACTERES_ENTERO64 + 1] = "null";
+  int64_t ahoraUs;
+  if (relojUTC.ahoraUTC(ahoraUs))
+  {
+    snprintf(segundos, sizeof(segundos), "%lld", (long long)(ahoraUs / 1000000));
+  }
+  snprintf(ejemploJSON, sizeof(ejemploJSON), "{\"sistema\":\"ESP32\",\"estado\":\"operativo\",\"timestamp\":%s}",
+           segundos);
+  clienteMQTT.publish("EIE_SEDE2_http/ejemploJSON", ejemploJSON);
+
+  // Publicar mensajes de prueba Modbus
+  LOG_INFO("Publicando mensajes de prueba Modbus:");
+  clienteMQTT.publish("EIE_SEDE2_modbus/1/string/8", "Test desde ESP32");
+  clienteMQTT.publish("EIE_SEDE2_modbus/1/holding/0", "123.45");
+  clienteMQTT.publish("EIE_SEDE2_modbus/1/input/0", "123");
+
+  LOG_INFO("-> Mensajes de prueba publicados");
+#endif
+
+#if MODO_OTA
+  // Una transferencia interrumpida se reanuda pidiendo de nuevo el bloque que falta
+  avisoOTA.vigente = false;
+#endif
+
+  // Tras una reconexion el siguiente valor de cada canal se publica siempre
+  for (uint8_t i = 0; i < NUMERO_CANALES; i++)
+  {
+    reportesCanales[i].reiniciar();
+  }
+
+  return true;
+}
+
+/**
+ * @brief Cambia el estado de la maquina de conexion
+ * @param estado Estado nuevo
+ * @param ahoraMs Marca de tiempo actual
+ * @param esperaMs Tiempo minimo antes del proximo intento
+ */
+void cambiarEstadoConexion(EstadoConexion estado, uint32_t ahoraMs, uint32_t esperaMs)
+{
+  conexion.estado = estado;
+  conexion.inicioEstadoMs = ahoraMs;
+  conexion.proximoIntentoMs = ahoraMs + esperaMs;
+}
+
+/**
+ * @brief Maquina de estados no bloqueante de la conexion WiFi y MQTT
+ *
+ * Se llama en cada vuelta de la tarea de red. Nunca duerme: cuando un
+ * intento falla programa el siguiente con espera exponencial y
+ * fluctuacion aleatoria (Backoff) y regresa. Tras perder una sesion
+ * establecida el primer reintento tambien se retrasa al azar, para que
+ * toda la flota no reconecte a la vez cuando el broker se reinicia.
+ *
+ * @param ahoraMs Marca de tiempo actual
+ */
+void gestionarConexion(uint32_t ahoraMs)
+{
+  bool intentoVencido = (int32_t)(ahoraMs - conexion.proximoIntentoMs) >= 0;
+
+  switch (conexion.estado)
+  {
+  case CONEXION_WIFI_INICIO:
+    if (intentoVencido)
+    {
+      iniciarAsociacionWiFi();
+      cambiarEstadoConexion(CONEXION_WIFI_ESPERANDO, ahoraMs, 0);
+    }
+    break;
+
+  case CONEXION_WIFI_ESPERANDO:
+    if (WiFi.status() == WL_CONNECTED)
+    {
+      backoffWiFi.reiniciar();
+      diagnostico.reconexionesWiFi++;
+      mostrarInformacionRed();
+      cambiarEstadoConexion(CONEXION_MQTT_PENDIENTE, ahoraMs, 0);
+    }
+    else if (asociacionDirigida && ahoraMs - conexion.inicioEstadoMs >= TIMEOUT_ASOCIACION_DIRIGIDA)
+    {
+      // El punto de acceso o la concesion cambiaron: escanear de inmediato
+      LOG_AVISO("-> Reconexion rapida fallida - Escaneando la red");
+      cacheRed.magia = 0;
+      WiFi.disconnect();
+      cambiarEstadoConexion(CONEXION_WIFI_INICIO, ahoraMs, 0);
+    }
+    else if (ahoraMs - conexion.inicioEstadoMs >= TIMEOUT_ASOCIACION_WIFI)
+    {
+      uint32_t esperaMs = backoffWiFi.siguienteEsperaMs();
+      LOG_AVISO("-> WiFi sin asociar - Reintentando en %u ms", (unsigned)esperaMs);
+      WiFi.disconnect();
+      cambiarEstadoConexion(CONEXION_WIFI_INICIO, ahoraMs, esperaMs);
+    }
+    break;
+
+  case CONEXION_MQTT_PENDIENTE:
+    if (WiFi.status() != WL_CONNECTED)
+    {
+      LOG_AVISO("-> WiFi perdido");
+      cambiarEstadoConexion(CONEXION_WIFI_INICIO, ahoraMs, backoffWiFi.esperaInicialMs());
+    }
+    else if (intentoVencido)
+    {
+      prepararDireccionBroker();
+      if (reconectarMQTT())
+      {
+        backoffMQTT.reiniciar();
+        cambiarEstadoConexion(CONEXION_MQTT_CONECTADA, millis(), 0);
+      }
+      else
+      {
+        // La IP guardada pudo cambiar: resolver otra vez en el proximo intento
+        cacheRed.ipBroker = 0;
+        uint32_t esperaMs = backoffMQTT.siguienteEsperaMs();
+        if (asociacionDirigida && backoffMQTT.intentos() >= INTENTOS_MQTT_CON_CACHE)
+        {
+          // Una concesion reusada que ya no es nuestra deja la red muda: pedir DHCP
+          LOG_AVISO("-> MQTT no responde con la red en cache - Reasociando con DHCP");
+          cacheRed.magia = 0;
+          WiFi.disconnect();
+          cambiarEstadoConexion(CONEXION_WIFI_INICIO, millis(), 0);
+          break;
+        }
+        LOG_AVISO("-> Reintentando MQTT en %u ms (intento %u)",
+                  (unsigned)esperaMs, backoffMQTT.intentos());
+        cambiarEstadoConexion(CONEXION_MQTT_PENDIENTE, millis(), esperaMs);
+      }
+    }
+    break;
+
+  case CONEXION_MQTT_CONECTADA:
+    if (!clienteMQTT.connected())
+    {
+      LOG_AVISO("RECONECTANDO AL SERVIDOR MQTT");
+      cambiarEstadoConexion(CONEXION_MQTT_PENDIENTE, ahoraMs, backoffMQTT.esperaInicialMs());
+    }
+    break;
+  }
+}
+
+/* ============================================================================
+ * CONTROLADORES DE SENSOR
+ * ============================================================================ */
+
+/**
+ * @brief Arma el topico de un canal: prefijo mas sufijo, o mas el numero de sensor
+ * @param origen Configuracion de la que se toma el prefijo
+ * @param canal Canal de sensor (CanalSensor)
+ * @param destino LONGITUD_TOPICO_CANAL bytes
+ * @return false si no cabe en LONGITUD_TOPICO_CANAL
+ */
+bool armarTopicoCanal(const ConfiguracionDispositivo &origen, uint8_t canal, char *destino)
+{
+  const DescriptorCanal &descriptor = descriptorCanal(canal);
+  const char *prefijo = origen.prefijos[descriptor.prefijo];
+  size_t capacidad = LONGITUD_TOPICO_CANAL - 1; // Reserva para '\0'
+
+  size_t longitud = strlen(prefijo);
+  if (longitud > capacidad)
+  {
+    return false;
+  }
+  memcpy(destino, prefijo, longitud);
+
+  size_t resto;
+  if (descriptor.sufijo != NULL)
+  {
+    resto = strlen(descriptor.sufijo);
+    if (resto > capacidad - longitud)
+    {
+      return false;
+    }
+    memcpy(destino + longitud, descriptor.sufijo, resto);
+  }
+  else
+  {
+    // Solo la entrada de los DS18B20 no tiene sufijo: el numero es la posicion en el bus
+    resto = formatearEntero(destino + longitud, capacidad - longitud, canal - CANAL_ONEWIRE_BASE);
+    if (resto == 0)
+    {
+      return false;
+    }
+  }
+  destino[longitud + resto] = '\0';
+  return true;
+}
+
+/**
+ * @brief Arma un topico de servicio: el prefijo PREFIJO_SEDE1_HTTP mas el sufijo
+ * @param origen Configuracion de la que se toma el prefijo
+ * @param sufijo Uno de los SUFIJO_TOPICO_*
+ * @param destino LONGITUD_TOPICO_CANAL bytes
+ * @return false si no cabe en LONGITUD_TOPICO_CANAL
+ */
+bool armarTopicoServicio(const ConfiguracionDispositivo &origen, const char *sufijo, char *destino)
+{
+  int longitud = snprintf(destino, LONGITUD_TOPICO_CANAL, "%s%s", origen.prefijos[PREFIJO_SEDE1_HTTP], sufijo);
+  return longitud > 0 && longitud < LONGITUD_TOPICO_CANAL;
+}
+
+/**
+ * @brief Arma los topicos de los canales y de servicio con los prefijos de la configuracion
+ *
+ * Un topico que no cabe queda vacio: ese canal no se publica.
+ */
+void armarTopicos(const ConfiguracionDispositivo &origen)
+{
+  for (uint8_t canal = 0; canal < NUMERO_CANALES; canal++)
+  {
+    if (!armarTopicoCanal(origen, canal, topicosCanales[canal]))
+    {
+      topicosCanales[canal][0] = '\0';
+      LOG_ERROR("-> Topico del canal %u no cabe en %u bytes", canal, (unsigned)LONGITUD_TOPICO_CANAL);
+    }
+  }
+
+  bool completos = armarTopicoServicio(origen, SUFIJO_TOPICO_TRAMA, topicosServicio.trama);
+  completos = armarTopicoServicio(origen, SUFIJO_TOPICO_REENVIO, topicosServicio.reenvio) && completos;
+  completos = armarTopicoServicio(origen, SUFIJO_TOPICO_DIAGNOSTICO, topicosServicio.diagnostico) && completos;
+  completos = armarTopicoServicio(origen, SUFIJO_TOPICO_BITACORA, topicosServicio.bitacora) && completos;
+  completos = armarTopicoServicio(origen, SUFIJO_TOPICO_CICLO_SUENO, topicosServicio.cicloSueno) && completos;
+  completos = armarTopicoServicio(origen, SUFIJO_TOPICO_ALARMA, topicosServicio.alarma) && completos;
+  if (!completos)
+  {
+    LOG_ERROR("-> Algun topico de servicio no cabe en %u bytes", (unsigned)LONGITUD_TOPICO_CANAL);
+  }
+}
+
+/**
+ * @brief Construye el filtro de cada canal segun REGISTRO_CANALES y los topicos segun la configuracion
+ */
+void inicializarCanales(void)
+{
+  for (uint8_t canal = 0; canal < NUMERO_CANALES; canal++)
+  {
+    canales[canal].filtro = FiltroCanal(descriptorCanal(canal));
+    canales[canal].recientes = 0;
+  }
+  armarTopicos(configuracion);
+}
+
+/**
+ * @brief Controlador del sensor ultrasonico: una salida, la distancia en cm
+ *
+ * Cada consulta recoge el eco del disparo anterior, medido en segundo
+ * plano por interrupcion (EcoUltrasonico), y lanza el siguiente disparo.
+ * Un eco que no llega dentro de TIMEOUT_ECO_US es una lectura invalida.
+ */
+class ControladorDistancia
+{
+public:
+  explicit ControladorDistancia(EcoUltrasonico &eco) : eco(eco), distancia(NAN)
+  {
+  }
+
+  bool consultar(uint32_t ahoraMs)
+  {
+    (void)ahoraMs;
+    EstadoEco estado = eco.consultar();
+    if (estado == ECO_ESPERANDO)
+    {
+      // Periodo de tarea menor que el timeout: esperar al siguiente tick
+      return false;
+    }
+
+    // Lanzar la siguiente medicion antes de procesar la anterior
+    uint32_t duracion = eco.duracionUs();
+    eco.disparar();
+
+    if (estado == ECO_INACTIVO)
+    {
+      return false;
+    }
+
+    distancia = estado == ECO_COMPLETO ? (duracion * 0.0343) / 2 : NAN; // Velocidad del sonido (cm/us)
+    return true;
+  }
+
+  uint8_t salidas(void) const
+  {
+    return 1;
+  }
+
+  float leer(uint8_t salida) const
+  {
+    (void)salida;
+    return distancia;
+  }
+
+private:
+  EcoUltrasonico &eco;
+  float distancia;
+};
+
+/**
+ * @brief Controlador de los DHT: temperatura y humedad de cada sensor del lector
+ *
+ * La salida 2 * i es la temperatura del sensor i y la 2 * i + 1 su
+ * humedad. El lector dispara todos los sensores juntos y respeta
+ * INTERVALO_MINIMO_DHT_MS, asi que solo algunas consultas traen lectura;
+ * un sensor que fallo en ella aporta NaN.
+ */
+class ControladorDHT
+{
+public:
+  explicit ControladorDHT(LectorDHTRMT &lector) : lector(lector)
+  {
+  }
+
+  bool consultar(uint32_t ahoraMs)
+  {
+    lector.actualizar(ahoraMs);
+
+    bool nuevas = false;
+    for (uint8_t i = 0; i < lector.cantidadSensores(); i++)
+    {
+      if (lector.lectura(i, valores[2 * i], valores[2 * i + 1]))
+      {
+        nuevas = true;
+      }
+      else
+      {
+        valores[2 * i] = NAN;
+        valores[2 * i + 1] = NAN;
+      }
+    }
+    return nuevas;
+  }
+
+  uint8_t salidas(void) const
+  {
+    return (uint8_t)(2 * lector.cantidadSensores());
+  }
+
+  float leer(uint8_t salida) const
+  {
+    return valores[salida];
+  }
 
-/* ============================================================================
- * FUNCIONES AUXILIARES
- * ============================================================================ */
+private:
+  LectorDHTRMT &lector;
+  float valores[2 * MAX_SENSORES_DHT_RMT];
+};
 
 /**
- * @brief Imprime una linea separadora de caracteres
- * @param longitud Numero de caracteres a imprimir
+ * @brief Enumera los DS18B20 del bus y configura su resolucion y modo
+ *
+ * Recorre el bus una sola vez y guarda hasta MAX_SENSORES_ONEWIRE
+ * direcciones ROM validas en direccionesOneWire, para que las lecturas se
+ * hagan por direccion sin volver a buscar. Aplica
+ * RESOLUCION_SENSORES_ONEWIRE a cada sensor y, en modo asincrono,
+ * desactiva la espera interna de requestTemperatures(). El tiempo de
+ * conversion se calcula para la resolucion mas alta del bus.
  */
-void imprimirSeparador(int longitud)
+void configurarSensoresOneWire(void)
 {
-  for (int i = 0; i < longitud; i++)
+  uint8_t resolucionMaxima = 9;
+  DeviceAddress direccion;
+
+  numeroSensoresOneWire = 0;
+  oneWire.reset_search();
+  while (numeroSensoresOneWire < MAX_SENSORES_ONEWIRE && oneWire.search(direccion))
   {
-    Serial.print("=");
+    if (!sensoresTemperatura.validAddress(direccion) || !sensoresTemperatura.validFamily(direccion))
+    {
+      continue;
+    }
+
+    uint8_t indice = numeroSensoresOneWire++;
+    memcpy(direccionesOneWire[indice], direccion, sizeof(DeviceAddress));
+
+    uint8_t resolucion = indice < NUMERO_RESOLUCIONES_ONEWIRE ? RESOLUCION_SENSORES_ONEWIRE[indice]
+                                                              : RESOLUCION_DS18B20_DEFECTO;
+    sensoresTemperatura.setResolution(direccionesOneWire[indice], resolucion);
+    if (resolucion > resolucionMaxima)
+    {
+      resolucionMaxima = resolucion;
+    }
   }
-  Serial.println();
-}
 
-/* ============================================================================
- * FUNCIONES PRINCIPALES
- * ============================================================================ */
+  conversionOneWire.duracionMs = sensoresTemperatura.millisToWaitForConversion(resolucionMaxima);
+  conversionOneWire.alimentacionParasita = sensoresTemperatura.isParasitePowerMode();
+  sensoresTemperatura.setWaitForConversion(!MODO_DS18B20_ASINCRONO);
+
+  LOG_INFO("-> Bus OneWire: %u sensores, conversion de %u ms (%s)",
+           numeroSensoresOneWire, (unsigned)conversionOneWire.duracionMs,
+           MODO_DS18B20_ASINCRONO ? "asincrona" : "bloqueante");
+}
 
 /**
- * @brief Funcion de callback para mensajes MQTT entrantes
+ * @brief Controlador del bus OneWire: la temperatura de cada DS18B20 enumerado
  *
- * Esta funcion se ejecuta cada vez que se recibe un mensaje MQTT en los
- * topicos a los que esta suscrito el ESP32. Maneja comandos para controlar
- * el LED indicador y otros actuadores.
- *
- * @param topic Topico MQTT donde se recibio el mensaje
- * @param payload Puntero al array de bytes del mensaje
- * @param length Longitud del payload en bytes
+ * - Una sola conversion global (Skip ROM) para todos los sensores, de modo
+ *   que leer N sensores cuesta un tiempo de conversion y no N
+ * - Lee cada sensor por su direccion ROM en cache, sin buscar en el bus
+ * - Un sensor desconectado aporta NaN
  *
- * @note La funcion es segura en memoria y no lee mas alla del buffer
+ * En modo asincrono (MODO_DS18B20_ASINCRONO) una consulta inicia la
+ * conversion y regresa de inmediato; las siguientes solo comprueban si
+ * vencio el tiempo de conversion o si el bus ya la reporta terminada, y
+ * entonces leen el resultado. En modo bloqueante cada consulta espera la
+ * conversion completa dentro de requestTemperatures().
  */
-void callbackMQTT(char *topic, byte *payload, unsigned int length)
+class ControladorOneWire
 {
-  // Crear buffer temporal para el mensaje
-  char bufferMensaje[length + 1];
-  memcpy(bufferMensaje, payload, length);
-  bufferMensaje[length] = '\0';
-
-  // Imprimir el payload recibido de forma segura
-  Serial.print("Mensaje recibido en topico: ");
-  Serial.println(topic);
-  Serial.print("Payload: ");
-  Serial.println(bufferMensaje);
+public:
+  ControladorOneWire(void)
+  {
+  }
 
-  // Procesar comandos segun el payload
-  if (strcmp(bufferMensaje, "true") == 0)
+  bool consultar(uint32_t ahoraMs)
   {
-    digitalWrite(PIN_LED_INDICADOR, HIGH);
-    Serial.println("-> LED encendido - Comando 'true' recibido");
+    if (numeroSensoresOneWire == 0)
+    {
+      return false;
+    }
+
+#if MODO_DS18B20_ASINCRONO
+    if (!conversionOneWire.enCurso)
+    {
+      sensoresTemperatura.requestTemperatures();
+      conversionOneWire.enCurso = true;
+      conversionOneWire.inicioMs = ahoraMs;
+      return false;
+    }
+
+    // El bit de fin de conversion no es fiable con alimentacion parasita
+    bool plazoVencido = ahoraMs - conversionOneWire.inicioMs >= conversionOneWire.duracionMs;
+    if (!plazoVencido &&
+        (conversionOneWire.alimentacionParasita || !sensoresTemperatura.isConversionComplete()))
+    {
+      return false;
+    }
+
+    conversionOneWire.enCurso = false;
+#else
+    (void)ahoraMs;
+    sensoresTemperatura.requestTemperatures();
+#endif
+
+    for (uint8_t i = 0; i < numeroSensoresOneWire; i++)
+    {
+      float temperatura = sensoresTemperatura.getTempC(direccionesOneWire[i]);
+      temperaturas[i] = temperatura == DEVICE_DISCONNECTED_C ? NAN : temperatura;
+    }
+    return true;
   }
-  else if (strcmp(bufferMensaje, "false") == 0)
+
+  uint8_t salidas(void) const
   {
-    digitalWrite(PIN_LED_INDICADOR, LOW);
-    delay(5000); // Mantener apagado por 5 segundos
-    Serial.println("-> LED apagado - Comando 'false' recibido");
+    return numeroSensoresOneWire;
   }
-  else
+
+  float leer(uint8_t salida) const
   {
-    Serial.println("-> Payload no reconocido - Comando ignorado");
+    return temperaturas[salida];
   }
-}
+
+private:
+  float temperaturas[MAX_SENSORES_ONEWIRE];
+};
+
+ControladorDistancia controladorDistancia(ecoUltrasonico);
+ControladorDHT controladorDHT(lectorDHT);
+ControladorOneWire controladorOneWire;
+
+// Una tarea generica por grupo de GRUPOS_SENSORES
+TareaSensor<ControladorDistancia, entregarValorCanal, RelojUTC::monotonicoUs> tareaDistancia(
+    controladorDistancia, GRUPOS_SENSORES[GRUPO_DISTANCIA], canales);
+TareaSensor<ControladorDHT, entregarValorCanal, RelojUTC::monotonicoUs> tareaDHT(
+    controladorDHT, GRUPOS_SENSORES[GRUPO_DHT], canales);
+TareaSensor<ControladorOneWire, entregarValorCanal, RelojUTC::monotonicoUs> tareaOneWire(
+    controladorOneWire, GRUPOS_SENSORES[GRUPO_ONEWIRE], canales);
 
 /**
- * @brief Configura y establece la conexion WiFi
- *
- * Esta funcion maneja la conexion WiFi del ESP32, incluyendo:
- * - Inicializacion de la conexion
- * - Espera hasta que la conexion este establecida
- * - Resolucion DNS del servidor MQTT
- * - Impresion de informacion de red
+ * @brief Adaptador de una TareaSensor al planificador, con su latencia en el diagnostico
+ * @tparam Tarea Tipo de la tarea
+ * @tparam tarea Tarea a ejecutar
+ * @tparam Grupo Grupo de la tarea (GrupoSensor)
  */
-void configurarWiFi(void)
+template <typename Tarea, Tarea &tarea, uint8_t Grupo>
+void ejecutarTareaSensor(uint32_t ahoraMs)
 {
-  Serial.println();
-  imprimirSeparador(50);
-  Serial.println("CONFIGURANDO CONEXION WiFi");
-  imprimirSeparador(50);
-
-  WiFi.begin(wifissid, wifipass);
-
-  Serial.print("Conectando a red WiFi: ");
-  Serial.println(wifissid);
-  Serial.print("Estado de conexion: ");
+  CronometroLatencia cronometro(diagnostico.lecturas[Grupo]);
+  if (!tarea.ejecutar(ahoraMs) || motorReglas.cantidad() == 0)
+  {
+    return;
+  }
 
-  // Esperar hasta que la conexion WiFi este establecida
-  while (WiFi.status() != WL_CONNECTED)
+  bool cambiaron = false;
+  for (uint8_t i = 0; i < tarea.cantidadSalidas(); i++)
+  {
+    cambiaron = evaluarReglas(GRUPOS_SENSORES[Grupo].primerCanal + i, tarea.lectura(i), tarea.ultimaLectura()) ||
+                cambiaron;
+  }
+  if (cambiaron)
   {
-    delay(500);
-    Serial.print(".");
+    accionarSalidas();
   }
+}
 
-  // Inicializar generador de numeros aleatorios
-  randomSeed(micros());
+/// Funcion del planificador de cada grupo, indexada por GrupoSensor
+const FuncionTarea TAREAS_GRUPOS[NUMERO_GRUPOS] = {
+    ejecutarTareaSensor<decltype(tareaDistancia), tareaDistancia, GRUPO_DISTANCIA>,
+    ejecutarTareaSensor<decltype(tareaDHT), tareaDHT, GRUPO_DHT>,
+    ejecutarTareaSensor<decltype(tareaOneWire), tareaOneWire, GRUPO_ONEWIRE>,
+};
 
-  // Mostrar informacion de la conexion establecida
-  Serial.println("\n-> WiFi conectado exitosamente");
-  Serial.println("Informacion de red:");
-  Serial.print("  * Direccion IP: ");
-  Serial.println(WiFi.localIP());
-  Serial.print("  * Direccion DNS: ");
-  Serial.println(WiFi.dnsIP());
+/**
+ * @brief Aplica a los sensores el periodo, las lecturas por entrega y la ventana de los filtros
+ *
+ * Solo la tarea de adquisicion, o setup() antes de crearla.
+ */
+void aplicarMuestreo(const ConfiguracionDispositivo &nueva)
+{
+  for (uint8_t g = 0; g < NUMERO_GRUPOS; g++)
+  {
+    planificador.cambiarPeriodo(tareasGrupos[g], nueva.periodoMuestreoMs);
+  }
+  // El DHT conserva su ciclo: sus lecturas llegan cada INTERVALO_MINIMO_DHT_MS
+  tareaDistancia.cambiarLecturasPorEntrega(LECTURAS_POR_ENTREGA(nueva.muestrasPorEntrega));
+  tareaOneWire.cambiarLecturasPorEntrega(LECTURAS_POR_ENTREGA(nueva.muestrasPorEntrega));
+  for (uint8_t canal = 0; canal < NUMERO_CANALES; canal++)
+  {
+    canales[canal].filtro.cambiarVentana(nueva.muestrasPorEntrega);
+  }
+}
 
-  // Resolver IP del servidor MQTT
-  IPAddress ipServidorMQTT;
-  if (WiFi.hostByName("mqtt.backend.kriollotech.com", ipServidorMQTT))
+/**
+ * @brief Carga las reglas de la configuracion; todas empiezan liberadas
+ *
+ * Solo la tarea de adquisicion, o setup() antes de crearla. Las salidas
+ * que manejaban las reglas anteriores se liberan.
+ */
+void aplicarReglas(const ConfiguracionDispositivo &nueva)
+{
+  if (!motorReglas.cargar(nueva.reglas, nueva.numeroReglas))
   {
-    Serial.print("  * Servidor MQTT: ");
-    Serial.println(ipServidorMQTT);
+    LOG_ERROR("-> Reglas de alarma invalidas - Sin reglas");
   }
-  else
+  accionarSalidas();
+  LOG_INFO("-> %u reglas de alarma cargadas", motorReglas.cantidad());
+}
+
+/**
+ * @brief Evalua las reglas de un canal con una lectura
+ *
+ * Se llama con cada lectura completa, sobre el valor crudo: el filtro
+ * retrasaria el cruce de un umbral en media ventana. Una lectura NaN (un
+ * sensor que no respondio) no cambia nada. Cada cambio de estado se
+ * encola para publicarse antes que las muestras. Solo la tarea de
+ * adquisicion.
+ *
+ * @param canal Canal de la lectura
+ * @param lectura Valor sin filtrar
+ * @param instanteUs Instante de la lectura (RelojUTC::monotonicoUs())
+ * @return true si alguna regla cambio de estado
+ */
+bool evaluarReglas(uint8_t canal, float lectura, int64_t instanteUs)
+{
+  CambioRegla cambios[MAX_REGLAS];
+  uint8_t numeroCambios = motorReglas.evaluar(canal, lectura, instanteUs, cambios);
+  for (uint8_t i = 0; i < numeroCambios; i++)
   {
-    Serial.println("  * Error resolviendo servidor MQTT");
+    EventoAlarma evento;
+    evento.marcaTiempoUs = instanteUs;
+    evento.valor = cambios[i].valor;
+    evento.regla = cambios[i].regla;
+    evento.canal = canal;
+    evento.activa = cambios[i].activa;
+    evento.arranque = relojUTC.arranque();
+    if (!colaAlarmas.encolar(evento))
+    {
+      alarmasDescartadas++;
+    }
   }
+  return numeroCambios > 0;
+}
 
-  imprimirSeparador(50);
+/**
+ * @brief Lleva las salidas al estado de sus reglas en el acto
+ *
+ * Escribe los pines que cambiaron; el LED pasa por actualizarActuadores(),
+ * que lo combina con COIL_LED y respeta su apagado minimo. Solo la tarea
+ * de adquisicion.
+ */
+void accionarSalidas(void)
+{
+  uint32_t activas = motorReglas.salidasActivas();
+  uint32_t cambiadas = activas ^ salidasReglas;
+  salidasReglas = activas;
+  for (uint8_t salida = 0; salida < NUMERO_SALIDAS; salida++)
+  {
+    if (salida != SALIDA_LED && (cambiadas & (1UL << salida)))
+    {
+      digitalWrite(PINES_SALIDAS[salida], (activas & (1UL << salida)) ? HIGH : LOW);
+    }
+  }
+  actualizarActuadores(millis());
 }
 
+/* ============================================================================
+ * TAREAS FreeRTOS
+ * ============================================================================ */
+
 /**
- * @brief Configura la conexion MQTT segura
+ * @brief Tarea de adquisicion de sensores (nucleo NUCLEO_ADQUISICION)
  *
- * Esta funcion configura el cliente MQTT con:
- * - Certificados CA para conexion segura
- * - Parametros de conexion del servidor
- * - Configuracion de keep-alive
- * - Funcion de callback para mensajes entrantes
+ * Ejecuta el planificador de sensores y duerme hasta el proximo
+ * vencimiento, a lo sumo PERIODO_ACTUADORES_MS. No toca la red: las
+ * lecturas salen por colaMuestras, asi que la cadencia de muestreo no
+ * depende del estado del broker ni del enlace. Tambien maneja los
+ * actuadores, para que las reglas y las bobinas no esperen a la tarea de
+ * red.
+ *
+ * @param parametro No utilizado
  */
-void configurarMQTT(void)
+void tareaAdquisicion(void *parametro)
 {
-  Serial.println("CONFIGURANDO CONEXION MQTT SEGURA");
-  imprimirSeparador(50);
+  (void)parametro;
 
-  // Configurar certificados CA para conexion segura
-  clienteWiFiSeguro.setCACertBundle(rootca_crt_bundle_start);
+  monitorMemoria.registrarTarea("adquisicion");
+  planificador.iniciar(millis());
 
-  // Configurar servidor MQTT
-  clienteMQTT.setServer(mqtt_host, mqtt_port);
-  clienteMQTT.setKeepAlive(KEEP_ALIVE_MQTT);
-  clienteMQTT.setCallback(callbackMQTT);
+  for (;;)
+  {
+    uint32_t ahoraMs = millis();
+    ConfiguracionDispositivo nueva;
+    if (colaConfiguracion.desencolar(nueva))
+    {
+      // Escalonar de nuevo los grupos desde ahora, con el desfase nuevo
+      aplicarMuestreo(nueva);
+      aplicarReglas(nueva);
+      for (uint8_t g = 0; g < NUMERO_GRUPOS; g++)
+      {
+        planificador.reprogramar(tareasGrupos[g], ahoraMs + g * nueva.desfaseSensoresMs);
+      }
+    }
 
-  Serial.println("-> Cliente MQTT configurado");
-  Serial.print("  * Servidor: ");
-  Serial.println(mqtt_host);
-  Serial.print("  * Puerto: ");
-  Serial.println(mqtt_port);
-  Serial.print("  * Keep-alive: ");
-  Serial.print(KEEP_ALIVE_MQTT);
-  Serial.println(" segundos");
-  imprimirSeparador(50);
+    {
+      ZonaSinReservas zona(ZONA_ADQUISICION);
+      planificador.ejecutar(ahoraMs);
+    }
+    // Las bobinas las escriben MQTT y Modbus desde otras tareas: se revisan en cada vuelta
+    actualizarActuadores(millis());
+
+    uint32_t esperaMs = planificador.msHastaProximaTarea(millis());
+    esperaMs = esperaMs < PERIODO_ACTUADORES_MS ? esperaMs : PERIODO_ACTUADORES_MS;
+    vTaskDelay(pdMS_TO_TICKS(esperaMs > 0 ? esperaMs : 1));
+  }
 }
 
 /**
- * @brief Reconoecta al servidor MQTT si se pierde la conexion
+ * @brief Tarea de red: conexion, mensajes entrantes y publicacion
+ *        (nucleo NUCLEO_RED)
  *
- * Esta funcion maneja la reconexion automatica al servidor MQTT:
- * - Intenta reconectar hasta que sea exitoso
- * - Se suscribe a los topicos necesarios
- * - Publica mensajes de prueba para verificar la conexion
- * - Implementa reintentos con delays apropiados
+ * Mantiene la conexion WiFi/MQTT, atiende los mensajes entrantes y vacia la
+ * cola de muestras, publicando cada una en su topico o agrupandolas en
+ * tramas por lotes segun MODO_PUBLICACION.
+ *
+ * @param parametro No utilizado
  */
-void reconectarMQTT(void)
+void tareaRed(void *parametro)
 {
-  Serial.println("RECONECTANDO AL SERVIDOR MQTT");
+  (void)parametro;
+
+  uint32_t descartadasReportadas = 0;
+  uint32_t alarmasReportadas = 0;
+#if AGREGACION_ACTIVA
+  uint32_t resumenesReportados = 0;
+#endif
+  bool conectadoAntes = false;
+  monitorMemoria.registrarTarea("red");
 
-  while (!clienteMQTT.connected())
+  for (;;)
   {
-    Serial.print("Intentando conexion MQTT... ");
+    // Avanzar la maquina de conexion y los efectos programados sin bloquear
+    gestionarConexion(millis());
+    validarFirmware(conexion.estado == CONEXION_MQTT_CONECTADA, millis());
+    if (conexion.estado != CONEXION_MQTT_CONECTADA)
+    {
+#if MODO_ALMACEN_OFFLINE
+      // Sin conexion las muestras pasan de la cola al registro en flash; con
+      // agregacion, solo si tambien se publican crudas: si no, lo que se
+      // guarda son sus ventanas (encolarResumen())
+      Muestra muestra;
+      while (colaMuestras.desencolar(muestra))
+      {
+        acumularMuestra(muestra);
+        if (publicacionCruda && topicoCanal(muestra.canal) != NULL && muestraReportable(muestra))
+        {
+          almacenarOffline(muestra);
+        }
+      }
+      sincronizarOffline(millis(), false);
+#endif
+      // Si no, las muestras esperan en la cola hasta que vuelva la conexion
+      conectadoAntes = false;
+      vTaskDelay(pdMS_TO_TICKS(10));
+      continue;
+    }
+
+    // Al reconectar, cerrar la pagina parcial para poder reenviarla
+    sincronizarOffline(millis(), !conectadoAntes);
+    conectadoAntes = true;
+
+    // Procesar mensajes MQTT entrantes
+    {
+      ZonaSinReservas zona(ZONA_RED);
+      CronometroLatencia cronometro(diagnostico.bucleMQTT);
+      clienteMQTT.loop();
+    }
+    // Un cambio de buffer pedido por comando reserva a proposito: fuera de la zona
+    aplicarBufferMQTT();
+    aplicarConfiguracion();
 
-    // Intentar conectar con credenciales
-    if (clienteMQTT.connect("ESP32Client", mqtt_user, mqtt_pass))
     {
-      Serial.println("-> Conectado exitosamente");
+      ZonaSinReservas zona(ZONA_RED);
+
+      // Las alarmas van primero, y de nuevo entre muestra y muestra
+      publicarAlarmas();
+
+      // Publicar las muestras pendientes
+      Muestra muestra;
+      while (colaMuestras.desencolar(muestra))
+      {
+        publicarAlarmas();
+        acumularMuestra(muestra);
+        publicarResumenes();
+        if (!publicacionCruda)
+        {
+          continue;
+        }
+#if MODO_PUBLICACION == PUBLICACION_INDIVIDUAL
+        publicarMuestra(muestra);
+#else
+        agregarMuestraTrama(muestra);
+#endif
+      }
+      cerrarVentanasVencidas();
+      publicarResumenes();
 
-      // Suscribirse a topicos de control
-      if (clienteMQTT.subscribe("EIE_SEDE1_modbus/1/coil/0"))
+#if MODO_PUBLICACION != PUBLICACION_INDIVIDUAL
+      // La trama sale cuando se completa el ciclo de todas las tareas
+      if (tramaPendiente.cantidad > 0 && millis() - tramaPendiente.inicioMs >= periodoTramaMs())
       {
-        Serial.println("-> Suscrito a topico de control");
+        publicarTrama();
       }
+#endif
+    }
 
-      // Publicar mensajes de prueba HTTP
-      Serial.println("Publicando mensajes de prueba HTTP:");
-      clienteMQTT.publish("EIE_SEDE1_http/alphanumeric", "Sistema ESP32 operativo");
-      clienteMQTT.publish("EIE_SEDE2_http/numeric", "123.45");
-      clienteMQTT.publish("EIE_SEDE2_http/int", "123");
-      clienteMQTT.publish("EIE_SEDE2_http/boolean", "true");
-      clienteMQTT.publish("EIE_SEDE2_http/ejemploJSON",
-                          "{\"sistema\":\"ESP32\",\"estado\":\"operativo\",\"timestamp\":1234567890}");
+    // Rellenar el hueco con lo guardado en flash, solo con la cola al dia
+    if (colaMuestras.vacia())
+    {
+      reenviarOffline(millis());
+      reenviarResumenesOffline(millis());
+    }
 
-      // Publicar mensajes de prueba Modbus
-      Serial.println("Publicando mensajes de prueba Modbus:");
-      clienteMQTT.publish("EIE_SEDE2_modbus/1/string/8", "Test desde ESP32");
-      clienteMQTT.publish("EIE_SEDE2_modbus/1/holding/0", "123.45");
-      clienteMQTT.publish("EIE_SEDE2_modbus/1/input/0", "123");
+    publicarDiagnostico(millis());
+    reenviarBitacora();
+    atenderOTA(millis());
 
-      Serial.println("-> Mensajes de prueba publicados");
+    uint32_t descartadas = muestrasDescartadas;
+    if (descartadas != descartadasReportadas)
+    {
+      LOG_AVISO("-> Cola de muestras llena: %u muestras descartadas", (unsigned)descartadas);
+      descartadasReportadas = descartadas;
     }
-    else
+    uint32_t alarmasPerdidas = alarmasDescartadas;
+    if (alarmasPerdidas != alarmasReportadas)
+    {
+      LOG_AVISO("-> Cola de alarmas llena: %u alarmas descartadas", (unsigned)alarmasPerdidas);
+      alarmasReportadas = alarmasPerdidas;
+    }
+#if AGREGACION_ACTIVA
+    if (resumenesDescartados != resumenesReportados)
     {
-      Serial.print("-> Error de conexion, codigo: ");
-      Serial.print(clienteMQTT.state());
-      Serial.print(" - Reintentando en ");
-      Serial.print(TIEMPO_RECONEXION / 1000);
-      Serial.println(" segundos...");
-      delay(TIEMPO_RECONEXION);
+      LOG_AVISO("-> Cola de resumenes llena: %u ventanas descartadas", (unsigned)resumenesDescartados);
+      resumenesReportados = resumenesDescartados;
     }
+#endif
+
+    vTaskDelay(1);
   }
 }
 
 /**
- * @brief Lee la distancia del sensor ultrasonico y publica el resultado
+ * @brief Tarea del servidor Modbus TCP (nucleo NUCLEO_RED)
  *
- * Esta funcion implementa un algoritmo de muestreo multiple para mejorar
- * la precision de las lecturas del sensor ultrasonico:
- * - Toma multiples muestras consecutivas
- * - Calcula el promedio para reducir ruido
- * - Publica el resultado en el topico MQTT correspondiente
- * - Implementa delays apropiados entre muestras
+ * Abre el puerto en cuanto hay WiFi y atiende a los clientes cada
+ * PERIODO_MODBUS_MS, sin depender de que MQTT este conectado.
+ *
+ * @param parametro No utilizado
  */
-void leerDistanciaYPublicar(void)
+void tareaModbus(void *parametro)
 {
-  float distanciaTotal = 0.0;
-  float muestras[NUMERO_MUESTRAS];
+  (void)parametro;
+  monitorMemoria.registrarTarea("modbus");
 
-  // Tomar multiples muestras para promediar
-  for (int i = 0; i < NUMERO_MUESTRAS; i++)
+  for (;;)
   {
-    // Generar pulso ultrasonico
-    digitalWrite(PIN_TRIGGER_ULTRASONICO, LOW);
-    delayMicroseconds(5);
-    digitalWrite(PIN_TRIGGER_ULTRASONICO, HIGH);
-    delayMicroseconds(25);
-    digitalWrite(PIN_TRIGGER_ULTRASONICO, LOW);
-
-    // Medir tiempo de eco
-    float duracion = pulseIn(PIN_ECHO_ULTRASONICO, HIGH);
-    float distancia = (duracion * 0.0343) / 2; // Velocidad del sonido (cm/us)
-
-    muestras[i] = distancia;
-    distanciaTotal += distancia;
-
-    delay(DELAY_ENTRE_MUESTRAS);
+    if (WiFi.status() == WL_CONNECTED)
+    {
+      servidorModbus.iniciar();
+      servidorModbus.atender(millis());
+    }
+    vTaskDelay(pdMS_TO_TICKS(PERIODO_MODBUS_MS));
   }
+}
 
-  // Calcular distancia promedio
-  float distanciaPromedio = distanciaTotal / NUMERO_MUESTRAS;
-
-  // Publicar resultado
-  char bufferDistancia[20];
-  sprintf(bufferDistancia, "%.2f", distanciaPromedio);
+/**
+ * @brief Tarea de la bitacora: vacia el anillo al UART
+ *
+ * Corre con la prioridad mas baja, de modo que la espera del UART solo usa
+ * tiempo que ninguna otra tarea quiere.
+ *
+ * @param parametro No utilizado
+ */
+void tareaBitacora(void *parametro)
+{
+  (void)parametro;
+  monitorMemoria.registrarTarea("bitacora");
 
-  if (clienteMQTT.publish("EIE_SEDE1_http/numeric", bufferDistancia))
-  {
-    Serial.print("-> Distancia publicada: ");
-    Serial.print(bufferDistancia);
-    Serial.println(" cm");
-  }
-  else
+  for (;;)
   {
-    Serial.println("-> Error publicando distancia");
+    bitacora.vaciar(Serial);
+    vTaskDelay(pdMS_TO_TICKS(PERIODO_BITACORA_MS));
   }
 }
 
 /**
- * @brief Lee temperatura y humedad de los sensores DHT
+ * @brief Tarea de la actualizacion: escribe en flash los bloques que encola el callback
  *
- * Esta funcion lee multiples sensores DHT simultaneamente:
- * - Sensor DHT1 en pin 26
- * - Sensor DHT2 en pin 25
- * - Implementa muestreo multiple para precision
- * - Publica datos en topicos separados por sede
- * - Maneja errores de lectura de forma robusta
+ * Corre con la prioridad mas baja, como la bitacora, y escribe a lo sumo
+ * un bloque por tick: la escritura solo usa tiempo que la adquisicion y
+ * la red no quieren.
+ *
+ * @param parametro No utilizado
  */
-void leerTemperaturaYHumedad(void)
+void tareaOTA(void *parametro)
 {
-  float temperaturaTotal1 = 0.0, humedadTotal1 = 0.0;
-  float temperaturaTotal2 = 0.0, humedadTotal2 = 0.0;
+  (void)parametro;
+  monitorMemoria.registrarTarea("ota");
 
-  // Tomar multiples muestras de cada sensor
-  for (int i = 0; i < NUMERO_MUESTRAS; i++)
+  for (;;)
   {
-    delay(DELAY_ENTRE_MUESTRAS);
-
-    // Leer sensor DHT1
-    float humedad1 = sensorDHT1.readHumidity();
-    float temperatura1 = sensorDHT1.readTemperature();
-
-    // Leer sensor DHT2
-    float humedad2 = sensorDHT2.readHumidity();
-    float temperatura2 = sensorDHT2.readTemperature();
-
-    // Validar lecturas y acumular valores
-    if (!isnan(humedad1))
-      humedadTotal1 += humedad1;
-    if (!isnan(temperatura1))
-      temperaturaTotal1 += temperatura1;
-    if (!isnan(humedad2))
-      humedadTotal2 += humedad2;
-    if (!isnan(temperatura2))
-      temperaturaTotal2 += temperatura2;
+    vTaskDelay(actualizacionOTA.procesar() ? 1 : pdMS_TO_TICKS(PERIODO_OTA_MS));
   }
+}
 
-  // Calcular promedios
-  float humedadPromedio1 = humedadTotal1 / NUMERO_MUESTRAS;
-  float temperaturaPromedio1 = temperaturaTotal1 / NUMERO_MUESTRAS;
-  float humedadPromedio2 = humedadTotal2 / NUMERO_MUESTRAS;
-  float temperaturaPromedio2 = temperaturaTotal2 / NUMERO_MUESTRAS;
+/* ============================================================================
+ * MODO DE SUENO PROFUNDO
+ * ============================================================================ */
 
-  // Publicar datos de sede 1
-  char bufferDatos[20];
-  sprintf(bufferDatos, "%.2f", temperaturaPromedio1);
-  clienteMQTT.publish("EIE_SEDE1_http/temp", bufferDatos);
+/**
+ * @brief Entrega a la cola el valor filtrado de todos los canales
+ */
+void entregarTodosLosCanales(void)
+{
+  tareaDistancia.entregar();
+  tareaDHT.entregar();
+  tareaOneWire.entregar();
+}
 
-  sprintf(bufferDatos, "%.2f", humedadPromedio1);
-  clienteMQTT.publish("EIE_SEDE1_http/humidity", bufferDatos);
+#if MODO_SUENO_PROFUNDO
+/**
+ * @brief Recupera de memoria RTC filtros y secuencias del ciclo anterior
+ *
+ * Solo tras un despertar por temporizador; en un arranque en frio el
+ * estado se descarta. Llamar despues de configurarSensoresOneWire().
+ *
+ * @param estado Copia de trabajo del estado RTC
+ * @return true si habia estado valido
+ */
+bool restaurarEstadoSueno(EstadoSuenoRTC &estado)
+{
+  memcpy(&estado, estadoSuenoRTC, sizeof(estado));
+  if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER || estado.magia != MAGIA_ESTADO_SUENO)
+  {
+    // Los filtros se llenan al guardar; basta con reiniciar contadores
+    estado.magia = MAGIA_ESTADO_SUENO;
+    estado.ciclos = 0;
+    estado.secuenciaTrama = 0;
+    estado.secuenciaReenvio = 0;
+    estado.despiertoAnteriorMs = 0;
+    return false;
+  }
 
-  // Publicar datos de sede 2
-  sprintf(bufferDatos, "%.2f", temperaturaPromedio2);
-  clienteMQTT.publish("EIE_SEDE2_http/temp", bufferDatos);
+  // Los DS18B20 solo si el bus no cambio: el indice de canal es la posicion en el bus
+  uint8_t restaurables = estado.sensoresOneWire == numeroSensoresOneWire ? NUMERO_CANALES : CANAL_ONEWIRE_BASE;
+  for (uint8_t canal = 0; canal < restaurables; canal++)
+  {
+    canales[canal] = estado.canales[canal];
+  }
 
-  sprintf(bufferDatos, "%.2f", humedadPromedio2);
-  clienteMQTT.publish("EIE_SEDE2_http/humidity", bufferDatos);
+  tramaPendiente.secuencia = estado.secuenciaTrama;
+#if MODO_ALMACEN_OFFLINE
+  secuenciaReenvio = estado.secuenciaReenvio;
+#endif
+  return true;
+}
 
-  // Mostrar resumen en consola
-  Serial.println("-> Datos DHT publicados:");
-  Serial.printf("  * Sede 1 - Temp: %.2f C, Hum: %.2f%%\n",
-                temperaturaPromedio1, humedadPromedio1);
-  Serial.printf("  * Sede 2 - Temp: %.2f C, Hum: %.2f%%\n",
-                temperaturaPromedio2, humedadPromedio2);
+/**
+ * @brief Guarda en memoria RTC filtros y secuencias para el proximo ciclo
+ * @param estado Copia de trabajo del estado RTC
+ */
+void guardarEstadoSueno(EstadoSuenoRTC &estado)
+{
+  estado.ciclos++;
+  estado.secuenciaTrama = tramaPendiente.secuencia;
+#if MODO_ALMACEN_OFFLINE
+  estado.secuenciaReenvio = secuenciaReenvio;
+#endif
+  estado.sensoresOneWire = numeroSensoresOneWire;
+  for (uint8_t canal = 0; canal < NUMERO_CANALES; canal++)
+  {
+    estado.canales[canal] = canales[canal];
+  }
+  memcpy(estadoSuenoRTC, &estado, sizeof(estado));
 }
 
 /**
- * @brief Lee temperatura del sensor OneWire (DS18B20)
+ * @brief Publica en el topico de ciclo el tiempo despierto
  *
- * Esta funcion lee el sensor de temperatura DS18B20 conectado al bus OneWire:
- * - Implementa muestreo multiple para precision
- * - Publica datos en formato Modbus
- * - Maneja la comunicacion OneWire de forma robusta
+ * "despiertoMs" es lo que va del ciclo actual hasta la publicacion y
+ * "anteriorMs" el ciclo anterior completo, hasta la entrada al sueno.
  */
-void leerTemperaturaOneWire(void)
+void publicarCicloSueno(const EstadoSuenoRTC &estado, uint8_t muestras)
 {
-  float temperaturaTotal = 0.0;
+  char mensaje[128];
+  int longitud = snprintf(mensaje, sizeof(mensaje),
+                          "{\"ciclo\":%u,\"despiertoMs\":%u,\"anteriorMs\":%u,\"muestras\":%u}",
+                          (unsigned)estado.ciclos, (unsigned)millis(),
+                          (unsigned)estado.despiertoAnteriorMs, muestras);
+  clienteMQTT.publish(topicosServicio.cicloSueno, (const uint8_t *)mensaje, (unsigned int)longitud);
+}
+#endif
 
-  // Tomar multiples muestras
-  for (int i = 0; i < NUMERO_MUESTRAS; i++)
+/**
+ * @brief Un ciclo completo del modo de sueno profundo; no regresa
+ *
+ * Muestrea todos los sensores a la vez durante VENTANA_MUESTREO_SUENO_MS
+ * mientras la red se asocia en paralelo, publica todo en una sola trama,
+ * reenvia algo del registro offline y duerme hasta completar
+ * PERIODO_SUENO_S. Si la conexion no llega en TIMEOUT_CONEXION_SUENO_MS las
+ * muestras van al registro offline. El tiempo despierto se mide desde el
+ * arranque (millis()), sin contar el cargador de la ROM.
+ */
+void ejecutarCicloSueno(void)
+{
+#if MODO_SUENO_PROFUNDO
+  EstadoSuenoRTC estado;
+  bool restaurado = restaurarEstadoSueno(estado);
+  LOG_INFO("-> Despertar %u (%s) - Ciclo anterior despierto %u ms", (unsigned)estado.ciclos,
+           restaurado ? "estado RTC recuperado" : "arranque en frio", (unsigned)estado.despiertoAnteriorMs);
+
+  // Muestrear y conectar a la vez
+  uint32_t inicioMs = millis();
+  planificador.iniciar(inicioMs);
+  bool muestreoTerminado = false;
+  for (;;)
   {
-    sensoresTemperatura.requestTemperatures();
-    float temperatura = sensoresTemperatura.getTempCByIndex(0);
+    uint32_t ahoraMs = millis();
+    if (!muestreoTerminado)
+    {
+      {
+        ZonaSinReservas zona(ZONA_ADQUISICION);
+        planificador.ejecutar(ahoraMs);
+      }
+      if (ahoraMs - inicioMs >= VENTANA_MUESTREO_SUENO_MS)
+      {
+        entregarTodosLosCanales();
+        muestreoTerminado = true;
+      }
+    }
 
-    if (!isnan(temperatura))
+    gestionarConexion(ahoraMs);
+    if (muestreoTerminado &&
+        (conexion.estado == CONEXION_MQTT_CONECTADA || ahoraMs - inicioMs >= TIMEOUT_CONEXION_SUENO_MS))
     {
-      temperaturaTotal += temperatura;
+      break;
     }
+    vTaskDelay(1);
+  }
 
-    delay(DELAY_ENTRE_MUESTRAS);
+  bool conectado = conexion.estado == CONEXION_MQTT_CONECTADA;
+  // Sin conexion no se revierte aqui: el bootloader vuelve al anterior al despertar
+  validarFirmware(conectado, 0);
+  uint8_t muestras = 0;
+  Muestra muestra;
+  while (colaMuestras.desencolar(muestra))
+  {
+    muestras++;
+    if (conectado)
+    {
+      agregarMuestraTrama(muestra);
+    }
+    else if (topicoCanal(muestra.canal) != NULL && muestraReportable(muestra))
+    {
+      almacenarOffline(muestra);
+    }
   }
 
-  // Calcular temperatura promedio
-  float temperaturaPromedio = temperaturaTotal / NUMERO_MUESTRAS;
+  if (conectado)
+  {
+    publicarAlarmas();
+    publicarCicloSueno(estado, muestras);
+    publicarTrama();
 
-  // Publicar en formato Modbus
-  char bufferTemperatura[20];
-  sprintf(bufferTemperatura, "%.2f", temperaturaPromedio);
+    // Vaciar de a poco lo que quedo guardado en ciclos sin conexion
+    sincronizarOffline(millis(), true);
+    for (uint8_t i = 0; i < REENVIOS_POR_DESPERTAR; i++)
+    {
+      vTaskDelay(pdMS_TO_TICKS(INTERVALO_REENVIO_MS));
+      clienteMQTT.loop();
+      reenviarOffline(millis());
+    }
 
-  if (clienteMQTT.publish("EIE_SEDE1_modbus/1/holding/0", bufferTemperatura))
-  {
-    Serial.printf("-> Temperatura OneWire publicada: %.2f C\n", temperaturaPromedio);
+    // Los mensajes en vuelo se pierden al dormir: esperar sus PUBACK
+    uint32_t esperaMs = millis();
+    while (clienteQoS1.enVuelo() > 0 && millis() - esperaMs < TIMEOUT_CONFIRMACIONES_SUENO_MS)
+    {
+      clienteMQTT.loop();
+      vTaskDelay(1);
+    }
+    atenderReenvioEnVuelo();
+    if (clienteQoS1.enVuelo() > 0)
+    {
+      LOG_AVISO("-> %u mensajes sin PUBACK al dormir", clienteQoS1.enVuelo());
+    }
+    // Una configuracion recibida en este despertar queda en NVS para el siguiente
+    aplicarConfiguracion();
+    clienteMQTT.disconnect();
   }
   else
   {
-    Serial.println("-> Error publicando temperatura OneWire");
+    LOG_AVISO("-> Sin conexion en el despertar - Muestras al registro offline");
+    sincronizarOffline(millis(), true);
   }
+
+  estado.despiertoAnteriorMs = millis();
+  guardarEstadoSueno(estado);
+  LOG_INFO("-> A dormir tras %u ms despierto", (unsigned)estado.despiertoAnteriorMs);
+
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+  bitacora.vaciar(Serial);
+  Serial.flush();
+
+  uint64_t periodoUs = (uint64_t)PERIODO_SUENO_S * 1000000ULL;
+  uint64_t despiertoUs = (uint64_t)millis() * 1000ULL;
+  esp_sleep_enable_timer_wakeup(despiertoUs < periodoUs ? periodoUs - despiertoUs : 1000000ULL);
+  esp_deep_sleep_start();
+#endif
 }
 
 /* ============================================================================
@@ -488,12 +3826,26 @@ void leerTemperaturaOneWire(void)
 void setup(void)
 {
   // Configurar comunicacion serial
-  Serial.begin(9600);
-  Serial.println();
+  Serial.begin(VELOCIDAD_SERIAL);
+  xTaskCreatePinnedToCore(tareaBitacora, "bitacora", PILA_TAREA_BITACORA, NULL,
+                          PRIORIDAD_TAREA_BITACORA, NULL, NUCLEO_RED);
   imprimirSeparador(60);
-  Serial.println("SISTEMA DE MONITOREO REMOTO ESP32 - INICIANDO");
+  LOG_INFO("SISTEMA DE MONITOREO REMOTO ESP32 - INICIANDO");
   imprimirSeparador(60);
 
+  // Antes de la primera muestra: identificador de arranque y hora que sobrevivio al reinicio
+  relojUTC.iniciar();
+  LOG_INFO("-> Arranque %u, hora UTC %s", (unsigned)relojUTC.arranque(),
+           relojUTC.horaValida() ? "recuperada" : "pendiente del SNTP");
+
+#if MODO_OTA
+  validacionOTAPendiente = ActualizacionOTA::pendienteDeValidar();
+  if (validacionOTAPendiente)
+  {
+    LOG_INFO("-> Firmware nuevo: se confirma al conectar a MQTT");
+  }
+#endif
+
   // Configurar pines
   pinMode(PIN_TRIGGER_ULTRASONICO, OUTPUT);
   pinMode(PIN_ECHO_ULTRASONICO, INPUT_PULLDOWN);
@@ -502,54 +3854,119 @@ void setup(void)
   pinMode(PIN_ONE_WIRE_TEMP, INPUT_PULLUP);
   pinMode(PIN_LED_INDICADOR, OUTPUT);
 
-  Serial.println("-> Pines configurados");
+  LOG_INFO("-> Pines configurados");
+
+  // La configuracion remota guardada manda sobre la de compilacion
+  configuracionPorDefecto(configuracion);
+  ConfiguracionDispositivo guardada;
+  if (cargarConfiguracion(guardada))
+  {
+    if (configuracionValida(guardada))
+    {
+      configuracion = guardada;
+      LOG_INFO("-> Configuracion %u recuperada de NVS", (unsigned)configuracion.version);
+    }
+    else
+    {
+      LOG_AVISO("-> Configuracion en NVS fuera de rango - Se usa la de compilacion");
+    }
+  }
 
   // Inicializar sensores
-  sensorDHT1.begin();
-  sensorDHT2.begin();
+  ecoUltrasonico.iniciar();
+  // En el orden de los canales del grupo DHT: sede 1 y sede 2
+  lectorDHT.agregarSensor(PIN_DHT_SENSOR_1, TIPO_DHT);
+  lectorDHT.agregarSensor(PIN_DHT_SENSOR_2, TIPO_DHT);
+  if (!lectorDHT.iniciar(MODO_SUENO_PROFUNDO ? 0 : INTERVALO_MINIMO_DHT_MS))
+  {
+    LOG_ERROR("-> No se pudieron configurar los canales RMT de los DHT");
+  }
   sensoresTemperatura.begin();
-  Serial.println("-> Sensores inicializados");
+  inicializarCanales();
+  configurarSensoresOneWire();
+  LOG_INFO("-> Sensores inicializados");
+
+#if MODO_ALMACEN_OFFLINE
+  // Recuperar el registro offline antes de arrancar la tarea de red
+  registroOfflineListo = registroOffline.iniciar();
+  if (registroOfflineListo)
+  {
+    LOG_INFO("-> Registro offline listo: %u paginas pendientes",
+             (unsigned)registroOffline.paginasPendientes());
+  }
+  else
+  {
+    LOG_ERROR("-> Error montando LittleFS - Registro offline deshabilitado");
+  }
+#if RESUMENES_OFFLINE
+  registroResumenesListo = registroOfflineListo && registroResumenes.iniciar();
+  if (registroResumenesListo)
+  {
+    LOG_INFO("-> Registro de ventanas listo: %u paginas pendientes", (unsigned)registroResumenes.paginasPendientes());
+  }
+#endif
+#endif
 
   // Configurar conexiones de red
   configurarWiFi();
+  relojUTC.sincronizar(SERVIDOR_NTP_PRINCIPAL, SERVIDOR_NTP_SECUNDARIO);
   configurarMQTT();
+  configurarComandos();
 
-  Serial.println("-> Sistema inicializado completamente");
+  monitorMemoria.definirZonas(NOMBRES_ZONAS, NUMERO_ZONAS);
+
+  // Registrar las tareas de sensores, escalonadas para no coincidir en el mismo tick
+  // (sin desfase en modo de sueno, para aprovechar la ventana de muestreo)
+  uint32_t desfaseSensores = MODO_SUENO_PROFUNDO ? 0 : configuracion.desfaseSensoresMs;
+  for (uint8_t g = 0; g < NUMERO_GRUPOS; g++)
+  {
+    tareasGrupos[g] = planificador.agregarTarea(GRUPOS_SENSORES[g].nombre, configuracion.periodoMuestreoMs,
+                                                TAREAS_GRUPOS[g], g * desfaseSensores);
+  }
+  aplicarMuestreo(configuracion);
+  aplicarReglas(configuracion);
+  LOG_INFO("-> Tareas de sensores planificadas");
+
+#if MODO_SUENO_PROFUNDO
+  // Todo el ciclo corre en la tarea de Arduino y termina en sueno profundo
+  monitorMemoria.registrarTarea("arduino");
+  monitorMemoria.armar();
+  ejecutarCicloSueno();
+#endif
+
+  // Separar adquisicion y transporte en nucleos distintos
+  xTaskCreatePinnedToCore(tareaRed, "red", PILA_TAREA_RED, NULL,
+                          PRIORIDAD_TAREA_RED, NULL, NUCLEO_RED);
+  xTaskCreatePinnedToCore(tareaAdquisicion, "adquisicion", PILA_TAREA_ADQUISICION, NULL,
+                          PRIORIDAD_TAREA_ADQUISICION, NULL, NUCLEO_ADQUISICION);
+  LOG_INFO("-> Tareas de red y adquisicion iniciadas");
+
+#if MODO_MODBUS_TCP
+  xTaskCreatePinnedToCore(tareaModbus, "modbus", PILA_TAREA_MODBUS, NULL,
+                          PRIORIDAD_TAREA_RED, NULL, NUCLEO_RED);
+  LOG_INFO("-> Servidor Modbus TCP en el puerto %u", PUERTO_MODBUS);
+#endif
+
+#if OTA_POR_MQTT
+  xTaskCreatePinnedToCore(tareaOTA, "ota", PILA_TAREA_OTA, NULL,
+                          PRIORIDAD_TAREA_OTA, NULL, NUCLEO_RED);
+#endif
+
+  // Lo reservado hasta aqui es la configuracion; desde ahora toda reserva cuenta
+  monitorMemoria.armar();
+  LOG_INFO("-> Sistema inicializado completamente");
   imprimirSeparador(60);
 }
 
 /**
  * @brief Bucle principal del sistema
  *
- * Esta funcion se ejecuta continuamente y maneja:
- * - Verificacion de conexion MQTT
- * - Lectura y publicacion de datos de sensores
- * - Reconexion automatica si es necesario
- * - Timing apropiado entre operaciones
+ * Todo el trabajo lo hacen tareaAdquisicion() y tareaRed(), creadas en
+ * setup(); la tarea de Arduino se elimina para no consumir CPU.
  */
 void loop(void)
 {
-  // Verificar conexion MQTT
-  if (!clienteMQTT.connected())
-  {
-    reconectarMQTT();
-  }
-
-  // Procesar mensajes MQTT entrantes
-  clienteMQTT.loop();
-
-  // Ciclo de lectura de sensores
-  leerDistanciaYPublicar();
-  delay(DELAY_ENTRE_SENSORES);
-
-  leerTemperaturaYHumedad();
-  delay(DELAY_ENTRE_SENSORES);
-
-  leerTemperaturaOneWire();
-  delay(DELAY_ENTRE_SENSORES);
-
-  // Delay adicional para estabilidad
-  delay(DELAY_ENTRE_SENSORES);
+  vTaskDelete(NULL);
 }
 
 /* ============================================================================
@@ -557,8 +3974,8 @@ void loop(void)
  * ============================================================================
  *
  * 1. CERTIFICADOS SSL:
- *    - Ejecutar: python3 scripts/generate_cert_bundle.py
- *    - Esto genera el archivo _binary_data_cert_bundle_start
+ *    - Ejecutar: python3 data/cert/bundleUp.py ... --indexed (ver rootca_crt_bundle_start)
+ *    - Copiar el x509_crt_bundle generado a data/cert/bundle
  *    - El archivo se incluye automaticamente en el build
  *
  * 2. ARCHIVO SECRETS.H:
@@ -566,9 +3983,9 @@ void loop(void)
  *    - NO incluir este archivo en el control de versiones
  *
  * 3. DEPENDENCIAS:
- *    - WiFi.h, WiFiClientSecure.h
- *    - PubSubClient.h
- *    - DHT.h, OneWire.h, DallasTemperature.h
+ *    - WiFi.h, mbedTLS (cliente_tls)
+ *    - PubSubClient.h (>= 2.8, por connect() con cleanSession; QoS 1 en cliente_qos1)
+ *    - OneWire.h, DallasTemperature.h (los DHT se leen con el RMT, sin libreria)
  *
  * 4. CONFIGURACION PLATFORMIO:
  *    - Asegurar que las librerias esten instaladas
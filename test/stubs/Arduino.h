@@ -0,0 +1,98 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+/**
+ * @file Arduino.h
+ * @brief Lo minimo del core de Arduino para compilar las librerias en el host (env:native)
+ *
+ * millis() y micros() corren sobre un reloj simulado que solo avanza con
+ * avanzarRelojSimulado(): el banco de pruebas recorre horas de operacion
+ * en segundos y cada corrida es reproducible. El costo de CPU se mide
+ * aparte, con esp_timer_get_time(), que aqui es el reloj real del host.
+ */
+
+/// Milisegundos del reloj simulado
+inline uint32_t &relojSimuladoMs(void)
+{
+  static uint32_t ms = 0;
+  return ms;
+}
+
+inline void avanzarRelojSimulado(uint32_t ms)
+{
+  relojSimuladoMs() += ms;
+}
+
+inline unsigned long millis(void)
+{
+  return relojSimuladoMs();
+}
+
+inline unsigned long micros(void)
+{
+  return relojSimuladoMs() * 1000UL;
+}
+
+inline void delay(uint32_t ms)
+{
+  avanzarRelojSimulado(ms);
+}
+
+class Print
+{
+public:
+  virtual ~Print(void)
+  {
+  }
+
+  virtual size_t write(uint8_t dato) = 0;
+
+  virtual size_t write(const uint8_t *buf, size_t size)
+  {
+    size_t escritos = 0;
+    while (escritos < size && write(buf[escritos]) == 1)
+    {
+      escritos++;
+    }
+    return escritos;
+  }
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available(void) = 0;
+  virtual int read(void) = 0;
+  virtual int peek(void) = 0;
+  virtual void flush(void)
+  {
+  }
+};
+
+class IPAddress
+{
+public:
+  IPAddress(void) : direccion(0)
+  {
+  }
+
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : direccion((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24))
+  {
+  }
+
+  operator uint32_t(void) const
+  {
+    return direccion;
+  }
+
+private:
+  uint32_t direccion;
+};
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef LITTLEFS_H
+#define LITTLEFS_H
+
+#include "Arduino.h"
+#include <stdio.h>
+
+/**
+ * @file LittleFS.h
+ * @brief LittleFS en RAM para probar el registro offline en el host (env:native)
+ *
+ * Solo lo que usa registro_flash: begin, exists, mkdir y open, y File con
+ * read, write, seek y close. Los archivos viven en un arreglo fijo, sin
+ * memoria dinamica. fallarEscrituras hace que toda escritura falle, como
+ * una flash llena o danada.
+ */
+
+#define ARCHIVOS_SIMULADOS 8                ///< Archivos a la vez
+#define TAMANO_ARCHIVO_SIMULADO (16 * 1024) ///< Tamano maximo de cada archivo
+
+enum SeekMode
+{
+  SeekSet = 0,
+  SeekCur = 1,
+  SeekEnd = 2
+};
+
+/**
+ * @brief Contenido de un archivo simulado
+ */
+struct ArchivoSimulado
+{
+  bool usado;
+  char ruta[48];
+  size_t tamano;
+  uint8_t datos[TAMANO_ARCHIVO_SIMULADO];
+};
+
+class File
+{
+public:
+  File(ArchivoSimulado *archivo = NULL, bool escritura = false, bool *fallarEscrituras = NULL)
+      : archivo(archivo), escritura(escritura), fallarEscrituras(fallarEscrituras), posicion(0)
+  {
+  }
+
+  explicit operator bool(void) const
+  {
+    return archivo != NULL;
+  }
+
+  size_t read(uint8_t *buf, size_t size)
+  {
+    if (archivo == NULL || posicion >= archivo->tamano)
+    {
+      return 0;
+    }
+    size_t leidos = size < archivo->tamano - posicion ? size : archivo->tamano - posicion;
+    memcpy(buf, archivo->datos + posicion, leidos);
+    posicion += leidos;
+    return leidos;
+  }
+
+  size_t write(const uint8_t *buf, size_t size)
+  {
+    if (archivo == NULL || !escritura || *fallarEscrituras || posicion + size > TAMANO_ARCHIVO_SIMULADO)
+    {
+      return 0;
+    }
+    if (posicion > archivo->tamano)
+    {
+      memset(archivo->datos + archivo->tamano, 0, posicion - archivo->tamano);
+    }
+    memcpy(archivo->datos + posicion, buf, size);
+    posicion += size;
+    archivo->tamano = posicion > archivo->tamano ? posicion : archivo->tamano;
+    return size;
+  }
+
+  bool seek(uint32_t pos, SeekMode mode)
+  {
+    if (archivo == NULL)
+    {
+      return false;
+    }
+    size_t base = mode == SeekSet ? 0 : mode == SeekCur ? posicion : archivo->tamano;
+    if (base + pos > TAMANO_ARCHIVO_SIMULADO || (!escritura && base + pos > archivo->tamano))
+    {
+      return false;
+    }
+    posicion = base + pos;
+    return true;
+  }
+
+  void close(void)
+  {
+    archivo = NULL;
+  }
+
+private:
+  ArchivoSimulado *archivo;
+  bool escritura;
+  bool *fallarEscrituras;
+  size_t posicion;
+};
+
+class SistemaArchivosSimulado
+{
+public:
+  SistemaArchivosSimulado(void) : fallarEscrituras(false)
+  {
+    formatear();
+  }
+
+  bool begin(bool formatearSiFalla)
+  {
+    (void)formatearSiFalla;
+    return true;
+  }
+
+  /// Borra todos los archivos
+  void formatear(void)
+  {
+    for (uint8_t i = 0; i < ARCHIVOS_SIMULADOS; i++)
+    {
+      archivos[i].usado = false;
+    }
+  }
+
+  bool exists(const char *ruta)
+  {
+    return buscar(ruta) != NULL;
+  }
+
+  bool mkdir(const char *ruta)
+  {
+    (void)ruta;
+    return true;
+  }
+
+  /**
+   * @param modo "r", "r+" o "w" (trunca o crea)
+   */
+  File open(const char *ruta, const char *modo)
+  {
+    ArchivoSimulado *archivo = buscar(ruta);
+    if (modo[0] == 'w')
+    {
+      archivo = archivo != NULL ? archivo : crear(ruta);
+      if (archivo != NULL)
+      {
+        archivo->tamano = 0;
+      }
+    }
+    return File(archivo, modo[0] == 'w' || modo[1] == '+', &fallarEscrituras);
+  }
+
+  bool fallarEscrituras; ///< Toda escritura devuelve 0
+
+private:
+  ArchivoSimulado *buscar(const char *ruta)
+  {
+    for (uint8_t i = 0; i < ARCHIVOS_SIMULADOS; i++)
+    {
+      if (archivos[i].usado && strcmp(archivos[i].ruta, ruta) == 0)
+      {
+        return &archivos[i];
+      }
+    }
+    return NULL;
+  }
+
+  ArchivoSimulado *crear(const char *ruta)
+  {
+    for (uint8_t i = 0; i < ARCHIVOS_SIMULADOS; i++)
+    {
+      if (!archivos[i].usado)
+      {
+        archivos[i].usado = true;
+        snprintf(archivos[i].ruta, sizeof(archivos[i].ruta), "%s", ruta);
+        archivos[i].tamano = 0;
+        return &archivos[i];
+      }
+    }
+    return NULL;
+  }
+
+  ArchivoSimulado archivos[ARCHIVOS_SIMULADOS];
+};
+
+/// Unico sistema de archivos, compartido por todas las unidades de compilacion
+inline SistemaArchivosSimulado &sistemaArchivosSimulado(void)
+{
+  static SistemaArchivosSimulado sistema;
+  return sistema;
+}
+
+#define LittleFS sistemaArchivosSimulado()
+
+#endif
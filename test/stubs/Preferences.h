@@ -0,0 +1,175 @@
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+#include "Arduino.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @file Preferences.h
+ * @brief Preferences (NVS) en RAM para probar la configuracion remota en el host (env:native)
+ *
+ * Solo lo que usa configuracion_remota: begin, end, getUInt, putUInt,
+ * getBytes y putBytes. Como en el ESP32, begin() de solo lectura falla si
+ * el espacio de nombres nunca se escribio, y las escrituras en un espacio
+ * abierto de solo lectura devuelven 0. Las claves viven en un arreglo fijo,
+ * sin memoria dinamica.
+ */
+
+#define CLAVES_NVS_SIMULADAS 8        ///< Claves a la vez, entre todos los espacios
+#define LONGITUD_NOMBRE_NVS 16        ///< Nombre mas largo, con el terminador (como en NVS)
+#define TAMANO_VALOR_NVS_SIMULADO 512 ///< Bytes maximos de cada valor
+
+/**
+ * @brief Una clave guardada
+ */
+struct ClaveNVSSimulada
+{
+  bool usada;
+  char espacio[LONGITUD_NOMBRE_NVS];
+  char clave[LONGITUD_NOMBRE_NVS];
+  size_t tamano;
+  uint8_t datos[TAMANO_VALOR_NVS_SIMULADO];
+};
+
+class NVSSimulada
+{
+public:
+  NVSSimulada(void)
+  {
+    formatear();
+  }
+
+  /// Borra todas las claves
+  void formatear(void)
+  {
+    for (uint8_t i = 0; i < CLAVES_NVS_SIMULADAS; i++)
+    {
+      claves[i].usada = false;
+    }
+  }
+
+  bool existeEspacio(const char *espacio)
+  {
+    for (uint8_t i = 0; i < CLAVES_NVS_SIMULADAS; i++)
+    {
+      if (claves[i].usada && strcmp(claves[i].espacio, espacio) == 0)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  ClaveNVSSimulada *buscar(const char *espacio, const char *clave)
+  {
+    for (uint8_t i = 0; i < CLAVES_NVS_SIMULADAS; i++)
+    {
+      if (claves[i].usada && strcmp(claves[i].espacio, espacio) == 0 && strcmp(claves[i].clave, clave) == 0)
+      {
+        return &claves[i];
+      }
+    }
+    return NULL;
+  }
+
+  size_t escribir(const char *espacio, const char *clave, const void *valor, size_t tamano)
+  {
+    if (tamano > TAMANO_VALOR_NVS_SIMULADO || strlen(clave) >= LONGITUD_NOMBRE_NVS)
+    {
+      return 0;
+    }
+    ClaveNVSSimulada *destino = buscar(espacio, clave);
+    for (uint8_t i = 0; destino == NULL && i < CLAVES_NVS_SIMULADAS; i++)
+    {
+      if (!claves[i].usada)
+      {
+        destino = &claves[i];
+        destino->usada = true;
+        snprintf(destino->espacio, sizeof(destino->espacio), "%s", espacio);
+        snprintf(destino->clave, sizeof(destino->clave), "%s", clave);
+      }
+    }
+    if (destino == NULL)
+    {
+      return 0;
+    }
+    memcpy(destino->datos, valor, tamano);
+    destino->tamano = tamano;
+    return tamano;
+  }
+
+private:
+  ClaveNVSSimulada claves[CLAVES_NVS_SIMULADAS];
+};
+
+/// Unica NVS, compartida por todas las unidades de compilacion
+inline NVSSimulada &nvsSimulada(void)
+{
+  static NVSSimulada nvs;
+  return nvs;
+}
+
+class Preferences
+{
+public:
+  Preferences(void) : abierto(false), soloLectura(true)
+  {
+    espacio[0] = '\0';
+  }
+
+  bool begin(const char *nombre, bool soloLectura = false)
+  {
+    if (abierto || strlen(nombre) >= LONGITUD_NOMBRE_NVS || (soloLectura && !nvsSimulada().existeEspacio(nombre)))
+    {
+      return false;
+    }
+    snprintf(espacio, sizeof(espacio), "%s", nombre);
+    this->soloLectura = soloLectura;
+    abierto = true;
+    return true;
+  }
+
+  void end(void)
+  {
+    abierto = false;
+  }
+
+  uint32_t getUInt(const char *clave, uint32_t porDefecto = 0)
+  {
+    uint32_t valor;
+    return getBytes(clave, &valor, sizeof(valor)) == sizeof(valor) ? valor : porDefecto;
+  }
+
+  size_t putUInt(const char *clave, uint32_t valor)
+  {
+    return putBytes(clave, &valor, sizeof(valor));
+  }
+
+  size_t getBytes(const char *clave, void *destino, size_t maximo)
+  {
+    ClaveNVSSimulada *guardada = abierto ? nvsSimulada().buscar(espacio, clave) : NULL;
+    if (guardada == NULL || guardada->tamano > maximo)
+    {
+      return 0;
+    }
+    memcpy(destino, guardada->datos, guardada->tamano);
+    return guardada->tamano;
+  }
+
+  size_t putBytes(const char *clave, const void *valor, size_t tamano)
+  {
+    if (!abierto || soloLectura)
+    {
+      return 0;
+    }
+    return nvsSimulada().escribir(espacio, clave, valor, tamano);
+  }
+
+private:
+  char espacio[LONGITUD_NOMBRE_NVS];
+  bool abierto;
+  bool soloLectura;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef PUBSUBCLIENT_H
+#define PUBSUBCLIENT_H
+
+#include "Client.h"
+
+/**
+ * @file PubSubClient.h
+ * @brief Sustituto de PubSubClient 2.8 para el host, con la parte que usa la ruta de datos
+ *
+ * Escribe en el Client los mismos PUBLISH de QoS 0 que la libreria real,
+ * con su misma regla de buffer (publish() falla si el paquete no cabe en
+ * getBufferSize()), de modo que los bytes que cuenta el broker simulado
+ * son los que saldrian por el socket. loop() solo consume lo que llega;
+ * asi ClienteQoS1, intercalado como transporte, ve pasar los PUBACK.
+ */
+
+#define MQTT_MAX_HEADER_SIZE 5 ///< Tipo y hasta 4 bytes de longitud restante
+
+class PubSubClient
+{
+public:
+  explicit PubSubClient(Client &cliente) : cliente(cliente), tamanoBuffer(256)
+  {
+  }
+
+  bool setBufferSize(uint16_t tamano)
+  {
+    tamanoBuffer = tamano;
+    return tamano > 0;
+  }
+
+  uint16_t getBufferSize(void)
+  {
+    return tamanoBuffer;
+  }
+
+  bool connected(void)
+  {
+    return cliente.connected() != 0;
+  }
+
+  bool publish(const char *topico, const uint8_t *carga, unsigned int longitud, bool retener = false)
+  {
+    if (MQTT_MAX_HEADER_SIZE + 2 + strlen(topico) + longitud > tamanoBuffer)
+    {
+      return false;
+    }
+    return beginPublish(topico, longitud, retener) && write(carga, longitud) == longitud && endPublish() == 1;
+  }
+
+  bool publish(const char *topico, const char *carga)
+  {
+    return publish(topico, (const uint8_t *)carga, (unsigned int)strlen(carga));
+  }
+
+  bool beginPublish(const char *topico, unsigned int longitud, bool retener)
+  {
+    if (!connected())
+    {
+      return false;
+    }
+
+    size_t longitudTopico = strlen(topico);
+    size_t restante = 2 + longitudTopico + longitud;
+    uint8_t cabecera[MQTT_MAX_HEADER_SIZE + 2];
+    size_t n = 0;
+    cabecera[n++] = (uint8_t)(0x30 | (retener ? 1 : 0));
+    do
+    {
+      uint8_t digito = restante % 128;
+      restante /= 128;
+      cabecera[n++] = restante > 0 ? (uint8_t)(digito | 0x80) : digito;
+    } while (restante > 0);
+    cabecera[n++] = (uint8_t)(longitudTopico >> 8);
+    cabecera[n++] = (uint8_t)longitudTopico;
+
+    return cliente.write(cabecera, n) == n &&
+           cliente.write((const uint8_t *)topico, longitudTopico) == longitudTopico;
+  }
+
+  size_t write(const uint8_t *datos, size_t longitud)
+  {
+    return cliente.write(datos, longitud);
+  }
+
+  int endPublish(void)
+  {
+    return 1;
+  }
+
+  bool loop(void)
+  {
+    while (cliente.available() > 0)
+    {
+      cliente.read();
+    }
+    return connected();
+  }
+
+private:
+  Client &cliente;
+  uint16_t tamanoBuffer;
+};
+
+#endif
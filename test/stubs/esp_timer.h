@@ -0,0 +1,21 @@
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <stdint.h>
+#include <chrono>
+
+/**
+ * @file esp_timer.h
+ * @brief esp_timer_get_time() sobre el reloj monotonico real del host
+ *
+ * Lo usan HistogramaLatencia y el banco de pruebas para medir costo de
+ * CPU; no sigue al reloj simulado de millis().
+ */
+inline int64_t esp_timer_get_time(void)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ * @file test_banda_muerta.cpp
+ * @brief Pruebas del reporte por cambio con banda muerta y latido
+ *
+ * Ejecutar con: pio test -e native -f test_banda_muerta -v
+ */
+
+#include <unity.h>
+#include "banda_muerta.h"
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_primer_valor_se_publica(void)
+{
+  ConfiguracionReporte configuracion = {0.5f, 0};
+  ReportePorCambio reporte;
+  TEST_ASSERT_TRUE(reporte.debePublicar(configuracion, 20.0f, 0));
+}
+
+void test_banda_filtra_cambios_pequenos(void)
+{
+  ConfiguracionReporte configuracion = {0.5f, 0};
+  ReportePorCambio reporte;
+  reporte.registrarPublicacion(20.0f, 0);
+  TEST_ASSERT_FALSE(reporte.debePublicar(configuracion, 20.0f, 100));
+  TEST_ASSERT_FALSE(reporte.debePublicar(configuracion, 20.4f, 100));
+  TEST_ASSERT_TRUE(reporte.debePublicar(configuracion, 20.6f, 100));
+  TEST_ASSERT_TRUE(reporte.debePublicar(configuracion, 19.4f, 100));
+}
+
+void test_banda_cero_publica_siempre(void)
+{
+  ConfiguracionReporte configuracion = {0.0f, 0};
+  ReportePorCambio reporte;
+  reporte.registrarPublicacion(20.0f, 0);
+  TEST_ASSERT_TRUE(reporte.debePublicar(configuracion, 20.0f, 100));
+  reporte.registrarPublicacion(20.0f, 100);
+  TEST_ASSERT_TRUE(reporte.debePublicar(configuracion, 20.0f, 200));
+}
+
+void test_latido_republica_valor_estable(void)
+{
+  ConfiguracionReporte configuracion = {0.5f, 60000};
+  ReportePorCambio reporte;
+  reporte.registrarPublicacion(20.0f, 1000);
+  TEST_ASSERT_FALSE(reporte.debePublicar(configuracion, 20.0f, 60999));
+  TEST_ASSERT_TRUE(reporte.debePublicar(configuracion, 20.0f, 61000));
+}
+
+void test_reiniciar_publica_el_siguiente(void)
+{
+  ConfiguracionReporte configuracion = {0.5f, 0};
+  ReportePorCambio reporte;
+  reporte.registrarPublicacion(20.0f, 0);
+  reporte.reiniciar();
+  TEST_ASSERT_TRUE(reporte.debePublicar(configuracion, 20.0f, 100));
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_primer_valor_se_publica);
+  RUN_TEST(test_banda_filtra_cambios_pequenos);
+  RUN_TEST(test_banda_cero_publica_siempre);
+  RUN_TEST(test_latido_republica_valor_estable);
+  RUN_TEST(test_reiniciar_publica_el_siguiente);
+  return UNITY_END();
+}
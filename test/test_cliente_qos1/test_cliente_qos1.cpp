@@ -0,0 +1,500 @@
+/**
+ * @file test_cliente_qos1.cpp
+ * @brief Pruebas de la ventana de PUBLISH de QoS 1 y del seguimiento de los PUBACK
+ *
+ * Ejecutar con: pio test -e native -f test_cliente_qos1 -v
+ */
+
+#include <unity.h>
+#include <string.h>
+#include "cliente_qos1.h"
+
+#define TOPICO_PRUEBA "t"       ///< Topico de un caracter: cabecera variable de 5 bytes
+#define CAPTURA_TRANSPORTE 8192 ///< Bytes escritos que guarda el transporte simulado
+#define ENTRADA_TRANSPORTE 512  ///< Bytes pendientes de leer del transporte simulado
+#define CARGA_GRANDE 1000       ///< Carga que deja tres paquetes de 1008 bytes en la arena
+#define CARGA_MAYOR 1500        ///< Carga que solo entra tras compactar la arena
+
+/**
+ * @brief Transporte que guarda lo escrito y entrega los bytes que se le cargan
+ */
+class TransporteSimulado : public Client
+{
+public:
+  TransporteSimulado(void)
+  {
+    reiniciar();
+  }
+
+  void reiniciar(void)
+  {
+    escritos = 0;
+    lectura = 0;
+    escritura = 0;
+    conectado = true;
+    cierres = 0;
+  }
+
+  /// Deja bytes para que los lea el cliente, como si los enviara el broker
+  void recibir(const uint8_t *datos, size_t longitud)
+  {
+    for (size_t i = 0; i < longitud && escritura < ENTRADA_TRANSPORTE; i++)
+    {
+      entrada[escritura++] = datos[i];
+    }
+  }
+
+  uint8_t captura[CAPTURA_TRANSPORTE]; ///< Lo escrito por el cliente
+  size_t escritos;                     ///< Bytes validos en captura
+  bool conectado;
+  uint32_t cierres; ///< Llamadas a stop()
+
+  int connect(IPAddress ip, uint16_t port) override
+  {
+    (void)ip;
+    (void)port;
+    conectado = true;
+    return 1;
+  }
+
+  int connect(const char *host, uint16_t port) override
+  {
+    (void)host;
+    (void)port;
+    conectado = true;
+    return 1;
+  }
+
+  size_t write(uint8_t dato) override
+  {
+    return write(&dato, 1);
+  }
+
+  size_t write(const uint8_t *buf, size_t size) override
+  {
+    if (!conectado)
+    {
+      return 0;
+    }
+    for (size_t i = 0; i < size && escritos < CAPTURA_TRANSPORTE; i++)
+    {
+      captura[escritos++] = buf[i];
+    }
+    return size;
+  }
+
+  int available(void) override
+  {
+    return (int)(escritura - lectura);
+  }
+
+  int read(void) override
+  {
+    return lectura == escritura ? -1 : entrada[lectura++];
+  }
+
+  int read(uint8_t *buf, size_t size) override
+  {
+    size_t leidos = 0;
+    while (leidos < size && lectura != escritura)
+    {
+      buf[leidos++] = entrada[lectura++];
+    }
+    return (int)leidos;
+  }
+
+  int peek(void) override
+  {
+    return lectura == escritura ? -1 : entrada[lectura];
+  }
+
+  void flush(void) override
+  {
+  }
+
+  void stop(void) override
+  {
+    conectado = false;
+    cierres++;
+  }
+
+  uint8_t connected(void) override
+  {
+    return conectado ? 1 : 0;
+  }
+
+  operator bool(void) override
+  {
+    return conectado;
+  }
+
+private:
+  uint8_t entrada[ENTRADA_TRANSPORTE];
+  size_t lectura;
+  size_t escritura;
+};
+
+static TransporteSimulado transporte;
+static uint8_t carga[CARGA_MAYOR];
+
+/// El broker confirma un PUBLISH y el cliente lo lee byte a byte
+static void recibirPuback(ClienteQoS1 &cliente, uint16_t identificador)
+{
+  const uint8_t puback[4] = {0x40, 0x02, (uint8_t)(identificador >> 8), (uint8_t)identificador};
+  transporte.recibir(puback, sizeof(puback));
+  while (cliente.read() >= 0)
+  {
+  }
+}
+
+/**
+ * @brief Arma el PUBLISH de QoS 1 que deberia escribir el cliente
+ * @return Bytes del paquete
+ */
+static size_t armarPublish(uint8_t *destino, uint8_t tipo, uint16_t identificador, const uint8_t *datos,
+                           size_t longitud)
+{
+  size_t restante = 2 + strlen(TOPICO_PRUEBA) + 2 + longitud;
+  size_t posicion = 0;
+  destino[posicion++] = tipo;
+  do
+  {
+    uint8_t digito = restante % 128;
+    restante /= 128;
+    destino[posicion++] = restante > 0 ? (uint8_t)(digito | 0x80) : digito;
+  } while (restante > 0);
+  destino[posicion++] = 0;
+  destino[posicion++] = (uint8_t)strlen(TOPICO_PRUEBA);
+  memcpy(destino + posicion, TOPICO_PRUEBA, strlen(TOPICO_PRUEBA));
+  posicion += strlen(TOPICO_PRUEBA);
+  destino[posicion++] = (uint8_t)(identificador >> 8);
+  destino[posicion++] = (uint8_t)identificador;
+  memcpy(destino + posicion, datos, longitud);
+  return posicion + longitud;
+}
+
+void setUp(void)
+{
+  transporte.reiniciar();
+  for (size_t i = 0; i < sizeof(carga); i++)
+  {
+    carga[i] = (uint8_t)(i * 7 + 1);
+  }
+}
+
+void tearDown(void)
+{
+}
+
+void test_publicar_escribe_publish_qos1(void)
+{
+  ClienteQoS1 cliente(transporte);
+  TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+  TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+
+  uint8_t esperado[32];
+  size_t longitud = armarPublish(esperado, 0x32, 1, carga, 3);
+  TEST_ASSERT_EQUAL_UINT32(2 * longitud, transporte.escritos);
+  TEST_ASSERT_EQUAL_MEMORY(esperado, transporte.captura, longitud);
+  armarPublish(esperado, 0x32, 2, carga, 3);
+  TEST_ASSERT_EQUAL_MEMORY(esperado, transporte.captura + longitud, longitud);
+  TEST_ASSERT_EQUAL_UINT8(2, cliente.enVuelo());
+}
+
+void test_puback_libera_la_ventana(void)
+{
+  ClienteQoS1 cliente(transporte);
+  TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+  TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+
+  recibirPuback(cliente, 1);
+  TEST_ASSERT_EQUAL_UINT8(1, cliente.enVuelo());
+  recibirPuback(cliente, 2);
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.enVuelo());
+  TEST_ASSERT_EQUAL_UINT32(2, cliente.confirmadas());
+}
+
+void test_puback_desconocido_o_repetido_se_ignora(void)
+{
+  ClienteQoS1 cliente(transporte);
+  TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+
+  recibirPuback(cliente, 7);
+  TEST_ASSERT_EQUAL_UINT8(1, cliente.enVuelo());
+  recibirPuback(cliente, 1);
+  recibirPuback(cliente, 1);
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.enVuelo());
+  TEST_ASSERT_EQUAL_UINT32(1, cliente.confirmadas());
+}
+
+void test_puback_partido_entre_lecturas(void)
+{
+  ClienteQoS1 cliente(transporte);
+  TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+
+  const uint8_t puback[4] = {0x40, 0x02, 0x00, 0x01};
+  uint8_t leido[4];
+  for (uint8_t i = 0; i < sizeof(puback); i++)
+  {
+    TEST_ASSERT_EQUAL_UINT8(1, cliente.enVuelo());
+    transporte.recibir(puback + i, 1);
+    TEST_ASSERT_EQUAL_INT(1, cliente.read(leido, sizeof(leido)));
+    TEST_ASSERT_EQUAL_UINT8(puback[i], leido[0]);
+  }
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.enVuelo());
+}
+
+void test_otros_paquetes_no_confirman(void)
+{
+  ClienteQoS1 cliente(transporte);
+  TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+
+  // PUBLISH entrante de 200 bytes (longitud en dos bytes) cuyo cuerpo imita un PUBACK
+  uint8_t publish[3 + 200];
+  memset(publish, 0, sizeof(publish));
+  publish[0] = 0x30;
+  publish[1] = 0xC8;
+  publish[2] = 0x01;
+  const uint8_t imitacion[4] = {0x40, 0x02, 0x00, 0x01};
+  memcpy(publish + 10, imitacion, sizeof(imitacion));
+  transporte.recibir(publish, sizeof(publish));
+
+  // PUBACK con longitud distinta de 2, PINGRESP sin cuerpo y SUBACK
+  const uint8_t otros[] = {0x40, 0x03, 0x00, 0x01, 0x00, 0xD0, 0x00, 0x90, 0x03, 0x00, 0x01, 0x01};
+  transporte.recibir(otros, sizeof(otros));
+
+  uint8_t bloque[64];
+  while (cliente.read(bloque, sizeof(bloque)) > 0)
+  {
+  }
+  TEST_ASSERT_EQUAL_UINT8(1, cliente.enVuelo());
+
+  recibirPuback(cliente, 1);
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.enVuelo());
+}
+
+void test_ventana_llena(void)
+{
+  ClienteQoS1 cliente(transporte);
+  for (uint8_t i = 0; i < VENTANA_QOS1; i++)
+  {
+    TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+  }
+  TEST_ASSERT_FALSE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+  TEST_ASSERT_EQUAL_UINT16(0, cliente.iniciarPublicacion(TOPICO_PRUEBA, 3));
+  TEST_ASSERT_EQUAL_UINT8(VENTANA_QOS1, cliente.enVuelo());
+
+  recibirPuback(cliente, 1);
+  TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+  TEST_ASSERT_EQUAL_UINT8(VENTANA_QOS1, cliente.enVuelo());
+}
+
+void test_sin_conexion_no_publica(void)
+{
+  ClienteQoS1 cliente(transporte);
+  transporte.conectado = false;
+  TEST_ASSERT_FALSE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+  TEST_ASSERT_EQUAL_UINT16(0, cliente.iniciarPublicacion(TOPICO_PRUEBA, 3));
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.enVuelo());
+}
+
+void test_confirmacion_fuera_de_orden(void)
+{
+  ClienteQoS1 cliente(transporte);
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+  }
+
+  // El frente sigue sin confirmar: no se libera nada
+  recibirPuback(cliente, 2);
+  recibirPuback(cliente, 3);
+  TEST_ASSERT_EQUAL_UINT8(3, cliente.enVuelo());
+  TEST_ASSERT_EQUAL_UINT32(2, cliente.confirmadas());
+
+  recibirPuback(cliente, 1);
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.enVuelo());
+}
+
+void test_mensaje_mayor_que_la_arena(void)
+{
+  static uint8_t enorme[TAMANO_ARENA_QOS1];
+  ClienteQoS1 cliente(transporte);
+  TEST_ASSERT_FALSE(cliente.publicar(TOPICO_PRUEBA, enorme, sizeof(enorme)));
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.enVuelo());
+}
+
+void test_arena_llena_y_compactacion(void)
+{
+  ClienteQoS1 cliente(transporte);
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, CARGA_GRANDE));
+  }
+
+  // Queda lugar en la ventana pero no en la arena
+  TEST_ASSERT_FALSE(cliente.publicar(TOPICO_PRUEBA, carga, CARGA_MAYOR));
+
+  // Liberado el frente, el nuevo mensaje solo entra moviendo el tercero al inicio
+  recibirPuback(cliente, 1);
+  recibirPuback(cliente, 2);
+  TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, CARGA_MAYOR));
+  TEST_ASSERT_EQUAL_UINT8(2, cliente.enVuelo());
+
+  // El reenvio sale de la arena: los paquetes deben haber sobrevivido la compactacion
+  transporte.reiniciar();
+  TEST_ASSERT_EQUAL_UINT8(2, cliente.reenviarPendientes());
+
+  static uint8_t esperado[2 * (CARGA_MAYOR + 16)];
+  size_t longitud = armarPublish(esperado, 0x3A, 3, carga, CARGA_GRANDE);
+  longitud += armarPublish(esperado + longitud, 0x3A, 4, carga, CARGA_MAYOR);
+  TEST_ASSERT_EQUAL_UINT32(longitud, transporte.escritos);
+  TEST_ASSERT_EQUAL_MEMORY(esperado, transporte.captura, longitud);
+}
+
+void test_reenvio_con_dup(void)
+{
+  ClienteQoS1 cliente(transporte);
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga + i, 4));
+  }
+  recibirPuback(cliente, 2);
+
+  // Solo los no confirmados, con el mismo identificador y la marca DUP
+  transporte.stop();
+  cliente.connect("broker", 8883);
+  transporte.escritos = 0;
+  TEST_ASSERT_EQUAL_UINT8(2, cliente.reenviarPendientes());
+  TEST_ASSERT_EQUAL_UINT32(2, cliente.reenviadas());
+
+  uint8_t esperado[64];
+  size_t longitud = armarPublish(esperado, 0x3A, 1, carga, 4);
+  longitud += armarPublish(esperado + longitud, 0x3A, 3, carga + 2, 4);
+  TEST_ASSERT_EQUAL_UINT32(longitud, transporte.escritos);
+  TEST_ASSERT_EQUAL_MEMORY(esperado, transporte.captura, longitud);
+
+  // Tras confirmar el frente se libera tambien el que ya tenia PUBACK
+  recibirPuback(cliente, 1);
+  TEST_ASSERT_EQUAL_UINT8(1, cliente.enVuelo());
+  recibirPuback(cliente, 3);
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.enVuelo());
+}
+
+void test_reconexion_descarta_paquete_entrante_a_medias(void)
+{
+  ClienteQoS1 cliente(transporte);
+  TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+
+  // La conexion cae a mitad de un PUBLISH entrante
+  const uint8_t cortado[] = {0x30, 0x10, 0x00};
+  transporte.recibir(cortado, sizeof(cortado));
+  while (cliente.read() >= 0)
+  {
+  }
+
+  transporte.stop();
+  cliente.connect("broker", 8883);
+  cliente.reenviarPendientes();
+  recibirPuback(cliente, 1);
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.enVuelo());
+}
+
+void test_flujo_confirmado(void)
+{
+  ClienteQoS1 cliente(transporte);
+  uint16_t identificador = cliente.iniciarPublicacion(TOPICO_PRUEBA, 6);
+  TEST_ASSERT_EQUAL_UINT16(1, identificador);
+  TEST_ASSERT_EQUAL_UINT32(3, cliente.write(carga, 3));
+  TEST_ASSERT_EQUAL_UINT32(3, cliente.write(carga + 3, 3));
+  TEST_ASSERT_TRUE(cliente.terminarPublicacion());
+
+  uint8_t esperado[32];
+  size_t longitud = armarPublish(esperado, 0x32, identificador, carga, 6);
+  TEST_ASSERT_EQUAL_UINT32(longitud, transporte.escritos);
+  TEST_ASSERT_EQUAL_MEMORY(esperado, transporte.captura, longitud);
+  TEST_ASSERT_EQUAL_UINT8(FLUJO_EN_VUELO, cliente.estadoFlujo(identificador));
+
+  recibirPuback(cliente, identificador);
+  TEST_ASSERT_EQUAL_UINT8(FLUJO_CONFIRMADO, cliente.estadoFlujo(identificador));
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.enVuelo());
+}
+
+void test_flujo_truncado_cierra_la_conexion(void)
+{
+  ClienteQoS1 cliente(transporte);
+  TEST_ASSERT_TRUE(cliente.iniciarPublicacion(TOPICO_PRUEBA, 6) != 0);
+  cliente.write(carga, 3);
+  TEST_ASSERT_FALSE(cliente.terminarPublicacion());
+  TEST_ASSERT_EQUAL_UINT32(1, transporte.cierres);
+}
+
+void test_flujo_perdido_tras_reconectar(void)
+{
+  ClienteQoS1 cliente(transporte);
+  TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+  uint16_t identificador = cliente.iniciarPublicacion(TOPICO_PRUEBA, 3);
+  cliente.write(carga, 3);
+  TEST_ASSERT_TRUE(cliente.terminarPublicacion());
+  TEST_ASSERT_TRUE(cliente.publicar(TOPICO_PRUEBA, carga, 3));
+
+  transporte.stop();
+  cliente.connect("broker", 8883);
+  transporte.escritos = 0;
+
+  // El enviado por flujo no tiene copia: queda perdido aunque siga en la
+  // ventana detras del primero, que aun espera su PUBACK
+  TEST_ASSERT_EQUAL_UINT8(2, cliente.reenviarPendientes());
+  TEST_ASSERT_EQUAL_UINT8(FLUJO_PERDIDO, cliente.estadoFlujo(identificador));
+  TEST_ASSERT_EQUAL_UINT8(3, cliente.enVuelo());
+
+  uint8_t esperado[32];
+  size_t longitud = armarPublish(esperado, 0x3A, 1, carga, 3);
+  longitud += armarPublish(esperado + longitud, 0x3A, 3, carga, 3);
+  TEST_ASSERT_EQUAL_UINT32(longitud, transporte.escritos);
+  TEST_ASSERT_EQUAL_MEMORY(esperado, transporte.captura, longitud);
+
+  // Un PUBACK tardio del perdido no cambia su estado
+  recibirPuback(cliente, identificador);
+  TEST_ASSERT_EQUAL_UINT8(FLUJO_PERDIDO, cliente.estadoFlujo(identificador));
+  recibirPuback(cliente, 1);
+  recibirPuback(cliente, 3);
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.enVuelo());
+  TEST_ASSERT_EQUAL_UINT8(FLUJO_PERDIDO, cliente.estadoFlujo(identificador));
+}
+
+void test_flujo_perdido_al_frente_sale_de_la_ventana(void)
+{
+  ClienteQoS1 cliente(transporte);
+  uint16_t identificador = cliente.iniciarPublicacion(TOPICO_PRUEBA, 3);
+  cliente.write(carga, 3);
+  TEST_ASSERT_TRUE(cliente.terminarPublicacion());
+
+  transporte.stop();
+  cliente.connect("broker", 8883);
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.reenviarPendientes());
+  TEST_ASSERT_EQUAL_UINT8(FLUJO_PERDIDO, cliente.estadoFlujo(identificador));
+  TEST_ASSERT_EQUAL_UINT8(0, cliente.enVuelo());
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_publicar_escribe_publish_qos1);
+  RUN_TEST(test_puback_libera_la_ventana);
+  RUN_TEST(test_puback_desconocido_o_repetido_se_ignora);
+  RUN_TEST(test_puback_partido_entre_lecturas);
+  RUN_TEST(test_otros_paquetes_no_confirman);
+  RUN_TEST(test_ventana_llena);
+  RUN_TEST(test_sin_conexion_no_publica);
+  RUN_TEST(test_confirmacion_fuera_de_orden);
+  RUN_TEST(test_mensaje_mayor_que_la_arena);
+  RUN_TEST(test_arena_llena_y_compactacion);
+  RUN_TEST(test_reenvio_con_dup);
+  RUN_TEST(test_reconexion_descarta_paquete_entrante_a_medias);
+  RUN_TEST(test_flujo_confirmado);
+  RUN_TEST(test_flujo_truncado_cierra_la_conexion);
+  RUN_TEST(test_flujo_perdido_tras_reconectar);
+  RUN_TEST(test_flujo_perdido_al_frente_sale_de_la_ventana);
+  return UNITY_END();
+}
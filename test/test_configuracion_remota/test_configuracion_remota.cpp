@@ -0,0 +1,211 @@
+/**
+ * @file test_configuracion_remota.cpp
+ * @brief Pruebas del mensaje de configuracion remota y de su copia en NVS
+ *
+ * Ejecutar con: pio test -e native -f test_configuracion_remota -v
+ */
+
+#include <unity.h>
+#include <string.h>
+#include <Preferences.h>
+#include "configuracion_remota.h"
+
+static ConfiguracionDispositivo configuracion;
+
+/// Valores por defecto de la aplicacion, con dos reglas ya en uso
+static void valoresPorDefecto(ConfiguracionDispositivo &destino)
+{
+  memset(&destino, 0, sizeof(destino));
+  destino.periodoMuestreoMs = 25;
+  destino.desfaseSensoresMs = 5;
+  destino.keepAliveS = 15;
+  destino.muestrasPorEntrega = 20;
+  destino.numeroReglas = 2;
+  strcpy(destino.prefijos[0], "EIE_SEDE1_http/");
+}
+
+static bool interpretar(const char *texto)
+{
+  return interpretarConfiguracion((const uint8_t *)texto, (unsigned int)strlen(texto), configuracion);
+}
+
+void setUp(void)
+{
+  valoresPorDefecto(configuracion);
+  nvsSimulada().formatear();
+}
+
+void tearDown(void)
+{
+}
+
+void test_mensaje_completo(void)
+{
+  TEST_ASSERT_TRUE(interpretar("version=3;muestras=10;periodoMs=50;desfaseMs=7;keepAliveS=30;"
+                               "prefijo1=PLANTA_B/http/;regla0=4,mayor,150,5,2;regla1=3,cambio,2.5"));
+  TEST_ASSERT_EQUAL_UINT32(3, configuracion.version);
+  TEST_ASSERT_EQUAL_UINT8(10, configuracion.muestrasPorEntrega);
+  TEST_ASSERT_EQUAL_UINT16(50, configuracion.periodoMuestreoMs);
+  TEST_ASSERT_EQUAL_UINT16(7, configuracion.desfaseSensoresMs);
+  TEST_ASSERT_EQUAL_UINT16(30, configuracion.keepAliveS);
+  TEST_ASSERT_TRUE(strcmp(configuracion.prefijos[0], "EIE_SEDE1_http/") == 0);
+  TEST_ASSERT_TRUE(strcmp(configuracion.prefijos[1], "PLANTA_B/http/") == 0);
+
+  TEST_ASSERT_EQUAL_UINT8(2, configuracion.numeroReglas);
+  TEST_ASSERT_EQUAL_UINT8(4, configuracion.reglas[0].canal);
+  TEST_ASSERT_EQUAL_UINT8(REGLA_MAYOR, configuracion.reglas[0].tipo);
+  TEST_ASSERT_EQUAL_FLOAT(150.0f, configuracion.reglas[0].umbral);
+  TEST_ASSERT_EQUAL_FLOAT(5.0f, configuracion.reglas[0].histeresis);
+  TEST_ASSERT_EQUAL_UINT8(2, configuracion.reglas[0].salida);
+
+  // Histeresis y salida son opcionales
+  TEST_ASSERT_EQUAL_UINT8(REGLA_CAMBIO, configuracion.reglas[1].tipo);
+  TEST_ASSERT_EQUAL_FLOAT(2.5f, configuracion.reglas[1].umbral);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, configuracion.reglas[1].histeresis);
+  TEST_ASSERT_EQUAL_UINT8(SALIDA_NINGUNA, configuracion.reglas[1].salida);
+}
+
+void test_separadores_y_valores_por_defecto(void)
+{
+  TEST_ASSERT_TRUE(interpretar("version=4\r\nmuestras=12\n;;periodoMs=40;"));
+  TEST_ASSERT_EQUAL_UINT32(4, configuracion.version);
+  TEST_ASSERT_EQUAL_UINT8(12, configuracion.muestrasPorEntrega);
+  TEST_ASSERT_EQUAL_UINT16(40, configuracion.periodoMuestreoMs);
+
+  // Lo que no viene queda como estaba, salvo las reglas, que se reemplazan
+  TEST_ASSERT_EQUAL_UINT16(15, configuracion.keepAliveS);
+  TEST_ASSERT_EQUAL_UINT8(0, configuracion.numeroReglas);
+}
+
+void test_version_obligatoria(void)
+{
+  TEST_ASSERT_FALSE(interpretar("muestras=10"));
+  valoresPorDefecto(configuracion);
+  TEST_ASSERT_FALSE(interpretar("version=0;muestras=10"));
+  valoresPorDefecto(configuracion);
+  TEST_ASSERT_FALSE(interpretar(""));
+}
+
+void test_clave_desconocida_rechaza_el_mensaje(void)
+{
+  const char *mensajes[] = {"version=1;desconocida=3",
+                            "version=1;Muestras=10",
+                            "version=1;muestras",
+                            "version=1;=10",
+                            "version=1;prefijo4=A/",
+                            "version=1;prefijo=A/",
+                            "version=1;regla8=0,mayor,1",
+                            "version=1;regla00=0,mayor,1",
+                            "version=1;muestras =10"};
+  for (uint8_t i = 0; i < sizeof(mensajes) / sizeof(mensajes[0]); i++)
+  {
+    valoresPorDefecto(configuracion);
+    TEST_ASSERT_FALSE(interpretar(mensajes[i]));
+  }
+}
+
+void test_numero_que_no_cabe(void)
+{
+  TEST_ASSERT_TRUE(interpretar("version=2147483647;muestras=255;periodoMs=65535;desfaseMs=65535;keepAliveS=65535"));
+  TEST_ASSERT_EQUAL_UINT32(2147483647UL, configuracion.version);
+  TEST_ASSERT_EQUAL_UINT8(255, configuracion.muestrasPorEntrega);
+  TEST_ASSERT_EQUAL_UINT16(65535, configuracion.periodoMuestreoMs);
+
+  const char *mensajes[] = {"version=2147483648",      "version=99999999999999999999",
+                            "version=1;muestras=256",  "version=1;muestras=-1",
+                            "version=1;periodoMs=65536", "version=1;desfaseMs=70000",
+                            "version=1;keepAliveS=65536", "version=1;muestras=1x",
+                            "version=1;muestras=",     "version=1;regla0=32,mayor,1",
+                            "version=1;regla0=0,mayor,1,0,32"};
+  for (uint8_t i = 0; i < sizeof(mensajes) / sizeof(mensajes[0]); i++)
+  {
+    valoresPorDefecto(configuracion);
+    TEST_ASSERT_FALSE(interpretar(mensajes[i]));
+  }
+}
+
+void test_reglas_numeradas_sin_huecos(void)
+{
+  TEST_ASSERT_TRUE(interpretar("version=1;regla0=0,mayor,1;regla1=1,mayor,1;regla2=2,menor,1;regla3=3,mayor,1;"
+                               "regla4=4,mayor,1;regla5=5,mayor,1;regla6=6,mayor,1;regla7=7,mayor,1"));
+  TEST_ASSERT_EQUAL_UINT8(MAX_REGLAS, configuracion.numeroReglas);
+  TEST_ASSERT_EQUAL_UINT8(REGLA_MENOR, configuracion.reglas[2].tipo);
+
+  // El orden en el mensaje no importa, la numeracion si
+  valoresPorDefecto(configuracion);
+  TEST_ASSERT_TRUE(interpretar("regla1=1,mayor,1;version=1;regla0=0,menor,1"));
+  TEST_ASSERT_EQUAL_UINT8(2, configuracion.numeroReglas);
+
+  const char *mensajes[] = {"version=1;regla1=1,mayor,1", "version=1;regla0=0,mayor,1;regla2=2,mayor,1",
+                            "version=1;regla0=0,mayor,1;regla1=1,mayor,1;regla7=7,mayor,1"};
+  for (uint8_t i = 0; i < sizeof(mensajes) / sizeof(mensajes[0]); i++)
+  {
+    valoresPorDefecto(configuracion);
+    TEST_ASSERT_FALSE(interpretar(mensajes[i]));
+  }
+}
+
+void test_regla_invalida(void)
+{
+  const char *mensajes[] = {"version=1;regla0=0,igual,1",   "version=1;regla0=0,mayor",
+                            "version=1;regla0=0,mayor,",    "version=1;regla0=0,,1",
+                            "version=1;regla0=0,mayor,1e3", "version=1;regla0=0,mayor,1,-1",
+                            "version=1;regla0=0,mayor,1,1,0,9", "version=1;regla0=0,mayor,1.2.3",
+                            "version=1;regla0=-1,mayor,1",  "version=1;regla0=0,MAYOR,1"};
+  for (uint8_t i = 0; i < sizeof(mensajes) / sizeof(mensajes[0]); i++)
+  {
+    valoresPorDefecto(configuracion);
+    TEST_ASSERT_FALSE(interpretar(mensajes[i]));
+  }
+
+  TEST_ASSERT_TRUE(interpretar("version=1;regla0=0,menor,-3.25,0.5"));
+  TEST_ASSERT_EQUAL_FLOAT(-3.25f, configuracion.reglas[0].umbral);
+  TEST_ASSERT_EQUAL_FLOAT(0.5f, configuracion.reglas[0].histeresis);
+}
+
+void test_prefijo_invalido(void)
+{
+  char largo[64];
+  memset(largo, 0, sizeof(largo));
+  strcpy(largo, "version=1;prefijo0=");
+  memset(largo + strlen(largo), 'A', LONGITUD_PREFIJO_CONFIGURACION);
+
+  const char *mensajes[] = {"version=1;prefijo0=", "version=1;prefijo0=A/+/", "version=1;prefijo0=A/#", largo};
+  for (uint8_t i = 0; i < sizeof(mensajes) / sizeof(mensajes[0]); i++)
+  {
+    valoresPorDefecto(configuracion);
+    TEST_ASSERT_FALSE(interpretar(mensajes[i]));
+  }
+
+  // El mas largo que cabe, con el terminador
+  valoresPorDefecto(configuracion);
+  largo[strlen(largo) - 1] = '\0';
+  TEST_ASSERT_TRUE(interpretar(largo));
+  TEST_ASSERT_EQUAL_UINT32(LONGITUD_PREFIJO_CONFIGURACION - 1, strlen(configuracion.prefijos[0]));
+}
+
+void test_guardar_y_cargar(void)
+{
+  ConfiguracionDispositivo leida;
+  TEST_ASSERT_FALSE(cargarConfiguracion(leida));
+
+  TEST_ASSERT_TRUE(interpretar("version=9;muestras=8;regla0=1,mayor,30,1,0"));
+  TEST_ASSERT_TRUE(guardarConfiguracion(configuracion));
+  TEST_ASSERT_TRUE(cargarConfiguracion(leida));
+  TEST_ASSERT_EQUAL_MEMORY(&configuracion, &leida, sizeof(leida));
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_mensaje_completo);
+  RUN_TEST(test_separadores_y_valores_por_defecto);
+  RUN_TEST(test_version_obligatoria);
+  RUN_TEST(test_clave_desconocida_rechaza_el_mensaje);
+  RUN_TEST(test_numero_que_no_cabe);
+  RUN_TEST(test_reglas_numeradas_sin_huecos);
+  RUN_TEST(test_regla_invalida);
+  RUN_TEST(test_prefijo_invalido);
+  RUN_TEST(test_guardar_y_cargar);
+  return UNITY_END();
+}
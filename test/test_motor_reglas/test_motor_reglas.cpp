@@ -0,0 +1,246 @@
+/**
+ * @file test_motor_reglas.cpp
+ * @brief Pruebas de las reglas de alarma con histeresis y de las salidas que manejan
+ *
+ * Ejecutar con: pio test -e native -f test_motor_reglas -v
+ */
+
+#include <unity.h>
+#include <math.h>
+#include "motor_reglas.h"
+
+#define SEGUNDO_US 1000000LL ///< Microsegundos por segundo
+
+static MotorReglas motor;
+static CambioRegla cambios[MAX_REGLAS];
+
+void setUp(void)
+{
+  motor = MotorReglas();
+}
+
+void tearDown(void)
+{
+}
+
+void test_mayor_con_histeresis(void)
+{
+  Regla regla = {0, REGLA_MAYOR, SALIDA_NINGUNA, 30.0f, 2.0f};
+  TEST_ASSERT_TRUE(motor.cargar(&regla, 1));
+
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 29.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 30.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(0, 31.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, cambios[0].regla);
+  TEST_ASSERT_TRUE(cambios[0].activa);
+  TEST_ASSERT_EQUAL_FLOAT(31.0f, cambios[0].valor);
+
+  // Dentro de la banda de histeresis sigue activa
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 29.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 28.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(0, 27.9f, 0, cambios));
+  TEST_ASSERT_FALSE(cambios[0].activa);
+  TEST_ASSERT_EQUAL_FLOAT(27.9f, cambios[0].valor);
+}
+
+void test_menor_con_histeresis(void)
+{
+  Regla regla = {0, REGLA_MENOR, SALIDA_NINGUNA, 10.0f, 1.0f};
+  TEST_ASSERT_TRUE(motor.cargar(&regla, 1));
+
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 10.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(0, 9.9f, 0, cambios));
+  TEST_ASSERT_TRUE(cambios[0].activa);
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 10.8f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 11.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(0, 11.2f, 0, cambios));
+  TEST_ASSERT_FALSE(cambios[0].activa);
+}
+
+void test_sin_histeresis(void)
+{
+  Regla regla = {0, REGLA_MAYOR, SALIDA_NINGUNA, 5.0f, 0.0f};
+  TEST_ASSERT_TRUE(motor.cargar(&regla, 1));
+
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(0, 5.1f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 5.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(0, 4.9f, 0, cambios));
+  TEST_ASSERT_FALSE(cambios[0].activa);
+}
+
+void test_ritmo_de_cambio(void)
+{
+  Regla regla = {0, REGLA_CAMBIO, SALIDA_NINGUNA, 2.0f, 0.5f};
+  TEST_ASSERT_TRUE(motor.cargar(&regla, 1));
+
+  // La primera lectura no tiene ritmo
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 100.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 101.0f, SEGUNDO_US, cambios));
+
+  // 2 unidades en medio segundo: 4 unidades por segundo
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(0, 103.0f, SEGUNDO_US + SEGUNDO_US / 2, cambios));
+  TEST_ASSERT_TRUE(cambios[0].activa);
+  TEST_ASSERT_EQUAL_FLOAT(4.0f, cambios[0].valor);
+
+  // En valor absoluto: bajar 1.75 por segundo sigue dentro de la histeresis
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 101.25f, 2 * SEGUNDO_US + SEGUNDO_US / 2, cambios));
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(0, 102.25f, 3 * SEGUNDO_US + SEGUNDO_US / 2, cambios));
+  TEST_ASSERT_FALSE(cambios[0].activa);
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, cambios[0].valor);
+}
+
+void test_ritmo_sin_tiempo_transcurrido(void)
+{
+  Regla regla = {0, REGLA_CAMBIO, SALIDA_NINGUNA, 2.0f, 0.0f};
+  TEST_ASSERT_TRUE(motor.cargar(&regla, 1));
+
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 10.0f, SEGUNDO_US, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 50.0f, SEGUNDO_US, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 90.0f, 0, cambios));
+
+  // El ritmo se mide desde la ultima lectura, aunque no haya dado ritmo
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 91.0f, SEGUNDO_US, cambios));
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(0, 94.0f, 2 * SEGUNDO_US, cambios));
+  TEST_ASSERT_EQUAL_FLOAT(3.0f, cambios[0].valor);
+}
+
+void test_nan_no_cambia_nada(void)
+{
+  Regla reglas[2] = {{0, REGLA_MAYOR, 1, 30.0f, 0.0f}, {1, REGLA_CAMBIO, SALIDA_NINGUNA, 2.0f, 0.0f}};
+  TEST_ASSERT_TRUE(motor.cargar(reglas, 2));
+
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(0, 31.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, NAN, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT32(1UL << 1, motor.salidasActivas());
+
+  // Una lectura invalida no cuenta como lectura anterior del ritmo
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(1, 10.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(1, NAN, SEGUNDO_US, cambios));
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(1, 15.0f, 2 * SEGUNDO_US, cambios));
+  TEST_ASSERT_EQUAL_FLOAT(2.5f, cambios[0].valor);
+}
+
+void test_canal_sin_reglas(void)
+{
+  Regla regla = {4, REGLA_MAYOR, 0, 30.0f, 0.0f};
+  TEST_ASSERT_TRUE(motor.cargar(&regla, 1));
+
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(3, 100.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(MAX_CANALES_REGLAS, 100.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(255, 100.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT32(0, motor.salidasActivas());
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(4, 100.0f, 0, cambios));
+}
+
+void test_varias_reglas_en_un_canal(void)
+{
+  Regla reglas[3] = {{2, REGLA_MAYOR, SALIDA_NINGUNA, 30.0f, 0.0f},
+                     {5, REGLA_MAYOR, SALIDA_NINGUNA, 0.0f, 0.0f},
+                     {2, REGLA_MENOR, SALIDA_NINGUNA, 10.0f, 0.0f}};
+  TEST_ASSERT_TRUE(motor.cargar(reglas, 3));
+
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(2, 35.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, cambios[0].regla);
+
+  // Un mismo valor libera una y activa la otra; el indice es el de cargar()
+  TEST_ASSERT_EQUAL_UINT8(2, motor.evaluar(2, 5.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT8(0, cambios[0].regla);
+  TEST_ASSERT_FALSE(cambios[0].activa);
+  TEST_ASSERT_EQUAL_UINT8(2, cambios[1].regla);
+  TEST_ASSERT_TRUE(cambios[1].activa);
+}
+
+void test_salida_activa_con_cualquiera_de_sus_reglas(void)
+{
+  Regla reglas[4] = {{0, REGLA_MAYOR, 2, 30.0f, 0.0f},
+                     {1, REGLA_MAYOR, 2, 30.0f, 0.0f},
+                     {2, REGLA_MAYOR, 31, 30.0f, 0.0f},
+                     {3, REGLA_MAYOR, SALIDA_NINGUNA, 30.0f, 0.0f}};
+  TEST_ASSERT_TRUE(motor.cargar(reglas, 4));
+
+  motor.evaluar(0, 31.0f, 0, cambios);
+  TEST_ASSERT_EQUAL_UINT32(1UL << 2, motor.salidasActivas());
+  motor.evaluar(1, 31.0f, 0, cambios);
+  motor.evaluar(0, 20.0f, 0, cambios);
+  TEST_ASSERT_EQUAL_UINT32(1UL << 2, motor.salidasActivas());
+  motor.evaluar(2, 31.0f, 0, cambios);
+  TEST_ASSERT_EQUAL_UINT32((1UL << 2) | (1UL << 31), motor.salidasActivas());
+  motor.evaluar(1, 20.0f, 0, cambios);
+  TEST_ASSERT_EQUAL_UINT32(1UL << 31, motor.salidasActivas());
+
+  // Una regla sin salida solo da alarma
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(3, 31.0f, 0, cambios));
+  TEST_ASSERT_EQUAL_UINT32(1UL << 31, motor.salidasActivas());
+  motor.evaluar(2, 20.0f, 0, cambios);
+  TEST_ASSERT_EQUAL_UINT32(0, motor.salidasActivas());
+}
+
+void test_cargar_rechaza_reglas_invalidas(void)
+{
+  const Regla invalidas[] = {{MAX_CANALES_REGLAS, REGLA_MAYOR, 0, 1.0f, 0.0f},
+                             {0, NUMERO_TIPOS_REGLA, 0, 1.0f, 0.0f},
+                             {0, REGLA_MAYOR, MAX_SALIDAS_REGLAS, 1.0f, 0.0f},
+                             {0, REGLA_MAYOR, 0, NAN, 0.0f},
+                             {0, REGLA_MAYOR, 0, INFINITY, 0.0f},
+                             {0, REGLA_MAYOR, 0, 1.0f, -0.5f},
+                             {0, REGLA_MAYOR, 0, 1.0f, NAN}};
+  const Regla valida = {0, REGLA_MAYOR, 0, 1.0f, 0.0f};
+
+  for (uint8_t i = 0; i < sizeof(invalidas) / sizeof(invalidas[0]); i++)
+  {
+    TEST_ASSERT_FALSE(MotorReglas::reglaValida(invalidas[i]));
+
+    // Una sola invalida descarta todas, tambien las que ya estaban
+    TEST_ASSERT_TRUE(motor.cargar(&valida, 1));
+    Regla reglas[2] = {valida, invalidas[i]};
+    TEST_ASSERT_FALSE(motor.cargar(reglas, 2));
+    TEST_ASSERT_EQUAL_UINT8(0, motor.cantidad());
+    TEST_ASSERT_EQUAL_UINT8(0, motor.evaluar(0, 5.0f, 0, cambios));
+  }
+  TEST_ASSERT_TRUE(MotorReglas::reglaValida(valida));
+}
+
+void test_cargar_rechaza_demasiadas(void)
+{
+  Regla reglas[MAX_REGLAS + 1];
+  for (uint8_t i = 0; i < MAX_REGLAS + 1; i++)
+  {
+    Regla regla = {i, REGLA_MAYOR, SALIDA_NINGUNA, 1.0f, 0.0f};
+    reglas[i] = regla;
+  }
+  TEST_ASSERT_FALSE(motor.cargar(reglas, MAX_REGLAS + 1));
+  TEST_ASSERT_EQUAL_UINT8(0, motor.cantidad());
+  TEST_ASSERT_TRUE(motor.cargar(reglas, MAX_REGLAS));
+  TEST_ASSERT_EQUAL_UINT8(MAX_REGLAS, motor.cantidad());
+}
+
+void test_cargar_libera_todo(void)
+{
+  Regla regla = {0, REGLA_MAYOR, 3, 30.0f, 0.0f};
+  TEST_ASSERT_TRUE(motor.cargar(&regla, 1));
+  motor.evaluar(0, 31.0f, 0, cambios);
+  TEST_ASSERT_EQUAL_UINT32(1UL << 3, motor.salidasActivas());
+
+  TEST_ASSERT_TRUE(motor.cargar(&regla, 1));
+  TEST_ASSERT_EQUAL_UINT32(0, motor.salidasActivas());
+  TEST_ASSERT_EQUAL_UINT8(1, motor.evaluar(0, 31.0f, 0, cambios));
+  TEST_ASSERT_TRUE(cambios[0].activa);
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_mayor_con_histeresis);
+  RUN_TEST(test_menor_con_histeresis);
+  RUN_TEST(test_sin_histeresis);
+  RUN_TEST(test_ritmo_de_cambio);
+  RUN_TEST(test_ritmo_sin_tiempo_transcurrido);
+  RUN_TEST(test_nan_no_cambia_nada);
+  RUN_TEST(test_canal_sin_reglas);
+  RUN_TEST(test_varias_reglas_en_un_canal);
+  RUN_TEST(test_salida_activa_con_cualquiera_de_sus_reglas);
+  RUN_TEST(test_cargar_rechaza_reglas_invalidas);
+  RUN_TEST(test_cargar_rechaza_demasiadas);
+  RUN_TEST(test_cargar_libera_todo);
+  return UNITY_END();
+}
@@ -0,0 +1,123 @@
+/**
+ * @file test_registro_flash.cpp
+ * @brief Pruebas del registro offline sobre un LittleFS en RAM (test/stubs/LittleFS.h)
+ *
+ * Ejecutar con: pio test -e native -f test_registro_flash -v
+ */
+
+#include <unity.h>
+#include <LittleFS.h>
+#include "registro_flash.h"
+
+#define TAMANO_REGISTRO_PRUEBA 16
+#define REGISTROS_POR_PAGINA ((TAMANO_PAGINA_REGISTRO - 12) / TAMANO_REGISTRO_PRUEBA) ///< Cabecera de 12 bytes
+#define BYTE_GUARDA 0xA5
+
+/**
+ * @brief Registro seguido de una guarda que delata escrituras fuera de la pagina en RAM
+ */
+struct RegistroResguardado
+{
+  RegistroResguardado(void) : registro("/offline", TAMANO_REGISTRO_PRUEBA, 2, 2)
+  {
+    memset(guarda, BYTE_GUARDA, sizeof(guarda));
+  }
+
+  bool guardaIntacta(void) const
+  {
+    for (size_t i = 0; i < sizeof(guarda); i++)
+    {
+      if (guarda[i] != BYTE_GUARDA)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  RegistroFlash registro;
+  uint8_t guarda[4 * TAMANO_REGISTRO_PRUEBA];
+};
+
+static void registroNumerado(uint32_t numero, uint8_t *registro)
+{
+  memset(registro, (uint8_t)numero, TAMANO_REGISTRO_PRUEBA);
+  memcpy(registro, &numero, sizeof(numero));
+}
+
+void setUp(void)
+{
+  LittleFS.formatear();
+  LittleFS.fallarEscrituras = false;
+}
+
+void tearDown(void)
+{
+}
+
+void test_pagina_llena_va_a_flash(void)
+{
+  RegistroResguardado prueba;
+  TEST_ASSERT_TRUE(prueba.registro.iniciar());
+
+  uint8_t registro[TAMANO_REGISTRO_PRUEBA];
+  for (uint32_t i = 0; i < REGISTROS_POR_PAGINA; i++)
+  {
+    registroNumerado(i, registro);
+    TEST_ASSERT_TRUE(prueba.registro.agregar(registro));
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, prueba.registro.paginasPendientes());
+  TEST_ASSERT_EQUAL_UINT16(0, prueba.registro.registrosEnMemoria());
+
+  uint8_t leidos[4 * TAMANO_REGISTRO_PRUEBA];
+  TEST_ASSERT_EQUAL_UINT16(4, prueba.registro.leer(leidos, 4));
+  registroNumerado(3, registro);
+  TEST_ASSERT_EQUAL_MEMORY(registro, leidos + 3 * TAMANO_REGISTRO_PRUEBA, TAMANO_REGISTRO_PRUEBA);
+  TEST_ASSERT_TRUE(prueba.guardaIntacta());
+}
+
+void test_escritura_fallida_no_desborda(void)
+{
+  RegistroResguardado prueba;
+  TEST_ASSERT_TRUE(prueba.registro.iniciar());
+  LittleFS.fallarEscrituras = true;
+
+  uint8_t registro[TAMANO_REGISTRO_PRUEBA];
+  for (uint32_t i = 0; i < REGISTROS_POR_PAGINA - 1; i++)
+  {
+    registroNumerado(i, registro);
+    TEST_ASSERT_TRUE(prueba.registro.agregar(registro));
+  }
+  // El ultimo llena la pagina, que no se puede escribir: todos los siguientes se descartan
+  registroNumerado(REGISTROS_POR_PAGINA - 1, registro);
+  TEST_ASSERT_FALSE(prueba.registro.agregar(registro));
+  for (uint32_t i = 0; i < 8; i++)
+  {
+    registroNumerado(0xEE, registro);
+    TEST_ASSERT_FALSE(prueba.registro.agregar(registro));
+    TEST_ASSERT_EQUAL_UINT16(REGISTROS_POR_PAGINA, prueba.registro.registrosEnMemoria());
+  }
+  TEST_ASSERT_TRUE(prueba.guardaIntacta());
+  TEST_ASSERT_EQUAL_UINT32(0, prueba.registro.paginasPendientes());
+
+  // Al recuperarse la flash, el siguiente agregar escribe la pagina retenida y empieza otra
+  LittleFS.fallarEscrituras = false;
+  registroNumerado(REGISTROS_POR_PAGINA, registro);
+  TEST_ASSERT_TRUE(prueba.registro.agregar(registro));
+  TEST_ASSERT_EQUAL_UINT32(1, prueba.registro.paginasPendientes());
+  TEST_ASSERT_EQUAL_UINT16(1, prueba.registro.registrosEnMemoria());
+
+  uint8_t leido[TAMANO_REGISTRO_PRUEBA];
+  TEST_ASSERT_EQUAL_UINT16(1, prueba.registro.leer(leido, 1));
+  registroNumerado(0, registro);
+  TEST_ASSERT_EQUAL_MEMORY(registro, leido, TAMANO_REGISTRO_PRUEBA);
+  TEST_ASSERT_TRUE(prueba.guardaIntacta());
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_pagina_llena_va_a_flash);
+  RUN_TEST(test_escritura_fallida_no_desborda);
+  return UNITY_END();
+}
@@ -0,0 +1,205 @@
+#ifndef BROKER_SIMULADO_H
+#define BROKER_SIMULADO_H
+
+#include <Client.h>
+
+/**
+ * @file broker_simulado.h
+ * @brief Broker MQTT simulado en lugar del socket TLS
+ *
+ * Separa en paquetes lo que escribe el cliente, cuenta los PUBLISH y sus
+ * bytes y, por cada PUBLISH de QoS 1, deja un PUBACK para leer. No cuenta
+ * el sobrecosto de TLS (cabecera y MAC de cada registro).
+ */
+
+#define RESPUESTAS_BROKER_SIMULADO 256 ///< Bytes de PUBACK pendientes de leer (potencia de dos)
+
+class BrokerSimulado : public Client
+{
+public:
+  BrokerSimulado(void)
+  {
+    reiniciar();
+  }
+
+  void reiniciar(void)
+  {
+    publicaciones = 0;
+    bytesRecibidos = 0;
+    bytesCarga = 0;
+    escritura = 0;
+    lectura = 0;
+    fase = FASE_TIPO;
+  }
+
+  uint32_t publicaciones;  ///< PUBLISH completos recibidos
+  uint64_t bytesRecibidos; ///< Todo lo escrito por el cliente, cabeceras incluidas
+  uint64_t bytesCarga;     ///< Solo la carga de los PUBLISH
+
+  int connect(IPAddress ip, uint16_t port) override
+  {
+    (void)ip;
+    (void)port;
+    return 1;
+  }
+
+  int connect(const char *host, uint16_t port) override
+  {
+    (void)host;
+    (void)port;
+    return 1;
+  }
+
+  size_t write(uint8_t dato) override
+  {
+    return write(&dato, 1);
+  }
+
+  size_t write(const uint8_t *buf, size_t size) override
+  {
+    for (size_t i = 0; i < size; i++)
+    {
+      recibir(buf[i]);
+    }
+    bytesRecibidos += size;
+    return size;
+  }
+
+  int available(void) override
+  {
+    return (int)(escritura - lectura);
+  }
+
+  int read(void) override
+  {
+    if (lectura == escritura)
+    {
+      return -1;
+    }
+    return respuestas[lectura++ % RESPUESTAS_BROKER_SIMULADO];
+  }
+
+  int read(uint8_t *buf, size_t size) override
+  {
+    size_t leidos = 0;
+    while (leidos < size && lectura != escritura)
+    {
+      buf[leidos++] = (uint8_t)read();
+    }
+    return (int)leidos;
+  }
+
+  int peek(void) override
+  {
+    return lectura == escritura ? -1 : respuestas[lectura % RESPUESTAS_BROKER_SIMULADO];
+  }
+
+  void flush(void) override
+  {
+  }
+
+  void stop(void) override
+  {
+  }
+
+  uint8_t connected(void) override
+  {
+    return 1;
+  }
+
+  operator bool(void) override
+  {
+    return true;
+  }
+
+private:
+  enum Fase : uint8_t
+  {
+    FASE_TIPO = 0,
+    FASE_LONGITUD,
+    FASE_CUERPO
+  };
+
+  /// Avanza el analisis del flujo del cliente un byte
+  void recibir(uint8_t dato)
+  {
+    switch (fase)
+    {
+    case FASE_TIPO:
+      tipo = dato;
+      restante = 0;
+      desplazamiento = 0;
+      fase = FASE_LONGITUD;
+      break;
+
+    case FASE_LONGITUD:
+      restante |= (uint32_t)(dato & 0x7F) << desplazamiento;
+      desplazamiento += 7;
+      if (!(dato & 0x80))
+      {
+        posicion = 0;
+        longitudCuerpo = restante;
+        longitudTopico = 0;
+        identificador = 0;
+        fase = restante > 0 ? FASE_CUERPO : FASE_TIPO;
+        if (restante == 0)
+        {
+          terminarPaquete();
+        }
+      }
+      break;
+
+    case FASE_CUERPO:
+      if (posicion < 2)
+      {
+        longitudTopico = (uint16_t)((longitudTopico << 8) | dato);
+      }
+      else if (posicion >= 2u + longitudTopico && posicion < 4u + longitudTopico)
+      {
+        identificador = (uint16_t)((identificador << 8) | dato);
+      }
+      posicion++;
+      if (--restante == 0)
+      {
+        terminarPaquete();
+        fase = FASE_TIPO;
+      }
+      break;
+    }
+  }
+
+  void terminarPaquete(void)
+  {
+    if ((tipo & 0xF0) != 0x30)
+    {
+      return;
+    }
+
+    bool qos1 = (tipo & 0x06) == 0x02;
+    publicaciones++;
+    bytesCarga += longitudCuerpo - 2 - longitudTopico - (qos1 ? 2 : 0);
+    if (qos1 && escritura - lectura <= RESPUESTAS_BROKER_SIMULADO - 4)
+    {
+      const uint8_t puback[4] = {0x40, 0x02, (uint8_t)(identificador >> 8), (uint8_t)identificador};
+      for (uint8_t i = 0; i < sizeof(puback); i++)
+      {
+        respuestas[escritura++ % RESPUESTAS_BROKER_SIMULADO] = puback[i];
+      }
+    }
+  }
+
+  Fase fase;
+  uint8_t tipo;
+  uint8_t desplazamiento;
+  uint32_t restante;
+  uint32_t posicion;
+  uint32_t longitudCuerpo;
+  uint16_t longitudTopico;
+  uint16_t identificador;
+
+  uint8_t respuestas[RESPUESTAS_BROKER_SIMULADO];
+  uint32_t escritura;
+  uint32_t lectura;
+};
+
+#endif
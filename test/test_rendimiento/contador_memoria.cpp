@@ -0,0 +1,76 @@
+#include "contador_memoria.h"
+
+#include <stddef.h>
+#include <new>
+
+static uint32_t totalReservas = 0;
+static uint64_t totalBytes = 0;
+
+extern "C"
+{
+  void *__real_malloc(size_t tamano);
+  void *__real_calloc(size_t cantidad, size_t tamano);
+  void *__real_realloc(void *puntero, size_t tamano);
+  void __real_free(void *puntero);
+
+  void *__wrap_malloc(size_t tamano)
+  {
+    totalReservas++;
+    totalBytes += tamano;
+    return __real_malloc(tamano);
+  }
+
+  void *__wrap_calloc(size_t cantidad, size_t tamano)
+  {
+    totalReservas++;
+    totalBytes += cantidad * tamano;
+    return __real_calloc(cantidad, tamano);
+  }
+
+  void *__wrap_realloc(void *puntero, size_t tamano)
+  {
+    totalReservas++;
+    totalBytes += tamano;
+    return __real_realloc(puntero, tamano);
+  }
+
+  void __wrap_free(void *puntero)
+  {
+    __real_free(puntero);
+  }
+}
+
+void *operator new(size_t tamano)
+{
+  void *puntero = __wrap_malloc(tamano);
+  if (puntero == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return puntero;
+}
+
+void *operator new[](size_t tamano)
+{
+  return operator new(tamano);
+}
+
+void operator delete(void *puntero) noexcept
+{
+  __wrap_free(puntero);
+}
+
+void operator delete[](void *puntero) noexcept
+{
+  __wrap_free(puntero);
+}
+
+uint32_t reservasMemoria(void)
+{
+  return totalReservas;
+}
+
+uint64_t bytesReservados(void)
+{
+  return totalBytes;
+}
@@ -0,0 +1,26 @@
+#ifndef CONTADOR_MEMORIA_H
+#define CONTADOR_MEMORIA_H
+
+#include <stdint.h>
+
+/**
+ * @file contador_memoria.h
+ * @brief Cuenta las reservas de memoria dinamica del proceso
+ *
+ * El env:native enlaza con -Wl,--wrap=malloc (y calloc, realloc y free):
+ * toda llamada de las librerias y del banco pasa por los envoltorios de
+ * contador_memoria.cpp. new y delete se reemplazan alli mismo, porque
+ * libstdc++ es una biblioteca compartida y el --wrap no llega a ella.
+ */
+
+/**
+ * @brief Reservas (malloc, calloc, realloc, new) desde el arranque del proceso
+ */
+uint32_t reservasMemoria(void);
+
+/**
+ * @brief Bytes pedidos en esas reservas
+ */
+uint64_t bytesReservados(void);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef SENSOR_SIMULADO_H
+#define SENSOR_SIMULADO_H
+
+#include <stdint.h>
+#include <math.h>
+
+/**
+ * @file sensor_simulado.h
+ * @brief Controlador de sensor simulado para TareaSensor
+ *
+ * Cumple el ciclo de vida de canal_sensor.h en lugar del HC-SR04, los DHT
+ * o los DS18B20: cada lectura tarda duracionMs (la conversion de un
+ * DS18B20, el intervalo minimo de un DHT) y cada salida es una senoidal
+ * lenta con ruido, algun atipico y algun fallo (NaN), de modo que los
+ * filtros y la banda muerta trabajen como con sensores reales. El ruido
+ * sale de un generador lineal con semilla fija: las corridas se repiten.
+ */
+
+#define MAX_SALIDAS_SIMULADAS 16 ///< Salidas de un controlador simulado
+
+class SensorSimulado
+{
+public:
+  /**
+   * @param salidas Valores por lectura
+   * @param duracionMs Tiempo de cada lectura
+   * @param base Valor medio de la salida 0; cada salida siguiente suma 1
+   * @param amplitud Amplitud de la senoidal
+   * @param ruido Amplitud del ruido uniforme
+   * @param semilla Semilla del generador
+   */
+  SensorSimulado(uint8_t salidas, uint32_t duracionMs, float base, float amplitud, float ruido, uint32_t semilla)
+      : numeroSalidas(salidas < MAX_SALIDAS_SIMULADAS ? salidas : MAX_SALIDAS_SIMULADAS), duracionMs(duracionMs),
+        base(base), amplitud(amplitud), ruido(ruido), estado(semilla), enCurso(false), inicioMs(0)
+  {
+  }
+
+  bool consultar(uint32_t ahoraMs)
+  {
+    if (!enCurso)
+    {
+      enCurso = true;
+      inicioMs = ahoraMs;
+    }
+    if (ahoraMs - inicioMs < duracionMs)
+    {
+      return false;
+    }
+    enCurso = false;
+
+    float fase = (float)ahoraMs * 1e-4f;
+    for (uint8_t i = 0; i < numeroSalidas; i++)
+    {
+      uint32_t azar = siguiente();
+      if (azar % 200 == 0)
+      {
+        valores[i] = NAN; // Lectura fallida
+      }
+      else if (azar % 97 == 0)
+      {
+        valores[i] = base + i + 50.0f * amplitud; // Atipico aislado
+      }
+      else
+      {
+        valores[i] = base + i + amplitud * sinf(fase + i) + ruido * ((float)(azar >> 8) / 16777216.0f - 0.5f);
+      }
+    }
+    return true;
+  }
+
+  uint8_t salidas(void) const
+  {
+    return numeroSalidas;
+  }
+
+  float leer(uint8_t salida) const
+  {
+    return salida < numeroSalidas ? valores[salida] : NAN;
+  }
+
+private:
+  uint32_t siguiente(void)
+  {
+    estado = estado * 1664525u + 1013904223u;
+    return estado;
+  }
+
+  uint8_t numeroSalidas;
+  uint32_t duracionMs;
+  float base;
+  float amplitud;
+  float ruido;
+  uint32_t estado;
+  bool enCurso;
+  uint32_t inicioMs;
+  float valores[MAX_SALIDAS_SIMULADAS];
+};
+
+#endif
@@ -0,0 +1,526 @@
+/**
+ * @file test_rendimiento.cpp
+ * @brief Banco de rendimiento de la ruta adquisicion -> publicacion en el host
+ *
+ * Arma la misma ruta que src/main.cpp con las librerias reales
+ * (Planificador, TareaSensor y sus filtros, ColaSPSC, banda muerta, trama,
+ * formato_fijo y ClienteQoS1), con sensores simulados y un broker
+ * simulado en lugar del hardware y del socket TLS. La corrida avanza un
+ * reloj simulado, asi que DURACION_BANCO_MS de operacion se recorren en
+ * una fraccion de ese tiempo, y mide por modo de publicacion:
+ *
+ * - ciclo: costo de CPU de cada vuelta (planificador, cola, publicacion y
+ *   loop()), media y p50/p99 del HistogramaLatencia
+ * - publicaciones por segundo simulado y bytes por el socket (MQTT, sin TLS)
+ * - reservas de memoria dinamica durante la corrida, que deben ser cero
+ *
+ * Ejecutar con: pio test -e native -v
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <PubSubClient.h>
+#include "esp_timer.h"
+#include "planificador.h"
+#include "cola_spsc.h"
+#include "muestra.h"
+#include "canal_sensor.h"
+#include "banda_muerta.h"
+#include "trama.h"
+#include "formato_fijo.h"
+#include "cliente_qos1.h"
+#include "histograma_latencia.h"
+#include "broker_simulado.h"
+#include "sensor_simulado.h"
+#include "contador_memoria.h"
+
+#ifndef DURACION_BANCO_MS
+#define DURACION_BANCO_MS (10UL * 60UL * 1000UL) ///< Operacion simulada por modo
+#endif
+#define EPOCA_BANCO_US 1718035200000000LL ///< Hora UTC del arranque simulado
+
+// Los mismos valores que src/main.cpp
+#define PERIODO_MUESTREO_MS 50     ///< DELAY_ENTRE_MUESTRAS
+#define LECTURAS_POR_ENTREGA 10    ///< NUMERO_MUESTRAS
+#define LECTURAS_DHT_POR_ENTREGA 2 ///< Una lectura DHT cada 2 s
+#define INTERVALO_DHT_MS 2000      ///< INTERVALO_MINIMO_DHT_MS
+#define CONVERSION_DS18B20_MS 750  ///< Conversion de 12 bits
+#define SENSORES_ONEWIRE 4         ///< DS18B20 simulados en el bus
+#define LATIDO_MS 60000UL
+#define MAX_MUESTRAS_TRAMA 32
+#define TAMANO_TRAMA 768
+#define TAMANO_BLOQUE_TRAMA 256
+#define PERIODO_TRAMA_MS (LECTURAS_POR_ENTREGA * PERIODO_MUESTREO_MS)
+#define TAMANO_BUFFER_MQTT 1024
+#define CAPACIDAD_COLA_MUESTRAS 256
+#define TOPICO_TRAMA "EIE_SEDE1_http/lote"
+#define ESPERA_MAXIMA_CICLO_MS 10 ///< Mayor salto del reloj simulado entre vueltas
+
+enum CanalBanco : uint8_t
+{
+  CANAL_DISTANCIA = 0,
+  CANAL_DHT_BASE = 1,
+  CANAL_ONEWIRE_BASE = 5,
+  NUMERO_CANALES = CANAL_ONEWIRE_BASE + SENSORES_ONEWIRE
+};
+
+enum GrupoBanco : uint8_t
+{
+  GRUPO_DISTANCIA = 0,
+  GRUPO_DHT,
+  GRUPO_ONEWIRE,
+  NUMERO_GRUPOS
+};
+
+/**
+ * @brief Forma de publicar de un modo, como MODO_PUBLICACION
+ */
+enum PublicacionBanco : uint8_t
+{
+  PUBLICACION_INDIVIDUAL = 0,
+  PUBLICACION_LOTE_JSON,
+  PUBLICACION_LOTE_CBOR
+};
+
+/**
+ * @brief Combinacion de opciones de compilacion del firmware que se mide
+ */
+struct ModoBanco
+{
+  const char *nombre;
+  PublicacionBanco publicacion; ///< MODO_PUBLICACION
+  bool qos1;                    ///< QOS_DATOS
+  bool bandaMuerta;             ///< MODO_BANDA_MUERTA
+  bool cadaMuestra;             ///< PUBLICAR_CADA_MUESTRA
+};
+
+struct ResultadoBanco
+{
+  uint32_t ciclos;
+  uint32_t muestras;       ///< Muestras entregadas a la cola
+  uint32_t descartadas;    ///< Muestras perdidas por cola llena
+  uint32_t publicaciones;  ///< PUBLISH recibidos por el broker
+  uint32_t fallidas;       ///< Publicaciones rechazadas por el cliente
+  uint32_t confirmadas;    ///< PUBACK procesados (QoS 1)
+  uint64_t bytes;          ///< Bytes MQTT por el socket
+  uint64_t bytesCarga;     ///< Bytes de carga de los PUBLISH
+  uint32_t reservas;       ///< Reservas de memoria dinamica durante la corrida
+  double cpuPorCicloUs;    ///< Costo medio de una vuelta
+  ResumenLatencia ciclo;   ///< Distribucion del costo de las vueltas
+};
+
+const char *const TOPICOS_CANALES[NUMERO_CANALES] = {
+    "EIE_SEDE1_http/numeric",
+    "EIE_SEDE1_http/temp",
+    "EIE_SEDE1_http/humidity",
+    "EIE_SEDE2_http/temp",
+    "EIE_SEDE2_http/humidity",
+    "EIE_SEDE1_modbus/1/holding/0",
+    "EIE_SEDE1_modbus/1/holding/1",
+    "EIE_SEDE1_modbus/1/holding/2",
+    "EIE_SEDE1_modbus/1/holding/3",
+};
+
+/// Filtro y reporte por canal, como REGISTRO_CANALES
+const DescriptorCanal DESCRIPTORES_CANALES[NUMERO_CANALES] = {
+    {0, "numeric", FILTRO_MEDIANA, 0.0f, 0.0f, {1.0f, LATIDO_MS}},
+    {0, "temp", FILTRO_MEDIA_ROBUSTA, 3.0f, 0.3f, {0.2f, LATIDO_MS}},
+    {0, "humidity", FILTRO_EWMA, 0.2f, 0.0f, {1.0f, LATIDO_MS}},
+    {1, "temp", FILTRO_MEDIA_ROBUSTA, 3.0f, 0.3f, {0.2f, LATIDO_MS}},
+    {1, "humidity", FILTRO_EWMA, 0.2f, 0.0f, {1.0f, LATIDO_MS}},
+    {2, NULL, FILTRO_MEDIA_ROBUSTA, 3.0f, 0.3f, {0.1f, LATIDO_MS}},
+    {2, NULL, FILTRO_MEDIA_ROBUSTA, 3.0f, 0.3f, {0.1f, LATIDO_MS}},
+    {2, NULL, FILTRO_MEDIA_ROBUSTA, 3.0f, 0.3f, {0.1f, LATIDO_MS}},
+    {2, NULL, FILTRO_MEDIA_ROBUSTA, 3.0f, 0.3f, {0.1f, LATIDO_MS}},
+};
+
+/**
+ * @brief Reloj de las marcas de adquisicion: el simulado, en microsegundos
+ */
+static int64_t relojSimuladoUs(void)
+{
+  return (int64_t)millis() * 1000;
+}
+
+static void entregarBanco(uint8_t canal, float valor, int64_t instanteUs);
+
+/**
+ * @brief Una instancia completa de la ruta de datos; se arma de nuevo en cada corrida
+ */
+class Banco
+{
+public:
+  explicit Banco(const ModoBanco &modo)
+      : modo(modo), qos(broker), mqtt(modo.qos1 ? (Client &)qos : (Client &)broker),
+        distancia(1, 0, 120.0f, 30.0f, 2.0f, 1), dht(4, INTERVALO_DHT_MS, 24.0f, 3.0f, 0.4f, 2),
+        onewire(SENSORES_ONEWIRE, CONVERSION_DS18B20_MS, 22.0f, 1.5f, 0.1f, 3),
+        grupos{{"distancia", CANAL_DISTANCIA, 1, PERIODO_MUESTREO_MS, lecturasPorEntrega(modo, LECTURAS_POR_ENTREGA)},
+               {"dht", CANAL_DHT_BASE, 4, PERIODO_MUESTREO_MS, lecturasPorEntrega(modo, LECTURAS_DHT_POR_ENTREGA)},
+               {"onewire", CANAL_ONEWIRE_BASE, SENSORES_ONEWIRE, PERIODO_MUESTREO_MS,
+                lecturasPorEntrega(modo, LECTURAS_POR_ENTREGA)}},
+        tareaDistancia(distancia, grupos[GRUPO_DISTANCIA], canales), tareaDHT(dht, grupos[GRUPO_DHT], canales),
+        tareaOneWire(onewire, grupos[GRUPO_ONEWIRE], canales), muestras(0), descartadas(0), fallidas(0),
+        cantidadTrama(0), inicioTramaMs(0), secuencia(0)
+  {
+    activo = this;
+    relojSimuladoMs() = 0;
+    mqtt.setBufferSize(TAMANO_BUFFER_MQTT);
+
+    for (uint8_t canal = 0; canal < NUMERO_CANALES; canal++)
+    {
+      canales[canal].filtro = FiltroCanal(DESCRIPTORES_CANALES[canal]);
+      canales[canal].recientes = 0;
+    }
+
+    planificador.agregarTarea("distancia", PERIODO_MUESTREO_MS, ejecutarDistancia, 0);
+    planificador.agregarTarea("dht", PERIODO_MUESTREO_MS, ejecutarDHT, 200);
+    planificador.agregarTarea("onewire", PERIODO_MUESTREO_MS, ejecutarOneWire, 400);
+    planificador.iniciar(millis());
+  }
+
+  ~Banco(void)
+  {
+    activo = NULL;
+  }
+
+  /**
+   * @brief Recorre DURACION_BANCO_MS de operacion simulada
+   */
+  ResultadoBanco ejecutar(void)
+  {
+    HistogramaLatencia histograma;
+    ResultadoBanco resultado = {};
+    uint32_t reservasIniciales = reservasMemoria();
+    int64_t inicioUs = esp_timer_get_time();
+
+    while (millis() < DURACION_BANCO_MS)
+    {
+      int64_t inicioCicloUs = esp_timer_get_time();
+      planificador.ejecutar(millis());
+      atenderRed();
+      mqtt.loop();
+      histograma.registrarDesde(inicioCicloUs);
+      resultado.ciclos++;
+
+      uint32_t esperaMs = planificador.msHastaProximaTarea(millis());
+      avanzarRelojSimulado(esperaMs == 0 ? 1 : esperaMs < ESPERA_MAXIMA_CICLO_MS ? esperaMs : ESPERA_MAXIMA_CICLO_MS);
+    }
+    publicarTrama();
+    mqtt.loop();
+
+    int64_t duracionUs = esp_timer_get_time() - inicioUs;
+    resultado.reservas = reservasMemoria() - reservasIniciales;
+    resultado.cpuPorCicloUs = resultado.ciclos > 0 ? (double)duracionUs / resultado.ciclos : 0.0;
+    histograma.resumirYReiniciar(resultado.ciclo);
+    resultado.muestras = muestras;
+    resultado.descartadas = descartadas;
+    resultado.publicaciones = broker.publicaciones;
+    resultado.fallidas = fallidas;
+    resultado.confirmadas = qos.confirmadas();
+    resultado.bytes = broker.bytesRecibidos;
+    resultado.bytesCarga = broker.bytesCarga;
+    return resultado;
+  }
+
+  /// Lado de adquisicion: como encolarMuestra()
+  void encolar(uint8_t canal, float valor, int64_t instanteUs)
+  {
+    if (isnan(valor))
+    {
+      return;
+    }
+    Muestra muestra;
+    muestra.marcaTiempoUs = EPOCA_BANCO_US + instanteUs;
+    muestra.valor = valor;
+    muestra.canal = canal;
+    muestra.banderas = MUESTRA_UTC;
+    muestra.arranque = 1;
+    muestras++;
+    if (!cola.encolar(muestra))
+    {
+      descartadas++;
+    }
+  }
+
+  static Banco *activo; ///< Banco de la corrida en curso, para las funciones del planificador
+
+private:
+  /// Como LECTURAS_POR_ENTREGA(n) del firmware
+  static uint8_t lecturasPorEntrega(const ModoBanco &modo, uint8_t lecturas)
+  {
+    return modo.cadaMuestra ? 1 : lecturas;
+  }
+
+  static void ejecutarDistancia(uint32_t ahoraMs)
+  {
+    activo->tareaDistancia.ejecutar(ahoraMs);
+  }
+
+  static void ejecutarDHT(uint32_t ahoraMs)
+  {
+    activo->tareaDHT.ejecutar(ahoraMs);
+  }
+
+  static void ejecutarOneWire(uint32_t ahoraMs)
+  {
+    activo->tareaOneWire.ejecutar(ahoraMs);
+  }
+
+  /// Lado de red: vacia la cola como tareaRed()
+  void atenderRed(void)
+  {
+    Muestra muestra;
+    while (cola.desencolar(muestra))
+    {
+      if (modo.bandaMuerta &&
+          !reportes[muestra.canal].debePublicar(DESCRIPTORES_CANALES[muestra.canal].reporte, muestra.valor, millis()))
+      {
+        continue;
+      }
+
+      if (modo.publicacion == PUBLICACION_INDIVIDUAL)
+      {
+        publicarMuestra(muestra);
+      }
+      else
+      {
+        if (cantidadTrama >= MAX_MUESTRAS_TRAMA)
+        {
+          publicarTrama();
+        }
+        if (cantidadTrama == 0)
+        {
+          inicioTramaMs = millis();
+        }
+        trama[cantidadTrama++] = muestra;
+      }
+    }
+
+    if (cantidadTrama > 0 && millis() - inicioTramaMs >= PERIODO_TRAMA_MS)
+    {
+      publicarTrama();
+    }
+  }
+
+  bool publicarDatos(const char *topico, const uint8_t *carga, size_t longitud)
+  {
+    bool publicado;
+    if (modo.qos1)
+    {
+      if (qos.enVuelo() >= VENTANA_QOS1)
+      {
+        mqtt.loop();
+      }
+      publicado = qos.publicar(topico, carga, longitud);
+    }
+    else
+    {
+      publicado = mqtt.publish(topico, carga, (unsigned int)longitud);
+    }
+    if (!publicado)
+    {
+      fallidas++;
+    }
+    return publicado;
+  }
+
+  void publicarMuestra(const Muestra &muestra)
+  {
+    char carga[MAX_CARACTERES_CENTESIMAS];
+    size_t longitud = formatearCentesimas(carga, sizeof(carga), muestra.valor);
+    if (longitud > 0 && publicarDatos(TOPICOS_CANALES[muestra.canal], (const uint8_t *)carga, longitud))
+    {
+      reportes[muestra.canal].registrarPublicacion(muestra.valor, millis());
+    }
+  }
+
+  static bool escribirBloque(void *contexto, const uint8_t *datos, size_t longitud)
+  {
+    Banco *banco = static_cast<Banco *>(contexto);
+    return banco->modo.qos1 ? banco->qos.write(datos, longitud) == longitud
+                            : banco->mqtt.write(datos, longitud) == longitud;
+  }
+
+  /// Como publicarTrama() y publicarTramaPorFlujo()
+  void publicarTrama(void)
+  {
+    if (cantidadTrama == 0)
+    {
+      return;
+    }
+
+    FormatoTrama formato = modo.publicacion == PUBLICACION_LOTE_CBOR ? TRAMA_CBOR : TRAMA_JSON;
+    size_t longitud = codificarTrama(formato, bufferTrama, sizeof(bufferTrama), secuencia, trama, cantidadTrama);
+    bool publicada;
+    if (longitud > 0)
+    {
+      publicada = publicarDatos(TOPICO_TRAMA, bufferTrama, longitud);
+    }
+    else
+    {
+      size_t total = medirTrama(formato, secuencia, trama, cantidadTrama);
+      if (modo.qos1)
+      {
+        if (qos.enVuelo() >= VENTANA_QOS1)
+        {
+          mqtt.loop();
+        }
+        publicada = qos.iniciarPublicacion(TOPICO_TRAMA, total) != 0;
+      }
+      else
+      {
+        publicada = mqtt.beginPublish(TOPICO_TRAMA, (unsigned int)total, false);
+      }
+      publicada = publicada && emitirTrama(formato, bloqueTrama, sizeof(bloqueTrama), escribirBloque, this,
+                                           secuencia, trama, cantidadTrama);
+      publicada = modo.qos1 ? qos.terminarPublicacion() && publicada : mqtt.endPublish() == 1 && publicada;
+      if (!publicada)
+      {
+        fallidas++;
+      }
+    }
+    secuencia++;
+
+    if (publicada)
+    {
+      for (uint8_t i = 0; i < cantidadTrama; i++)
+      {
+        reportes[trama[i].canal].registrarPublicacion(trama[i].valor, millis());
+      }
+    }
+    cantidadTrama = 0;
+  }
+
+  const ModoBanco &modo;
+  BrokerSimulado broker;
+  ClienteQoS1 qos;
+  PubSubClient mqtt;
+
+  SensorSimulado distancia;
+  SensorSimulado dht;
+  SensorSimulado onewire;
+  DescriptorGrupo grupos[NUMERO_GRUPOS];
+  CanalFiltrado canales[NUMERO_CANALES];
+  TareaSensor<SensorSimulado, entregarBanco, relojSimuladoUs> tareaDistancia;
+  TareaSensor<SensorSimulado, entregarBanco, relojSimuladoUs> tareaDHT;
+  TareaSensor<SensorSimulado, entregarBanco, relojSimuladoUs> tareaOneWire;
+  Planificador planificador;
+
+  ColaSPSC<Muestra, CAPACIDAD_COLA_MUESTRAS> cola;
+  ReportePorCambio reportes[NUMERO_CANALES];
+  uint32_t muestras;
+  uint32_t descartadas;
+  uint32_t fallidas;
+
+  Muestra trama[MAX_MUESTRAS_TRAMA];
+  uint8_t cantidadTrama;
+  uint32_t inicioTramaMs;
+  uint32_t secuencia;
+  uint8_t bufferTrama[TAMANO_TRAMA];
+  uint8_t bloqueTrama[TAMANO_BLOQUE_TRAMA];
+};
+
+Banco *Banco::activo = NULL;
+
+static void entregarBanco(uint8_t canal, float valor, int64_t instanteUs)
+{
+  Banco::activo->encolar(canal, valor, instanteUs);
+}
+
+/**
+ * @brief Corre un modo, imprime su linea del informe y verifica las invariantes
+ */
+static void medirModo(const ModoBanco &modo)
+{
+  Banco *banco = new Banco(modo); // La arena de QoS 1 y los buffers no van en la pila
+  ResultadoBanco r = banco->ejecutar();
+  delete banco;
+
+  double segundos = DURACION_BANCO_MS / 1000.0;
+  printf("%-22s ciclo %7.3f us (p50 %u, p99 %u, max %u) | %7.2f pub/s | %8.1f B/s (%5.1f B/muestra, carga %4.1f%%)"
+         " | reservas %u\n",
+         modo.nombre, r.cpuPorCicloUs, (unsigned)r.ciclo.p50Us, (unsigned)r.ciclo.p99Us, (unsigned)r.ciclo.maximoUs,
+         r.publicaciones / segundos, r.bytes / segundos, r.muestras > 0 ? (double)r.bytes / r.muestras : 0.0,
+         r.bytes > 0 ? 100.0 * r.bytesCarga / r.bytes : 0.0, (unsigned)r.reservas);
+
+  TEST_ASSERT_GREATER_THAN_UINT32(0, r.publicaciones);
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, r.reservas, "La ruta de datos no debe reservar memoria");
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, r.descartadas, "Cola de muestras desbordada");
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, r.fallidas, "Publicaciones rechazadas por el cliente");
+  if (modo.qos1)
+  {
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(r.publicaciones, r.confirmadas, "PUBACK sin procesar");
+  }
+}
+
+static const ModoBanco MODO_INDIVIDUAL = {"individual", PUBLICACION_INDIVIDUAL, false, true, false};
+static const ModoBanco MODO_INDIVIDUAL_QOS1 = {"individual qos1", PUBLICACION_INDIVIDUAL, true, true, false};
+static const ModoBanco MODO_CADA_MUESTRA = {"cada muestra", PUBLICACION_INDIVIDUAL, false, false, true};
+static const ModoBanco MODO_LOTE_JSON = {"lote json", PUBLICACION_LOTE_JSON, false, true, false};
+static const ModoBanco MODO_LOTE_JSON_QOS1 = {"lote json qos1", PUBLICACION_LOTE_JSON, true, true, false};
+static const ModoBanco MODO_LOTE_CBOR = {"lote cbor", PUBLICACION_LOTE_CBOR, false, true, false};
+static const ModoBanco MODO_LOTE_CBOR_QOS1 = {"lote cbor qos1", PUBLICACION_LOTE_CBOR, true, true, false};
+static const ModoBanco MODO_LOTE_CBOR_CADA_MUESTRA = {"lote cbor cada muestra", PUBLICACION_LOTE_CBOR, true, false,
+                                                      true};
+
+void test_individual(void)
+{
+  medirModo(MODO_INDIVIDUAL);
+}
+
+void test_individual_qos1(void)
+{
+  medirModo(MODO_INDIVIDUAL_QOS1);
+}
+
+void test_cada_muestra(void)
+{
+  medirModo(MODO_CADA_MUESTRA);
+}
+
+void test_lote_json(void)
+{
+  medirModo(MODO_LOTE_JSON);
+}
+
+void test_lote_json_qos1(void)
+{
+  medirModo(MODO_LOTE_JSON_QOS1);
+}
+
+void test_lote_cbor(void)
+{
+  medirModo(MODO_LOTE_CBOR);
+}
+
+void test_lote_cbor_qos1(void)
+{
+  medirModo(MODO_LOTE_CBOR_QOS1);
+}
+
+void test_lote_cbor_cada_muestra(void)
+{
+  medirModo(MODO_LOTE_CBOR_CADA_MUESTRA);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_individual);
+  RUN_TEST(test_individual_qos1);
+  RUN_TEST(test_cada_muestra);
+  RUN_TEST(test_lote_json);
+  RUN_TEST(test_lote_json_qos1);
+  RUN_TEST(test_lote_cbor);
+  RUN_TEST(test_lote_cbor_qos1);
+  RUN_TEST(test_lote_cbor_cada_muestra);
+  return UNITY_END();
+}